@@ -11,6 +11,7 @@
 #include <cstring>
 #include <iomanip> // std::get_time
 #include <iterator> // std::size
+#include <limits>
 #include <sstream> // std::istringstream
 #include <string_view>
 
@@ -27,6 +28,7 @@
 #if defined(CONF_FAMILY_UNIX)
 #include <csignal>
 #include <locale>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/utsname.h>
@@ -106,6 +108,22 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+#ifdef CONF_PLATFORM_LINUX
+/* outgoing packets collected between net_udp_batch_begin and net_udp_batch_flush */
+typedef struct
+{
+	bool active;
+	int count;
+	int num_queued;
+	int num_syscalls;
+	int socks[VLEN];
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	struct sockaddr_storage sockaddrs[VLEN];
+} NETSOCKET_SEND_QUEUE;
+#endif
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -114,6 +132,9 @@ struct NETSOCKET_INTERNAL
 	int web_ipv4sock;
 
 	NETSOCKET_BUFFER buffer;
+#ifdef CONF_PLATFORM_LINUX
+	NETSOCKET_SEND_QUEUE *send_queue;
+#endif
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1};
 
@@ -339,6 +360,52 @@ char *io_read_all_str(IOHANDLE io)
 	return (char *)buffer;
 }
 
+bool io_map(IOHANDLE io, void **result, unsigned *result_len)
+{
+	*result = nullptr;
+	*result_len = 0;
+
+	const int64_t length = io_length(io);
+	if(length <= 0 || length > std::numeric_limits<unsigned>::max())
+		return false;
+
+#if defined(CONF_FAMILY_WINDOWS)
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE *)io));
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if(mapping == nullptr)
+		return false;
+	void *data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, length);
+	// the view keeps the mapping alive
+	CloseHandle(mapping);
+	if(data == nullptr)
+		return false;
+#else
+	// no MAP_POPULATE, it write-faults every page of a private writable
+	// mapping and turns the whole file into anonymous memory. Pages that
+	// are only read stay in the page cache and are shared between processes.
+	void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno((FILE *)io), 0);
+	if(data == MAP_FAILED)
+		return false;
+	// the whole file is usually read right away, start reading it ahead
+	madvise(data, length, MADV_WILLNEED);
+#endif
+
+	*result = data;
+	*result_len = length;
+	return true;
+}
+
+void io_unmap(void *data, unsigned len)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	UnmapViewOfFile(data);
+#else
+	munmap(data, len);
+#endif
+}
+
 int io_skip(IOHANDLE io, int64_t size)
 {
 	return io_seek(io, size, IOSEEK_CUR);
@@ -1671,10 +1738,110 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+#ifdef CONF_PLATFORM_LINUX
+static void priv_net_udp_send_queued(NETSOCKET sock)
+{
+	NETSOCKET_SEND_QUEUE *queue = sock->send_queue;
+	int i = 0;
+	while(i < queue->count)
+	{
+		/* sendmmsg only takes one socket, so send runs of the same one */
+		int num = 1;
+		while(i + num < queue->count && queue->socks[i + num] == queue->socks[i])
+			num++;
+		int sent = sendmmsg(queue->socks[i], &queue->msgs[i], num, 0);
+		queue->num_syscalls++;
+		/* drop a packet that can't be sent, like a failing sendto would */
+		i += sent > 0 ? sent : 1;
+	}
+	queue->count = 0;
+}
+
+static bool priv_net_udp_queue(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
+{
+	NETSOCKET_SEND_QUEUE *queue = sock->send_queue;
+	if(size > PACKETSIZE || (addr->type != NETTYPE_IPV4 && addr->type != NETTYPE_IPV6))
+		return false;
+
+	int fd = addr->type == NETTYPE_IPV4 ? sock->ipv4sock : sock->ipv6sock;
+	if(fd < 0)
+		return false;
+
+	if(queue->count == VLEN)
+		priv_net_udp_send_queued(sock);
+
+	int i = queue->count;
+	socklen_t namelen;
+	if(addr->type == NETTYPE_IPV4)
+	{
+		netaddr_to_sockaddr_in(addr, (struct sockaddr_in *)&queue->sockaddrs[i]);
+		namelen = sizeof(struct sockaddr_in);
+	}
+	else
+	{
+		netaddr_to_sockaddr_in6(addr, (struct sockaddr_in6 *)&queue->sockaddrs[i]);
+		namelen = sizeof(struct sockaddr_in6);
+	}
+	mem_copy(queue->bufs[i], data, size);
+	queue->iovecs[i].iov_base = queue->bufs[i];
+	queue->iovecs[i].iov_len = size;
+	mem_zero(&queue->msgs[i], sizeof(queue->msgs[i]));
+	queue->msgs[i].msg_hdr.msg_name = &queue->sockaddrs[i];
+	queue->msgs[i].msg_hdr.msg_namelen = namelen;
+	queue->msgs[i].msg_hdr.msg_iov = &queue->iovecs[i];
+	queue->msgs[i].msg_hdr.msg_iovlen = 1;
+	queue->socks[i] = fd;
+	queue->count++;
+	queue->num_queued++;
+	return true;
+}
+#endif
+
+void net_udp_batch_begin(NETSOCKET sock)
+{
+#ifdef CONF_PLATFORM_LINUX
+	if(!sock->send_queue)
+	{
+		sock->send_queue = (NETSOCKET_SEND_QUEUE *)malloc(sizeof(*sock->send_queue));
+		sock->send_queue->count = 0;
+	}
+	sock->send_queue->active = true;
+	sock->send_queue->num_queued = 0;
+	sock->send_queue->num_syscalls = 0;
+#endif
+}
+
+int net_udp_batch_flush(NETSOCKET sock)
+{
+#ifdef CONF_PLATFORM_LINUX
+	if(!sock->send_queue || !sock->send_queue->active)
+		return 0;
+	sock->send_queue->active = false;
+	priv_net_udp_send_queued(sock);
+	return sock->send_queue->num_queued - sock->send_queue->num_syscalls;
+#else
+	return 0;
+#endif
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
 
+#ifdef CONF_PLATFORM_LINUX
+	if(sock->send_queue && sock->send_queue->active)
+	{
+		if(priv_net_udp_queue(sock, addr, data, size))
+		{
+			network_stats.sent_bytes += size;
+			network_stats.sent_packets++;
+			return size;
+		}
+		/* keep the order of packets that can't be queued */
+		priv_net_udp_send_queued(sock);
+	}
+#endif
+
 	if(addr->type & NETTYPE_IPV4)
 	{
 		if(sock->ipv4sock >= 0)
@@ -1876,6 +2043,13 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 int net_udp_close(NETSOCKET sock)
 {
+#ifdef CONF_PLATFORM_LINUX
+	if(sock->send_queue)
+	{
+		priv_net_udp_send_queued(sock);
+		free(sock->send_queue);
+	}
+#endif
 	return priv_net_close_all_sockets(sock);
 }
 
@@ -2559,6 +2733,26 @@ int fs_file_time(const char *name, time_t *created, time_t *modified)
 	return 0;
 }
 
+int fs_file_touch(const char *name)
+{
+#if defined(CONF_FAMILY_WINDOWS)
+	const std::wstring wide_name = windows_utf8_to_wide(name);
+	HANDLE handle = CreateFileW(wide_name.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(handle == INVALID_HANDLE_VALUE)
+		return 1;
+
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	const BOOL result = SetFileTime(handle, nullptr, nullptr, &now);
+	CloseHandle(handle);
+	return result ? 0 : 1;
+#elif defined(CONF_FAMILY_UNIX)
+	return utimes(name, nullptr) != 0;
+#else
+#error not implemented
+#endif
+}
+
 void swap_endian(void *data, unsigned elem_size, unsigned num)
 {
 	char *src = (char *)data;
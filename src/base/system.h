@@ -327,6 +327,36 @@ bool io_read_all(IOHANDLE io, void **result, unsigned *result_len);
  */
 char *io_read_all_str(IOHANDLE io);
 
+/**
+ * Maps the whole file into memory.
+ *
+ * @ingroup File-IO
+ *
+ * @param io Handle to the file to map.
+ * @param result Receives the address of the file's contents.
+ * @param result_len Receives the file's length.
+ *
+ * @return `true` on success, `false` on failure.
+ *
+ * @remark The mapping is private, changes to it are not written back
+ * to the file. It stays valid after the file has been closed.
+ * @remark Pages are only copied when they are written to, until then
+ * processes which map the same file share its memory.
+ * @remark The mapping must be released with io_unmap.
+ * @remark Empty files can't be mapped.
+ */
+bool io_map(IOHANDLE io, void **result, unsigned *result_len);
+
+/**
+ * Releases a mapping created by io_map.
+ *
+ * @ingroup File-IO
+ *
+ * @param data Address of the mapping.
+ * @param len Length of the mapping.
+ */
+void io_unmap(void *data, unsigned len);
+
 /**
  * Skips data in a file.
  *
@@ -952,6 +982,32 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Starts collecting the packets sent over an UDP socket instead of sending
+ * them one by one, until @link net_udp_batch_flush @endlink is called.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @remark Without `sendmmsg` (non-Linux platforms) packets are still sent
+ * right away.
+ */
+void net_udp_batch_begin(NETSOCKET sock);
+
+/**
+ * Sends the packets collected since @link net_udp_batch_begin @endlink with
+ * as few system calls as possible and stops collecting.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to use.
+ *
+ * @return The number of system calls saved compared to sending each packet
+ * separately.
+ */
+int net_udp_batch_flush(NETSOCKET sock);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
@@ -2124,6 +2180,19 @@ int fs_rename(const char *oldname, const char *newname);
  */
 int fs_file_time(const char *name, time_t *created, time_t *modified);
 
+/**
+ * Sets the last modification date of a file to the current time.
+ *
+ * @ingroup Filesystem
+ *
+ * @param name Path of the file.
+ *
+ * @return 0 on success, non-zero on failure.
+ *
+ * @remark The strings are treated as zero-terminated strings.
+ */
+int fs_file_touch(const char *name);
+
 /*
 	Group: Undocumented
 */
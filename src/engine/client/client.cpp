@@ -825,10 +825,11 @@ void CClient::LoadDebugFont()
 IClient::CSnapItem CClient::SnapGetItem(int SnapId, int Index) const
 {
 	dbg_assert(SnapId >= 0 && SnapId < NUM_SNAPSHOT_TYPES, "invalid SnapId");
-	const CSnapshot *pSnapshot = m_aapSnapshots[g_Config.m_ClDummy][SnapId]->m_pAltSnap;
+	const CSnapshotStorage::CHolder *pHolder = m_aapSnapshots[g_Config.m_ClDummy][SnapId];
+	const CSnapshot *pSnapshot = pHolder->m_pAltSnap;
 	const CSnapshotItem *pSnapshotItem = pSnapshot->GetItem(Index);
 	CSnapItem Item;
-	Item.m_Type = pSnapshot->GetItemType(Index);
+	Item.m_Type = pHolder->m_pAltIndex->GetItemType(Index);
 	Item.m_Id = pSnapshotItem->Id();
 	Item.m_pData = pSnapshotItem->Data();
 	Item.m_DataSize = pSnapshot->GetItemSize(Index);
@@ -840,7 +841,7 @@ const void *CClient::SnapFindItem(int SnapId, int Type, int Id) const
 	if(!m_aapSnapshots[g_Config.m_ClDummy][SnapId])
 		return nullptr;
 
-	return m_aapSnapshots[g_Config.m_ClDummy][SnapId]->m_pAltSnap->FindItem(Type, Id);
+	return m_aapSnapshots[g_Config.m_ClDummy][SnapId]->m_pAltIndex->FindItem(Type, Id);
 }
 
 int CClient::SnapNumItems(int SnapId) const
@@ -2622,6 +2623,7 @@ void CClient::OnDemoPlayerSnapshot(void *pData, int Size)
 	std::swap(m_aapSnapshots[0][SNAP_PREV], m_aapSnapshots[0][SNAP_CURRENT]);
 	mem_copy(m_aapSnapshots[0][SNAP_CURRENT]->m_pSnap, pData, Size);
 	mem_copy(m_aapSnapshots[0][SNAP_CURRENT]->m_pAltSnap, pAltSnapBuffer, AltSnapSize);
+	m_aapSnapshots[0][SNAP_CURRENT]->m_pAltIndex->Build(m_aapSnapshots[0][SNAP_CURRENT]->m_pAltSnap);
 
 	GameClient()->OnNewSnapshot();
 }
@@ -3919,6 +3921,8 @@ const char *CClient::DemoPlayer_Play(const char *pFilename, int StorageType)
 		m_aapSnapshots[0][SnapshotType] = &m_aDemorecSnapshotHolders[SnapshotType];
 		m_aapSnapshots[0][SnapshotType]->m_pSnap = (CSnapshot *)&m_aaaDemorecSnapshotData[SnapshotType][0];
 		m_aapSnapshots[0][SnapshotType]->m_pAltSnap = (CSnapshot *)&m_aaaDemorecSnapshotData[SnapshotType][1];
+		m_aapSnapshots[0][SnapshotType]->m_pAltIndex = &m_aDemorecSnapshotIndices[SnapshotType];
+		m_aapSnapshots[0][SnapshotType]->m_pAltIndex->Build(m_aapSnapshots[0][SnapshotType]->m_pAltSnap);
 		m_aapSnapshots[0][SnapshotType]->m_SnapSize = 0;
 		m_aapSnapshots[0][SnapshotType]->m_AltSnapSize = 0;
 		m_aapSnapshots[0][SnapshotType]->m_Tick = -1;
@@ -4032,7 +4036,7 @@ void CClient::DemoRecorder_HandleAutoStart()
 		{
 			// clean up auto recorded demos
 			CFileCollection AutoDemos;
-			AutoDemos.Init(Storage(), "demos/auto", "" /* empty for wild card */, ".demo", g_Config.m_ClAutoDemoMax);
+			AutoDemos.Init(Storage(), "demos/auto", "" /* empty for wild card */, ".demo", g_Config.m_ClAutoDemoMax, RemoveDemoFile);
 		}
 	}
 
@@ -203,6 +203,7 @@ public:
 		int m_aSnapshotIncomingDataSize[NUM_DUMMIES] = {0, 0};
 
 		CSnapshotStorage::CHolder m_aDemorecSnapshotHolders[NUM_SNAPSHOT_TYPES];
+		CSnapshotItemIndex m_aDemorecSnapshotIndices[NUM_SNAPSHOT_TYPES];
 		char m_aaaDemorecSnapshotData[NUM_SNAPSHOT_TYPES][2][CSnapshot::MAX_SIZE];
 
 		CSnapshotDelta m_SnapshotDelta;
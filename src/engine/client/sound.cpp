@@ -10,6 +10,7 @@
 #include <engine/storage.h>
 
 #include "sound.h"
+#include "sound_mix.h"
 
 #if defined(CONF_VIDEORECORDER)
 #include <engine/shared/video.h>
@@ -24,28 +25,19 @@ extern "C" {
 static constexpr int SAMPLE_INDEX_USED = -2;
 static constexpr int SAMPLE_INDEX_FULL = -1;
 
-void CSound::Mix(short *pFinalOut, unsigned Frames)
+int CSound::CollectMixVoices(unsigned Frames)
 {
-	Frames = minimum(Frames, m_MaxFrames);
-	mem_zero(m_pMixBuffer, Frames * 2 * sizeof(int));
-
-	// acquire lock while we are mixing
-	m_SoundLock.lock();
+	const CLockScope LockScope(m_SoundLock);
 
-	const int MasterVol = m_SoundVolume.load(std::memory_order_relaxed);
+	ReleaseStreams();
 
+	int NumMixVoices = 0;
+	bool Streaming = false;
 	for(auto &Voice : m_aVoices)
 	{
 		if(!Voice.m_pSample)
 			continue;
 
-		// mix voice
-		int *pOut = m_pMixBuffer;
-
-		const int Step = Voice.m_pSample->m_Channels; // setup input sources
-		short *pInL = &Voice.m_pSample->m_pData[Voice.m_Tick * Step];
-		short *pInR = &Voice.m_pSample->m_pData[Voice.m_Tick * Step + 1];
-
 		unsigned End = Voice.m_pSample->m_NumFrames - Voice.m_Tick;
 
 		int VolumeR = round_truncate(Voice.m_pChannel->m_Vol * (Voice.m_Vol / 255.0f));
@@ -55,10 +47,6 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 		if(Frames < End)
 			End = Frames;
 
-		// check if we have a mono sound
-		if(Voice.m_pSample->m_Channels == 1)
-			pInR = pInL;
-
 		// volume calculation
 		if(Voice.m_Flags & ISound::FLAG_POS && Voice.m_pChannel->m_Pan)
 		{
@@ -131,15 +119,40 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 			}
 		}
 
-		// process all frames
-		for(unsigned s = 0; s < End; s++)
+		// silent voices only advance
+		if(End > 0 && (VolumeL != 0 || VolumeR != 0))
+		{
+			const short *pData;
+			unsigned MixFrames = End;
+			if(Voice.m_pSample->IsStreamed())
+			{
+				// the voice keeps its time if the stream has fewer frames,
+				// the missing ones are silent
+				pData = ReadStream(&Voice - m_aVoices, Voice, End, &MixFrames);
+				Streaming = true;
+			}
+			else
+			{
+				pData = &Voice.m_pSample->m_pData[Voice.m_Tick * Voice.m_pSample->m_Channels];
+			}
+
+			if(MixFrames > 0)
+			{
+				CMixVoice &MixVoice = m_aMixVoices[NumMixVoices++];
+				MixVoice.m_pData = pData;
+				MixVoice.m_Channels = Voice.m_pSample->m_Channels;
+				MixVoice.m_Frames = MixFrames;
+				MixVoice.m_VolumeL = VolumeL;
+				MixVoice.m_VolumeR = VolumeR;
+			}
+		}
+		else if(Voice.m_pSample->IsStreamed())
 		{
-			*pOut++ += (*pInL) * VolumeL;
-			*pOut++ += (*pInR) * VolumeR;
-			pInL += Step;
-			pInR += Step;
-			Voice.m_Tick++;
+			// give the stream to audible voices, it seeks to the voice's
+			// tick when the voice becomes audible again
+			ReleaseStream(&Voice - m_aVoices);
 		}
+		Voice.m_Tick += End;
 
 		// free voice if not used any more
 		if(Voice.m_Tick == Voice.m_pSample->m_NumFrames)
@@ -154,11 +167,249 @@ void CSound::Mix(short *pFinalOut, unsigned Frames)
 		}
 	}
 
-	m_SoundLock.unlock();
+	// let the stream thread refill the consumed frames
+	if(Streaming)
+		m_StreamSemaphore.Signal();
+	return NumMixVoices;
+}
+
+void CSound::ReleaseStreams()
+{
+	for(auto &Stream : m_aStreams)
+	{
+		if(Stream.m_VoiceId == -1)
+			continue;
+		const CVoice &Voice = m_aVoices[Stream.m_VoiceId];
+		if(Voice.m_pSample == Stream.m_pVoiceSample && Voice.m_Age == Stream.m_VoiceAge)
+			continue;
+		ReleaseStream(Stream);
+	}
+}
+
+void CSound::ReleaseStream(int VoiceId)
+{
+	for(auto &Stream : m_aStreams)
+	{
+		if(Stream.m_VoiceId == VoiceId)
+		{
+			ReleaseStream(Stream);
+			break;
+		}
+	}
+}
+
+void CSound::ReleaseStream(CSoundStream &Stream)
+{
+	Stream.m_VoiceId = -1;
+	Stream.m_pVoiceSample = nullptr;
+	const CLockScope LockScope(Stream.m_Lock);
+	Stream.m_pSample = nullptr;
+	Stream.m_Generation++;
+}
+
+const short *CSound::ReadStream(int VoiceId, const CVoice &Voice, unsigned Frames, unsigned *pNumFrames)
+{
+	*pNumFrames = 0;
+
+	CSoundStream *pStream = nullptr;
+	CSoundStream *pFreeStream = nullptr;
+	for(auto &Stream : m_aStreams)
+	{
+		if(Stream.m_VoiceId == VoiceId)
+		{
+			pStream = &Stream;
+			break;
+		}
+		if(!pFreeStream && Stream.m_VoiceId == -1)
+			pFreeStream = &Stream;
+	}
+	if(!pStream)
+	{
+		// the voice stays silent if all streams are in use
+		if(!pFreeStream)
+			return nullptr;
+		pStream = pFreeStream;
+		pStream->m_VoiceId = VoiceId;
+		pStream->m_VoiceAge = Voice.m_Age;
+		pStream->m_pVoiceSample = Voice.m_pSample;
+	}
+
+	const CLockScope LockScope(pStream->m_Lock);
+	const int SampleFrames = Voice.m_pSample->m_NumFrames;
+	int Behind = Voice.m_Tick - pStream->m_ReadTick;
+	if(Behind < 0 && pStream->m_Loop)
+		Behind += SampleFrames;
+	if(pStream->m_pSample != Voice.m_pSample || Behind < 0 || Behind >= STREAM_RING_FRAMES)
+	{
+		// new voice or the voice was moved, decode from its tick
+		pStream->m_pSample = Voice.m_pSample;
+		pStream->m_StartTick = Voice.m_Tick;
+		pStream->m_Loop = Voice.m_Flags & ISound::FLAG_LOOP;
+		pStream->m_Generation++;
+		pStream->m_ReadPos = 0;
+		pStream->m_NumFrames = 0;
+		pStream->m_ReadTick = Voice.m_Tick;
+		return nullptr;
+	}
+
+	const auto &&Consume = [&](int NumFrames) {
+		pStream->m_ReadPos = (pStream->m_ReadPos + NumFrames) % STREAM_RING_FRAMES;
+		pStream->m_NumFrames -= NumFrames;
+		pStream->m_ReadTick += NumFrames;
+		if(pStream->m_Loop && pStream->m_ReadTick >= SampleFrames)
+			pStream->m_ReadTick -= SampleFrames;
+	};
+
+	// the voice went on while the decoder lagged behind, drop the frames
+	// it missed
+	if(Behind > 0)
+	{
+		const int Skip = minimum(Behind, pStream->m_NumFrames);
+		Consume(Skip);
+		if(Skip < Behind)
+			return nullptr;
+	}
+
+	const int Channels = Voice.m_pSample->m_Channels;
+	const int NumFrames = minimum<int>(Frames, pStream->m_NumFrames);
+	const int FirstPart = minimum<int>(NumFrames, STREAM_RING_FRAMES - pStream->m_ReadPos);
+	mem_copy(pStream->m_pMixData, pStream->m_pRing + pStream->m_ReadPos * Channels, FirstPart * Channels * sizeof(short));
+	mem_copy(pStream->m_pMixData + FirstPart * Channels, pStream->m_pRing, (NumFrames - FirstPart) * Channels * sizeof(short));
+	Consume(NumFrames);
+
+	*pNumFrames = NumFrames;
+	return pStream->m_pMixData;
+}
+
+void CSound::StreamThread(void *pUser)
+{
+	CSound *pSelf = static_cast<CSound *>(pUser);
+	while(true)
+	{
+		pSelf->m_StreamSemaphore.Wait();
+		if(pSelf->m_StopStreamThread.load())
+			break;
+		pSelf->DecodeStreams();
+	}
+}
+
+void CSound::DecodeStreams()
+{
+	const CLockScope DecodeLockScope(m_StreamDecodeLock);
+	for(auto &Stream : m_aStreams)
+	{
+		CSample *pSample;
+		int Generation;
+		int StartTick;
+		bool Loop;
+		int FreeFrames;
+		{
+			const CLockScope LockScope(Stream.m_Lock);
+			pSample = Stream.m_pSample;
+			Generation = Stream.m_Generation;
+			StartTick = Stream.m_StartTick;
+			Loop = Stream.m_Loop;
+			FreeFrames = STREAM_RING_FRAMES - Stream.m_NumFrames;
+		}
+
+		if(Generation != Stream.m_FileGeneration)
+		{
+			Stream.m_FileGeneration = Generation;
+			if(Stream.m_pFileSample != pSample)
+			{
+				if(Stream.m_pFile)
+					op_free(Stream.m_pFile);
+				Stream.m_pFile = pSample ? op_open_memory(pSample->m_pStreamData, pSample->m_StreamDataSize, nullptr) : nullptr;
+				Stream.m_pFileSample = Stream.m_pFile ? pSample : nullptr;
+			}
+			if(Stream.m_pFile)
+			{
+				op_pcm_seek(Stream.m_pFile, StartTick);
+				Stream.m_FileTick = StartTick;
+			}
+		}
+		if(!Stream.m_pFile || FreeFrames == 0)
+			continue;
+
+		const int Channels = pSample->m_Channels;
+		const int WantedFrames = minimum<int>(FreeFrames, STREAM_DECODE_FRAMES);
+		int NumFrames = 0;
+		while(NumFrames < WantedFrames)
+		{
+			if(Stream.m_FileTick >= pSample->m_NumFrames)
+			{
+				if(!Loop)
+					break;
+				op_pcm_seek(Stream.m_pFile, 0);
+				Stream.m_FileTick = 0;
+			}
+			const int Read = op_read(Stream.m_pFile, m_pStreamDecodeBuffer + NumFrames * Channels, minimum(WantedFrames - NumFrames, pSample->m_NumFrames - Stream.m_FileTick) * Channels, nullptr);
+			if(Read <= 0)
+			{
+				// stop decoding, the file is opened again when the voice has to be moved
+				if(Read < 0)
+					dbg_msg("sound/opus", "op_read error %d at %d while streaming", Read, Stream.m_FileTick);
+				op_free(Stream.m_pFile);
+				Stream.m_pFile = nullptr;
+				Stream.m_pFileSample = nullptr;
+				break;
+			}
+			NumFrames += Read;
+			Stream.m_FileTick += Read;
+		}
+		if(NumFrames == 0)
+			continue;
+
+		const CLockScope LockScope(Stream.m_Lock);
+		if(Stream.m_Generation != Generation)
+			continue;
+		const int WritePos = (Stream.m_ReadPos + Stream.m_NumFrames) % STREAM_RING_FRAMES;
+		const int FirstPart = minimum<int>(NumFrames, STREAM_RING_FRAMES - WritePos);
+		mem_copy(Stream.m_pRing + WritePos * Channels, m_pStreamDecodeBuffer, FirstPart * Channels * sizeof(short));
+		mem_copy(Stream.m_pRing, m_pStreamDecodeBuffer + FirstPart * Channels, (NumFrames - FirstPart) * Channels * sizeof(short));
+		Stream.m_NumFrames += NumFrames;
+	}
+}
+
+void CSound::CloseStreams(const CSample *pSample)
+{
+	for(auto &Stream : m_aStreams)
+	{
+		if(pSample && Stream.m_pVoiceSample != pSample && Stream.m_pFileSample != pSample)
+			continue;
+		if(Stream.m_pFile)
+			op_free(Stream.m_pFile);
+		Stream.m_pFile = nullptr;
+		Stream.m_pFileSample = nullptr;
+		Stream.m_FileGeneration = -1;
+		Stream.m_VoiceId = -1;
+		Stream.m_pVoiceSample = nullptr;
+		const CLockScope LockScope(Stream.m_Lock);
+		Stream.m_pSample = nullptr;
+		Stream.m_Generation++;
+	}
+}
+
+void CSound::Mix(short *pFinalOut, unsigned Frames)
+{
+	Frames = minimum(Frames, m_MaxFrames);
+	mem_zero(m_pMixBuffer, Frames * 2 * sizeof(int));
+
+	// the sound lock is only held while collecting the voices, the sample
+	// data stays valid until the mix lock is released
+	const CLockScope LockScope(m_MixLock);
+	const int NumMixVoices = CollectMixVoices(Frames);
+	for(int i = 0; i < NumMixVoices; i++)
+	{
+		const CMixVoice &MixVoice = m_aMixVoices[i];
+		if(MixVoice.m_Channels == 1)
+			SoundMixMono(m_pMixBuffer, MixVoice.m_pData, MixVoice.m_Frames, MixVoice.m_VolumeL, MixVoice.m_VolumeR);
+		else
+			SoundMixStereo(m_pMixBuffer, MixVoice.m_pData, MixVoice.m_Frames, MixVoice.m_VolumeL, MixVoice.m_VolumeR);
+	}
 
 	// clamp accumulated values
-	for(unsigned i = 0; i < Frames * 2; i++)
-		pFinalOut[i] = clamp<int>(((m_pMixBuffer[i] * MasterVol) / 101) >> 8, std::numeric_limits<short>::min(), std::numeric_limits<short>::max());
+	SoundMixClamp(pFinalOut, m_pMixBuffer, Frames * 2, m_SoundVolume.load(std::memory_order_relaxed));
 
 #if defined(CONF_ARCH_ENDIAN_BIG)
 	swap_endian(pFinalOut, sizeof(short), Frames * 2);
@@ -198,6 +449,7 @@ int CSound::Init()
 		m_aSamples[i].m_Index = i;
 		m_aSamples[i].m_NextFreeSampleIndex = i + 1;
 		m_aSamples[i].m_pData = nullptr;
+		m_aSamples[i].m_pStreamData = nullptr;
 	}
 	m_aSamples[std::size(m_aSamples) - 1].m_Index = std::size(m_aSamples) - 1;
 	m_aSamples[std::size(m_aSamples) - 1].m_NextFreeSampleIndex = SAMPLE_INDEX_FULL;
@@ -236,6 +488,20 @@ int CSound::Init()
 #endif
 	m_pMixBuffer = (int *)calloc(m_MaxFrames * 2, sizeof(int));
 
+	// the streams decode at the opus sample rate, other rates need the resampled samples
+	if(m_MixingRate == 48000)
+	{
+		for(auto &Stream : m_aStreams)
+		{
+			const CLockScope StreamLockScope(Stream.m_Lock);
+			Stream.m_pRing = (short *)calloc(STREAM_RING_FRAMES * 2, sizeof(short));
+			Stream.m_pMixData = (short *)calloc(m_MaxFrames * 2, sizeof(short));
+		}
+		m_pStreamDecodeBuffer = (short *)calloc(STREAM_DECODE_FRAMES * 2, sizeof(short));
+		m_StopStreamThread.store(false);
+		m_pStreamThread = thread_init(StreamThread, this, "sound stream");
+	}
+
 	m_SoundEnabled = true;
 	Update();
 
@@ -266,11 +532,37 @@ void CSound::Shutdown()
 	SDL_QuitSubSystem(SDL_INIT_AUDIO);
 	m_Device = 0;
 
+	if(m_pStreamThread)
+	{
+		m_StopStreamThread.store(true);
+		m_StreamSemaphore.Signal();
+		thread_wait(m_pStreamThread);
+		m_pStreamThread = nullptr;
+	}
+
+	const CLockScope MixLockScope(m_MixLock);
 	const CLockScope LockScope(m_SoundLock);
+	{
+		const CLockScope DecodeLockScope(m_StreamDecodeLock);
+		CloseStreams(nullptr);
+	}
+	for(auto &Stream : m_aStreams)
+	{
+		const CLockScope StreamLockScope(Stream.m_Lock);
+		free(Stream.m_pRing);
+		Stream.m_pRing = nullptr;
+		free(Stream.m_pMixData);
+		Stream.m_pMixData = nullptr;
+	}
+	free(m_pStreamDecodeBuffer);
+	m_pStreamDecodeBuffer = nullptr;
+
 	for(auto &Sample : m_aSamples)
 	{
 		free(Sample.m_pData);
 		Sample.m_pData = nullptr;
+		free(Sample.m_pStreamData);
+		Sample.m_pStreamData = nullptr;
 	}
 
 	free(m_pMixBuffer);
@@ -285,7 +577,7 @@ CSample *CSound::AllocSample()
 		return nullptr;
 
 	CSample *pSample = &m_aSamples[m_FirstFreeSampleIndex];
-	if(pSample->m_pData != nullptr || pSample->m_NextFreeSampleIndex == SAMPLE_INDEX_USED)
+	if(pSample->IsLoaded() || pSample->m_NextFreeSampleIndex == SAMPLE_INDEX_USED)
 	{
 		char aError[128];
 		str_format(aError, sizeof(aError), "Sample was not unloaded (index=%d, next=%d, duration=%f, data=%p)",
@@ -333,7 +625,7 @@ void CSound::RateConvert(CSample &Sample) const
 	Sample.m_Rate = m_MixingRate;
 }
 
-bool CSound::DecodeOpus(CSample &Sample, const void *pData, unsigned DataSize) const
+bool CSound::DecodeOpus(CSample &Sample, const void *pData, unsigned DataSize, bool AllowStreaming) const
 {
 	int OpusError = 0;
 	OggOpusFile *pOpusFile = op_open_memory((const unsigned char *)pData, DataSize, &OpusError);
@@ -355,6 +647,23 @@ bool CSound::DecodeOpus(CSample &Sample, const void *pData, unsigned DataSize) c
 			return false;
 		}
 
+		Sample.m_Rate = 48000;
+		Sample.m_Channels = NumChannels;
+		Sample.m_LoopStart = -1;
+		Sample.m_LoopEnd = -1;
+		Sample.m_PausedAt = 0;
+
+		// keep long samples encoded, they are decoded while playing
+		if(AllowStreaming && m_pStreamThread && NumSamples >= STREAM_MIN_FRAMES)
+		{
+			op_free(pOpusFile);
+			Sample.m_pStreamData = (unsigned char *)malloc(DataSize);
+			mem_copy(Sample.m_pStreamData, pData, DataSize);
+			Sample.m_StreamDataSize = DataSize;
+			Sample.m_NumFrames = NumSamples;
+			return true;
+		}
+
 		short *pSampleData = (short *)calloc((size_t)NumSamples * NumChannels, sizeof(short));
 
 		int Pos = 0;
@@ -377,11 +686,6 @@ bool CSound::DecodeOpus(CSample &Sample, const void *pData, unsigned DataSize) c
 
 		Sample.m_pData = pSampleData;
 		Sample.m_NumFrames = Pos;
-		Sample.m_Rate = 48000;
-		Sample.m_Channels = NumChannels;
-		Sample.m_LoopStart = -1;
-		Sample.m_LoopEnd = -1;
-		Sample.m_PausedAt = 0;
 	}
 	else
 	{
@@ -540,7 +844,7 @@ int CSound::LoadOpus(const char *pFilename, int StorageType)
 		return -1;
 	}
 
-	const bool DecodeSuccess = DecodeOpus(*pSample, pData, DataSize);
+	const bool DecodeSuccess = DecodeOpus(*pSample, pData, DataSize, true);
 	free(pData);
 	if(!DecodeSuccess)
 	{
@@ -602,7 +906,7 @@ int CSound::LoadOpusFromMem(const void *pData, unsigned DataSize, bool ForceLoad
 	if(!pSample)
 		return -1;
 
-	if(!DecodeOpus(*pSample, pData, DataSize))
+	if(!DecodeOpus(*pSample, pData, DataSize, true))
 	{
 		UnloadSample(pSample->m_Index);
 		return -1;
@@ -638,6 +942,8 @@ void CSound::UnloadSample(int SampleId)
 		return;
 
 	dbg_assert(SampleId >= 0 && SampleId < NUM_SAMPLES, "SampleId invalid");
+	// wait for the mix that might still read the sample data
+	const CLockScope MixLockScope(m_MixLock);
 	const CLockScope LockScope(m_SoundLock);
 	CSample &Sample = m_aSamples[SampleId];
 
@@ -652,9 +958,18 @@ void CSound::UnloadSample(int SampleId)
 			}
 		}
 
+		// Close the streams decoding this sample
+		if(Sample.IsStreamed())
+		{
+			const CLockScope DecodeLockScope(m_StreamDecodeLock);
+			CloseStreams(&Sample);
+		}
+
 		// Free data
 		free(Sample.m_pData);
 		Sample.m_pData = nullptr;
+		free(Sample.m_pStreamData);
+		Sample.m_pStreamData = nullptr;
 	}
 
 	// Free slot
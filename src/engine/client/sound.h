@@ -4,6 +4,7 @@
 #define ENGINE_CLIENT_SOUND_H
 
 #include <base/lock.h>
+#include <base/tl/threading.h>
 
 #include <engine/sound.h>
 
@@ -11,12 +12,17 @@
 
 #include <atomic>
 
+struct OggOpusFile;
+
 struct CSample
 {
 	int m_Index;
 	int m_NextFreeSampleIndex;
 
 	short *m_pData;
+	// long opus samples keep the encoded data instead and are decoded while playing
+	unsigned char *m_pStreamData;
+	unsigned m_StreamDataSize;
 	int m_NumFrames;
 	int m_Rate;
 	int m_Channels;
@@ -31,7 +37,12 @@ struct CSample
 
 	bool IsLoaded() const
 	{
-		return m_pData != nullptr;
+		return m_pData != nullptr || m_pStreamData != nullptr;
+	}
+
+	bool IsStreamed() const
+	{
+		return m_pStreamData != nullptr;
 	}
 };
 
@@ -60,6 +71,35 @@ struct CVoice
 	};
 };
 
+// Decodes a streamed sample for one voice on the stream thread, ahead of
+// the mixer
+struct CSoundStream
+{
+	CLock m_Lock;
+	// changing the sample or the tick to decode from increases the generation
+	CSample *m_pSample GUARDED_BY(m_Lock) = nullptr;
+	int m_StartTick GUARDED_BY(m_Lock) = 0;
+	bool m_Loop GUARDED_BY(m_Lock) = false;
+	int m_Generation GUARDED_BY(m_Lock) = 0;
+	// m_NumFrames decoded frames from m_ReadPos on, starting at m_ReadTick of the sample
+	short *m_pRing GUARDED_BY(m_Lock) = nullptr;
+	int m_ReadPos GUARDED_BY(m_Lock) = 0;
+	int m_NumFrames GUARDED_BY(m_Lock) = 0;
+	int m_ReadTick GUARDED_BY(m_Lock) = 0;
+
+	// the voice using the stream, only used by the mixer
+	int m_VoiceId = -1;
+	int m_VoiceAge = 0;
+	CSample *m_pVoiceSample = nullptr;
+	short *m_pMixData = nullptr;
+
+	// only used with the stream decode lock
+	OggOpusFile *m_pFile = nullptr;
+	CSample *m_pFileSample = nullptr;
+	int m_FileGeneration = -1;
+	int m_FileTick = 0;
+};
+
 class CSound : public IEngineSound
 {
 	enum
@@ -67,11 +107,24 @@ class CSound : public IEngineSound
 		NUM_SAMPLES = 512,
 		NUM_VOICES = 256,
 		NUM_CHANNELS = 16,
+
+		// opus samples of at least 10 seconds are streamed
+		STREAM_MIN_FRAMES = 48000 * 10,
+		// streams are only held by audible voices
+		NUM_STREAMS = 16,
+		STREAM_RING_FRAMES = 16384,
+		STREAM_DECODE_FRAMES = 4096,
 	};
 
 	bool m_SoundEnabled = false;
 	SDL_AudioDeviceID m_Device = 0;
+	// held by the audio thread while mixing, sample data must not be freed
+	// without it. Must be acquired before m_SoundLock.
+	CLock m_MixLock ACQUIRED_BEFORE(m_SoundLock);
 	CLock m_SoundLock;
+	// held by the stream thread while decoding, the encoded data of a
+	// sample must not be freed without it
+	CLock m_StreamDecodeLock ACQUIRED_AFTER(m_SoundLock);
 
 	CSample m_aSamples[NUM_SAMPLES] GUARDED_BY(m_SoundLock) = {{0}};
 	int m_FirstFreeSampleIndex GUARDED_BY(m_SoundLock) = 0;
@@ -93,10 +146,36 @@ class CSound : public IEngineSound
 
 	int *m_pMixBuffer = nullptr;
 
+	// the voices of the current mix, collected while holding m_SoundLock
+	// so the mixing itself doesn't block the game thread
+	struct CMixVoice
+	{
+		const short *m_pData;
+		int m_Channels;
+		unsigned m_Frames;
+		int m_VolumeL;
+		int m_VolumeR;
+	};
+	CMixVoice m_aMixVoices[NUM_VOICES];
+	int CollectMixVoices(unsigned Frames) REQUIRES(m_MixLock, !m_SoundLock);
+
+	CSoundStream m_aStreams[NUM_STREAMS];
+	void *m_pStreamThread = nullptr;
+	std::atomic<bool> m_StopStreamThread = false;
+	CSemaphore m_StreamSemaphore;
+	short *m_pStreamDecodeBuffer = nullptr;
+	static void StreamThread(void *pUser);
+	void DecodeStreams() REQUIRES(!m_StreamDecodeLock);
+	void ReleaseStreams() REQUIRES(m_SoundLock);
+	void ReleaseStream(int VoiceId) REQUIRES(m_SoundLock);
+	static void ReleaseStream(CSoundStream &Stream);
+	const short *ReadStream(int VoiceId, const CVoice &Voice, unsigned Frames, unsigned *pNumFrames) REQUIRES(m_SoundLock);
+	void CloseStreams(const CSample *pSample) REQUIRES(m_StreamDecodeLock);
+
 	CSample *AllocSample() REQUIRES(!m_SoundLock);
 	void RateConvert(CSample &Sample) const;
 
-	bool DecodeOpus(CSample &Sample, const void *pData, unsigned DataSize) const;
+	bool DecodeOpus(CSample &Sample, const void *pData, unsigned DataSize, bool AllowStreaming) const;
 	bool DecodeWV(CSample &Sample, const void *pData, unsigned DataSize) const;
 
 	void UpdateVolume();
@@ -104,7 +183,7 @@ class CSound : public IEngineSound
 public:
 	int Init() override REQUIRES(!m_SoundLock);
 	int Update() override;
-	void Shutdown() override REQUIRES(!m_SoundLock);
+	void Shutdown() override REQUIRES(!m_MixLock, !m_SoundLock);
 
 	bool IsSoundEnabled() override { return m_SoundEnabled; }
 
@@ -112,7 +191,7 @@ public:
 	int LoadWV(const char *pFilename, int StorageType = IStorage::TYPE_ALL) override REQUIRES(!m_SoundLock);
 	int LoadOpusFromMem(const void *pData, unsigned DataSize, bool ForceLoad) override REQUIRES(!m_SoundLock);
 	int LoadWVFromMem(const void *pData, unsigned DataSize, bool ForceLoad) override REQUIRES(!m_SoundLock);
-	void UnloadSample(int SampleId) override REQUIRES(!m_SoundLock);
+	void UnloadSample(int SampleId) override REQUIRES(!m_MixLock, !m_SoundLock);
 
 	float GetSampleTotalTime(int SampleId) override REQUIRES(!m_SoundLock); // in s
 	float GetSampleCurrentTime(int SampleId) override REQUIRES(!m_SoundLock); // in s
@@ -139,7 +218,7 @@ public:
 	bool IsPlaying(int SampleId) override REQUIRES(!m_SoundLock);
 
 	int MixingRate() const override { return m_MixingRate; }
-	void Mix(short *pFinalOut, unsigned Frames) override REQUIRES(!m_SoundLock);
+	void Mix(short *pFinalOut, unsigned Frames) override REQUIRES(!m_MixLock, !m_SoundLock);
 
 	void PauseAudioDevice() override;
 	void UnpauseAudioDevice() override;
@@ -0,0 +1,143 @@
+#include "sound_mix.h"
+
+#include <base/math.h>
+
+#include <cstdint>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOUND_MIX_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SOUND_MIX_NEON
+#include <arm_neon.h>
+#endif
+
+// the vector kernels multiply with 16 bit volumes
+static bool VolumesFitShort(int VolumeL, int VolumeR)
+{
+	return VolumeL >= 0 && VolumeL <= std::numeric_limits<short>::max() && VolumeR >= 0 && VolumeR <= std::numeric_limits<short>::max();
+}
+
+static void MixMonoScalar(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	for(unsigned i = 0; i < Frames; i++)
+	{
+		pOut[i * 2] += pIn[i] * VolumeL;
+		pOut[i * 2 + 1] += pIn[i] * VolumeR;
+	}
+}
+
+static void MixStereoScalar(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	for(unsigned i = 0; i < Frames; i++)
+	{
+		pOut[i * 2] += pIn[i * 2] * VolumeL;
+		pOut[i * 2 + 1] += pIn[i * 2 + 1] * VolumeR;
+	}
+}
+
+static void ClampScalar(short *pOut, const int *pIn, unsigned Samples, int MasterVol)
+{
+	for(unsigned i = 0; i < Samples; i++)
+		pOut[i] = clamp<int64_t>(((int64_t)pIn[i] * MasterVol / 101) >> 8, std::numeric_limits<short>::min(), std::numeric_limits<short>::max());
+}
+
+#if defined(SOUND_MIX_SSE2)
+// adds four interleaved stereo frames multiplied with the volumes to the mix buffer
+static inline void MixFramesSse2(int *pOut, __m128i In, __m128i Volume)
+{
+	const __m128i Low = _mm_mullo_epi16(In, Volume);
+	const __m128i High = _mm_mulhi_epi16(In, Volume);
+	__m128i *pOutVec = (__m128i *)pOut;
+	_mm_storeu_si128(pOutVec, _mm_add_epi32(_mm_loadu_si128(pOutVec), _mm_unpacklo_epi16(Low, High)));
+	_mm_storeu_si128(pOutVec + 1, _mm_add_epi32(_mm_loadu_si128(pOutVec + 1), _mm_unpackhi_epi16(Low, High)));
+}
+
+// divides two samples, the doubles hold the product with the master volume exactly
+static inline __m128i ScaleSse2(__m128i In, __m128d MasterVol, __m128d Divisor)
+{
+	return _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(In), MasterVol), Divisor));
+}
+#endif
+
+void SoundMixMono(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	unsigned i = 0;
+	if(VolumesFitShort(VolumeL, VolumeR))
+	{
+#if defined(SOUND_MIX_SSE2)
+		const __m128i Volume = _mm_set_epi16(VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL);
+		for(; i + 8 <= Frames; i += 8)
+		{
+			const __m128i In = _mm_loadu_si128((const __m128i *)(pIn + i));
+			MixFramesSse2(pOut + i * 2, _mm_unpacklo_epi16(In, In), Volume);
+			MixFramesSse2(pOut + i * 2 + 8, _mm_unpackhi_epi16(In, In), Volume);
+		}
+#elif defined(SOUND_MIX_NEON)
+		const int16_t aVolume[4] = {(int16_t)VolumeL, (int16_t)VolumeR, (int16_t)VolumeL, (int16_t)VolumeR};
+		const int16x4_t Volume = vld1_s16(aVolume);
+		for(; i + 4 <= Frames; i += 4)
+		{
+			const int16x4_t In = vld1_s16(pIn + i);
+			const int16x4x2_t Duplicated = vzip_s16(In, In);
+			vst1q_s32(pOut + i * 2, vmlal_s16(vld1q_s32(pOut + i * 2), Duplicated.val[0], Volume));
+			vst1q_s32(pOut + i * 2 + 4, vmlal_s16(vld1q_s32(pOut + i * 2 + 4), Duplicated.val[1], Volume));
+		}
+#endif
+	}
+	MixMonoScalar(pOut + i * 2, pIn + i, Frames - i, VolumeL, VolumeR);
+}
+
+void SoundMixStereo(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR)
+{
+	unsigned i = 0;
+	if(VolumesFitShort(VolumeL, VolumeR))
+	{
+#if defined(SOUND_MIX_SSE2)
+		const __m128i Volume = _mm_set_epi16(VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL, VolumeR, VolumeL);
+		for(; i + 4 <= Frames; i += 4)
+			MixFramesSse2(pOut + i * 2, _mm_loadu_si128((const __m128i *)(pIn + i * 2)), Volume);
+#elif defined(SOUND_MIX_NEON)
+		const int16_t aVolume[4] = {(int16_t)VolumeL, (int16_t)VolumeR, (int16_t)VolumeL, (int16_t)VolumeR};
+		const int16x4_t Volume = vld1_s16(aVolume);
+		for(; i + 4 <= Frames; i += 4)
+		{
+			const int16x8_t In = vld1q_s16(pIn + i * 2);
+			vst1q_s32(pOut + i * 2, vmlal_s16(vld1q_s32(pOut + i * 2), vget_low_s16(In), Volume));
+			vst1q_s32(pOut + i * 2 + 4, vmlal_s16(vld1q_s32(pOut + i * 2 + 4), vget_high_s16(In), Volume));
+		}
+#endif
+	}
+	MixStereoScalar(pOut + i * 2, pIn + i * 2, Frames - i, VolumeL, VolumeR);
+}
+
+void SoundMixClamp(short *pOut, const int *pIn, unsigned Samples, int MasterVol)
+{
+	unsigned i = 0;
+#if defined(SOUND_MIX_SSE2)
+	const __m128d MasterVolVec = _mm_set1_pd(MasterVol);
+	const __m128d Divisor = _mm_set1_pd(101.0);
+	for(; i + 8 <= Samples; i += 8)
+	{
+		const __m128i In0 = _mm_loadu_si128((const __m128i *)(pIn + i));
+		const __m128i In1 = _mm_loadu_si128((const __m128i *)(pIn + i + 4));
+		const __m128i Out0 = _mm_unpacklo_epi64(ScaleSse2(In0, MasterVolVec, Divisor), ScaleSse2(_mm_srli_si128(In0, 8), MasterVolVec, Divisor));
+		const __m128i Out1 = _mm_unpacklo_epi64(ScaleSse2(In1, MasterVolVec, Divisor), ScaleSse2(_mm_srli_si128(In1, 8), MasterVolVec, Divisor));
+		// the saturating pack does the clamping
+		_mm_storeu_si128((__m128i *)(pOut + i), _mm_packs_epi32(_mm_srai_epi32(Out0, 8), _mm_srai_epi32(Out1, 8)));
+	}
+#elif defined(SOUND_MIX_NEON)
+	const float64x2_t MasterVolVec = vdupq_n_f64(MasterVol);
+	const float64x2_t Divisor = vdupq_n_f64(101.0);
+	for(; i + 4 <= Samples; i += 4)
+	{
+		const int32x4_t In = vld1q_s32(pIn + i);
+		const int64x2_t Low = vcvtq_s64_f64(vdivq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(In))), MasterVolVec), Divisor));
+		const int64x2_t High = vcvtq_s64_f64(vdivq_f64(vmulq_f64(vcvtq_f64_s64(vmovl_high_s32(In)), MasterVolVec), Divisor));
+		// the saturating narrow does the clamping
+		vst1_s16(pOut + i, vqmovn_s32(vshrq_n_s32(vcombine_s32(vmovn_s64(Low), vmovn_s64(High)), 8)));
+	}
+#endif
+	ClampScalar(pOut + i, pIn + i, Samples - i, MasterVol);
+}
@@ -0,0 +1,13 @@
+#ifndef ENGINE_CLIENT_SOUND_MIX_H
+#define ENGINE_CLIENT_SOUND_MIX_H
+
+// Adds the frames of a 16 bit sample to the interleaved stereo mix buffer,
+// scaled by the volume of each side. The volumes are in the range 0 - 255.
+void SoundMixMono(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR);
+void SoundMixStereo(int *pOut, const short *pIn, unsigned Frames, int VolumeL, int VolumeR);
+
+// Applies the master volume (0 - 100) to the mix buffer and clamps the
+// result to 16 bit samples.
+void SoundMixClamp(short *pOut, const int *pIn, unsigned Samples, int MasterVol);
+
+#endif
@@ -7,6 +7,8 @@
 #include <base/hash.h>
 #include <base/types.h>
 
+#include <vector>
+
 enum
 {
 	MAX_MAP_LENGTH = 128
@@ -22,6 +24,8 @@ public:
 	virtual const char *GetDataString(int Index) = 0;
 	virtual void UnloadData(int Index) = 0;
 	virtual int NumData() const = 0;
+	// decompresses the given data in parallel, so that later GetData calls don't block on it
+	virtual void PreloadData(const std::vector<int> &vIndices) = 0;
 
 	virtual int GetItemSize(int Index) = 0;
 	virtual void *GetItem(int Index, int *pType = nullptr, int *pId = nullptr) = 0;
@@ -36,6 +40,8 @@ class IEngineMap : public IMap
 	MACRO_INTERFACE("enginemap")
 public:
 	virtual bool Load(const char *pMapName) = 0;
+	// maps loaded data shared with other processes from this directory, disabled if empty
+	virtual void SetCacheDirectory(const char *pDirectory) = 0;
 	virtual void Unload() = 0;
 	virtual bool IsLoaded() const = 0;
 	virtual IOHANDLE File() const = 0;
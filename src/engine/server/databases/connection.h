@@ -42,6 +42,8 @@ public:
 	virtual const char *MedianMapTime(char *pBuffer, int BufferSize) const = 0;
 	virtual const char *False() const = 0;
 	virtual const char *True() const = 0;
+	// starts a transaction that takes the write lock right away
+	virtual const char *BeginWrite() const = 0;
 
 	// tries to allocate the connection from the pool established
 	//
@@ -75,6 +77,11 @@ public:
 	//
 	// returns true on failure
 	virtual bool ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSize) = 0;
+	// executes a statement without parameters and results directly, used for
+	// transaction control. Discards the current prepared statement.
+	//
+	// returns true on failure
+	virtual bool Execute(const char *pStmt, char *pError, int ErrorSize) = 0;
 
 	virtual bool IsNull(int Col) = 0;
 	virtual float GetFloat(int Col) = 0;
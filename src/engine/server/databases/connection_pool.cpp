@@ -2,11 +2,14 @@
 #include "connection.h"
 #include <engine/shared/config.h>
 
+#include <base/math.h>
 #include <base/system.h>
 #include <cstring>
 #include <engine/console.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cinttypes>
 #include <iterator>
 #include <memory>
 #include <thread>
@@ -65,6 +68,10 @@ struct CSqlExecData
 
 	std::unique_ptr<const ISqlData> m_pThreadData;
 	const char *m_pName;
+	std::chrono::nanoseconds m_EnqueueTime = time_get_nanoseconds();
+	// read queries: number of write queue entries that must be processed
+	// before executing it
+	int64_t m_WaitForProcessed = 0;
 };
 
 CSqlExecData::CSqlExecData(
@@ -118,25 +125,118 @@ CSqlExecData::CSqlExecData(IConsole *pConsole, CDbConnectionPool::Mode m) :
 	m_Ptr.m_Print.m_Mode = m;
 }
 
-void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
+void CDbConnectionPool::AddQuery(std::unique_ptr<CSqlExecData> pQuery)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pConsole, DatabaseMode);
+	m_pShared->m_aQueries[m_InsertIdx++] = std::move(pQuery);
 	m_InsertIdx %= std::size(m_pShared->m_aQueries);
+	m_NumQueued++;
 	m_pShared->m_NumBackup.Signal();
 }
 
+void CDbConnectionPool::Print(IConsole *pConsole, Mode DatabaseMode)
+{
+	if(DatabaseMode == Mode::READ)
+	{
+		StartReadWorkers();
+		{
+			const CLockScope LockScope(m_pShared->m_ReadLock);
+			m_pShared->m_ReadQueries.push_back(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
+		}
+		m_pShared->m_NumRead.Signal();
+		return;
+	}
+	AddQuery(std::make_unique<CSqlExecData>(pConsole, DatabaseMode));
+}
+
+void CDbConnectionPool::PrintStats(IConsole *pConsole)
+{
+	const CLockScope LockScope(m_pShared->m_StatsLock);
+	if(m_pShared->m_Stats.empty())
+	{
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "No sql queries executed yet");
+		return;
+	}
+	char aBuf[512];
+	for(const auto &[Name, Stats] : m_pShared->m_Stats)
+	{
+		str_format(aBuf, sizeof(aBuf), "%s: count=%" PRId64 " failed=%" PRId64 " avg=%.2fms max=%.2fms avg_queue=%.2fms",
+			Name.c_str(), Stats.m_NumQueries, Stats.m_NumFailed,
+			Stats.m_TotalExecNs / 1e6 / Stats.m_NumQueries, Stats.m_MaxExecNs / 1e6,
+			Stats.m_TotalQueueNs / 1e6 / Stats.m_NumQueries);
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+
+		aBuf[0] = '\0';
+		for(int i = 0; i < NUM_LATENCY_BUCKETS; i++)
+		{
+			if(Stats.m_aBuckets[i] == 0)
+				continue;
+			char aBucket[64];
+			if(i == NUM_LATENCY_BUCKETS - 1)
+				str_format(aBucket, sizeof(aBucket), " >=%dms:%" PRId64, 1 << (i - 1), Stats.m_aBuckets[i]);
+			else
+				str_format(aBucket, sizeof(aBucket), " <%dms:%" PRId64, 1 << i, Stats.m_aBuckets[i]);
+			str_append(aBuf, aBucket, sizeof(aBuf));
+		}
+		pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	}
+}
+
+void CDbConnectionPool::CSharedData::AddStats(const char *pName, bool Success, int64_t QueueNs, int64_t ExecNs)
+{
+	int Bucket = 0;
+	while(Bucket < NUM_LATENCY_BUCKETS - 1 && ExecNs >= (int64_t)(1 << Bucket) * 1000000)
+		Bucket++;
+
+	const CLockScope LockScope(m_StatsLock);
+	CQueryStats &Stats = m_Stats[pName];
+	Stats.m_aBuckets[Bucket]++;
+	Stats.m_NumQueries++;
+	if(!Success)
+		Stats.m_NumFailed++;
+	Stats.m_TotalExecNs += ExecNs;
+	Stats.m_MaxExecNs = std::max(Stats.m_MaxExecNs, ExecNs);
+	Stats.m_TotalQueueNs += QueueNs;
+}
+
+bool CDbConnectionPool::CSharedData::NextIsWrite(CSemaphore &Queue, int JobNum)
+{
+	const std::chrono::nanoseconds Deadline = time_get_nanoseconds() + std::chrono::milliseconds(g_Config.m_SvSqlGroupCommitWindow);
+	while(Queue.GetApproximateValue() == 0)
+	{
+		if(m_Shutdown || time_get_nanoseconds() >= Deadline)
+			return false;
+		std::this_thread::sleep_for(1ms);
+	}
+	const CSqlExecData *pNext = m_aQueries[(JobNum + 1) % std::size(m_aQueries)].get();
+	return pNext != nullptr && pNext->m_Mode == CSqlExecData::WRITE_ACCESS;
+}
+
 void CDbConnectionPool::RegisterSqliteDatabase(Mode DatabaseMode, const char aFileName[64])
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, aFileName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+	{
+		{
+			const CLockScope LockScope(m_pShared->m_ReadLock);
+			m_pShared->m_vpReadDatabases.push_back(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
+		}
+		StartReadWorkers();
+		return;
+	}
+	AddQuery(std::make_unique<CSqlExecData>(DatabaseMode, aFileName));
 }
 
 void CDbConnectionPool::RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	if(DatabaseMode == Mode::READ)
+	{
+		{
+			const CLockScope LockScope(m_pShared->m_ReadLock);
+			m_pShared->m_vpReadDatabases.push_back(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
+		}
+		StartReadWorkers();
+		return;
+	}
+	AddQuery(std::make_unique<CSqlExecData>(DatabaseMode, pMysqlConfig));
 }
 
 void CDbConnectionPool::Execute(
@@ -144,9 +244,14 @@ void CDbConnectionPool::Execute(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	StartReadWorkers();
+	auto pQuery = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
+	pQuery->m_WaitForProcessed = m_NumQueued;
+	{
+		const CLockScope LockScope(m_pShared->m_ReadLock);
+		m_pShared->m_ReadQueries.push_back(std::move(pQuery));
+	}
+	m_pShared->m_NumRead.Signal();
 }
 
 void CDbConnectionPool::ExecuteWrite(
@@ -154,9 +259,7 @@ void CDbConnectionPool::ExecuteWrite(
 	std::unique_ptr<const ISqlData> pSqlRequestData,
 	const char *pName)
 {
-	m_pShared->m_aQueries[m_InsertIdx++] = std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName);
-	m_InsertIdx %= std::size(m_pShared->m_aQueries);
-	m_pShared->m_NumBackup.Signal();
+	AddQuery(std::make_unique<CSqlExecData>(pFunc, std::move(pSqlRequestData), pName));
 }
 
 void CDbConnectionPool::OnShutdown()
@@ -166,8 +269,15 @@ void CDbConnectionPool::OnShutdown()
 	m_Shutdown = true;
 	m_pShared->m_Shutdown.store(true);
 	m_pShared->m_NumBackup.Signal();
+	{
+		const CLockScope LockScope(m_pShared->m_ReadLock);
+		for(size_t i = 0; i < m_vpReadThreads.size(); i++)
+			m_pShared->m_ReadQueries.push_back(nullptr);
+	}
+	for(size_t i = 0; i < m_vpReadThreads.size(); i++)
+		m_pShared->m_NumRead.Signal();
 	int i = 0;
-	while(m_pShared->m_Shutdown.load())
+	while(!m_pShared->m_WorkerDone.load())
 	{
 		// print a log about every two seconds
 		if(i % 20 == 0 && i > 0)
@@ -230,18 +340,33 @@ void CBackup::ProcessQueries()
 		}
 		else if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS && m_pWriteBackup.get())
 		{
-			bool Success = CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData, Write::BACKUP_FIRST);
-			if(m_DebugSql || !Success)
-				dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", JobNum, pThreadData->m_pName, Success);
+			const int FirstJobNum = JobNum;
+			std::vector<CSqlExecData *> vpBatch = {pThreadData};
+			while((int)vpBatch.size() < g_Config.m_SvSqlGroupCommit && m_pShared->NextIsWrite(m_pShared->m_NumBackup, JobNum))
+			{
+				m_pShared->m_NumBackup.Wait();
+				JobNum++;
+				vpBatch.push_back(m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)].get());
+			}
+
+			std::vector<bool> vSuccess;
+			CDbConnectionPool::ExecSqlBatch(m_pWriteBackup.get(), vpBatch, std::vector<Write>(vpBatch.size(), Write::BACKUP_FIRST), vSuccess);
+			for(size_t i = 0; i < vpBatch.size(); i++)
+			{
+				if(m_DebugSql || !vSuccess[i])
+					dbg_msg("sql", "[%i] %s done on write backup database, Success=%i", FirstJobNum + (int)i, vpBatch[i]->m_pName, (int)vSuccess[i]);
+				m_pShared->m_NumWorker.Signal();
+			}
+			continue;
 		}
 		m_pShared->m_NumWorker.Signal();
 	}
 }
 
-// the worker threads executes queries on mysql or sqlite. If we write on
-// a mysql server and have a backup server configured, we'll remove the
+// the worker thread executes write queries on mysql or sqlite. If we write
+// on a mysql server and have a backup server configured, we'll remove the
 // entry from the backup server after completing it on the write server.
-// static void Worker(void *pUser);
+// Having a single thread for all writes keeps them in insertion order.
 class CWorker
 {
 public:
@@ -251,6 +376,7 @@ public:
 	void ProcessQueries();
 
 private:
+	void ProcessWrites(int FirstJobNum, const std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, bool *pFailMode);
 	void Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode);
 
 	bool m_DebugSql;
@@ -262,8 +388,7 @@ private:
 	//                most one WRITE server. The WRITE server for all DDNet
 	//                Servers must be the same (to counteract double loads).
 	//                There may be one WRITE_BACKUP sqlite server.
-	// This variable should only change, before the worker threads
-	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+	// The READ servers are handled by the CReadWorker threads.
 	std::unique_ptr<IDbConnection> m_pWriteConnection;
 	std::unique_ptr<IDbConnection> m_pWriteBackup;
 
@@ -280,10 +405,8 @@ void CWorker::Start(void *pUser)
 
 void CWorker::ProcessQueries()
 {
-	// remember last working server and try to connect to it first
-	int ReadServer = 0;
-	// enter fail mode when a sql request fails, skip read request during it and
-	// write to the backup database until all requests are handled
+	// enter fail mode when a sql request fails, write to the backup database
+	// until all requests are handled
 	bool FailMode = false;
 	for(int JobNum = 0;; JobNum++)
 	{
@@ -296,76 +419,41 @@ void CWorker::ProcessQueries()
 		// work through all database jobs after OnShutdown is called before exiting the thread
 		if(pThreadData == nullptr)
 		{
-			m_pShared->m_Shutdown.store(false);
+			m_pShared->m_WorkerDone.store(true);
 			return;
 		}
-		bool Success = false;
-		switch(pThreadData->m_Mode)
-		{
-		case CSqlExecData::READ_ACCESS:
+		if(pThreadData->m_Mode == CSqlExecData::WRITE_ACCESS)
 		{
-			for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+			// group commit: take the writes queued behind this one as well
+			const int FirstJobNum = JobNum;
+			std::vector<std::unique_ptr<CSqlExecData>> vpBatch;
+			vpBatch.push_back(std::move(pThreadData));
+			while((int)vpBatch.size() < g_Config.m_SvSqlGroupCommit && m_pShared->NextIsWrite(m_pShared->m_NumWorker, JobNum))
 			{
-				if(m_pShared->m_Shutdown)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during shutdown", JobNum, pThreadData->m_pName);
-					break;
-				}
-				if(FailMode)
-				{
-					dbg_msg("sql", "[%i] %s dismissed read request during FailMode", JobNum, pThreadData->m_pName);
-					break;
-				}
-				int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
-				if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
-				{
-					ReadServer = CurServer;
-					if(m_DebugSql)
-						dbg_msg("sql", "[%i] %s done on read database %d", JobNum, pThreadData->m_pName, CurServer);
-					Success = true;
-					break;
-				}
-			}
-			if(!Success)
-			{
-				FailMode = true;
+				m_pShared->m_NumWorker.Wait();
+				JobNum++;
+				vpBatch.push_back(std::move(m_pShared->m_aQueries[JobNum % std::size(m_pShared->m_aQueries)]));
 			}
+			ProcessWrites(FirstJobNum, vpBatch, &FailMode);
+			m_pShared->m_NumProcessed.fetch_add(vpBatch.size());
+			continue;
 		}
-		break;
-		case CSqlExecData::WRITE_ACCESS:
+		bool Success = false;
+		switch(pThreadData->m_Mode)
 		{
-			if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", JobNum, pThreadData->m_pName);
-			}
-			else if(FailMode && m_pWriteBackup != nullptr)
-			{
-				dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", JobNum, pThreadData->m_pName);
-			}
-			else if(CDbConnectionPool::ExecSqlFunc(m_pWriteConnection.get(), pThreadData.get(), Write::NORMAL))
-			{
-				if(m_DebugSql)
-					dbg_msg("sql", "[%i] %s done on write database", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-			// enter fail mode if not successful
-			FailMode = FailMode || !Success;
-			const Write w = Success ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED;
-			if(m_pWriteBackup && CDbConnectionPool::ExecSqlFunc(m_pWriteBackup.get(), pThreadData.get(), w))
-			{
-				if(m_DebugSql)
-					dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", JobNum, pThreadData->m_pName);
-				Success = true;
-			}
-		}
-		break;
+		case CSqlExecData::READ_ACCESS:
+			dbg_assert(false, "read query in write queue");
+			break;
+		case CSqlExecData::WRITE_ACCESS:
+			dbg_assert(false, "unreachable");
+			break;
 		case CSqlExecData::ADD_MYSQL:
 		{
 			auto pMysql = CreateMysqlConnection(pThreadData->m_Ptr.m_Mysql.m_Config);
 			switch(pThreadData->m_Ptr.m_Mysql.m_Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pMysql));
+				dbg_assert(false, "read database in write queue");
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pMysql);
@@ -385,7 +473,7 @@ void CWorker::ProcessQueries()
 			switch(pThreadData->m_Ptr.m_Sqlite.m_Mode)
 			{
 			case CDbConnectionPool::Mode::READ:
-				m_vpReadConnections.push_back(std::move(pSqlite));
+				dbg_assert(false, "read database in write queue");
 				break;
 			case CDbConnectionPool::Mode::WRITE:
 				m_pWriteConnection = std::move(pSqlite);
@@ -411,19 +499,75 @@ void CWorker::ProcessQueries()
 			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
 			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
 		}
+		m_pShared->m_NumProcessed.fetch_add(1);
 	}
 }
 
-void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
+void CWorker::ProcessWrites(int FirstJobNum, const std::vector<std::unique_ptr<CSqlExecData>> &vpBatch, bool *pFailMode)
 {
-	if(DatabaseMode == CDbConnectionPool::Mode::READ)
+	const std::chrono::nanoseconds StartTime = time_get_nanoseconds();
+	std::vector<CSqlExecData *> vpData;
+	for(const auto &pThreadData : vpBatch)
+		vpData.push_back(pThreadData.get());
+
+	std::vector<bool> vSuccess(vpData.size(), false);
+	if(m_pShared->m_Shutdown && m_pWriteBackup != nullptr)
+	{
+		for(size_t i = 0; i < vpData.size(); i++)
+			dbg_msg("sql", "[%i] %s skipped to backup database during shutdown", FirstJobNum + (int)i, vpData[i]->m_pName);
+	}
+	else if(*pFailMode && m_pWriteBackup != nullptr)
+	{
+		for(size_t i = 0; i < vpData.size(); i++)
+			dbg_msg("sql", "[%i] %s skipped to backup database during FailMode", FirstJobNum + (int)i, vpData[i]->m_pName);
+	}
+	else
+	{
+		CDbConnectionPool::ExecSqlBatch(m_pWriteConnection.get(), vpData, std::vector<Write>(vpData.size(), Write::NORMAL), vSuccess);
+		for(size_t i = 0; i < vpData.size(); i++)
+			if(m_DebugSql && vSuccess[i])
+				dbg_msg("sql", "[%i] %s done on write database", FirstJobNum + (int)i, vpData[i]->m_pName);
+	}
+
+	std::vector<Write> vBackupWrites;
+	for(bool Success : vSuccess)
 	{
-		for(auto &pReadConnection : m_vpReadConnections)
-			pReadConnection->Print(pConsole, "Read");
-		if(m_vpReadConnections.empty())
-			pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+		// enter fail mode if not successful
+		*pFailMode = *pFailMode || !Success;
+		vBackupWrites.push_back(Success ? Write::NORMAL_SUCCEEDED : Write::NORMAL_FAILED);
 	}
-	else if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
+	if(m_pWriteBackup)
+	{
+		std::vector<bool> vBackupSuccess;
+		CDbConnectionPool::ExecSqlBatch(m_pWriteBackup.get(), vpData, vBackupWrites, vBackupSuccess);
+		for(size_t i = 0; i < vpData.size(); i++)
+		{
+			if(!vBackupSuccess[i])
+				continue;
+			if(m_DebugSql)
+				dbg_msg("sql", "[%i] %s done move write on backup database to non-backup table", FirstJobNum + (int)i, vpData[i]->m_pName);
+			vSuccess[i] = true;
+		}
+	}
+
+	const std::chrono::nanoseconds EndTime = time_get_nanoseconds();
+	for(size_t i = 0; i < vpData.size(); i++)
+	{
+		CSqlExecData *pThreadData = vpData[i];
+		if(!vSuccess[i])
+			dbg_msg("sql", "[%i] %s failed on all databases", FirstJobNum + (int)i, pThreadData->m_pName);
+		m_pShared->AddStats(pThreadData->m_pName, vSuccess[i], (StartTime - pThreadData->m_EnqueueTime).count(), (EndTime - StartTime).count());
+		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+		{
+			pThreadData->m_pThreadData->m_pResult->m_Success = vSuccess[i];
+			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+		}
+	}
+}
+
+void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
+{
+	if(DatabaseMode == CDbConnectionPool::Mode::WRITE)
 	{
 		if(m_pWriteConnection)
 			m_pWriteConnection->Print(pConsole, "Write");
@@ -439,21 +583,133 @@ void CWorker::Print(IConsole *pConsole, CDbConnectionPool::Mode DatabaseMode)
 	}
 }
 
+// The read worker threads share the read queue. Every read worker has its
+// own connection to each READ database, so slow read queries (e.g. ranks on
+// a big table) only block one worker and never the writes.
+class CReadWorker
+{
+public:
+	CReadWorker(std::shared_ptr<CDbConnectionPool::CSharedData> pShared, int Id, int DebugSql) :
+		m_Id(Id), m_DebugSql(DebugSql), m_pShared(std::move(pShared)) {}
+	static void Start(void *pUser);
+	void ProcessQueries();
+
+private:
+	int m_Id;
+	bool m_DebugSql;
+
+	// one connection for every entry in m_vpReadDatabases
+	std::vector<std::unique_ptr<IDbConnection>> m_vpReadConnections;
+
+	std::shared_ptr<CDbConnectionPool::CSharedData> m_pShared;
+};
+
 /* static */
-bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
+void CReadWorker::Start(void *pUser)
 {
-	if(pConnection == nullptr)
+	CReadWorker *pThis = (CReadWorker *)pUser;
+	pThis->ProcessQueries();
+	delete pThis;
+}
+
+void CReadWorker::ProcessQueries()
+{
+	// remember last working server and try to connect to it first
+	int ReadServer = 0;
+	// enter fail mode when a sql request fails, skip read requests during it
+	// until all queued requests are handled
+	bool FailMode = false;
+	for(int JobNum = 0;; JobNum++)
 	{
-		dbg_msg("sql", "No database given");
-		return false;
+		if(FailMode && m_pShared->m_NumRead.GetApproximateValue() == 0)
+		{
+			FailMode = false;
+		}
+		m_pShared->m_NumRead.Wait();
+		std::unique_ptr<CSqlExecData> pThreadData;
+		{
+			const CLockScope LockScope(m_pShared->m_ReadLock);
+			pThreadData = std::move(m_pShared->m_ReadQueries.front());
+			m_pShared->m_ReadQueries.pop_front();
+			// pick up databases registered since the last query
+			while(m_vpReadConnections.size() < m_pShared->m_vpReadDatabases.size())
+			{
+				const CSqlExecData *pDatabase = m_pShared->m_vpReadDatabases[m_vpReadConnections.size()].get();
+				if(pDatabase->m_Mode == CSqlExecData::ADD_MYSQL)
+					m_vpReadConnections.push_back(CreateMysqlConnection(pDatabase->m_Ptr.m_Mysql.m_Config));
+				else
+					m_vpReadConnections.push_back(CreateSqliteConnection(pDatabase->m_Ptr.m_Sqlite.m_FileName, true));
+			}
+		}
+		// work through all database jobs after OnShutdown is called before exiting the thread
+		if(pThreadData == nullptr)
+		{
+			return;
+		}
+
+		if(pThreadData->m_Mode == CSqlExecData::PRINT)
+		{
+			IConsole *pConsole = pThreadData->m_Ptr.m_Print.m_pConsole;
+			for(auto &pReadConnection : m_vpReadConnections)
+				pReadConnection->Print(pConsole, "Read");
+			if(m_vpReadConnections.empty())
+				pConsole->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", "There are no read databases");
+			continue;
+		}
+
+		dbg_assert(pThreadData->m_Mode == CSqlExecData::READ_ACCESS, "non-read query in read queue");
+		// don't overtake the writes added before this read, e.g. /rank
+		// right after a finish must see the new time
+		while(m_pShared->m_NumProcessed.load() < pThreadData->m_WaitForProcessed && !m_pShared->m_Shutdown)
+			std::this_thread::sleep_for(1ms);
+		const std::chrono::nanoseconds StartTime = time_get_nanoseconds();
+		bool Success = false;
+		for(size_t i = 0; i < m_vpReadConnections.size(); i++)
+		{
+			if(m_pShared->m_Shutdown)
+			{
+				dbg_msg("sql", "[%d:%i] %s dismissed read request during shutdown", m_Id, JobNum, pThreadData->m_pName);
+				break;
+			}
+			if(FailMode)
+			{
+				dbg_msg("sql", "[%d:%i] %s dismissed read request during FailMode", m_Id, JobNum, pThreadData->m_pName);
+				break;
+			}
+			int CurServer = (ReadServer + i) % (int)m_vpReadConnections.size();
+			if(CDbConnectionPool::ExecSqlFunc(m_vpReadConnections[CurServer].get(), pThreadData.get(), Write::NORMAL))
+			{
+				ReadServer = CurServer;
+				if(m_DebugSql)
+					dbg_msg("sql", "[%d:%i] %s done on read database %d", m_Id, JobNum, pThreadData->m_pName, CurServer);
+				Success = true;
+				break;
+			}
+		}
+		const std::chrono::nanoseconds EndTime = time_get_nanoseconds();
+		if(!Success)
+		{
+			FailMode = true;
+			dbg_msg("sql", "[%d:%i] %s failed on all databases", m_Id, JobNum, pThreadData->m_pName);
+		}
+		m_pShared->AddStats(pThreadData->m_pName, Success, (StartTime - pThreadData->m_EnqueueTime).count(), (EndTime - StartTime).count());
+		if(pThreadData->m_pThreadData != nullptr && pThreadData->m_pThreadData->m_pResult != nullptr)
+		{
+			pThreadData->m_pThreadData->m_pResult->m_Success = Success;
+			pThreadData->m_pThreadData->m_pResult->m_Completed.store(true);
+		}
 	}
+}
+
+// calls the query function on an already connected database
+static bool CallSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
+{
 	char aError[256] = "unknown error";
-	if(pConnection->Connect(aError, sizeof(aError)))
+	bool Success = false;
+	if(pData->m_pThreadData != nullptr)
 	{
-		dbg_msg("sql", "failed connecting to db: %s", aError);
-		return false;
+		pData->m_pThreadData->m_OnCommitted = nullptr;
 	}
-	bool Success = false;
 	switch(pData->m_Mode)
 	{
 	case CSqlExecData::READ_ACCESS:
@@ -465,7 +721,6 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 	default:
 		dbg_assert(false, "unreachable");
 	}
-	pConnection->Disconnect();
 	if(!Success)
 	{
 		dbg_msg("sql", "%s failed: %s", pData->m_pName, aError);
@@ -473,6 +728,98 @@ bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pD
 	return Success;
 }
 
+static void OnCommitted(CSqlExecData *pData)
+{
+	if(pData->m_pThreadData != nullptr && pData->m_pThreadData->m_OnCommitted)
+	{
+		pData->m_pThreadData->m_OnCommitted();
+		pData->m_pThreadData->m_OnCommitted = nullptr;
+	}
+}
+
+/* static */
+bool CDbConnectionPool::ExecSqlFunc(IDbConnection *pConnection, CSqlExecData *pData, Write w)
+{
+	if(pConnection == nullptr)
+	{
+		dbg_msg("sql", "No database given");
+		return false;
+	}
+	char aError[256] = "unknown error";
+	if(pConnection->Connect(aError, sizeof(aError)))
+	{
+		dbg_msg("sql", "failed connecting to db: %s", aError);
+		return false;
+	}
+	bool Success = CallSqlFunc(pConnection, pData, w);
+	pConnection->Disconnect();
+	if(Success)
+	{
+		OnCommitted(pData);
+	}
+	return Success;
+}
+
+/* static */
+void CDbConnectionPool::ExecSqlBatch(IDbConnection *pConnection, const std::vector<CSqlExecData *> &vpData, const std::vector<Write> &vWrites, std::vector<bool> &vSuccess)
+{
+	vSuccess.assign(vpData.size(), false);
+	if(vpData.size() > 1 && pConnection != nullptr)
+	{
+		char aError[256] = "unknown error";
+		if(pConnection->Connect(aError, sizeof(aError)))
+		{
+			dbg_msg("sql", "failed connecting to db: %s", aError);
+			return;
+		}
+		// every write gets its own savepoint, so that a failing one is rolled
+		// back without affecting the others in the transaction
+		bool Failed = pConnection->Execute(pConnection->BeginWrite(), aError, sizeof(aError));
+		for(size_t i = 0; i < vpData.size() && !Failed; i++)
+		{
+			if(pConnection->Execute("SAVEPOINT group_commit", aError, sizeof(aError)))
+			{
+				Failed = true;
+				break;
+			}
+			vSuccess[i] = CallSqlFunc(pConnection, vpData[i], vWrites[i]);
+			if(!vSuccess[i] && pConnection->Execute("ROLLBACK TO SAVEPOINT group_commit", aError, sizeof(aError)))
+			{
+				Failed = true;
+				break;
+			}
+			Failed = pConnection->Execute("RELEASE SAVEPOINT group_commit", aError, sizeof(aError));
+		}
+		if(!Failed)
+		{
+			Failed = pConnection->Execute("COMMIT", aError, sizeof(aError));
+		}
+		if(Failed)
+		{
+			dbg_msg("sql", "group commit of %d queries failed, executing them one by one: %s", (int)vpData.size(), aError);
+			pConnection->Execute("ROLLBACK", aError, sizeof(aError));
+		}
+		pConnection->Disconnect();
+		if(!Failed)
+		{
+			for(size_t i = 0; i < vpData.size(); i++)
+			{
+				if(vSuccess[i])
+				{
+					OnCommitted(vpData[i]);
+				}
+			}
+			return;
+		}
+		// nothing got committed, the writes are retried below
+		vSuccess.assign(vpData.size(), false);
+	}
+	for(size_t i = 0; i < vpData.size(); i++)
+	{
+		vSuccess[i] = ExecSqlFunc(pConnection, vpData[i], vWrites[i]);
+	}
+}
+
 CDbConnectionPool::CDbConnectionPool()
 {
 	m_pShared = std::make_shared<CSharedData>();
@@ -480,6 +827,16 @@ CDbConnectionPool::CDbConnectionPool()
 	m_pBackupThread = thread_init(CBackup::Start, new CBackup(m_pShared, g_Config.m_DbgSql), "database backup worker thread");
 }
 
+void CDbConnectionPool::StartReadWorkers()
+{
+	// started lazily so the config is loaded by now
+	if(!m_vpReadThreads.empty() || m_Shutdown)
+		return;
+	const int NumWorkers = clamp(g_Config.m_SvSqlReadWorkers, 1, (int)MAX_READ_WORKERS);
+	for(int i = 0; i < NumWorkers; i++)
+		m_vpReadThreads.push_back(thread_init(CReadWorker::Start, new CReadWorker(m_pShared, i, g_Config.m_DbgSql), "database read worker thread"));
+}
+
 CDbConnectionPool::~CDbConnectionPool()
 {
 	OnShutdown();
@@ -487,4 +844,6 @@ CDbConnectionPool::~CDbConnectionPool()
 		thread_wait(m_pWorkerThread);
 	if(m_pBackupThread)
 		thread_wait(m_pBackupThread);
+	for(void *pThread : m_vpReadThreads)
+		thread_wait(pThread);
 }
@@ -2,8 +2,13 @@
 #define ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
 
 #include <atomic>
+#include <base/lock.h>
 #include <base/tl/threading.h>
+#include <deque>
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
 
 class IDbConnection;
@@ -29,6 +34,10 @@ struct ISqlData
 	virtual ~ISqlData() = default;
 
 	mutable std::shared_ptr<ISqlResult> m_pResult;
+	// can be set by write functions, called on the worker thread once the
+	// write is committed. Writes in a group commit are only committed with
+	// the whole transaction.
+	mutable std::function<void()> m_OnCommitted;
 };
 
 enum Write
@@ -77,16 +86,25 @@ public:
 	};
 
 	void Print(IConsole *pConsole, Mode DatabaseMode);
+	// prints per query latency histograms, called from the main thread
+	void PrintStats(IConsole *pConsole);
 
 	void RegisterSqliteDatabase(Mode DatabaseMode, const char FileName[64]);
 	void RegisterMysqlDatabase(Mode DatabaseMode, const CMysqlConfig *pMysqlConfig);
 
+	// read queries are distributed over several read workers, each with
+	// its own connection to every READ database. A read query is only
+	// started after all writes added before it are processed by the write
+	// worker, so it sees them if the READ database is the WRITE database or
+	// a synchronous replica of it. No ordering between read queries is
+	// guaranteed.
 	void Execute(
 		FRead pFunc,
 		std::unique_ptr<const ISqlData> pSqlRequestData,
 		const char *pName);
 	// writes to WRITE_BACKUP first and removes it from there when successfully
-	// executed on WRITE server
+	// executed on WRITE server. Writes are executed one after another in the
+	// order they were added.
 	void ExecuteWrite(
 		FWrite pFunc,
 		std::unique_ptr<const ISqlData> pSqlRequestData,
@@ -96,13 +114,42 @@ public:
 
 	friend class CWorker;
 	friend class CBackup;
+	friend class CReadWorker;
+
+	enum
+	{
+		// bucket i counts queries that took less than 2^i ms, the last one
+		// counts everything slower
+		NUM_LATENCY_BUCKETS = 16,
+		MAX_READ_WORKERS = 16,
+	};
+
+	struct CQueryStats
+	{
+		int64_t m_aBuckets[NUM_LATENCY_BUCKETS] = {0};
+		int64_t m_NumQueries = 0;
+		int64_t m_NumFailed = 0;
+		int64_t m_TotalExecNs = 0;
+		int64_t m_MaxExecNs = 0;
+		int64_t m_TotalQueueNs = 0;
+	};
 
 private:
 	static bool ExecSqlFunc(IDbConnection *pConnection, struct CSqlExecData *pData, Write w);
+	// group commit: executes all writes in one transaction, sets vSuccess
+	// for each of them
+	static void ExecSqlBatch(IDbConnection *pConnection, const std::vector<struct CSqlExecData *> &vpData, const std::vector<Write> &vWrites, std::vector<bool> &vSuccess);
+
+	void StartReadWorkers();
 
 	// Only the main thread accesses this variable. It points to the index,
 	// where the next query is added to the queue.
 	int m_InsertIdx = 0;
+	// Only the main thread accesses this variable. Number of queries added
+	// to the write queue so far.
+	int64_t m_NumQueued = 0;
+
+	void AddQuery(std::unique_ptr<struct CSqlExecData> pQuery);
 
 	bool m_Shutdown = false;
 
@@ -111,9 +158,13 @@ private:
 		// Used as signal that shutdown is in progress from main thread to
 		// speed up the queries by discarding read queries and writing to
 		// the sqlite file instead of the remote mysql server.
-		// The worker thread signals the main thread that all queries are
-		// processed by setting this variable to false again.
 		std::atomic_bool m_Shutdown{false};
+		// The worker thread signals the main thread that all queries are
+		// processed by setting this variable to true.
+		std::atomic_bool m_WorkerDone{false};
+		// Number of queries in the write queue processed by the worker
+		// thread. Read queries wait for the writes added before them.
+		std::atomic<int64_t> m_NumProcessed{0};
 		// Queries go first to the backup thread. This semaphore signals about
 		// new queries.
 		CSemaphore m_NumBackup;
@@ -122,12 +173,32 @@ private:
 		CSemaphore m_NumWorker;
 
 		// spsc queue with additional backup worker to look at queries first.
+		// Only write queries and WRITE/WRITE_BACKUP database changes go
+		// through here.
 		std::unique_ptr<struct CSqlExecData> m_aQueries[512];
+
+		// mpmc queue for read queries, a nullptr tells one read worker to
+		// exit. Signals the read workers about new entries.
+		CSemaphore m_NumRead;
+		CLock m_ReadLock;
+		std::deque<std::unique_ptr<struct CSqlExecData>> m_ReadQueries GUARDED_BY(m_ReadLock);
+		// READ databases, every read worker opens its own connection to each
+		std::vector<std::unique_ptr<struct CSqlExecData>> m_vpReadDatabases GUARDED_BY(m_ReadLock);
+
+		CLock m_StatsLock;
+		std::map<std::string, CQueryStats> m_Stats GUARDED_BY(m_StatsLock);
+
+		void AddStats(const char *pName, bool Success, int64_t QueueNs, int64_t ExecNs);
+		// waits up to sv_sql_group_commit_window for the query after JobNum
+		// to be signaled on Queue, returns true if it's a write query that
+		// can be added to the current group commit
+		bool NextIsWrite(CSemaphore &Queue, int JobNum);
 	};
 
 	std::shared_ptr<CSharedData> m_pShared;
 	void *m_pWorkerThread = nullptr;
 	void *m_pBackupThread = nullptr;
+	std::vector<void *> m_vpReadThreads;
 };
 
 #endif // ENGINE_SERVER_DATABASES_CONNECTION_POOL_H
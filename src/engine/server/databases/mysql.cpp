@@ -78,6 +78,7 @@ public:
 	const char *MedianMapTime(char *pBuffer, int BufferSize) const override;
 	const char *False() const override { return "FALSE"; }
 	const char *True() const override { return "TRUE"; }
+	const char *BeginWrite() const override { return "BEGIN"; }
 
 	bool Connect(char *pError, int ErrorSize) override;
 	void Disconnect() override;
@@ -94,6 +95,7 @@ public:
 	void Print() override {}
 	bool Step(bool *pEnd, char *pError, int ErrorSize) override;
 	bool ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSize) override;
+	bool Execute(const char *pStmt, char *pError, int ErrorSize) override;
 
 	bool IsNull(int Col) override;
 	float GetFloat(int Col) override;
@@ -496,6 +498,25 @@ bool CMysqlConnection::ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSi
 	return true;
 }
 
+bool CMysqlConnection::Execute(const char *pStmt, char *pError, int ErrorSize)
+{
+	// transaction control statements aren't available as prepared statements
+	// in all versions, run them as plain query instead
+	if(m_pStmt && mysql_stmt_free_result(m_pStmt.get()))
+	{
+		StoreErrorStmt("free_result");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	if(mysql_real_query(&m_Mysql, pStmt, str_length(pStmt)))
+	{
+		StoreErrorMysql("real_query");
+		str_copy(pError, m_aErrorDetail, ErrorSize);
+		return true;
+	}
+	return false;
+}
+
 bool CMysqlConnection::IsNull(int Col)
 {
 	Col -= 1;
@@ -6,6 +6,7 @@
 #include <engine/console.h>
 
 #include <atomic>
+#include <limits>
 
 class CSqliteConnection : public IDbConnection
 {
@@ -26,6 +27,9 @@ public:
 	// > the identifiers refer to the columns rather than Boolean constants.
 	const char *False() const override { return "0"; }
 	const char *True() const override { return "1"; }
+	// a deferred transaction fails with SQLITE_BUSY instead of waiting when
+	// it reads before writing while another connection writes
+	const char *BeginWrite() const override { return "BEGIN IMMEDIATE"; }
 
 	bool Connect(char *pError, int ErrorSize) override;
 	void Disconnect() override;
@@ -42,6 +46,7 @@ public:
 	void Print() override;
 	bool Step(bool *pEnd, char *pError, int ErrorSize) override;
 	bool ExecuteUpdate(int *pNumUpdated, char *pError, int ErrorSize) override;
+	bool Execute(const char *pQuery, char *pError, int ErrorSize) override;
 
 	bool IsNull(int Col) override;
 	float GetFloat(int Col) override;
@@ -64,8 +69,6 @@ private:
 	sqlite3 *m_pDb;
 	sqlite3_stmt *m_pStmt;
 	bool m_Done; // no more rows available for Step
-	// returns false, if the query succeeded
-	bool Execute(const char *pQuery, char *pError, int ErrorSize);
 	// returns true on failure
 	bool ConnectImpl(char *pError, int ErrorSize);
 
@@ -142,8 +145,10 @@ bool CSqliteConnection::ConnectImpl(char *pError, int ErrorSize)
 		return true;
 	}
 
-	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors
-	sqlite3_busy_timeout(m_pDb, -1);
+	// wait for database to unlock so we don't have to handle SQLITE_BUSY errors,
+	// the read workers and the write worker access the same file concurrently.
+	// A negative timeout would disable the busy handler instead of waiting forever.
+	sqlite3_busy_timeout(m_pDb, std::numeric_limits<int>::max());
 
 	if(m_Setup)
 	{
@@ -362,6 +367,12 @@ const char *CSqliteConnection::MedianMapTime(char *pBuffer, int BufferSize) cons
 
 bool CSqliteConnection::Execute(const char *pQuery, char *pError, int ErrorSize)
 {
+	// a statement that isn't stepped to the end keeps the transaction busy
+	if(m_pStmt != nullptr)
+		sqlite3_finalize(m_pStmt);
+	m_pStmt = nullptr;
+	m_Done = true;
+
 	char *pErrorMsg;
 	int Result = sqlite3_exec(m_pDb, pQuery, nullptr, nullptr, &pErrorMsg);
 	if(Result != SQLITE_OK)
@@ -23,8 +23,10 @@
 #include <engine/shared/filecollection.h>
 #include <engine/shared/host_lookup.h>
 #include <engine/shared/http.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/json.h>
 #include <engine/shared/jsonwriter.h>
+#include <engine/shared/map_cache.h>
 #include <engine/shared/masterserver.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
@@ -39,6 +41,8 @@
 
 // DDRace
 #include <engine/shared/linereader.h>
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <zlib.h>
 
@@ -229,9 +233,10 @@ CServer::CServer()
 {
 	m_pConfig = &g_Config;
 	for(int i = 0; i < MAX_CLIENTS; i++)
-		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true);
-	m_aDemoRecorder[RECORDER_MANUAL] = CDemoRecorder(&m_SnapshotDelta, false);
-	m_aDemoRecorder[RECORDER_AUTO] = CDemoRecorder(&m_SnapshotDelta, false);
+		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true, true);
+	m_aDemoRecorder[RECORDER_MANUAL] = CDemoRecorder(&m_SnapshotDelta, false, true);
+	m_aDemoRecorder[RECORDER_AUTO] = CDemoRecorder(&m_SnapshotDelta, false, true);
+	m_vClientSnapshots.resize(MAX_CLIENTS);
 
 	m_pGameServer = nullptr;
 
@@ -244,6 +249,7 @@ CServer::CServer()
 	{
 		m_apCurrentMapData[i] = nullptr;
 		m_aCurrentMapSize[i] = 0;
+		m_aCurrentMapDataMapped[i] = false;
 	}
 
 	m_MapReload = false;
@@ -274,9 +280,9 @@ CServer::CServer()
 
 CServer::~CServer()
 {
-	for(auto &pCurrentMapData : m_apCurrentMapData)
+	for(int MapType = 0; MapType < NUM_MAP_TYPES; MapType++)
 	{
-		free(pCurrentMapData);
+		FreeCurrentMapData(MapType);
 	}
 
 	if(m_RunServer != UNINITIALIZED)
@@ -856,21 +862,36 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientId)
 
 		if(!(Flags & MSGFLAG_NOSEND))
 		{
+			int aClientIds[MAX_CLIENTS];
+			bool aSixup[MAX_CLIENTS];
+			int NumClientIds = 0;
 			for(int i = 0; i < MAX_CLIENTS; i++)
 			{
 				if(m_aClients[i].m_State == CClient::STATE_INGAME)
 				{
 					CPacker *pPack = m_aClients[i].m_Sixup ? &Pack7 : &Pack6;
-					Packet.m_pData = pPack->Data();
-					Packet.m_DataSize = pPack->Size();
-					Packet.m_ClientId = i;
-					if(Antibot()->OnEngineServerMessage(i, Packet.m_pData, Packet.m_DataSize, Flags))
+					if(Antibot()->OnEngineServerMessage(i, pPack->Data(), pPack->Size(), Flags))
 					{
 						continue;
 					}
-					m_NetServer.Send(&Packet);
+					aSixup[NumClientIds] = m_aClients[i].m_Sixup;
+					aClientIds[NumClientIds++] = i;
 				}
 			}
+
+			CNetChunk PacketSixup = Packet;
+			Packet.m_pData = Pack6.Data();
+			Packet.m_DataSize = Pack6.Size();
+			PacketSixup.m_pData = Pack7.Data();
+			PacketSixup.m_DataSize = Pack7.Size();
+
+			// a flushed broadcast sends a packet to every client at once, batch them
+			const bool SendBatch = (Flags & MSGFLAG_FLUSH) && Config()->m_SvSendBatch;
+			if(SendBatch)
+				m_NetServer.BeginBatch();
+			m_NetServer.SendToClients(&Packet, &PacketSixup, aClientIds, aSixup, NumClientIds);
+			if(SendBatch)
+				m_TotalSendSyscallsSaved += m_NetServer.FlushBatch();
 		}
 	}
 	else
@@ -925,6 +946,158 @@ void CServer::SendMsgRaw(int ClientId, const void *pData, int Size, int Flags)
 	m_NetServer.Send(&Packet);
 }
 
+// shared by all threads encoding the snapshots of one tick
+class CSnapshotEncodeBatch
+{
+public:
+	CServer::CClientSnapshot *const *m_ppSnapshots;
+	int m_NumSnapshots;
+	std::atomic<int> m_NextSnapshot{0};
+	std::atomic<int> m_NumEncoded{0};
+
+	CSnapshotEncodeBatch(CServer::CClientSnapshot *const *ppSnapshots, int NumSnapshots) :
+		m_ppSnapshots(ppSnapshots),
+		m_NumSnapshots(NumSnapshots)
+	{
+	}
+
+	// returns false once all snapshots have been claimed
+	bool EncodeNext(CServer::CSnapshotEncoder *pEncoder)
+	{
+		const int Index = m_NextSnapshot.fetch_add(1);
+		if(Index >= m_NumSnapshots)
+			return false;
+		pEncoder->Encode(m_ppSnapshots[Index]);
+		m_NumEncoded.fetch_add(1);
+		return true;
+	}
+
+	bool Done() const { return m_NumEncoded.load() >= m_NumSnapshots; }
+};
+
+class CSnapshotEncodeJob : public IJob
+{
+	std::shared_ptr<CSnapshotEncodeBatch> m_pBatch;
+	CServer::CSnapshotEncoder *m_pEncoder;
+
+	void Run() override
+	{
+		while(m_pBatch->EncodeNext(m_pEncoder))
+		{
+		}
+	}
+
+public:
+	CSnapshotEncodeJob(std::shared_ptr<CSnapshotEncodeBatch> pBatch, CServer::CSnapshotEncoder *pEncoder) :
+		m_pBatch(std::move(pBatch)),
+		m_pEncoder(pEncoder)
+	{
+	}
+};
+
+void CServer::CSnapshotEncoder::Encode(CClientSnapshot *pSnapshot)
+{
+	if(!pSnapshot->m_HasCrc)
+	{
+		pSnapshot->m_Crc = pSnapshot->m_pData->Crc();
+		pSnapshot->m_HasCrc = true;
+	}
+
+	// create delta
+	m_Delta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, pSnapshot->m_Sixup);
+	m_Delta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, pSnapshot->m_Sixup);
+	const int DeltaSize = m_Delta.CreateDelta(pSnapshot->m_pDeltashot, pSnapshot->m_pData, m_aDeltaData);
+
+	// compress it
+	if(DeltaSize)
+		pSnapshot->m_CompSize = CVariableInt::Compress(m_aDeltaData, DeltaSize, pSnapshot->m_aCompData, sizeof(pSnapshot->m_aCompData));
+	else
+		pSnapshot->m_CompSize = 0;
+}
+
+bool CServer::CClientSnapshot::SameDelta(const CClientSnapshot *pOther) const
+{
+	// cheap key first, most snapshots of a tick differ
+	return m_DeltaTick == pOther->m_DeltaTick &&
+	       m_Crc == pOther->m_Crc &&
+	       m_Sixup == pOther->m_Sixup &&
+	       m_DataSize == pOther->m_DataSize &&
+	       m_DeltashotSize == pOther->m_DeltashotSize &&
+	       mem_comp(m_pData, pOther->m_pData, m_DataSize) == 0 &&
+	       mem_comp(m_pDeltashot, pOther->m_pDeltashot, m_DeltashotSize) == 0;
+}
+
+void CServer::EncodeSnapshots()
+{
+	const int NumSnapshots = m_vpSnapshotsToEncode.size();
+	// the main thread is one of the encoders, so it never has to wait for a
+	// job that is still queued behind unrelated work
+	const int NumEncoders = std::clamp(Config()->m_SvSnapshotThreads, 1, std::max(NumSnapshots, 1));
+	while((int)m_vpSnapshotEncoders.size() < NumEncoders)
+		m_vpSnapshotEncoders.push_back(std::make_unique<CSnapshotEncoder>(m_SnapshotDelta));
+
+	auto pBatch = std::make_shared<CSnapshotEncodeBatch>(m_vpSnapshotsToEncode.data(), NumSnapshots);
+	for(int i = 1; i < NumEncoders; i++)
+		Engine()->AddJob(std::make_shared<CSnapshotEncodeJob>(pBatch, m_vpSnapshotEncoders[i].get()));
+
+	while(pBatch->EncodeNext(m_vpSnapshotEncoders[0].get()))
+	{
+	}
+	while(!pBatch->Done())
+		thread_yield();
+}
+
+void CServer::SendSnapshot(const CClientSnapshot *pSnapshot)
+{
+	const int ClientId = pSnapshot->m_ClientId;
+	const int DeltaTick = pSnapshot->m_DeltaTick;
+	const CClientSnapshot *pEncoded = pSnapshot->m_pShared ? pSnapshot->m_pShared : pSnapshot;
+
+	if(pEncoded->m_CompSize)
+	{
+		const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+		const int SnapshotSize = pEncoded->m_CompSize;
+		const char *pCompData = pEncoded->m_aCompData;
+		int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+
+		for(int n = 0, Left = SnapshotSize; Left > 0; n++)
+		{
+			int Chunk = Left < MaxSize ? Left : MaxSize;
+			Left -= Chunk;
+
+			if(NumPackets == 1)
+			{
+				CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(pSnapshot->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+			}
+			else
+			{
+				CMsgPacker Msg(NETMSG_SNAP, true);
+				Msg.AddInt(m_CurrentGameTick);
+				Msg.AddInt(m_CurrentGameTick - DeltaTick);
+				Msg.AddInt(NumPackets);
+				Msg.AddInt(n);
+				Msg.AddInt(pSnapshot->m_Crc);
+				Msg.AddInt(Chunk);
+				Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+				SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+			}
+		}
+	}
+	else
+	{
+		CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+		Msg.AddInt(m_CurrentGameTick);
+		Msg.AddInt(m_CurrentGameTick - DeltaTick);
+		SendMsg(&Msg, MSGFLAG_FLUSH, ClientId);
+	}
+}
+
 void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
@@ -947,6 +1120,9 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
+	// building them touches the game state, so it stays on the main thread
+	int NumSnapshots = 0;
+	m_vpSnapshotsToEncode.clear();
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -977,8 +1153,6 @@ void CServer::DoSnapshot()
 				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
 			}
 
-			int Crc = pData->Crc();
-
 			// remove old snapshots
 			// keep 3 seconds worth of snapshots
 			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - TickSpeed() * 3);
@@ -989,71 +1163,74 @@ void CServer::DoSnapshot()
 			// find snapshot that we can perform delta against
 			int DeltaTick = -1;
 			const CSnapshot *pDeltashot = CSnapshot::EmptySnapshot();
+			int DeltashotSize;
 			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
+				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, nullptr, &pDeltashot, nullptr);
 				if(DeltashotSize >= 0)
 					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
 				else
 				{
+					DeltashotSize = sizeof(CSnapshot);
+
 					// no acked package found, force client to recover rate
 					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
 						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
 				}
 			}
 
-			// create delta
+			// the demo recorders share this delta
 			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
 			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
 
-			if(DeltaSize)
+			// the stored copy stays alive until this client's next snapshot
+			CClientSnapshot *pSnapshot = &m_vClientSnapshots[NumSnapshots++];
+			pSnapshot->m_ClientId = i;
+			pSnapshot->m_Sixup = m_aClients[i].m_Sixup;
+			pSnapshot->m_DeltaTick = DeltaTick;
+			pSnapshot->m_HasCrc = Config()->m_SvSnapshotCache;
+			pSnapshot->m_Crc = pSnapshot->m_HasCrc ? pData->Crc() : 0;
+			pSnapshot->m_pData = m_aClients[i].m_Snapshots.m_pLast->m_pSnap;
+			pSnapshot->m_DataSize = SnapshotSize;
+			pSnapshot->m_pDeltashot = pDeltashot;
+			pSnapshot->m_DeltashotSize = DeltashotSize;
+
+			// clients seeing the same world and having acked the same state get the same delta,
+			// e.g. spectators and teammates in the same area
+			pSnapshot->m_pShared = nullptr;
+			if(Config()->m_SvSnapshotCache)
 			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
-
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
+				for(const CClientSnapshot *pEncoded : m_vpSnapshotsToEncode)
 				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
-
-					if(NumPackets == 1)
+					if(pSnapshot->SameDelta(pEncoded))
 					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
+						pSnapshot->m_pShared = pEncoded;
+						break;
 					}
 				}
 			}
+			if(pSnapshot->m_pShared)
+				m_NumSnapshotsShared++;
 			else
-			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
-			}
+				m_vpSnapshotsToEncode.push_back(pSnapshot);
 		}
 	}
+	m_NumSnapshotsSent += NumSnapshots;
+
+	// delta-encode and compress, in parallel if sv_snapshot_threads allows it
+	if(!m_vpSnapshotsToEncode.empty())
+		EncodeSnapshots();
+
+	// send in client order so packets don't depend on the thread count
+	const bool SendBatch = Config()->m_SvSendBatch;
+	if(SendBatch)
+		m_NetServer.BeginBatch();
+	for(int i = 0; i < NumSnapshots; i++)
+		SendSnapshot(&m_vClientSnapshots[i]);
+	if(SendBatch)
+	{
+		m_SendSyscallsSaved = m_NetServer.FlushBatch();
+		m_TotalSendSyscallsSaved += m_SendSyscallsSaved;
+	}
 
 	GameServer()->OnPostSnap();
 }
@@ -2822,6 +2999,48 @@ void CServer::ReloadMap()
 	m_SameMapReload = true;
 }
 
+void CServer::FreeCurrentMapData(int MapType)
+{
+	if(m_aCurrentMapDataMapped[MapType])
+		io_unmap(m_apCurrentMapData[MapType], m_aCurrentMapSize[MapType]);
+	else
+		free(m_apCurrentMapData[MapType]);
+	m_apCurrentMapData[MapType] = nullptr;
+	m_aCurrentMapDataMapped[MapType] = false;
+}
+
+void CServer::ShareCurrentMapData(int MapType)
+{
+	if(Config()->m_SvMapCacheDir[0] == '\0' || !m_apCurrentMapData[MapType] || m_aCurrentMapDataMapped[MapType])
+		return;
+
+	// the first server that loads the map writes the copy for all others
+	char aPath[IO_MAX_PATH_LENGTH];
+	CMapCacheFile::Path(aPath, sizeof(aPath), Config()->m_SvMapCacheDir, m_aCurrentMapSha256[MapType], MapType == MAP_TYPE_SIX ? "map" : "map7");
+	if(!fs_is_file(aPath))
+	{
+		CMapCacheFile CacheFile;
+		if(!CacheFile.Begin(aPath) || !CacheFile.Write(m_apCurrentMapData[MapType], m_aCurrentMapSize[MapType]) || !CacheFile.Finish())
+			return;
+	}
+
+	void *pData;
+	unsigned Size;
+	if(!CMapCacheFile::Map(aPath, &pData, &Size))
+		return;
+	// the file can be left over from a broken write, only share it if it
+	// holds exactly the map
+	if(Size != m_aCurrentMapSize[MapType] || mem_comp(pData, m_apCurrentMapData[MapType], Size) != 0)
+	{
+		log_error("map_cache", "'%s' does not match the map", aPath);
+		io_unmap(pData, Size);
+		return;
+	}
+	free(m_apCurrentMapData[MapType]);
+	m_apCurrentMapData[MapType] = static_cast<unsigned char *>(pData);
+	m_aCurrentMapDataMapped[MapType] = true;
+}
+
 int CServer::LoadMap(const char *pMapName)
 {
 	m_MapReload = false;
@@ -2831,6 +3050,7 @@ int CServer::LoadMap(const char *pMapName)
 	str_format(aBuf, sizeof(aBuf), "maps/%s.map", pMapName);
 	GameServer()->OnMapChange(aBuf, sizeof(aBuf));
 
+	m_pMap->SetCacheDirectory(Config()->m_SvMapCacheDir);
 	if(!m_pMap->Load(aBuf))
 		return 0;
 
@@ -2851,10 +3071,11 @@ int CServer::LoadMap(const char *pMapName)
 
 	// load complete map into memory for download
 	{
-		free(m_apCurrentMapData[MAP_TYPE_SIX]);
+		FreeCurrentMapData(MAP_TYPE_SIX);
 		void *pData;
 		Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIX]);
 		m_apCurrentMapData[MAP_TYPE_SIX] = (unsigned char *)pData;
+		ShareCurrentMapData(MAP_TYPE_SIX);
 	}
 
 	if(Config()->m_SvMapsBaseUrl[0])
@@ -2874,7 +3095,8 @@ int CServer::LoadMap(const char *pMapName)
 	{
 		str_format(aBuf, sizeof(aBuf), "maps7/%s.map", pMapName);
 		void *pData;
-		if(!Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &m_aCurrentMapSize[MAP_TYPE_SIXUP]))
+		unsigned DataSize;
+		if(!Storage()->ReadFile(aBuf, IStorage::TYPE_ALL, &pData, &DataSize))
 		{
 			Config()->m_SvSixup = 0;
 			if(m_pRegister)
@@ -2886,11 +3108,13 @@ int CServer::LoadMap(const char *pMapName)
 		}
 		else
 		{
-			free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
+			FreeCurrentMapData(MAP_TYPE_SIXUP);
 			m_apCurrentMapData[MAP_TYPE_SIXUP] = (unsigned char *)pData;
+			m_aCurrentMapSize[MAP_TYPE_SIXUP] = DataSize;
 
 			m_aCurrentMapSha256[MAP_TYPE_SIXUP] = sha256(m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
 			m_aCurrentMapCrc[MAP_TYPE_SIXUP] = crc32(0, m_apCurrentMapData[MAP_TYPE_SIXUP], m_aCurrentMapSize[MAP_TYPE_SIXUP]);
+			ShareCurrentMapData(MAP_TYPE_SIXUP);
 			sha256_str(m_aCurrentMapSha256[MAP_TYPE_SIXUP], aSha256, sizeof(aSha256));
 			str_format(aBufMsg, sizeof(aBufMsg), "%s sha256 is %s", aBuf, aSha256);
 			Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "sixup", aBufMsg);
@@ -2898,8 +3122,7 @@ int CServer::LoadMap(const char *pMapName)
 	}
 	if(!Config()->m_SvSixup)
 	{
-		free(m_apCurrentMapData[MAP_TYPE_SIXUP]);
-		m_apCurrentMapData[MAP_TYPE_SIXUP] = nullptr;
+		FreeCurrentMapData(MAP_TYPE_SIXUP);
 	}
 
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -2991,6 +3214,9 @@ int CServer::Run()
 	}
 	m_pPersistentData = malloc(GameServer()->PersistentDataSize());
 
+	if(Config()->m_SvMapCacheDir[0] != '\0' && Config()->m_SvMapCacheMaxAge > 0)
+		CMapCacheFile::RemoveOld(Config()->m_SvMapCacheDir, time_timestamp() - Config()->m_SvMapCacheMaxAge * (int64_t)60 * 60 * 24);
+
 	// load map
 	if(!LoadMap(Config()->m_SvMap))
 	{
@@ -3393,6 +3619,21 @@ int CServer::Run()
 	return ErrorShutdown();
 }
 
+void CServer::InitOffline(IRegister *pRegister)
+{
+	m_RunServer = RUNNING;
+	m_AuthManager.Init();
+	m_pEngine = Kernel()->RequestInterface<IEngine>();
+	m_pRegister = pRegister;
+
+	int Size = GameServer()->PersistentClientDataSize();
+	for(auto &Client : m_aClients)
+	{
+		Client.m_HasPersistentData = false;
+		Client.m_pPersistentData = malloc(Size);
+	}
+}
+
 void CServer::ConKick(IConsole::IResult *pResult, void *pUser)
 {
 	if(pResult->NumArguments() > 1)
@@ -3460,6 +3701,19 @@ void CServer::ConStatus(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConSnapshotStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = static_cast<CServer *>(pUser);
+	const uint64_t Sent = pThis->m_NumSnapshotsSent;
+	const uint64_t Shared = pThis->m_NumSnapshotsShared;
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "snapshots=%" PRIu64 " encoded=%" PRIu64 " shared=%" PRIu64 " hitrate=%.1f%% threads=%d",
+		Sent, Sent - Shared, Shared, Sent ? Shared * 100.0 / Sent : 0.0, pThis->Config()->m_SvSnapshotThreads);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	str_format(aBuf, sizeof(aBuf), "send syscalls saved: last_tick=%d total=%" PRIu64, pThis->m_SendSyscallsSaved, pThis->m_TotalSendSyscallsSaved);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
 static int GetAuthLevel(const char *pLevel)
 {
 	int Level = -1;
@@ -3726,7 +3980,7 @@ void CServer::DemoRecorder_HandleAutoStart()
 		{
 			// clean up auto recorded demos
 			CFileCollection AutoDemos;
-			AutoDemos.Init(Storage(), "demos/auto/server", "", ".demo", Config()->m_SvAutoDemoMax);
+			AutoDemos.Init(Storage(), "demos/auto/server", "", ".demo", Config()->m_SvAutoDemoMax, RemoveDemoFile);
 		}
 	}
 }
@@ -3955,6 +4209,12 @@ void CServer::ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData)
 	}
 }
 
+void CServer::ConDumpSqlStats(IConsole::IResult *pResult, void *pUserData)
+{
+	CServer *pSelf = (CServer *)pUserData;
+	pSelf->DbPool()->PrintStats(pSelf->Console());
+}
+
 void CServer::ConReloadAnnouncement(IConsole::IResult *pResult, void *pUserData)
 {
 	CServer *pThis = static_cast<CServer *>(pUserData);
@@ -4206,6 +4466,7 @@ void CServer::RegisterCommands()
 	// register console commands
 	Console()->Register("kick", "i[id] ?r[reason]", CFGFLAG_SERVER, ConKick, this, "Kick player with specified id for any reason");
 	Console()->Register("status", "?r[name]", CFGFLAG_SERVER, ConStatus, this, "List players containing name or all players");
+	Console()->Register("snapshot_stats", "", CFGFLAG_SERVER, ConSnapshotStats, this, "Show how many client snapshots were encoded, how many reused an identical delta and how many send syscalls were saved");
 	Console()->Register("shutdown", "?r[reason]", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 	Console()->Register("show_ips", "?i[show]", CFGFLAG_SERVER, ConShowIps, this, "Show IP addresses in rcon commands (1 = on, 0 = off)");
@@ -4218,6 +4479,7 @@ void CServer::RegisterCommands()
 
 	Console()->Register("add_sqlserver", "s['r'|'w'] s[Database] s[Prefix] s[User] s[Password] s[IP] i[Port] ?i[SetUpDatabase ?]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAddSqlServer, this, "add a sqlserver");
 	Console()->Register("dump_sqlservers", "s['r'|'w']", CFGFLAG_SERVER, ConDumpSqlServers, this, "dumps all sqlservers readservers = r, writeservers = w");
+	Console()->Register("dump_sqlstats", "", CFGFLAG_SERVER, ConDumpSqlStats, this, "dumps latency histograms of the executed sql queries");
 
 	Console()->Register("auth_add", "s[ident] s[level] r[pw]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAdd, this, "Add a rcon key");
 	Console()->Register("auth_add_p", "s[ident] s[level] s[hash] s[salt]", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, ConAuthAddHashed, this, "Add a prehashed rcon key");
@@ -4278,6 +4540,8 @@ void *CServer::SnapNewItem(int Type, int Id, int Size)
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	for(auto &pEncoder : m_vpSnapshotEncoders)
+		pEncoder->m_Delta.SetStaticsize(ItemType, Size);
 }
 
 CServer *CreateServer() { return new CServer(); }
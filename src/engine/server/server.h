@@ -211,8 +211,53 @@ public:
 	CClient m_aClients[MAX_CLIENTS];
 	int m_aIdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
+	// per-client snapshot of the current tick, waiting to be delta-encoded and sent
+	class CClientSnapshot
+	{
+	public:
+		int m_ClientId;
+		bool m_Sixup;
+		int m_DeltaTick;
+		// computed up front as the key of the snapshot cache, by the encoder otherwise
+		bool m_HasCrc;
+		int m_Crc;
+		const CSnapshot *m_pData;
+		int m_DataSize;
+		const CSnapshot *m_pDeltashot;
+		int m_DeltashotSize;
+
+		// earlier snapshot of this tick with the same delta, reused instead of encoding this one
+		const CClientSnapshot *m_pShared;
+
+		// filled by the encoder
+		int m_CompSize;
+		char m_aCompData[CSnapshot::MAX_SIZE];
+
+		bool SameDelta(const CClientSnapshot *pOther) const;
+	};
+
+	// delta state and scratch space of one thread encoding snapshots
+	class CSnapshotEncoder
+	{
+	public:
+		CSnapshotEncoder(const CSnapshotDelta &Delta) :
+			m_Delta(Delta) {}
+
+		CSnapshotDelta m_Delta;
+		char m_aDeltaData[CSnapshot::MAX_SIZE];
+
+		void Encode(CClientSnapshot *pSnapshot);
+	};
+
 	CSnapshotDelta m_SnapshotDelta;
 	CSnapshotBuilder m_SnapshotBuilder;
+	std::vector<CClientSnapshot> m_vClientSnapshots;
+	std::vector<CClientSnapshot *> m_vpSnapshotsToEncode;
+	uint64_t m_NumSnapshotsSent = 0;
+	uint64_t m_NumSnapshotsShared = 0;
+	int m_SendSyscallsSaved = 0; // by batching the packets of the last snapshot tick
+	uint64_t m_TotalSendSyscallsSaved = 0;
+	std::vector<std::unique_ptr<CSnapshotEncoder>> m_vpSnapshotEncoders;
 	CSnapIdPool m_IdPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -263,6 +308,8 @@ public:
 	unsigned m_aCurrentMapCrc[NUM_MAP_TYPES];
 	unsigned char *m_apCurrentMapData[NUM_MAP_TYPES];
 	unsigned int m_aCurrentMapSize[NUM_MAP_TYPES];
+	// the data is mapped from the map cache directory instead of allocated
+	bool m_aCurrentMapDataMapped[NUM_MAP_TYPES];
 	char m_aMapDownloadUrl[256];
 
 	CDemoRecorder m_aDemoRecorder[NUM_RECORDERS];
@@ -333,6 +380,8 @@ public:
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientId) override;
 
 	void DoSnapshot();
+	void EncodeSnapshots();
+	void SendSnapshot(const CClientSnapshot *pSnapshot);
 
 	static int NewClientCallback(int ClientId, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientId, void *pUser);
@@ -418,6 +467,8 @@ public:
 	const char *GetMapName() const override;
 	void ReloadMap() override;
 	int LoadMap(const char *pMapName);
+	void FreeCurrentMapData(int MapType);
+	void ShareCurrentMapData(int MapType);
 
 	void SaveDemo(int ClientId, float Time) override;
 	void StartRecord(int ClientId) override;
@@ -426,9 +477,15 @@ public:
 	void StopDemos() override;
 
 	int Run();
+	// Sets up the server like Run does, for tools that drive the game tick
+	// by tick instead, like teehistorian_bench. pRegister takes the place
+	// of the master server registration, the server takes ownership of it.
+	void InitOffline(class IRegister *pRegister);
+	void AdvanceTick() { m_CurrentGameTick++; }
 
 	static void ConKick(IConsole::IResult *pResult, void *pUser);
 	static void ConStatus(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapshotStats(IConsole::IResult *pResult, void *pUser);
 	static void ConShutdown(IConsole::IResult *pResult, void *pUser);
 	static void ConRecord(IConsole::IResult *pResult, void *pUser);
 	static void ConStopRecord(IConsole::IResult *pResult, void *pUser);
@@ -447,6 +504,7 @@ public:
 	// console commands for sqlmasters
 	static void ConAddSqlServer(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpSqlServers(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpSqlStats(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConReloadAnnouncement(IConsole::IResult *pResult, void *pUserData);
 	static void ConReloadMaplist(IConsole::IResult *pResult, void *pUserData);
@@ -1,11 +1,39 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/math.h>
 #include <base/system.h>
 
 #include "compression.h"
 
+#include <cstdint>
 #include <iterator> // std::size
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VARINT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define VARINT_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#if defined(VARINT_SSE2) || defined(VARINT_NEON)
+// number of trailing zero bits, Mask must not be 0
+static inline int CountTrailingZeros(uint64_t Mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long Index;
+	_BitScanForward64(&Index, Mask);
+	return Index;
+#else
+	return __builtin_ctzll(Mask);
+#endif
+}
+#endif
+
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
 unsigned char *CVariableInt::Pack(unsigned char *pDst, int i, int DstSize)
 {
@@ -75,6 +103,52 @@ long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int D
 	const int *pDstEnd = pDst + DstSize / sizeof(int);
 	while(pSrc < pSrcEnd)
 	{
+#if defined(VARINT_SSE2) || defined(VARINT_NEON)
+		// snapshot deltas are mostly small ints packed into a single byte,
+		// decode the leading single byte ints of the next 16 bytes at once
+		if(pSrcEnd - pSrc >= 16 && pDstEnd - pDst >= 4)
+		{
+#if defined(VARINT_SSE2)
+			const __m128i Bytes = _mm_loadu_si128((const __m128i *)pSrc);
+			const int NumSingle = CountTrailingZeros(_mm_movemask_epi8(Bytes) | 0x10000);
+#else
+			const uint8x16_t Bytes = vld1q_u8(pSrc);
+			// four bits per byte that are set for bytes with the extend bit
+			const uint64_t ExtendMask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(vcltzq_s8(vreinterpretq_s8_u8(Bytes))), 4)), 0);
+			const int NumSingle = ExtendMask ? CountTrailingZeros(ExtendMask) / 4 : 16;
+#endif
+			const int Num = minimum<int>(NumSingle, pDstEnd - pDst) & ~3;
+			if(Num)
+			{
+#if defined(VARINT_SSE2)
+				const __m128i Zero = _mm_setzero_si128();
+				const __m128i Low = _mm_unpacklo_epi8(Bytes, Zero);
+				const __m128i High = _mm_unpackhi_epi8(Bytes, Zero);
+				const __m128i aWords[4] = {_mm_unpacklo_epi16(Low, Zero), _mm_unpackhi_epi16(Low, Zero), _mm_unpacklo_epi16(High, Zero), _mm_unpackhi_epi16(High, Zero)};
+				for(int i = 0; i < Num / 4; i++)
+				{
+					// the sign bit is moved to the top and spread over the whole int
+					const __m128i Sign = _mm_srai_epi32(_mm_slli_epi32(aWords[i], 25), 31);
+					_mm_storeu_si128((__m128i *)(pDst + i * 4), _mm_xor_si128(_mm_and_si128(aWords[i], _mm_set1_epi32(0x3F)), Sign));
+				}
+#else
+				const int16x8_t Low = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(Bytes)));
+				const int16x8_t High = vreinterpretq_s16_u16(vmovl_high_u8(Bytes));
+				const int32x4_t aWords[4] = {vmovl_s16(vget_low_s16(Low)), vmovl_high_s16(Low), vmovl_s16(vget_low_s16(High)), vmovl_high_s16(High)};
+				for(int i = 0; i < Num / 4; i++)
+				{
+					// the sign bit is moved to the top and spread over the whole int
+					const int32x4_t Sign = vshrq_n_s32(vshlq_n_s32(aWords[i], 25), 31);
+					vst1q_s32(pDst + i * 4, veorq_s32(vandq_s32(aWords[i], vdupq_n_s32(0x3F)), Sign));
+				}
+#endif
+				pSrc += Num;
+				pDst += Num;
+				if(pSrc >= pSrcEnd)
+					break;
+			}
+		}
+#endif
 		if(pDst >= pDstEnd)
 			return -1;
 		pSrc = CVariableInt::Unpack(pSrc, pDst, pSrcEnd - pSrc);
@@ -95,6 +169,44 @@ long CVariableInt::Compress(const void *pSrc_, int SrcSize, void *pDst_, int Dst
 	SrcSize /= sizeof(int);
 	while(SrcSize)
 	{
+#if defined(VARINT_SSE2) || defined(VARINT_NEON)
+		// pack the leading ints of the next eight that fit into a single byte at once,
+		// the bytes after them are overwritten by the following ints
+		if(SrcSize >= 8 && pDstEnd - pDst >= 8)
+		{
+#if defined(VARINT_SSE2)
+			const __m128i Values0 = _mm_loadu_si128((const __m128i *)pSrc);
+			const __m128i Values1 = _mm_loadu_si128((const __m128i *)(pSrc + 4));
+			const __m128i Sign0 = _mm_srai_epi32(Values0, 31);
+			const __m128i Sign1 = _mm_srai_epi32(Values1, 31);
+			const __m128i Magnitude0 = _mm_xor_si128(Values0, Sign0);
+			const __m128i Magnitude1 = _mm_xor_si128(Values1, Sign1);
+			const __m128i Large = _mm_packs_epi32(_mm_cmpgt_epi32(Magnitude0, _mm_set1_epi32(0x3F)), _mm_cmpgt_epi32(Magnitude1, _mm_set1_epi32(0x3F)));
+			const int NumSingle = CountTrailingZeros((_mm_movemask_epi8(_mm_packs_epi16(Large, Large)) & 0xFF) | 0x100);
+			const __m128i Words = _mm_packs_epi32(_mm_or_si128(Magnitude0, _mm_and_si128(Sign0, _mm_set1_epi32(0x40))), _mm_or_si128(Magnitude1, _mm_and_si128(Sign1, _mm_set1_epi32(0x40))));
+			_mm_storel_epi64((__m128i *)pDst, _mm_packus_epi16(Words, Words));
+#else
+			const int32x4_t Values0 = vld1q_s32(pSrc);
+			const int32x4_t Values1 = vld1q_s32(pSrc + 4);
+			const int32x4_t Sign0 = vshrq_n_s32(Values0, 31);
+			const int32x4_t Sign1 = vshrq_n_s32(Values1, 31);
+			const int32x4_t Magnitude0 = veorq_s32(Values0, Sign0);
+			const int32x4_t Magnitude1 = veorq_s32(Values1, Sign1);
+			// eight bits per int that are set for ints needing more than one byte
+			const uint16x8_t Large = vcombine_u16(vmovn_u32(vcgtq_s32(Magnitude0, vdupq_n_s32(0x3F))), vmovn_u32(vcgtq_s32(Magnitude1, vdupq_n_s32(0x3F))));
+			const uint64_t LargeMask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(Large)), 0);
+			const int NumSingle = LargeMask ? CountTrailingZeros(LargeMask) / 8 : 8;
+			const int32x4_t Packed0 = vorrq_s32(Magnitude0, vandq_s32(Sign0, vdupq_n_s32(0x40)));
+			const int32x4_t Packed1 = vorrq_s32(Magnitude1, vandq_s32(Sign1, vdupq_n_s32(0x40)));
+			vst1_u8(pDst, vmovn_u16(vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(Packed0)), vmovn_u32(vreinterpretq_u32_s32(Packed1)))));
+#endif
+			pDst += NumSingle;
+			pSrc += NumSingle;
+			SrcSize -= NumSingle;
+			if(NumSingle == 8)
+				continue;
+		}
+#endif
 		pDst = CVariableInt::Pack(pDst, *pSrc, pDstEnd - pDst);
 		if(!pDst)
 			return -1;
@@ -447,6 +447,9 @@ MACRO_CONFIG_STR(SvMap, sv_map, 128, "Sunny Side Up", CFGFLAG_SERVER, "Map to us
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, LEGACY_MAX_CLIENTS, 1, LEGACY_MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIp, sv_max_clients_per_ip, 4, 1, LEGACY_MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 0, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
+MACRO_CONFIG_INT(SvSnapshotThreads, sv_snapshot_threads, 1, 1, 64, CFGFLAG_SERVER, "Number of threads used to delta-encode and compress client snapshots (1 = main thread only)")
+MACRO_CONFIG_INT(SvSnapshotCache, sv_snapshot_cache, 0, 0, 1, CFGFLAG_SERVER, "Encode identical snapshot deltas of the same tick only once and send them to all clients that need them")
+MACRO_CONFIG_INT(SvSendBatch, sv_send_batch, 1, 0, 1, CFGFLAG_SERVER, "Collect the packets of a snapshot tick or a broadcast message and send them with as few system calls as possible")
 MACRO_CONFIG_STR(SvRegister, sv_register, 16, "1", CFGFLAG_SERVER, "Register server with master server for public listing, can also accept a comma-separated list of protocols to register on, like 'ipv4,ipv6'")
 MACRO_CONFIG_STR(SvRegisterExtra, sv_register_extra, 256, "", CFGFLAG_SERVER, "Extra headers to send to the register endpoint, comma-separated 'Header: Value' pairs")
 MACRO_CONFIG_STR(SvRegisterUrl, sv_register_url, 128, "https://master1.ddnet.org/ddnet/15/register", CFGFLAG_SERVER, "Masterserver URL to register to")
@@ -459,6 +462,7 @@ MACRO_CONFIG_INT(SvRconBantime, sv_rcon_bantime, 5, 0, 1440, CFGFLAG_SERVER, "Th
 MACRO_CONFIG_INT(SvAutoDemoRecord, sv_auto_demo_record, 0, 0, 1, CFGFLAG_SERVER, "Automatically record demos")
 MACRO_CONFIG_INT(SvAutoDemoMax, sv_auto_demo_max, 10, 0, 1000, CFGFLAG_SERVER, "Maximum number of automatically recorded demos (0 = no limit)")
 MACRO_CONFIG_INT(SvTeeHistorian, sv_tee_historian, 0, 0, 1, CFGFLAG_SERVER, "Activate the tee historian that writes complete gameplay data to disk (WARNING: This will use a lot of disk space)")
+MACRO_CONFIG_INT(SvTeeHistorianCompression, sv_tee_historian_compression, 0, 0, 9, CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, "Compression level of gzip compressed teehistorian files (0 = write uncompressed files)")
 MACRO_CONFIG_INT(SvVanillaAntiSpoof, sv_vanilla_antispoof, 1, 0, 1, CFGFLAG_SERVER, "Enable vanilla Antispoof")
 MACRO_CONFIG_INT(SvDnsbl, sv_dnsbl, 0, 0, 1, CFGFLAG_SERVER, "Enable DNSBL (DNS-based Blackhole List)")
 MACRO_CONFIG_STR(SvDnsblHost, sv_dnsbl_host, 128, "", CFGFLAG_SERVER, "Hostname of DNSBL provider to use for IP Verification")
@@ -473,6 +477,8 @@ MACRO_CONFIG_INT(SvPlayerDemoRecord, sv_player_demo_record, 0, 0, 1, CFGFLAG_SER
 MACRO_CONFIG_INT(SvDemoChat, sv_demo_chat, 0, 0, 1, CFGFLAG_SERVER, "Record chat for demos")
 MACRO_CONFIG_INT(SvServerInfoPerSecond, sv_server_info_per_second, 50, 0, 10000, CFGFLAG_SERVER, "Maximum number of complete server info responses that are sent out per second (0 for no limit)")
 MACRO_CONFIG_INT(SvVanConnPerSecond, sv_van_conn_per_second, 10, 0, 10000, CFGFLAG_SERVER, "Antispoof specific ratelimit (0 for no limit)")
+MACRO_CONFIG_STR(SvMapCacheDir, sv_map_cache_dir, IO_MAX_PATH_LENGTH, "", CFGFLAG_SERVER, "Directory (e.g. on /dev/shm) for map data shared by the servers of this host, disabled if empty")
+MACRO_CONFIG_INT(SvMapCacheMaxAge, sv_map_cache_max_age, 30, 0, 3650, CFGFLAG_SERVER, "Remove files from sv_map_cache_dir that weren't used for this many days when the server starts (0 to keep them)")
 MACRO_CONFIG_INT(SvSixup, sv_sixup, 1, 0, 1, CFGFLAG_SERVER, "Enable sixup connections")
 MACRO_CONFIG_INT(SvSkillLevel, sv_skill_level, 1, SERVERINFO_LEVEL_MIN, SERVERINFO_LEVEL_MAX, CFGFLAG_SERVER, "Difficulty level for Teeworlds 0.7 (0: Casual, 1: Normal, 2: Competitive)")
 
@@ -549,6 +555,10 @@ MACRO_CONFIG_INT(SvSwap, sv_swap, 1, 0, 1, CFGFLAG_SERVER, "Enable /swap")
 MACRO_CONFIG_INT(SvTeam0Mode, sv_team0mode, 1, 0, 1, CFGFLAG_SERVER, "Enables /team0mode")
 MACRO_CONFIG_INT(SvUseSql, sv_use_sql, 0, 0, 1, CFGFLAG_SERVER, "Enables MySQL backend instead of SQLite backend (sv_sqlite_file is still used as fallback write server when no MySQL server is reachable)")
 MACRO_CONFIG_INT(SvSqlQueriesDelay, sv_sql_queries_delay, 1, 0, 20, CFGFLAG_SERVER, "Delay in seconds between SQL queries of a single player")
+MACRO_CONFIG_INT(SvSqlLeaderboardCache, sv_sql_leaderboard_cache, 60, 0, 3600, CFGFLAG_SERVER, "Seconds to keep rank, top and points leaderboards in memory before reloading them from the database (0 to always query the database)")
+MACRO_CONFIG_INT(SvSqlGroupCommit, sv_sql_group_commit, 32, 1, 256, CFGFLAG_SERVER, "Maximum number of queued SQL writes committed in one transaction (1 to commit every write on its own)")
+MACRO_CONFIG_INT(SvSqlGroupCommitWindow, sv_sql_group_commit_window, 5, 0, 1000, CFGFLAG_SERVER, "Milliseconds to wait for further SQL writes before committing a transaction")
+MACRO_CONFIG_INT(SvSqlReadWorkers, sv_sql_read_workers, 4, 1, 16, CFGFLAG_SERVER, "Number of threads (each with its own connections) executing SQL read queries")
 MACRO_CONFIG_STR(SvSqliteFile, sv_sqlite_file, 64, "ddnet-server.sqlite", CFGFLAG_SERVER, "File to store ranks in case sv_use_sql is turned off or used as backup sql server")
 
 #if defined(CONF_UPNP)
@@ -14,6 +14,8 @@
 #include "console.h"
 #include "linereader.h"
 
+#include <algorithm>
+#include <cctype>
 #include <iterator> // std::size
 #include <new>
 
@@ -369,6 +371,39 @@ void CConsole::InitChecksum(CChecksumData *pData) const
 	}
 }
 
+// returns the end of the first command in pStr, *ppNextPart is set to the
+// following command or nullptr if there is none
+static const char *CommandEnd(const char *pStr, bool InterpretSemicolons, const char **ppNextPart)
+{
+	const char *pEnd = pStr;
+	int InString = 0;
+	*ppNextPart = nullptr;
+
+	while(*pEnd)
+	{
+		if(*pEnd == '"')
+			InString ^= 1;
+		else if(*pEnd == '\\') // escape sequences
+		{
+			if(pEnd[1] == '"')
+				pEnd++;
+		}
+		else if(!InString && InterpretSemicolons)
+		{
+			if(*pEnd == ';') // command separator
+			{
+				*ppNextPart = pEnd + 1;
+				break;
+			}
+			else if(*pEnd == '#') // comment, no need to do anything more
+				break;
+		}
+
+		pEnd++;
+	}
+	return pEnd;
+}
+
 bool CConsole::LineIsValid(const char *pStr)
 {
 	if(!pStr || *pStr == 0)
@@ -377,32 +412,8 @@ bool CConsole::LineIsValid(const char *pStr)
 	do
 	{
 		CResult Result(-1);
-		const char *pEnd = pStr;
-		const char *pNextPart = nullptr;
-		int InString = 0;
-
-		while(*pEnd)
-		{
-			if(*pEnd == '"')
-				InString ^= 1;
-			else if(*pEnd == '\\') // escape sequences
-			{
-				if(pEnd[1] == '"')
-					pEnd++;
-			}
-			else if(!InString)
-			{
-				if(*pEnd == ';') // command separator
-				{
-					pNextPart = pEnd + 1;
-					break;
-				}
-				else if(*pEnd == '#') // comment, no need to do anything more
-					break;
-			}
-
-			pEnd++;
-		}
+		const char *pNextPart;
+		const char *pEnd = CommandEnd(pStr, true, &pNextPart);
 
 		if(ParseStart(&Result, pStr, (pEnd - pStr) + 1) != 0)
 			return false;
@@ -427,161 +438,154 @@ void CConsole::ExecuteLineStroked(int Stroke, const char *pStr, int ClientId, bo
 	}
 	while(pStr && *pStr)
 	{
-		CResult Result(ClientId);
-		const char *pEnd = pStr;
-		const char *pNextPart = nullptr;
-		int InString = 0;
+		const char *pNextPart;
+		const char *pEnd = CommandEnd(pStr, InterpretSemicolons, &pNextPart);
+		if(!ExecuteCommand(Stroke, pStr, pEnd - pStr, ClientId, nullptr))
+			return;
+
+		pStr = pNextPart;
+	}
+}
+
+bool CConsole::ExecuteCommand(int Stroke, const char *pStr, int Length, int ClientId, CCompiledCommand *pCompiled)
+{
+	CResult Result(ClientId);
+	if(ParseStart(&Result, pStr, Length + 1) != 0)
+		return false;
 
-		while(*pEnd)
+	if(!*Result.m_pCommand)
+		return false;
+
+	CCommand *pCommand;
+	if(ClientId == IConsole::CLIENT_ID_GAME)
+		pCommand = FindCommand(Result.m_pCommand, m_FlagMask | CFGFLAG_GAME);
+	else
+		pCommand = FindCommand(Result.m_pCommand, m_FlagMask);
+
+	if(pCommand)
+	{
+		if(ClientId == IConsole::CLIENT_ID_GAME && !(pCommand->m_Flags & CFGFLAG_GAME))
 		{
-			if(*pEnd == '"')
-				InString ^= 1;
-			else if(*pEnd == '\\') // escape sequences
+			if(Stroke)
 			{
-				if(pEnd[1] == '"')
-					pEnd++;
+				char aBuf[CMDLINE_LENGTH + 64];
+				str_format(aBuf, sizeof(aBuf), "Command '%s' cannot be executed from a map.", Result.m_pCommand);
+				Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
 			}
-			else if(!InString && InterpretSemicolons)
+		}
+		else if(ClientId == IConsole::CLIENT_ID_NO_GAME && pCommand->m_Flags & CFGFLAG_GAME)
+		{
+			if(Stroke)
 			{
-				if(*pEnd == ';') // command separator
-				{
-					pNextPart = pEnd + 1;
-					break;
-				}
-				else if(*pEnd == '#') // comment, no need to do anything more
-					break;
+				char aBuf[CMDLINE_LENGTH + 64];
+				str_format(aBuf, sizeof(aBuf), "Command '%s' cannot be executed from a non-map config file.", Result.m_pCommand);
+				Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
+				str_format(aBuf, sizeof(aBuf), "Hint: Put the command in '%s.cfg' instead of '%s.map.cfg' ", g_Config.m_SvMap, g_Config.m_SvMap);
+				Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
 			}
-
-			pEnd++;
 		}
-
-		if(ParseStart(&Result, pStr, (pEnd - pStr) + 1) != 0)
-			return;
-
-		if(!*Result.m_pCommand)
-			return;
-
-		CCommand *pCommand;
-		if(ClientId == IConsole::CLIENT_ID_GAME)
-			pCommand = FindCommand(Result.m_pCommand, m_FlagMask | CFGFLAG_GAME);
-		else
-			pCommand = FindCommand(Result.m_pCommand, m_FlagMask);
-
-		if(pCommand)
+		else if(pCommand->GetAccessLevel() >= m_AccessLevel)
 		{
-			if(ClientId == IConsole::CLIENT_ID_GAME && !(pCommand->m_Flags & CFGFLAG_GAME))
+			int IsStrokeCommand = 0;
+			if(Result.m_pCommand[0] == '+')
 			{
-				if(Stroke)
-				{
-					char aBuf[CMDLINE_LENGTH + 64];
-					str_format(aBuf, sizeof(aBuf), "Command '%s' cannot be executed from a map.", Result.m_pCommand);
-					Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
-				}
+				// insert the stroke direction token
+				Result.AddArgument(m_apStrokeStr[Stroke]);
+				IsStrokeCommand = 1;
 			}
-			else if(ClientId == IConsole::CLIENT_ID_NO_GAME && pCommand->m_Flags & CFGFLAG_GAME)
+
+			if(Stroke || IsStrokeCommand)
 			{
-				if(Stroke)
+				bool IsColor = false;
+				{
+					FCommandCallback pfnCallback = pCommand->m_pfnCallback;
+					void *pUserData = pCommand->m_pUserData;
+					TraverseChain(&pfnCallback, &pUserData);
+					IsColor = pfnCallback == &SColorConfigVariable::CommandCallback;
+				}
+
+				if(int Error = ParseArgs(&Result, pCommand->m_pParams, IsColor))
 				{
 					char aBuf[CMDLINE_LENGTH + 64];
-					str_format(aBuf, sizeof(aBuf), "Command '%s' cannot be executed from a non-map config file.", Result.m_pCommand);
-					Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
-					str_format(aBuf, sizeof(aBuf), "Hint: Put the command in '%s.cfg' instead of '%s.map.cfg' ", g_Config.m_SvMap, g_Config.m_SvMap);
-					Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
+					if(Error == PARSEARGS_INVALID_INTEGER)
+						str_format(aBuf, sizeof(aBuf), "%s is not a valid integer.", Result.GetString(Result.NumArguments() - 1));
+					else if(Error == PARSEARGS_INVALID_FLOAT)
+						str_format(aBuf, sizeof(aBuf), "%s is not a valid decimal number.", Result.GetString(Result.NumArguments() - 1));
+					else
+						str_format(aBuf, sizeof(aBuf), "Invalid arguments. Usage: %s %s", pCommand->m_pName, pCommand->m_pParams);
+					Print(OUTPUT_LEVEL_STANDARD, "chatresp", aBuf);
 				}
-			}
-			else if(pCommand->GetAccessLevel() >= m_AccessLevel)
-			{
-				int IsStrokeCommand = 0;
-				if(Result.m_pCommand[0] == '+')
+				else
 				{
-					// insert the stroke direction token
-					Result.AddArgument(m_apStrokeStr[Stroke]);
-					IsStrokeCommand = 1;
+					if(pCompiled && !IsStrokeCommand)
+						StoreParsedCommand(pCompiled, pCommand, Result, Length);
+					return RunCommand(pCommand, &Result, ClientId);
 				}
+			}
+		}
+		else if(Stroke)
+		{
+			char aBuf[CMDLINE_LENGTH + 32];
+			str_format(aBuf, sizeof(aBuf), "Access for command %s denied.", Result.m_pCommand);
+			Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
+		}
+	}
+	else if(Stroke)
+	{
+		// Pass the original string to the unknown command callback instead of the parsed command, as the latter
+		// ends at the first whitespace, which breaks for unknown commands (filenames) containing spaces.
+		if(!m_pfnUnknownCommandCallback(pStr, m_pUnknownCommandUserdata))
+		{
+			char aBuf[CMDLINE_LENGTH + 32];
+			if(m_FlagMask & CFGFLAG_CHAT)
+				str_format(aBuf, sizeof(aBuf), "No such command: %s. Use /cmdlist for a list of all commands.", Result.m_pCommand);
+			else
+				str_format(aBuf, sizeof(aBuf), "No such command: %s.", Result.m_pCommand);
+			Print(OUTPUT_LEVEL_STANDARD, "chatresp", aBuf);
+		}
+	}
 
-				if(Stroke || IsStrokeCommand)
-				{
-					bool IsColor = false;
-					{
-						FCommandCallback pfnCallback = pCommand->m_pfnCallback;
-						void *pUserData = pCommand->m_pUserData;
-						TraverseChain(&pfnCallback, &pUserData);
-						IsColor = pfnCallback == &SColorConfigVariable::CommandCallback;
-					}
+	return true;
+}
 
-					if(int Error = ParseArgs(&Result, pCommand->m_pParams, IsColor))
-					{
-						char aBuf[CMDLINE_LENGTH + 64];
-						if(Error == PARSEARGS_INVALID_INTEGER)
-							str_format(aBuf, sizeof(aBuf), "%s is not a valid integer.", Result.GetString(Result.NumArguments() - 1));
-						else if(Error == PARSEARGS_INVALID_FLOAT)
-							str_format(aBuf, sizeof(aBuf), "%s is not a valid decimal number.", Result.GetString(Result.NumArguments() - 1));
-						else
-							str_format(aBuf, sizeof(aBuf), "Invalid arguments. Usage: %s %s", pCommand->m_pName, pCommand->m_pParams);
-						Print(OUTPUT_LEVEL_STANDARD, "chatresp", aBuf);
-					}
-					else if(m_StoreCommands && pCommand->m_Flags & CFGFLAG_STORE)
-					{
-						m_vExecutionQueue.emplace_back(pCommand, Result);
-					}
-					else
-					{
-						if(pCommand->m_Flags & CMDFLAG_TEST && !g_Config.m_SvTestingCommands)
-						{
-							Print(OUTPUT_LEVEL_STANDARD, "console", "Test commands aren't allowed, enable them with 'sv_test_cmds 1' in your initial config.");
-							return;
-						}
+bool CConsole::RunCommand(CCommand *pCommand, CResult *pResult, int ClientId)
+{
+	if(m_StoreCommands && pCommand->m_Flags & CFGFLAG_STORE)
+	{
+		m_vExecutionQueue.emplace_back(pCommand, *pResult);
+		return true;
+	}
 
-						if(m_pfnTeeHistorianCommandCallback && !(pCommand->m_Flags & CFGFLAG_NONTEEHISTORIC))
-						{
-							m_pfnTeeHistorianCommandCallback(ClientId, m_FlagMask, pCommand->m_pName, &Result, m_pTeeHistorianCommandUserdata);
-						}
+	if(pCommand->m_Flags & CMDFLAG_TEST && !g_Config.m_SvTestingCommands)
+	{
+		Print(OUTPUT_LEVEL_STANDARD, "console", "Test commands aren't allowed, enable them with 'sv_test_cmds 1' in your initial config.");
+		return false;
+	}
 
-						if(Result.GetVictim() == CResult::VICTIM_ME)
-							Result.SetVictim(ClientId);
+	if(m_pfnTeeHistorianCommandCallback && !(pCommand->m_Flags & CFGFLAG_NONTEEHISTORIC))
+	{
+		m_pfnTeeHistorianCommandCallback(ClientId, m_FlagMask, pCommand->m_pName, pResult, m_pTeeHistorianCommandUserdata);
+	}
 
-						if(Result.HasVictim() && Result.GetVictim() == CResult::VICTIM_ALL)
-						{
-							for(int i = 0; i < MAX_CLIENTS; i++)
-							{
-								Result.SetVictim(i);
-								pCommand->m_pfnCallback(&Result, pCommand->m_pUserData);
-							}
-						}
-						else
-						{
-							pCommand->m_pfnCallback(&Result, pCommand->m_pUserData);
-						}
+	if(pResult->GetVictim() == CResult::VICTIM_ME)
+		pResult->SetVictim(ClientId);
 
-						if(pCommand->m_Flags & CMDFLAG_TEST)
-							m_Cheated = true;
-					}
-				}
-			}
-			else if(Stroke)
-			{
-				char aBuf[CMDLINE_LENGTH + 32];
-				str_format(aBuf, sizeof(aBuf), "Access for command %s denied.", Result.m_pCommand);
-				Print(OUTPUT_LEVEL_STANDARD, "console", aBuf);
-			}
-		}
-		else if(Stroke)
+	if(pResult->HasVictim() && pResult->GetVictim() == CResult::VICTIM_ALL)
+	{
+		for(int i = 0; i < MAX_CLIENTS; i++)
 		{
-			// Pass the original string to the unknown command callback instead of the parsed command, as the latter
-			// ends at the first whitespace, which breaks for unknown commands (filenames) containing spaces.
-			if(!m_pfnUnknownCommandCallback(pStr, m_pUnknownCommandUserdata))
-			{
-				char aBuf[CMDLINE_LENGTH + 32];
-				if(m_FlagMask & CFGFLAG_CHAT)
-					str_format(aBuf, sizeof(aBuf), "No such command: %s. Use /cmdlist for a list of all commands.", Result.m_pCommand);
-				else
-					str_format(aBuf, sizeof(aBuf), "No such command: %s.", Result.m_pCommand);
-				Print(OUTPUT_LEVEL_STANDARD, "chatresp", aBuf);
-			}
+			pResult->SetVictim(i);
+			pCommand->m_pfnCallback(pResult, pCommand->m_pUserData);
 		}
-
-		pStr = pNextPart;
 	}
+	else
+	{
+		pCommand->m_pfnCallback(pResult, pCommand->m_pUserData);
+	}
+
+	if(pCommand->m_Flags & CMDFLAG_TEST)
+		m_Cheated = true;
+	return true;
 }
 
 int CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPossibleCallback pfnCallback, void *pUser)
@@ -601,9 +605,46 @@ int CConsole::PossibleCommands(const char *pStr, int FlagMask, bool Temp, FPossi
 	return Index;
 }
 
+static unsigned CommandNameHash(const char *pName)
+{
+	// FNV-1a of the lowercase name, equal for names that str_comp_nocase considers equal
+	unsigned Hash = 2166136261u;
+	for(; *pName; pName++)
+	{
+		Hash ^= (unsigned char)tolower((unsigned char)*pName);
+		Hash *= 16777619u;
+	}
+	return Hash;
+}
+
+void CConsole::IndexCommand(CCommand *pCommand)
+{
+	// same order as in the command list, the first match is returned
+	std::vector<CCommand *> &vpCommands = m_CommandIndex[CommandNameHash(pCommand->m_pName)];
+	auto It = std::find_if(vpCommands.begin(), vpCommands.end(), [pCommand](const CCommand *pOther) {
+		return str_comp(pCommand->m_pName, pOther->m_pName) <= 0;
+	});
+	vpCommands.insert(It, pCommand);
+}
+
+void CConsole::UnindexCommand(CCommand *pCommand)
+{
+	auto It = m_CommandIndex.find(CommandNameHash(pCommand->m_pName));
+	if(It == m_CommandIndex.end())
+		return;
+	std::vector<CCommand *> &vpCommands = It->second;
+	vpCommands.erase(std::remove(vpCommands.begin(), vpCommands.end(), pCommand), vpCommands.end());
+	if(vpCommands.empty())
+		m_CommandIndex.erase(It);
+}
+
 CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	auto It = m_CommandIndex.find(CommandNameHash(pName));
+	if(It == m_CommandIndex.end())
+		return nullptr;
+
+	for(CCommand *pCommand : It->second)
 	{
 		if(pCommand->m_Flags & FlagMask)
 		{
@@ -618,7 +659,9 @@ CConsole::CCommand *CConsole::FindCommand(const char *pName, int FlagMask)
 void CConsole::ExecuteLine(const char *pStr, int ClientId, bool InterpretSemicolons)
 {
 	CConsole::ExecuteLineStroked(1, pStr, ClientId, InterpretSemicolons); // press it
-	CConsole::ExecuteLineStroked(0, pStr, ClientId, InterpretSemicolons); // then release it
+	// only commands starting with '+' do anything on release
+	if(str_find(pStr, "+"))
+		CConsole::ExecuteLineStroked(0, pStr, ClientId, InterpretSemicolons); // then release it
 }
 
 void CConsole::ExecuteLineFlag(const char *pStr, int FlagMask, int ClientId, bool InterpretSemicolons)
@@ -650,18 +693,18 @@ bool CConsole::ExecuteFile(const char *pFilename, int ClientId, bool LogFailure,
 	ThisFile.m_pPrev = m_pFirstExec;
 	m_pFirstExec = &ThisFile;
 
-	// exec the file
-	CLineReader LineReader;
+	// exec the file, keeping a reference in case it's evicted from the
+	// cache by the files it executes
 	bool Success = false;
 	char aBuf[32 + IO_MAX_PATH_LENGTH];
-	if(LineReader.OpenFile(m_pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType)))
+	if(std::shared_ptr<CCompiledFile> pFile = CompileFile(pFilename, StorageType))
 	{
 		str_format(aBuf, sizeof(aBuf), "executing '%s'", pFilename);
 		Print(IConsole::OUTPUT_LEVEL_STANDARD, "console", aBuf);
 
-		while(const char *pLine = LineReader.Get())
+		for(CCompiledLine &Line : pFile->m_vLines)
 		{
-			ExecuteLine(pLine, ClientId);
+			ExecuteCompiledLine(&Line, ClientId);
 		}
 
 		Success = true;
@@ -676,6 +719,126 @@ bool CConsole::ExecuteFile(const char *pFilename, int ClientId, bool LogFailure,
 	return Success;
 }
 
+std::shared_ptr<CConsole::CCompiledFile> CConsole::CompileFile(const char *pFilename, int StorageType)
+{
+	IOHANDLE File = m_pStorage->OpenFile(pFilename, IOFLAG_READ, StorageType);
+	if(!File)
+		return nullptr;
+	char *pContent = io_read_all_str(File);
+	io_close(File);
+	if(!pContent)
+		return nullptr;
+
+	// reuse the compiled file if the content didn't change
+	const auto Key = std::make_pair(std::string(pFilename), StorageType);
+	auto It = m_CompiledFiles.find(Key);
+	if(It != m_CompiledFiles.end() && It->second->m_Content == pContent)
+	{
+		free(pContent);
+		It->second->m_LastUse = ++m_CompiledFileUse;
+		return It->second;
+	}
+
+	std::shared_ptr<CCompiledFile> pFile = std::make_shared<CCompiledFile>();
+	pFile->m_Content = pContent;
+	pFile->m_LastUse = ++m_CompiledFileUse;
+	CLineReader LineReader;
+	LineReader.OpenBuffer(pContent);
+	while(const char *pLine = LineReader.Get())
+	{
+		CCompiledLine Line;
+		CompileLine(pLine, &Line);
+		if(!Line.m_vCommands.empty())
+			pFile->m_vLines.push_back(std::move(Line));
+	}
+
+	if(It == m_CompiledFiles.end() && m_CompiledFiles.size() >= MAX_COMPILED_FILES)
+	{
+		auto Oldest = std::min_element(m_CompiledFiles.begin(), m_CompiledFiles.end(), [](const auto &a, const auto &b) {
+			return a.second->m_LastUse < b.second->m_LastUse;
+		});
+		m_CompiledFiles.erase(Oldest);
+	}
+	m_CompiledFiles[Key] = pFile;
+	return pFile;
+}
+
+void CConsole::CompileLine(const char *pStr, CCompiledLine *pLine)
+{
+	// lines of files are always executed with semicolons
+	const char *pWithoutPrefix = str_startswith(pStr, "mc;");
+	if(pWithoutPrefix)
+		pStr = pWithoutPrefix;
+
+	pLine->m_Line = pStr;
+	pLine->m_HasStrokeCommand = false;
+	const char *pLineStart = pLine->m_Line.c_str();
+	const char *pPart = pLineStart;
+	while(pPart && *pPart)
+	{
+		const char *pNextPart;
+		const char *pEnd = CommandEnd(pPart, true, &pNextPart);
+
+		// an empty command ends the line
+		const char *pCommand = str_skip_whitespaces_const(pPart);
+		if(pCommand >= pEnd)
+			break;
+		if(*pCommand == '+')
+			pLine->m_HasStrokeCommand = true;
+
+		CCompiledCommand &Command = pLine->m_vCommands.emplace_back();
+		Command.m_Offset = pPart - pLineStart;
+		Command.m_Length = pEnd - pPart;
+		pPart = pNextPart;
+	}
+}
+
+void CConsole::StoreParsedCommand(CCompiledCommand *pCompiled, CCommand *pCommand, const CResult &Result, int Length)
+{
+	const char *pStorage = Result.m_aStringStorage;
+	pCompiled->m_pCommand = pCommand;
+	pCompiled->m_Generation = m_CommandGeneration;
+	pCompiled->m_FlagMask = m_FlagMask;
+	pCompiled->m_ClientId = Result.m_ClientId;
+	pCompiled->m_Victim = Result.GetVictim();
+	pCompiled->m_vStorage.assign(pStorage, pStorage + minimum<int>(Length + 1, sizeof(Result.m_aStringStorage)));
+	pCompiled->m_CommandOffset = Result.m_pCommand - pStorage;
+	pCompiled->m_ArgsStartOffset = Result.m_pArgsStart - pStorage;
+	pCompiled->m_vArgOffsets.clear();
+	for(int i = 0; i < Result.NumArguments(); i++)
+		pCompiled->m_vArgOffsets.push_back(Result.m_apArgs[i] - pStorage);
+}
+
+void CConsole::ExecuteCompiledLine(CCompiledLine *pLine, int ClientId)
+{
+	for(CCompiledCommand &Command : pLine->m_vCommands)
+	{
+		// parse the command again if something changed since the last run
+		CCommand *pCommand = Command.m_pCommand;
+		if(!pCommand || Command.m_Generation != m_CommandGeneration || Command.m_FlagMask != m_FlagMask ||
+			Command.m_ClientId != ClientId || pCommand->GetAccessLevel() < m_AccessLevel)
+		{
+			Command.m_pCommand = nullptr;
+			if(!ExecuteCommand(1, pLine->m_Line.c_str() + Command.m_Offset, Command.m_Length, ClientId, &Command))
+				break;
+			continue;
+		}
+
+		CResult Result(ClientId);
+		mem_copy(Result.m_aStringStorage, Command.m_vStorage.data(), Command.m_vStorage.size());
+		Result.m_pCommand = Result.m_aStringStorage + Command.m_CommandOffset;
+		Result.m_pArgsStart = Result.m_aStringStorage + Command.m_ArgsStartOffset;
+		for(int Offset : Command.m_vArgOffsets)
+			Result.AddArgument(Result.m_aStringStorage + Offset);
+		Result.SetVictim(Command.m_Victim);
+		if(!RunCommand(pCommand, &Result, ClientId))
+			break;
+	}
+
+	if(pLine->m_HasStrokeCommand)
+		ExecuteLineStroked(0, pLine->m_Line.c_str(), ClientId); // release it
+}
+
 void CConsole::Con_Echo(IResult *pResult, void *pUserData)
 {
 	((CConsole *)pUserData)->Print(IConsole::OUTPUT_LEVEL_STANDARD, "console", pResult->GetString(0));
@@ -784,6 +947,8 @@ CConsole::CConsole(int FlagMask)
 	m_apStrokeStr[0] = "0";
 	m_apStrokeStr[1] = "1";
 	m_pFirstCommand = nullptr;
+	m_CommandGeneration = 0;
+	m_CompiledFileUse = 0;
 	m_pFirstExec = nullptr;
 	m_pfnTeeHistorianCommandCallback = nullptr;
 	m_pTeeHistorianCommandUserdata = nullptr;
@@ -879,6 +1044,7 @@ void CConsole::AddCommandSorted(CCommand *pCommand)
 			}
 		}
 	}
+	IndexCommand(pCommand);
 }
 
 void CConsole::Register(const char *pName, const char *pParams,
@@ -900,6 +1066,7 @@ void CConsole::Register(const char *pName, const char *pParams,
 
 	pCommand->m_Flags = Flags;
 	pCommand->m_Temp = false;
+	m_CommandGeneration++;
 
 	if(DoAdd)
 		AddCommandSorted(pCommand);
@@ -938,6 +1105,7 @@ void CConsole::RegisterTemp(const char *pName, const char *pParams, int Flags, c
 	pCommand->m_pUserData = nullptr;
 	pCommand->m_Flags = Flags;
 	pCommand->m_Temp = true;
+	m_CommandGeneration++;
 
 	AddCommandSorted(pCommand);
 }
@@ -969,6 +1137,8 @@ void CConsole::DeregisterTemp(const char *pName)
 	// add to recycle list
 	if(pRemoved)
 	{
+		UnindexCommand(pRemoved);
+		m_CommandGeneration++;
 		pRemoved->m_pNext = m_pRecycleList;
 		m_pRecycleList = pRemoved;
 	}
@@ -976,6 +1146,13 @@ void CConsole::DeregisterTemp(const char *pName)
 
 void CConsole::DeregisterTempAll()
 {
+	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	{
+		if(pCommand->m_Temp)
+			UnindexCommand(pCommand);
+	}
+	m_CommandGeneration++;
+
 	// set non temp as first one
 	for(; m_pFirstCommand && m_pFirstCommand->m_Temp; m_pFirstCommand = m_pFirstCommand->m_pNext)
 		;
@@ -1025,6 +1202,7 @@ void CConsole::Chain(const char *pName, FChainCommandCallback pfnChainFunc, void
 	// chain
 	pCommand->m_pfnCallback = Con_Chain;
 	pCommand->m_pUserData = pChainInfo;
+	m_CommandGeneration++;
 }
 
 void CConsole::StoreCommands(bool Store)
@@ -1042,7 +1220,11 @@ void CConsole::StoreCommands(bool Store)
 
 const IConsole::CCommandInfo *CConsole::GetCommandInfo(const char *pName, int FlagMask, bool Temp)
 {
-	for(CCommand *pCommand = m_pFirstCommand; pCommand; pCommand = pCommand->m_pNext)
+	auto It = m_CommandIndex.find(CommandNameHash(pName));
+	if(It == m_CommandIndex.end())
+		return nullptr;
+
+	for(CCommand *pCommand : It->second)
 	{
 		if(pCommand->m_Flags & FlagMask && pCommand->m_Temp == Temp)
 		{
@@ -9,6 +9,12 @@
 #include <engine/console.h>
 #include <engine/storage.h>
 
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 class CConsole : public IConsole
 {
 	class CCommand : public CCommandInfo
@@ -38,6 +44,11 @@ class CConsole : public IConsole
 	bool m_StoreCommands;
 	const char *m_apStrokeStr[2];
 	CCommand *m_pFirstCommand;
+	// case insensitive hash of the name -> commands, in list order
+	std::unordered_map<unsigned, std::vector<CCommand *>> m_CommandIndex;
+	// changes whenever a command is added, removed or chained, so that
+	// compiled commands know that their lookup is outdated
+	int m_CommandGeneration;
 
 	class CExecFile
 	{
@@ -87,10 +98,11 @@ class CConsole : public IConsole
 		CResult(int ClientId) :
 			IResult(ClientId)
 		{
-			mem_zero(m_aStringStorage, sizeof(m_aStringStorage));
+			// the arguments are only read up to m_NumArgs, so don't clear
+			// the whole storage for every executed command
+			m_aStringStorage[0] = '\0';
 			m_pArgsStart = nullptr;
 			m_pCommand = nullptr;
-			mem_zero(m_apArgs, sizeof(m_apArgs));
 		}
 
 		CResult(const CResult &Other) :
@@ -170,7 +182,59 @@ class CConsole : public IConsole
 	};
 	std::vector<CExecutionQueueEntry> m_vExecutionQueue;
 
+	// a command of a config file line, keeping the result of its last
+	// successful parse as long as it can be reused
+	class CCompiledCommand
+	{
+	public:
+		int m_Offset;
+		int m_Length;
+
+		CCommand *m_pCommand = nullptr;
+		int m_Generation;
+		int m_FlagMask;
+		int m_ClientId;
+		int m_Victim;
+		std::vector<char> m_vStorage;
+		int m_CommandOffset;
+		int m_ArgsStartOffset;
+		std::vector<int> m_vArgOffsets;
+	};
+
+	class CCompiledLine
+	{
+	public:
+		std::string m_Line;
+		std::vector<CCompiledCommand> m_vCommands;
+		bool m_HasStrokeCommand;
+	};
+
+	class CCompiledFile
+	{
+	public:
+		std::string m_Content;
+		std::vector<CCompiledLine> m_vLines;
+		int64_t m_LastUse;
+	};
+
+	enum
+	{
+		MAX_COMPILED_FILES = 32,
+	};
+	// filename, storage type -> compiled file
+	std::map<std::pair<std::string, int>, std::shared_ptr<CCompiledFile>> m_CompiledFiles;
+	int64_t m_CompiledFileUse;
+
+	std::shared_ptr<CCompiledFile> CompileFile(const char *pFilename, int StorageType);
+	void CompileLine(const char *pStr, CCompiledLine *pLine);
+	void ExecuteCompiledLine(CCompiledLine *pLine, int ClientId);
+	void StoreParsedCommand(CCompiledCommand *pCompiled, CCommand *pCommand, const CResult &Result, int Length);
+	bool ExecuteCommand(int Stroke, const char *pStr, int Length, int ClientId, CCompiledCommand *pCompiled);
+	bool RunCommand(CCommand *pCommand, CResult *pResult, int ClientId);
+
 	void AddCommandSorted(CCommand *pCommand);
+	void IndexCommand(CCommand *pCommand);
+	void UnindexCommand(CCommand *pCommand);
 	CCommand *FindCommand(const char *pName, int FlagMask);
 
 	bool m_Cheated;
@@ -7,12 +7,18 @@
 #include <base/log.h>
 #include <base/math.h>
 #include <base/system.h>
+#include <engine/engine.h>
 #include <engine/storage.h>
 
+#include "jobs.h"
+#include "map_cache.h"
 #include "uuid_manager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <limits>
+#include <thread>
 
 #include <zlib.h>
 
@@ -87,6 +93,38 @@ struct CDatafileInfo
 	char *m_pDataStart;
 };
 
+enum
+{
+	// where the memory of a loaded data item comes from
+	DATA_STORAGE_HEAP = 0,
+	DATA_STORAGE_MAPPED,
+
+	CACHE_ALIGNMENT = 16,
+};
+
+// a snapshot of the loaded data of a datafile, so that other processes
+// can map it instead of decompressing the data again
+struct CDatafileCacheHeader
+{
+	char m_aId[4];
+	int m_Version;
+	SHA256_DIGEST m_Sha256;
+	int m_NumRawData;
+};
+
+struct CDatafileCacheData
+{
+	int m_Offset;
+	int m_Size; // -1 if the data is not part of the cache
+};
+
+enum
+{
+	DATAFILE_CACHE_VERSION = 1,
+};
+
+static const char DATAFILE_CACHE_ID[4] = {'D', 'F', 'D', 'C'};
+
 struct CDatafile
 {
 	IOHANDLE m_File;
@@ -97,10 +135,164 @@ struct CDatafile
 	int m_DataStartOffset;
 	char **m_ppDataPtrs;
 	int *m_pDataSizes;
+	unsigned char *m_pDataStorage;
 	char *m_pData;
+
+	// only set while the file is memory-mapped
+	const unsigned char *m_pMapping;
+	unsigned m_MappingSize;
+
+	// only set if the loaded data comes from a cache file
+	const unsigned char *m_pCache;
+	unsigned m_CacheSize;
+};
+
+// returns how many of the wanted bytes of the data are inside the mapping
+static unsigned MappedData(const CDatafile *pDataFile, int Index, unsigned DataSize, const unsigned char **ppData)
+{
+	const int64_t Offset = (int64_t)pDataFile->m_DataStartOffset + pDataFile->m_Info.m_pDataOffsets[Index];
+	if(Offset < 0 || Offset > pDataFile->m_MappingSize)
+	{
+		*ppData = nullptr;
+		return 0;
+	}
+	*ppData = pDataFile->m_pMapping + Offset;
+	return minimum<int64_t>(DataSize, pDataFile->m_MappingSize - Offset);
+}
+
+static void FreeData(CDatafile *pDataFile, int Index)
+{
+	// mapped memory is released with the mapping
+	if(pDataFile->m_pDataStorage[Index] == DATA_STORAGE_HEAP)
+		free(pDataFile->m_ppDataPtrs[Index]);
+	pDataFile->m_pDataStorage[Index] = DATA_STORAGE_HEAP;
+	pDataFile->m_ppDataPtrs[Index] = nullptr;
+}
+
+// a compressed data item, split into steps so that the decompression
+// itself can run on another thread
+struct CDatafileDecompression
+{
+	int m_Index;
+	const unsigned char *m_pCompressedData;
+	void *m_pCompressedBuffer;
+	unsigned m_CompressedSize;
+	unsigned long m_UncompressedSize;
+	int m_Result;
+};
+
+// reads the compressed data and allocates the memory for the uncompressed data
+static bool BeginDecompression(CDatafile *pDataFile, int Index, unsigned DataSize, CDatafileDecompression *pDecompression)
+{
+	const unsigned OriginalUncompressedSize = pDataFile->m_Info.m_pDataSizes[Index];
+
+	log_trace("datafile", "loading data. index=%d size=%u uncompressed=%u", Index, DataSize, OriginalUncompressedSize);
+
+	pDecompression->m_Index = Index;
+	pDecompression->m_CompressedSize = DataSize;
+	pDecompression->m_UncompressedSize = OriginalUncompressedSize;
+	pDecompression->m_Result = Z_OK;
+
+	// read the compressed data, a mapped file can be decompressed in place
+	pDecompression->m_pCompressedBuffer = nullptr;
+	unsigned ActualDataSize = 0;
+	if(pDataFile->m_pMapping)
+	{
+		ActualDataSize = MappedData(pDataFile, Index, DataSize, &pDecompression->m_pCompressedData);
+	}
+	else
+	{
+		pDecompression->m_pCompressedBuffer = malloc(DataSize);
+		pDecompression->m_pCompressedData = (const unsigned char *)pDecompression->m_pCompressedBuffer;
+		if(io_seek(pDataFile->m_File, pDataFile->m_DataStartOffset + pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
+			ActualDataSize = io_read(pDataFile->m_File, pDecompression->m_pCompressedBuffer, DataSize);
+	}
+	if(DataSize != ActualDataSize)
+	{
+		log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u got=%u", Index, DataSize, ActualDataSize);
+		free(pDecompression->m_pCompressedBuffer);
+		pDataFile->m_ppDataPtrs[Index] = nullptr;
+		pDataFile->m_pDataSizes[Index] = -1;
+		return false;
+	}
+
+	pDataFile->m_ppDataPtrs[Index] = (char *)malloc(OriginalUncompressedSize);
+	pDataFile->m_pDataSizes[Index] = OriginalUncompressedSize;
+	return true;
+}
+
+// only touches the memory of this data item, safe to call from any thread
+static void Decompress(const CDatafile *pDataFile, CDatafileDecompression *pDecompression)
+{
+	pDecompression->m_Result = uncompress((Bytef *)pDataFile->m_ppDataPtrs[pDecompression->m_Index], &pDecompression->m_UncompressedSize, (const Bytef *)pDecompression->m_pCompressedData, pDecompression->m_CompressedSize);
+}
+
+static bool FinishDecompression(CDatafile *pDataFile, CDatafileDecompression *pDecompression)
+{
+	const int Index = pDecompression->m_Index;
+	const unsigned OriginalUncompressedSize = pDataFile->m_Info.m_pDataSizes[Index];
+	free(pDecompression->m_pCompressedBuffer);
+	pDecompression->m_pCompressedBuffer = nullptr;
+	if(pDecompression->m_Result != Z_OK || pDecompression->m_UncompressedSize != OriginalUncompressedSize)
+	{
+		log_error("datafile", "uncompress error. result=%d wanted=%u got=%lu", pDecompression->m_Result, OriginalUncompressedSize, pDecompression->m_UncompressedSize);
+		FreeData(pDataFile, Index);
+		pDataFile->m_pDataSizes[Index] = -1;
+		return false;
+	}
+	return true;
+}
+
+// shared by all threads decompressing the data items of one preload
+class CDatafileDecompressionBatch
+{
+public:
+	const CDatafile *m_pDataFile;
+	CDatafileDecompression *m_pDecompressions;
+	int m_NumDecompressions;
+	std::atomic<int> m_NextDecompression{0};
+	std::atomic<int> m_NumDecompressed{0};
+
+	CDatafileDecompressionBatch(const CDatafile *pDataFile, CDatafileDecompression *pDecompressions, int NumDecompressions) :
+		m_pDataFile(pDataFile),
+		m_pDecompressions(pDecompressions),
+		m_NumDecompressions(NumDecompressions)
+	{
+	}
+
+	// returns false once all data items have been claimed
+	bool DecompressNext()
+	{
+		const int Index = m_NextDecompression.fetch_add(1);
+		if(Index >= m_NumDecompressions)
+			return false;
+		Decompress(m_pDataFile, &m_pDecompressions[Index]);
+		m_NumDecompressed.fetch_add(1);
+		return true;
+	}
+
+	bool Done() const { return m_NumDecompressed.load() >= m_NumDecompressions; }
+};
+
+class CDatafileDecompressionJob : public IJob
+{
+	std::shared_ptr<CDatafileDecompressionBatch> m_pBatch;
+
+	void Run() override
+	{
+		while(m_pBatch->DecompressNext())
+		{
+		}
+	}
+
+public:
+	CDatafileDecompressionJob(std::shared_ptr<CDatafileDecompressionBatch> pBatch) :
+		m_pBatch(std::move(pBatch))
+	{
+	}
 };
 
-bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType)
+bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool MapFile)
 {
 	dbg_assert(m_pDataFile == nullptr, "File already open");
 
@@ -113,9 +305,23 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		return false;
 	}
 
+	void *pMapping = nullptr;
+	unsigned MappingSize = 0;
+#if !defined(CONF_ARCH_ENDIAN_BIG)
+	// big endian needs to swap the data in place, so it can't use the mapping
+	if(MapFile && !io_map(File, &pMapping, &MappingSize))
+		log_debug("datafile", "could not map file, reading it instead. filename='%s'", pFilename);
+#endif
+
 	// take the CRC of the file and store it
 	unsigned Crc = 0;
 	SHA256_DIGEST Sha256;
+	if(pMapping)
+	{
+		Crc = crc32(Crc, (const Bytef *)pMapping, MappingSize);
+		Sha256 = sha256(pMapping, MappingSize);
+	}
+	else
 	{
 		enum
 		{
@@ -141,7 +347,14 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 
 	// TODO: change this header
 	CDatafileHeader Header;
-	if(sizeof(Header) != io_read(File, &Header, sizeof(Header)))
+	if(pMapping)
+	{
+		if(MappingSize < sizeof(Header))
+			mem_zero(&Header, sizeof(Header));
+		else
+			mem_copy(&Header, pMapping, sizeof(Header));
+	}
+	else if(sizeof(Header) != io_read(File, &Header, sizeof(Header)))
 	{
 		dbg_msg("datafile", "couldn't load header");
 		return false;
@@ -151,6 +364,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 		if(Header.m_aId[0] != 'D' || Header.m_aId[1] != 'A' || Header.m_aId[2] != 'T' || Header.m_aId[3] != 'A')
 		{
 			dbg_msg("datafile", "wrong signature. %x %x %x %x", Header.m_aId[0], Header.m_aId[1], Header.m_aId[2], Header.m_aId[3]);
+			if(pMapping)
+				io_unmap(pMapping, MappingSize);
 			return false;
 		}
 	}
@@ -161,6 +376,8 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	if(Header.m_Version != 3 && Header.m_Version != 4)
 	{
 		dbg_msg("datafile", "wrong version. version=%x", Header.m_Version);
+		if(pMapping)
+			io_unmap(pMapping, MappingSize);
 		return false;
 	}
 
@@ -176,8 +393,11 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	AllocSize += sizeof(CDatafile); // add space for info structure
 	AllocSize += Header.m_NumRawData * sizeof(void *); // add space for data pointers
 	AllocSize += Header.m_NumRawData * sizeof(int); // add space for data sizes
+	AllocSize += Header.m_NumRawData * sizeof(unsigned char); // add space for data storage types
 	if(Size > (((int64_t)1) << 31) || Header.m_NumItemTypes < 0 || Header.m_NumItems < 0 || Header.m_NumRawData < 0 || Header.m_ItemSize < 0)
 	{
+		if(pMapping)
+			io_unmap(pMapping, MappingSize);
 		io_close(File);
 		dbg_msg("datafile", "unable to load file, invalid file information");
 		return false;
@@ -188,19 +408,36 @@ bool CDataFileReader::Open(class IStorage *pStorage, const char *pFilename, int
 	pTmpDataFile->m_DataStartOffset = sizeof(CDatafileHeader) + Size;
 	pTmpDataFile->m_ppDataPtrs = (char **)(pTmpDataFile + 1);
 	pTmpDataFile->m_pDataSizes = (int *)(pTmpDataFile->m_ppDataPtrs + Header.m_NumRawData);
-	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	pTmpDataFile->m_pDataStorage = (unsigned char *)(pTmpDataFile->m_pDataSizes + Header.m_NumRawData);
+	pTmpDataFile->m_pData = (char *)(pTmpDataFile->m_pDataStorage + Header.m_NumRawData);
 	pTmpDataFile->m_File = File;
 	pTmpDataFile->m_Sha256 = Sha256;
 	pTmpDataFile->m_Crc = Crc;
+	pTmpDataFile->m_pMapping = (const unsigned char *)pMapping;
+	pTmpDataFile->m_MappingSize = MappingSize;
+	pTmpDataFile->m_pCache = nullptr;
+	pTmpDataFile->m_CacheSize = 0;
 
 	// clear the data pointers and sizes
 	mem_zero(pTmpDataFile->m_ppDataPtrs, Header.m_NumRawData * sizeof(void *));
 	mem_zero(pTmpDataFile->m_pDataSizes, Header.m_NumRawData * sizeof(int));
+	mem_zero(pTmpDataFile->m_pDataStorage, Header.m_NumRawData * sizeof(unsigned char));
 
 	// read types, offsets, sizes and item data
-	unsigned ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	unsigned ReadSize = 0;
+	if(pMapping)
+	{
+		ReadSize = minimum(Size, MappingSize - (unsigned)sizeof(Header));
+		mem_copy(pTmpDataFile->m_pData, (const char *)pMapping + sizeof(Header), ReadSize);
+	}
+	else
+	{
+		ReadSize = io_read(File, pTmpDataFile->m_pData, Size);
+	}
 	if(ReadSize != Size)
 	{
+		if(pMapping)
+			io_unmap(pMapping, MappingSize);
 		io_close(pTmpDataFile->m_File);
 		free(pTmpDataFile);
 		dbg_msg("datafile", "couldn't load the whole thing, wanted=%d got=%d", Size, ReadSize);
@@ -245,11 +482,15 @@ bool CDataFileReader::Close()
 	// free the data that is loaded
 	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
 	{
-		free(m_pDataFile->m_ppDataPtrs[i]);
-		m_pDataFile->m_ppDataPtrs[i] = nullptr;
+		FreeData(m_pDataFile, i);
 		m_pDataFile->m_pDataSizes[i] = 0;
 	}
 
+	if(m_pDataFile->m_pMapping)
+		io_unmap((void *)m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize);
+	if(m_pDataFile->m_pCache)
+		io_unmap((void *)m_pDataFile->m_pCache, m_pDataFile->m_CacheSize);
+
 	io_close(m_pDataFile->m_File);
 	free(m_pDataFile);
 	m_pDataFile = nullptr;
@@ -331,42 +572,40 @@ void *CDataFileReader::GetDataImpl(int Index, bool Swap)
 		if(m_pDataFile->m_Header.m_Version == 4)
 		{
 			// v4 has compressed data
-			const unsigned OriginalUncompressedSize = m_pDataFile->m_Info.m_pDataSizes[Index];
-			unsigned long UncompressedSize = OriginalUncompressedSize;
-
-			log_trace("datafile", "loading data. index=%d size=%u uncompressed=%u", Index, DataSize, OriginalUncompressedSize);
+			CDatafileDecompression Decompression;
+			if(!BeginDecompression(m_pDataFile, Index, DataSize, &Decompression))
+				return nullptr;
+			Decompress(m_pDataFile, &Decompression);
+			if(!FinishDecompression(m_pDataFile, &Decompression))
+				return nullptr;
 
-			// read the compressed data
-			void *pCompressedData = malloc(DataSize);
-			unsigned ActualDataSize = 0;
-			if(io_seek(m_pDataFile->m_File, m_pDataFile->m_DataStartOffset + m_pDataFile->m_Info.m_pDataOffsets[Index], IOSEEK_START) == 0)
-				ActualDataSize = io_read(m_pDataFile->m_File, pCompressedData, DataSize);
+#if defined(CONF_ARCH_ENDIAN_BIG)
+			SwapSize = Decompression.m_UncompressedSize;
+#endif
+		}
+		else if(m_pDataFile->m_pMapping)
+		{
+			// use the data straight from the mapping if it is aligned for the item types
+			log_trace("datafile", "loading data. index=%d size=%d", Index, DataSize);
+			const unsigned char *pFileData;
+			const unsigned ActualDataSize = MappedData(m_pDataFile, Index, DataSize, &pFileData);
 			if(DataSize != ActualDataSize)
 			{
 				log_error("datafile", "truncation error, could not read all data. index=%d wanted=%u got=%u", Index, DataSize, ActualDataSize);
-				free(pCompressedData);
-				m_pDataFile->m_ppDataPtrs[Index] = nullptr;
 				m_pDataFile->m_pDataSizes[Index] = -1;
 				return nullptr;
 			}
-
-			// decompress the data
-			m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(UncompressedSize);
-			m_pDataFile->m_pDataSizes[Index] = UncompressedSize;
-			const int Result = uncompress((Bytef *)m_pDataFile->m_ppDataPtrs[Index], &UncompressedSize, (Bytef *)pCompressedData, DataSize);
-			free(pCompressedData);
-			if(Result != Z_OK || UncompressedSize != OriginalUncompressedSize)
+			if((uintptr_t)pFileData % sizeof(int) == 0)
 			{
-				log_error("datafile", "uncompress error. result=%d wanted=%u got=%lu", Result, OriginalUncompressedSize, UncompressedSize);
-				free(m_pDataFile->m_ppDataPtrs[Index]);
-				m_pDataFile->m_ppDataPtrs[Index] = nullptr;
-				m_pDataFile->m_pDataSizes[Index] = -1;
-				return nullptr;
+				m_pDataFile->m_ppDataPtrs[Index] = (char *)pFileData;
+				m_pDataFile->m_pDataStorage[Index] = DATA_STORAGE_MAPPED;
 			}
-
-#if defined(CONF_ARCH_ENDIAN_BIG)
-			SwapSize = UncompressedSize;
-#endif
+			else
+			{
+				m_pDataFile->m_ppDataPtrs[Index] = (char *)malloc(DataSize);
+				mem_copy(m_pDataFile->m_ppDataPtrs[Index], pFileData, DataSize);
+			}
+			m_pDataFile->m_pDataSizes[Index] = DataSize;
 		}
 		else
 		{
@@ -396,6 +635,64 @@ void *CDataFileReader::GetDataImpl(int Index, bool Swap)
 	return m_pDataFile->m_ppDataPtrs[Index];
 }
 
+void CDataFileReader::PreloadData(IEngine *pEngine, const std::vector<int> &vIndices)
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+#if defined(CONF_ARCH_ENDIAN_BIG)
+	// whether data has to be swapped is only known once it is requested
+	return;
+#endif
+
+	// only compressed data is worth loading ahead of time
+	if(m_pDataFile->m_Header.m_Version != 4)
+		return;
+
+	// reading the file and allocating happens here, only the decompression runs in parallel
+	std::vector<CDatafileDecompression> vDecompressions;
+	vDecompressions.reserve(vIndices.size());
+	for(int Index : vIndices)
+	{
+		if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
+			continue;
+		if(m_pDataFile->m_ppDataPtrs[Index] || m_pDataFile->m_pDataSizes[Index] < 0)
+			continue;
+		CDatafileDecompression Decompression;
+		if(BeginDecompression(m_pDataFile, Index, GetFileDataSize(Index), &Decompression))
+			vDecompressions.push_back(Decompression);
+	}
+	if(vDecompressions.empty())
+		return;
+
+	// the calling thread helps too, so it never has to wait for a job that
+	// is still queued behind unrelated work
+	auto pBatch = std::make_shared<CDatafileDecompressionBatch>(m_pDataFile, vDecompressions.data(), vDecompressions.size());
+	if(pEngine)
+	{
+		const int NumJobs = minimum<int>(vDecompressions.size() - 1, std::thread::hardware_concurrency());
+		for(int i = 0; i < NumJobs; i++)
+			pEngine->AddJob(std::make_shared<CDatafileDecompressionJob>(pBatch));
+	}
+	while(pBatch->DecompressNext())
+	{
+	}
+	while(!pBatch->Done())
+		thread_yield();
+
+	for(auto &Decompression : vDecompressions)
+		FinishDecompression(m_pDataFile, &Decompression);
+}
+
+void CDataFileReader::PreloadAllData(IEngine *pEngine)
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+	std::vector<int> vIndices(m_pDataFile->m_Header.m_NumRawData);
+	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
+		vIndices[i] = i;
+	PreloadData(pEngine, vIndices);
+}
+
 void *CDataFileReader::GetData(int Index)
 {
 	return GetDataImpl(Index, false);
@@ -426,7 +723,7 @@ void CDataFileReader::ReplaceData(int Index, char *pData, size_t Size)
 	dbg_assert(m_pDataFile != nullptr, "File not open");
 	dbg_assert(Index >= 0 && Index < m_pDataFile->m_Header.m_NumRawData, "Index invalid");
 
-	free(m_pDataFile->m_ppDataPtrs[Index]);
+	FreeData(m_pDataFile, Index);
 	m_pDataFile->m_ppDataPtrs[Index] = pData;
 	m_pDataFile->m_pDataSizes[Index] = Size;
 }
@@ -438,11 +735,137 @@ void CDataFileReader::UnloadData(int Index)
 	if(Index < 0 || Index >= m_pDataFile->m_Header.m_NumRawData)
 		return;
 
-	free(m_pDataFile->m_ppDataPtrs[Index]);
-	m_pDataFile->m_ppDataPtrs[Index] = nullptr;
+	FreeData(m_pDataFile, Index);
 	m_pDataFile->m_pDataSizes[Index] = 0;
 }
 
+void CDataFileReader::ReleaseMapping()
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+	if(!m_pDataFile->m_pMapping)
+		return;
+
+	// data used in place moves to the heap, data that isn't loaded yet is
+	// read from the file from now on
+	const unsigned char *pMappingEnd = m_pDataFile->m_pMapping + m_pDataFile->m_MappingSize;
+	for(int i = 0; i < m_pDataFile->m_Header.m_NumRawData; i++)
+	{
+		const unsigned char *pData = (const unsigned char *)m_pDataFile->m_ppDataPtrs[i];
+		if(m_pDataFile->m_pDataStorage[i] != DATA_STORAGE_MAPPED || pData < m_pDataFile->m_pMapping || pData >= pMappingEnd)
+			continue;
+		char *pCopy = (char *)malloc(m_pDataFile->m_pDataSizes[i]);
+		mem_copy(pCopy, pData, m_pDataFile->m_pDataSizes[i]);
+		m_pDataFile->m_ppDataPtrs[i] = pCopy;
+		m_pDataFile->m_pDataStorage[i] = DATA_STORAGE_HEAP;
+	}
+	io_unmap((void *)m_pDataFile->m_pMapping, m_pDataFile->m_MappingSize);
+	m_pDataFile->m_pMapping = nullptr;
+	m_pDataFile->m_MappingSize = 0;
+}
+
+bool CDataFileReader::LoadCachedData(const char *pCacheFilename)
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+	if(m_pDataFile->m_pCache)
+		return false;
+
+	void *pCache;
+	unsigned CacheSize;
+	if(!CMapCacheFile::Map(pCacheFilename, &pCache, &CacheSize))
+		return false;
+
+	const int NumRawData = m_pDataFile->m_Header.m_NumRawData;
+	const CDatafileCacheHeader *pHeader = static_cast<const CDatafileCacheHeader *>(pCache);
+	const CDatafileCacheData *pTable = reinterpret_cast<const CDatafileCacheData *>(pHeader + 1);
+	const size_t TableEnd = sizeof(CDatafileCacheHeader) + NumRawData * sizeof(CDatafileCacheData);
+	bool Valid = CacheSize >= TableEnd &&
+		     mem_comp(pHeader->m_aId, DATAFILE_CACHE_ID, sizeof(DATAFILE_CACHE_ID)) == 0 &&
+		     pHeader->m_Version == DATAFILE_CACHE_VERSION &&
+		     pHeader->m_Sha256 == m_pDataFile->m_Sha256 &&
+		     pHeader->m_NumRawData == NumRawData;
+	for(int i = 0; Valid && i < NumRawData; i++)
+	{
+		if(pTable[i].m_Size < 0)
+			continue;
+		if(pTable[i].m_Offset < (int64_t)TableEnd || (int64_t)pTable[i].m_Offset + pTable[i].m_Size > CacheSize)
+			Valid = false;
+	}
+	if(!Valid)
+	{
+		log_error("datafile", "invalid data cache. filename='%s'", pCacheFilename);
+		io_unmap(pCache, CacheSize);
+		return false;
+	}
+
+	m_pDataFile->m_pCache = static_cast<const unsigned char *>(pCache);
+	m_pDataFile->m_CacheSize = CacheSize;
+	for(int i = 0; i < NumRawData; i++)
+	{
+		if(pTable[i].m_Size < 0)
+			continue;
+		FreeData(m_pDataFile, i);
+		m_pDataFile->m_ppDataPtrs[i] = (char *)m_pDataFile->m_pCache + pTable[i].m_Offset;
+		m_pDataFile->m_pDataSizes[i] = pTable[i].m_Size;
+		m_pDataFile->m_pDataStorage[i] = DATA_STORAGE_MAPPED;
+	}
+	log_trace("datafile", "loaded data from cache. filename='%s' size=%u", pCacheFilename, CacheSize);
+	return true;
+}
+
+bool CDataFileReader::SaveLoadedData(const char *pCacheFilename)
+{
+	dbg_assert(m_pDataFile != nullptr, "File not open");
+
+	if(m_pDataFile->m_pCache)
+		return false;
+
+	const int NumRawData = m_pDataFile->m_Header.m_NumRawData;
+	CDatafileCacheHeader Header;
+	mem_copy(Header.m_aId, DATAFILE_CACHE_ID, sizeof(Header.m_aId));
+	Header.m_Version = DATAFILE_CACHE_VERSION;
+	Header.m_Sha256 = m_pDataFile->m_Sha256;
+	Header.m_NumRawData = NumRawData;
+
+	std::vector<CDatafileCacheData> vTable(NumRawData);
+	int64_t Offset = sizeof(CDatafileCacheHeader) + NumRawData * sizeof(CDatafileCacheData);
+	for(int i = 0; i < NumRawData; i++)
+	{
+		Offset = (Offset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+		if(!m_pDataFile->m_ppDataPtrs[i] || m_pDataFile->m_pDataSizes[i] < 0 || Offset + m_pDataFile->m_pDataSizes[i] > std::numeric_limits<int>::max())
+		{
+			vTable[i].m_Offset = 0;
+			vTable[i].m_Size = -1;
+			continue;
+		}
+		vTable[i].m_Offset = Offset;
+		vTable[i].m_Size = m_pDataFile->m_pDataSizes[i];
+		Offset += vTable[i].m_Size;
+	}
+
+	CMapCacheFile CacheFile;
+	if(!CacheFile.Begin(pCacheFilename))
+		return false;
+	static const char s_aPadding[CACHE_ALIGNMENT] = {0};
+	unsigned Written = sizeof(Header) + NumRawData * sizeof(CDatafileCacheData);
+	CacheFile.Write(&Header, sizeof(Header));
+	CacheFile.Write(vTable.data(), NumRawData * sizeof(CDatafileCacheData));
+	for(int i = 0; i < NumRawData; i++)
+	{
+		if(vTable[i].m_Size < 0)
+			continue;
+		CacheFile.Write(s_aPadding, vTable[i].m_Offset - Written);
+		CacheFile.Write(m_pDataFile->m_ppDataPtrs[i], vTable[i].m_Size);
+		Written = vTable[i].m_Offset + vTable[i].m_Size;
+	}
+	if(!CacheFile.Finish())
+		return false;
+
+	// use the shared copy from now on
+	return LoadCachedData(pCacheFilename);
+}
+
 int CDataFileReader::GetItemSize(int Index) const
 {
 	dbg_assert(m_pDataFile != nullptr, "File not open");
@@ -767,27 +1190,113 @@ static int CompressionLevelToZlib(CDataFileWriter::ECompressionLevel Compression
 	}
 }
 
-void CDataFileWriter::Finish()
+void CDataFileWriter::CompressData(CDataInfo *pDataInfo)
 {
-	dbg_assert((bool)m_File, "File not open");
+	unsigned long CompressedSize = compressBound(pDataInfo->m_UncompressedSize);
+	pDataInfo->m_pCompressedData = malloc(CompressedSize);
+	const int Result = compress2((Bytef *)pDataInfo->m_pCompressedData, &CompressedSize, (Bytef *)pDataInfo->m_pUncompressedData, pDataInfo->m_UncompressedSize, CompressionLevelToZlib(pDataInfo->m_CompressionLevel));
+	pDataInfo->m_CompressedSize = CompressedSize;
+	free(pDataInfo->m_pUncompressedData);
+	pDataInfo->m_pUncompressedData = nullptr;
+	if(Result != Z_OK)
+	{
+		char aError[32];
+		str_format(aError, sizeof(aError), "zlib compression error %d", Result);
+		dbg_assert(false, aError);
+	}
+}
 
-	// Compress data. This takes the majority of the time when saving a datafile,
-	// so it's delayed until the end so it can be off-loaded to another thread.
-	for(CDataInfo &DataInfo : m_vDatas)
+// shared by all threads compressing the data of one datafile
+class CDataFileWriter::CCompressionBatch
+{
+public:
+	CDataInfo *m_pDatas;
+	int m_NumDatas;
+	std::atomic<int> m_NextData{0};
+	std::atomic<int> m_NumCompressed{0};
+
+	CCompressionBatch(CDataInfo *pDatas, int NumDatas) :
+		m_pDatas(pDatas),
+		m_NumDatas(NumDatas)
 	{
-		unsigned long CompressedSize = compressBound(DataInfo.m_UncompressedSize);
-		DataInfo.m_pCompressedData = malloc(CompressedSize);
-		const int Result = compress2((Bytef *)DataInfo.m_pCompressedData, &CompressedSize, (Bytef *)DataInfo.m_pUncompressedData, DataInfo.m_UncompressedSize, CompressionLevelToZlib(DataInfo.m_CompressionLevel));
-		DataInfo.m_CompressedSize = CompressedSize;
-		free(DataInfo.m_pUncompressedData);
-		DataInfo.m_pUncompressedData = nullptr;
-		if(Result != Z_OK)
+	}
+
+	// returns false once all data has been claimed
+	bool CompressNext()
+	{
+		const int Index = m_NextData.fetch_add(1);
+		if(Index >= m_NumDatas)
+			return false;
+		CompressData(&m_pDatas[Index]);
+		m_NumCompressed.fetch_add(1);
+		return true;
+	}
+
+	bool Done() const { return m_NumCompressed.load() >= m_NumDatas; }
+
+	static void Thread(void *pUser)
+	{
+		CCompressionBatch *pBatch = static_cast<CCompressionBatch *>(pUser);
+		while(pBatch->CompressNext())
 		{
-			char aError[32];
-			str_format(aError, sizeof(aError), "zlib compression error %d", Result);
-			dbg_assert(false, aError);
 		}
 	}
+};
+
+class CDataFileWriter::CCompressionJob : public IJob
+{
+	std::shared_ptr<CCompressionBatch> m_pBatch;
+
+	void Run() override
+	{
+		CCompressionBatch::Thread(m_pBatch.get());
+	}
+
+public:
+	CCompressionJob(std::shared_ptr<CCompressionBatch> pBatch) :
+		m_pBatch(std::move(pBatch))
+	{
+	}
+};
+
+void CDataFileWriter::CompressDatas(IEngine *pEngine, int NumThreads)
+{
+	size_t UncompressedSize = 0;
+	for(const CDataInfo &DataInfo : m_vDatas)
+		UncompressedSize += DataInfo.m_UncompressedSize;
+
+	if(NumThreads <= 0)
+		NumThreads = std::thread::hardware_concurrency();
+	if(UncompressedSize < PARALLEL_COMPRESSION_MIN_SIZE)
+		NumThreads = 1;
+	NumThreads = std::clamp<int>(NumThreads, 1, maximum<int>(m_vDatas.size(), 1));
+
+	// every data is compressed into its own buffer, so the order in which
+	// the threads finish doesn't matter. The calling thread helps too, so it
+	// never has to wait for a job that is still queued behind unrelated work.
+	auto pBatch = std::make_shared<CCompressionBatch>(m_vDatas.data(), m_vDatas.size());
+	std::vector<void *> vpThreads;
+	for(int i = 1; i < NumThreads; i++)
+	{
+		if(pEngine)
+			pEngine->AddJob(std::make_shared<CCompressionJob>(pBatch));
+		else
+			vpThreads.push_back(thread_init(CCompressionBatch::Thread, pBatch.get(), "datafile compr"));
+	}
+	CCompressionBatch::Thread(pBatch.get());
+	for(void *pThread : vpThreads)
+		thread_wait(pThread);
+	while(!pBatch->Done())
+		thread_yield();
+}
+
+void CDataFileWriter::Finish(IEngine *pEngine, int NumThreads)
+{
+	dbg_assert((bool)m_File, "File not open");
+
+	// Compress data. This takes the majority of the time when saving a datafile,
+	// so it's delayed until the end so it can be off-loaded to other threads.
+	CompressDatas(pEngine, NumThreads);
 
 	// Calculate total size of items
 	size_t ItemSize = 0;
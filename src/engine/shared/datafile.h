@@ -41,7 +41,11 @@ public:
 		return *this;
 	}
 
-	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType);
+	// MapFile maps the file into memory instead of reading the data items,
+	// uncompressed data is then used in place. The mapping is only meant for
+	// loading, accessing it after the file was changed in place crashes
+	// with SIGBUS, so release it with ReleaseMapping once the loading is done.
+	bool Open(class IStorage *pStorage, const char *pFilename, int StorageType, bool MapFile = false);
 	bool Close();
 	bool IsOpen() const { return m_pDataFile != nullptr; }
 	IOHANDLE File() const;
@@ -52,7 +56,19 @@ public:
 	const char *GetDataString(int Index);
 	void ReplaceData(int Index, char *pData, size_t Size); // memory for data must have been allocated with malloc
 	void UnloadData(int Index);
+	// copies the data that is used in place and unmaps the file, data that
+	// is loaded later is read from the file
+	void ReleaseMapping();
 	int NumData() const;
+	// decompresses the data that is not loaded yet on the job pool of pEngine,
+	// runs on the calling thread only if pEngine is nullptr
+	void PreloadData(class IEngine *pEngine, const std::vector<int> &vIndices);
+	void PreloadAllData(class IEngine *pEngine);
+	// SaveLoadedData writes all loaded data into a cache file, LoadCachedData
+	// replaces the data with the one of such a file. The cache file is mapped,
+	// so processes which load it share its memory until they modify the data.
+	bool SaveLoadedData(const char *pCacheFilename);
+	bool LoadCachedData(const char *pCacheFilename);
 
 	int GetItemSize(int Index) const;
 	void *GetItem(int Index, int *pType = nullptr, int *pId = nullptr, CUuid *pUuid = nullptr);
@@ -109,9 +125,14 @@ private:
 		CUuid m_Uuid;
 	};
 
+	class CCompressionBatch;
+	class CCompressionJob;
+
 	enum
 	{
 		MAX_ITEM_TYPES = 0x10000,
+		// less data than this is compressed on the calling thread only
+		PARALLEL_COMPRESSION_MIN_SIZE = 256 * 1024,
 	};
 
 	IOHANDLE m_File;
@@ -122,6 +143,8 @@ private:
 
 	int GetTypeFromIndex(int Index) const;
 	int GetExtendedItemTypeIndex(int Type, const CUuid *pUuid);
+	static void CompressData(CDataInfo *pDataInfo);
+	void CompressDatas(class IEngine *pEngine, int NumThreads);
 
 public:
 	CDataFileWriter();
@@ -141,7 +164,10 @@ public:
 	int AddData(size_t Size, const void *pData, ECompressionLevel CompressionLevel = COMPRESSION_DEFAULT);
 	int AddDataSwapped(size_t Size, const void *pData);
 	int AddDataString(const char *pStr);
-	void Finish();
+	// Compresses the data on the job pool of pEngine, or on temporary threads
+	// if pEngine is nullptr. NumThreads limits the number of threads
+	// compressing at once, 0 uses one per core. The output doesn't depend on it.
+	void Finish(class IEngine *pEngine = nullptr, int NumThreads = 0);
 };
 
 #endif
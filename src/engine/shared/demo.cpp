@@ -1,7 +1,9 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
+#include <base/lock.h>
 #include <base/math.h>
 #include <base/system.h>
+#include <base/tl/threading.h>
 
 #include <engine/console.h>
 #include <engine/storage.h>
@@ -17,6 +19,8 @@
 #include "network.h"
 #include "snapshot.h"
 
+#include <deque>
+
 const double g_aSpeeds[g_DemoSpeeds] = {0.1, 0.25, 0.5, 0.75, 1.0, 1.25, 1.5, 2.0, 3.0, 4.0, 6.0, 8.0, 12.0, 16.0, 20.0, 24.0, 28.0, 32.0, 40.0, 48.0, 56.0, 64.0};
 const CUuid SHA256_EXTENSION =
 	{{0x6b, 0xe6, 0xda, 0x4a, 0xce, 0xbd, 0x38, 0x0c,
@@ -29,6 +33,70 @@ static const unsigned char gs_VersionTickCompression = 5; // demo files with thi
 
 static const ColorRGBA gs_DemoPrintColor{0.75f, 0.7f, 0.7f, 1.0f};
 
+// The seek index stores the keyframe positions of a demo in a file next to it,
+// so loading long demos doesn't have to scan the whole file for them.
+static const unsigned char gs_aSeekIndexMarker[] = {'D', 'E', 'M', 'O', 'I', 'D', 'X'};
+static const unsigned char gs_SeekIndexVersion = 1;
+static const size_t gs_SeekIndexMinKeyFrames = 120; // about 10 minutes, shorter demos are scanned quickly
+
+struct CSeekIndexHeader
+{
+	unsigned char m_aMarker[sizeof(gs_aSeekIndexMarker)];
+	unsigned char m_Version;
+	char m_aTimestamp[sizeof(CDemoHeader::m_aTimestamp)]; // of the demo, to detect a replaced demo
+	unsigned char m_aDemoSize[sizeof(int64_t)];
+	unsigned char m_aFirstTick[sizeof(int32_t)];
+	unsigned char m_aLastTick[sizeof(int32_t)];
+	unsigned char m_aNumKeyFrames[sizeof(int32_t)];
+};
+
+struct CSeekIndexKeyFrame
+{
+	unsigned char m_aFilepos[sizeof(int64_t)];
+	unsigned char m_aTick[sizeof(int32_t)];
+};
+
+static void SeekIndexFilename(const char *pDemoFilename, char *pBuffer, size_t BufferSize)
+{
+	str_format(pBuffer, BufferSize, "%s.idx", pDemoFilename);
+}
+
+bool RemoveDemoFile(IStorage *pStorage, const char *pFilename, int StorageType)
+{
+	if(!pStorage->RemoveFile(pFilename, StorageType))
+		return false;
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	SeekIndexFilename(pFilename, aIndexFilename, sizeof(aIndexFilename));
+	if(pStorage->FileExists(aIndexFilename, StorageType))
+		pStorage->RemoveFile(aIndexFilename, StorageType);
+	return true;
+}
+
+bool RenameDemoFile(IStorage *pStorage, const char *pOldFilename, const char *pNewFilename, int StorageType)
+{
+	if(!pStorage->RenameFile(pOldFilename, pNewFilename, StorageType))
+		return false;
+	char aOldIndexFilename[IO_MAX_PATH_LENGTH];
+	char aNewIndexFilename[IO_MAX_PATH_LENGTH];
+	SeekIndexFilename(pOldFilename, aOldIndexFilename, sizeof(aOldIndexFilename));
+	SeekIndexFilename(pNewFilename, aNewIndexFilename, sizeof(aNewIndexFilename));
+	// the index is only a cache, drop it if it can't be moved along
+	if(pStorage->FileExists(aOldIndexFilename, StorageType) && !pStorage->RenameFile(aOldIndexFilename, aNewIndexFilename, StorageType))
+		pStorage->RemoveFile(aOldIndexFilename, StorageType);
+	return true;
+}
+
+static void Int64ToBytesBe(unsigned char *pBytes, int64_t Value)
+{
+	uint_to_bytes_be(pBytes, (uint64_t)Value >> 32);
+	uint_to_bytes_be(pBytes + sizeof(int32_t), (uint64_t)Value & 0xffffffff);
+}
+
+static int64_t BytesBeToInt64(const unsigned char *pBytes)
+{
+	return (int64_t)(((uint64_t)bytes_be_to_uint(pBytes) << 32) | bytes_be_to_uint(pBytes + sizeof(int32_t)));
+}
+
 bool CDemoHeader::Valid() const
 {
 	// Check marker and ensure that strings are zero-terminated and valid UTF-8.
@@ -39,15 +107,209 @@ bool CDemoHeader::Valid() const
 	       mem_has_null(m_aTimestamp, sizeof(m_aTimestamp)) && str_utf8_check(m_aTimestamp);
 }
 
-CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData)
+/*
+	Tickmarker
+		7	= Always set
+		6	= Keyframe flag
+		0-5	= Delta tick
+
+	Normal
+		7 = Not set
+		5-6	= Type
+		0-4	= Size
+*/
+
+enum
+{
+	CHUNKTYPEFLAG_TICKMARKER = 0x80,
+	CHUNKTICKFLAG_KEYFRAME = 0x40, // only when tickmarker is set
+	CHUNKTICKFLAG_TICK_COMPRESSED = 0x20, // when we store the tick value in the first chunk
+
+	CHUNKMASK_TICK = 0x1f,
+	CHUNKMASK_TICK_LEGACY = 0x3f,
+	CHUNKMASK_TYPE = 0x60,
+	CHUNKMASK_SIZE = 0x1f,
+
+	CHUNKTYPE_SNAPSHOT = 1,
+	CHUNKTYPE_MESSAGE = 2,
+	CHUNKTYPE_DELTA = 3,
+};
+
+// all asynchronous recorders share one writer thread, it runs while at least
+// one of them is recording
+class CDemoRecorder::CAsyncWriter
+{
+	enum
+	{
+		// recording waits for the writer thread when more is queued, shared
+		// by all recorders
+		MAX_QUEUED_SIZE = 8 * 1024 * 1024,
+		MAX_FREE_BUFFERS = 64,
+		FLUSH_SIZE = 64 * 1024,
+	};
+
+	struct CChunk
+	{
+		// a chunk without writer stops the writer thread, a chunk without
+		// type is the last one of its writer
+		CAsyncWriter *m_pWriter;
+		int m_Type;
+		int m_Tick;
+		std::vector<unsigned char> m_vData;
+	};
+
+	class CThread
+	{
+	public:
+		// held while starting and stopping the thread
+		CLock m_StartLock;
+		int m_NumWriters GUARDED_BY(m_StartLock) = 0;
+		void *m_pThread GUARDED_BY(m_StartLock) = nullptr;
+
+		CLock m_Lock;
+		// chunks of all writers, in the order they were recorded
+		std::deque<CChunk> m_Queue GUARDED_BY(m_Lock);
+		// the buffers of written chunks are used again
+		std::vector<std::vector<unsigned char>> m_vFreeBuffers GUARDED_BY(m_Lock);
+		size_t m_QueuedSize GUARDED_BY(m_Lock) = 0;
+		int m_NumWaitingForSpace GUARDED_BY(m_Lock) = 0;
+		CSemaphore m_NumQueued;
+		CSemaphore m_SpaceAvailable;
+
+		void Add(CChunk Chunk) REQUIRES(!m_Lock)
+		{
+			{
+				const CLockScope LockScope(m_Lock);
+				m_QueuedSize += Chunk.m_vData.size();
+				m_Queue.push_back(std::move(Chunk));
+			}
+			m_NumQueued.Signal();
+		}
+
+		static void ThreadFunc(void *pUser)
+		{
+			static_cast<CThread *>(pUser)->Run();
+		}
+
+		void Run() REQUIRES(!m_Lock)
+		{
+			while(true)
+			{
+				m_NumQueued.Wait();
+				CChunk Chunk;
+				{
+					const CLockScope LockScope(m_Lock);
+					Chunk = std::move(m_Queue.front());
+					m_Queue.pop_front();
+				}
+				CAsyncWriter *pWriter = Chunk.m_pWriter;
+				if(pWriter == nullptr)
+					break;
+				CDemoRecorder *pRecorder = pWriter->m_pRecorder;
+				if(Chunk.m_Type == 0)
+				{
+					// the writer is destroyed once it's signaled
+					pRecorder->FlushData();
+					pWriter->m_Finished.Signal();
+					continue;
+				}
+
+				if(Chunk.m_Type == CHUNKTYPE_SNAPSHOT)
+					pRecorder->WriteSnapshot(&pWriter->m_SnapshotDelta, Chunk.m_Tick, Chunk.m_vData.data(), Chunk.m_vData.size());
+				else
+					pRecorder->Write(Chunk.m_Type, Chunk.m_vData.data(), Chunk.m_vData.size());
+
+				bool Idle;
+				{
+					const CLockScope LockScope(m_Lock);
+					m_QueuedSize -= Chunk.m_vData.size();
+					if(m_vFreeBuffers.size() < MAX_FREE_BUFFERS)
+						m_vFreeBuffers.push_back(std::move(Chunk.m_vData));
+					for(; m_NumWaitingForSpace > 0; m_NumWaitingForSpace--)
+						m_SpaceAvailable.Signal();
+					Idle = --pWriter->m_NumQueued == 0;
+				}
+				if(Idle || pRecorder->m_vWriteBuffer.size() >= FLUSH_SIZE)
+					pRecorder->FlushData();
+			}
+		}
+	};
+	static CThread ms_Thread;
+
+	CDemoRecorder *m_pRecorder;
+	// the recording thread keeps changing its delta
+	CSnapshotDelta m_SnapshotDelta;
+	// chunks of this writer that aren't written yet
+	int m_NumQueued GUARDED_BY(ms_Thread.m_Lock) = 0;
+	CSemaphore m_Finished;
+
+public:
+	CAsyncWriter(CDemoRecorder *pRecorder) REQUIRES(!ms_Thread.m_StartLock) :
+		m_pRecorder(pRecorder),
+		m_SnapshotDelta(*pRecorder->m_pSnapshotDelta)
+	{
+		const CLockScope LockScope(ms_Thread.m_StartLock);
+		if(ms_Thread.m_NumWriters++ == 0)
+			ms_Thread.m_pThread = thread_init(CThread::ThreadFunc, &ms_Thread, "demo writer");
+	}
+
+	~CAsyncWriter() REQUIRES(!ms_Thread.m_StartLock, !ms_Thread.m_Lock)
+	{
+		ms_Thread.Add({this, 0, 0, {}});
+		m_Finished.Wait();
+
+		const CLockScope LockScope(ms_Thread.m_StartLock);
+		if(--ms_Thread.m_NumWriters == 0)
+		{
+			ms_Thread.Add({nullptr, 0, 0, {}});
+			thread_wait(ms_Thread.m_pThread);
+			ms_Thread.m_pThread = nullptr;
+		}
+	}
+
+	void Push(int Type, int Tick, const void *pData, int Size) REQUIRES(!ms_Thread.m_Lock)
+	{
+		std::vector<unsigned char> vData;
+		while(true)
+		{
+			{
+				const CLockScope LockScope(ms_Thread.m_Lock);
+				if(ms_Thread.m_QueuedSize <= MAX_QUEUED_SIZE)
+				{
+					if(!ms_Thread.m_vFreeBuffers.empty())
+					{
+						vData = std::move(ms_Thread.m_vFreeBuffers.back());
+						ms_Thread.m_vFreeBuffers.pop_back();
+					}
+					m_NumQueued++;
+					break;
+				}
+				ms_Thread.m_NumWaitingForSpace++;
+			}
+			ms_Thread.m_SpaceAvailable.Wait();
+		}
+
+		const unsigned char *pBytes = (const unsigned char *)pData;
+		vData.assign(pBytes, pBytes + Size);
+		ms_Thread.Add({this, Type, Tick, std::move(vData)});
+	}
+};
+
+CDemoRecorder::CAsyncWriter::CThread CDemoRecorder::CAsyncWriter::ms_Thread;
+
+CDemoRecorder::CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData, bool Async)
 {
 	m_File = nullptr;
 	m_aCurrentFilename[0] = '\0';
 	m_pfnFilter = nullptr;
 	m_pUser = nullptr;
+	m_LastTick = -1;
+	m_FirstTick = -1;
 	m_LastTickMarker = -1;
 	m_pSnapshotDelta = pSnapshotDelta;
 	m_NoMapData = NoMapData;
+	m_Async = Async;
+	m_pAsyncWriter = nullptr;
 }
 
 CDemoRecorder::~CDemoRecorder()
@@ -194,8 +456,11 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 
 	m_LastKeyFrame = -1;
 	m_LastTickMarker = -1;
+	m_LastTick = -1;
 	m_FirstTick = -1;
 	m_NumTimelineMarkers = 0;
+	m_vKeyFrames.clear();
+	str_copy(m_aTimestamp, Header.m_aTimestamp);
 
 	if(m_pConsole)
 	{
@@ -210,37 +475,12 @@ int CDemoRecorder::Start(class IStorage *pStorage, class IConsole *pConsole, con
 	m_File = DemoFile;
 	str_copy(m_aCurrentFilename, pFilename);
 
+	if(m_Async)
+		m_pAsyncWriter = new CAsyncWriter(this);
+
 	return 0;
 }
 
-/*
-	Tickmarker
-		7	= Always set
-		6	= Keyframe flag
-		0-5	= Delta tick
-
-	Normal
-		7 = Not set
-		5-6	= Type
-		0-4	= Size
-*/
-
-enum
-{
-	CHUNKTYPEFLAG_TICKMARKER = 0x80,
-	CHUNKTICKFLAG_KEYFRAME = 0x40, // only when tickmarker is set
-	CHUNKTICKFLAG_TICK_COMPRESSED = 0x20, // when we store the tick value in the first chunk
-
-	CHUNKMASK_TICK = 0x1f,
-	CHUNKMASK_TICK_LEGACY = 0x3f,
-	CHUNKMASK_TYPE = 0x60,
-	CHUNKMASK_SIZE = 0x1f,
-
-	CHUNKTYPE_SNAPSHOT = 1,
-	CHUNKTYPE_MESSAGE = 2,
-	CHUNKTYPE_DELTA = 3,
-};
-
 void CDemoRecorder::WriteTickMarker(int Tick, bool Keyframe)
 {
 	if(m_LastTickMarker == -1 || Tick - m_LastTickMarker > CHUNKMASK_TICK || Keyframe)
@@ -252,18 +492,16 @@ void CDemoRecorder::WriteTickMarker(int Tick, bool Keyframe)
 		if(Keyframe)
 			aChunk[0] |= CHUNKTICKFLAG_KEYFRAME;
 
-		io_write(m_File, aChunk, sizeof(aChunk));
+		WriteData(aChunk, sizeof(aChunk));
 	}
 	else
 	{
 		unsigned char aChunk[1];
 		aChunk[0] = CHUNKTYPEFLAG_TICKMARKER | CHUNKTICKFLAG_TICK_COMPRESSED | (Tick - m_LastTickMarker);
-		io_write(m_File, aChunk, sizeof(aChunk));
+		WriteData(aChunk, sizeof(aChunk));
 	}
 
 	m_LastTickMarker = Tick;
-	if(m_FirstTick < 0)
-		m_FirstTick = Tick;
 }
 
 void CDemoRecorder::Write(int Type, const void *pData, int Size)
@@ -294,7 +532,7 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 	if(Size < 30)
 	{
 		aChunk[0] |= Size;
-		io_write(m_File, aChunk, 1);
+		WriteData(aChunk, 1);
 	}
 	else
 	{
@@ -302,25 +540,55 @@ void CDemoRecorder::Write(int Type, const void *pData, int Size)
 		{
 			aChunk[0] |= 30;
 			aChunk[1] = Size & 0xff;
-			io_write(m_File, aChunk, 2);
+			WriteData(aChunk, 2);
 		}
 		else
 		{
 			aChunk[0] |= 31;
 			aChunk[1] = Size & 0xff;
 			aChunk[2] = Size >> 8;
-			io_write(m_File, aChunk, 3);
+			WriteData(aChunk, 3);
 		}
 	}
 
-	io_write(m_File, aBuffer2, Size);
+	WriteData(aBuffer2, Size);
+}
+
+void CDemoRecorder::WriteData(const void *pData, int Size)
+{
+	const unsigned char *pBytes = (const unsigned char *)pData;
+	m_vWriteBuffer.insert(m_vWriteBuffer.end(), pBytes, pBytes + Size);
+}
+
+void CDemoRecorder::FlushData()
+{
+	if(m_vWriteBuffer.empty())
+		return;
+	io_write(m_File, m_vWriteBuffer.data(), m_vWriteBuffer.size());
+	m_vWriteBuffer.clear();
 }
 
 void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
+{
+	m_LastTick = Tick;
+	if(m_FirstTick < 0)
+		m_FirstTick = Tick;
+
+	if(m_pAsyncWriter)
+	{
+		m_pAsyncWriter->Push(CHUNKTYPE_SNAPSHOT, Tick, pData, Size);
+		return;
+	}
+	WriteSnapshot(m_pSnapshotDelta, Tick, pData, Size);
+	FlushData();
+}
+
+void CDemoRecorder::WriteSnapshot(CSnapshotDelta *pSnapshotDelta, int Tick, const void *pData, int Size)
 {
 	if(m_LastKeyFrame == -1 || (Tick - m_LastKeyFrame) > SERVER_TICK_SPEED * 5)
 	{
 		// write full tickmarker
+		m_vKeyFrames.emplace_back(io_tell(m_File) + (int64_t)m_vWriteBuffer.size(), Tick);
 		WriteTickMarker(Tick, true);
 
 		// write snapshot
@@ -336,9 +604,9 @@ void CDemoRecorder::RecordSnapshot(int Tick, const void *pData, int Size)
 
 		// create delta
 		char aDeltaData[CSnapshot::MAX_SIZE + sizeof(int)];
-		m_pSnapshotDelta->SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
-		m_pSnapshotDelta->SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
-		const int DeltaSize = m_pSnapshotDelta->CreateDelta((CSnapshot *)m_aLastSnapshotData, (CSnapshot *)pData, &aDeltaData);
+		pSnapshotDelta->SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
+		pSnapshotDelta->SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
+		const int DeltaSize = pSnapshotDelta->CreateDelta((CSnapshot *)m_aLastSnapshotData, (CSnapshot *)pData, &aDeltaData);
 		if(DeltaSize)
 		{
 			// record delta
@@ -357,7 +625,53 @@ void CDemoRecorder::RecordMessage(const void *pData, int Size)
 			return;
 		}
 	}
+
+	if(m_pAsyncWriter)
+	{
+		m_pAsyncWriter->Push(CHUNKTYPE_MESSAGE, m_LastTick, pData, Size);
+		return;
+	}
 	Write(CHUNKTYPE_MESSAGE, pData, Size);
+	FlushData();
+}
+
+void CDemoRecorder::WriteSeekIndex(const char *pFilename, int64_t DemoSize)
+{
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	SeekIndexFilename(pFilename, aIndexFilename, sizeof(aIndexFilename));
+	if(m_vKeyFrames.size() < gs_SeekIndexMinKeyFrames || DemoSize < 0)
+	{
+		// don't leave an index of a previous demo with the same name around
+		if(m_pStorage->FileExists(aIndexFilename, IStorage::TYPE_SAVE))
+			m_pStorage->RemoveFile(aIndexFilename, IStorage::TYPE_SAVE);
+		return;
+	}
+
+	IOHANDLE File = m_pStorage->OpenFile(aIndexFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+	if(!File)
+		return;
+
+	CSeekIndexHeader Header;
+	mem_copy(Header.m_aMarker, gs_aSeekIndexMarker, sizeof(Header.m_aMarker));
+	Header.m_Version = gs_SeekIndexVersion;
+	mem_copy(Header.m_aTimestamp, m_aTimestamp, sizeof(Header.m_aTimestamp));
+	Int64ToBytesBe(Header.m_aDemoSize, DemoSize);
+	uint_to_bytes_be(Header.m_aFirstTick, m_FirstTick);
+	uint_to_bytes_be(Header.m_aLastTick, m_LastTick);
+	uint_to_bytes_be(Header.m_aNumKeyFrames, m_vKeyFrames.size());
+
+	std::vector<CSeekIndexKeyFrame> vKeyFrames(m_vKeyFrames.size());
+	for(size_t i = 0; i < m_vKeyFrames.size(); i++)
+	{
+		Int64ToBytesBe(vKeyFrames[i].m_aFilepos, m_vKeyFrames[i].m_Filepos);
+		uint_to_bytes_be(vKeyFrames[i].m_aTick, m_vKeyFrames[i].m_Tick);
+	}
+
+	const bool Success = io_write(File, &Header, sizeof(Header)) == sizeof(Header) &&
+			     io_write(File, vKeyFrames.data(), vKeyFrames.size() * sizeof(CSeekIndexKeyFrame)) == vKeyFrames.size() * sizeof(CSeekIndexKeyFrame);
+	io_close(File);
+	if(!Success)
+		m_pStorage->RemoveFile(aIndexFilename, IStorage::TYPE_SAVE);
 }
 
 int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilename)
@@ -365,6 +679,14 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 	if(!m_File)
 		return -1;
 
+	// let the writer thread finish the queued chunks
+	delete m_pAsyncWriter;
+	m_pAsyncWriter = nullptr;
+	FlushData();
+
+	// all chunks are appended, so this is the size of the demo
+	const int64_t DemoSize = io_tell(m_File);
+
 	if(Mode == IDemoRecorder::EStopMode::KEEP_FILE)
 	{
 		// add the demo length to the header
@@ -416,6 +738,9 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 		}
 	}
 
+	if(Mode == IDemoRecorder::EStopMode::KEEP_FILE)
+		WriteSeekIndex(pTargetFilename[0] != '\0' ? pTargetFilename : m_aCurrentFilename, DemoSize);
+
 	if(m_pConsole)
 	{
 		char aBuf[64 + IO_MAX_PATH_LENGTH];
@@ -428,9 +753,9 @@ int CDemoRecorder::Stop(IDemoRecorder::EStopMode Mode, const char *pTargetFilena
 
 void CDemoRecorder::AddDemoMarker()
 {
-	if(m_LastTickMarker < 0)
+	if(m_LastTick < 0)
 		return;
-	AddDemoMarker(m_LastTickMarker);
+	AddDemoMarker(m_LastTick);
 }
 
 void CDemoRecorder::AddDemoMarker(int Tick)
@@ -626,6 +951,60 @@ bool CDemoPlayer::ScanFile()
 	return true;
 }
 
+bool CDemoPlayer::LoadSeekIndex(IStorage *pStorage, int StorageType)
+{
+	const int64_t DataStart = io_tell(m_File);
+	const int64_t DemoSize = io_length(m_File);
+	if(DataStart < 0 || io_seek(m_File, DataStart, IOSEEK_START) != 0)
+		return false;
+
+	char aIndexFilename[IO_MAX_PATH_LENGTH];
+	SeekIndexFilename(m_aFilename, aIndexFilename, sizeof(aIndexFilename));
+	void *pData;
+	unsigned DataSize;
+	if(!pStorage->ReadFile(aIndexFilename, StorageType, &pData, &DataSize))
+		return false;
+
+	// only use the index if it matches this exact demo, otherwise scan the file
+	const CSeekIndexHeader *pHeader = static_cast<const CSeekIndexHeader *>(pData);
+	const CSeekIndexKeyFrame *pKeyFrames = reinterpret_cast<const CSeekIndexKeyFrame *>(pHeader + 1);
+	const size_t NumKeyFrames = DataSize >= sizeof(CSeekIndexHeader) ? bytes_be_to_uint(pHeader->m_aNumKeyFrames) : 0;
+	if(DataSize < sizeof(CSeekIndexHeader) ||
+		mem_comp(pHeader->m_aMarker, gs_aSeekIndexMarker, sizeof(gs_aSeekIndexMarker)) != 0 ||
+		pHeader->m_Version != gs_SeekIndexVersion ||
+		mem_comp(pHeader->m_aTimestamp, m_Info.m_Header.m_aTimestamp, sizeof(pHeader->m_aTimestamp)) != 0 ||
+		BytesBeToInt64(pHeader->m_aDemoSize) != DemoSize ||
+		NumKeyFrames == 0 ||
+		DataSize != sizeof(CSeekIndexHeader) + NumKeyFrames * sizeof(CSeekIndexKeyFrame))
+	{
+		free(pData);
+		return false;
+	}
+
+	const int FirstTick = bytes_be_to_uint(pHeader->m_aFirstTick);
+	const int LastTick = bytes_be_to_uint(pHeader->m_aLastTick);
+	std::vector<CDemoKeyFrame> vKeyFrames;
+	vKeyFrames.reserve(NumKeyFrames);
+	for(size_t i = 0; i < NumKeyFrames; i++)
+	{
+		const int64_t Filepos = BytesBeToInt64(pKeyFrames[i].m_aFilepos);
+		const int Tick = bytes_be_to_uint(pKeyFrames[i].m_aTick);
+		const bool Ordered = vKeyFrames.empty() || (Filepos > vKeyFrames.back().m_Filepos && Tick > vKeyFrames.back().m_Tick);
+		if(!Ordered || Filepos < DataStart || Filepos >= DemoSize || Tick < FirstTick || Tick > LastTick)
+		{
+			free(pData);
+			return false;
+		}
+		vKeyFrames.emplace_back(Filepos, Tick);
+	}
+	free(pData);
+
+	m_vKeyFrames = std::move(vKeyFrames);
+	m_Info.m_Info.m_FirstTick = FirstTick;
+	m_Info.m_Info.m_LastTick = LastTick;
+	return true;
+}
+
 void CDemoPlayer::DoTick()
 {
 	// update ticks
@@ -846,8 +1225,8 @@ int CDemoPlayer::Load(class IStorage *pStorage, class IConsole *pConsole, const
 		}
 	}
 
-	// scan the file for interesting points
-	if(!ScanFile())
+	// scan the file for interesting points, unless a seek index lists them already
+	if(!LoadSeekIndex(pStorage, StorageType) && !ScanFile())
 	{
 		Stop("Error scanning demo file");
 		return -1;
@@ -15,6 +15,21 @@
 
 typedef std::function<void()> TUpdateIntraTimesFunc;
 
+struct CDemoKeyFrame
+{
+	int64_t m_Filepos;
+	int m_Tick;
+
+	CDemoKeyFrame(int64_t Filepos, int Tick) :
+		m_Filepos(Filepos), m_Tick(Tick)
+	{
+	}
+};
+
+// the seek index of a demo is stored next to it, these remove or rename both
+bool RemoveDemoFile(class IStorage *pStorage, const char *pFilename, int StorageType);
+bool RenameDemoFile(class IStorage *pStorage, const char *pOldFilename, const char *pNewFilename, int StorageType);
+
 class CDemoRecorder : public IDemoRecorder
 {
 	class IConsole *m_pConsole;
@@ -22,9 +37,18 @@ class CDemoRecorder : public IDemoRecorder
 
 	IOHANDLE m_File;
 	char m_aCurrentFilename[IO_MAX_PATH_LENGTH];
+	int m_LastTick;
+	int m_FirstTick;
+
+	// used by the thread writing the chunks, which is the writer thread
+	// of asynchronous recorders
 	int m_LastTickMarker;
 	int m_LastKeyFrame;
-	int m_FirstTick;
+	std::vector<unsigned char> m_vWriteBuffer;
+
+	// written next to long demos, so loading them doesn't have to scan the whole file
+	std::vector<CDemoKeyFrame> m_vKeyFrames;
+	char m_aTimestamp[sizeof(CDemoHeader::m_aTimestamp)];
 
 	unsigned char m_aLastSnapshotData[CSnapshot::MAX_SIZE];
 	class CSnapshotDelta *m_pSnapshotDelta;
@@ -34,14 +58,25 @@ class CDemoRecorder : public IDemoRecorder
 
 	bool m_NoMapData;
 
+	// asynchronous recorders create the deltas, compress and write the
+	// chunks on a writer thread shared by all of them, recording only
+	// copies the data
+	class CAsyncWriter;
+	bool m_Async;
+	CAsyncWriter *m_pAsyncWriter;
+
 	DEMOFUNC_FILTER m_pfnFilter;
 	void *m_pUser;
 
 	void WriteTickMarker(int Tick, bool Keyframe);
 	void Write(int Type, const void *pData, int Size);
+	void WriteSnapshot(class CSnapshotDelta *pSnapshotDelta, int Tick, const void *pData, int Size);
+	void WriteData(const void *pData, int Size);
+	void FlushData();
+	void WriteSeekIndex(const char *pFilename, int64_t DemoSize);
 
 public:
-	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData = false);
+	CDemoRecorder(class CSnapshotDelta *pSnapshotDelta, bool NoMapData = false, bool Async = false);
 	CDemoRecorder() {}
 	~CDemoRecorder() override;
 
@@ -57,7 +92,7 @@ public:
 	bool IsRecording() const override { return m_File != nullptr; }
 	const char *CurrentFilename() const override { return m_aCurrentFilename; }
 
-	int Length() const override { return (m_LastTickMarker - m_FirstTick) / SERVER_TICK_SPEED; }
+	int Length() const override { return (m_LastTick - m_FirstTick) / SERVER_TICK_SPEED; }
 };
 
 class CDemoPlayer : public IDemoPlayer
@@ -95,23 +130,12 @@ private:
 	TUpdateIntraTimesFunc m_UpdateIntraTimesFunc;
 
 	// Playback
-	struct SKeyFrame
-	{
-		int64_t m_Filepos;
-		int m_Tick;
-
-		SKeyFrame(int64_t Filepos, int Tick) :
-			m_Filepos(Filepos), m_Tick(Tick)
-		{
-		}
-	};
-
 	class IConsole *m_pConsole;
 	IOHANDLE m_File;
 	int64_t m_MapOffset;
 	char m_aFilename[IO_MAX_PATH_LENGTH];
 	char m_aErrorMessage[256];
-	std::vector<SKeyFrame> m_vKeyFrames;
+	std::vector<CDemoKeyFrame> m_vKeyFrames;
 	CMapInfo m_MapInfo;
 	int m_SpeedIndex;
 
@@ -143,6 +167,7 @@ private:
 	EReadChunkHeaderResult ReadChunkHeader(int *pType, int *pSize, int *pTick);
 	void DoTick();
 	bool ScanFile();
+	bool LoadSeekIndex(class IStorage *pStorage, int StorageType);
 
 	int64_t Time();
 	bool m_Sixup;
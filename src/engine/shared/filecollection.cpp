@@ -8,7 +8,7 @@
 
 #include "filecollection.h"
 
-void CFileCollection::Init(IStorage *pStorage, const char *pPath, const char *pFileDesc, const char *pFileExt, int MaxEntries)
+void CFileCollection::Init(IStorage *pStorage, const char *pPath, const char *pFileDesc, const char *pFileExt, int MaxEntries, FILECOLLECTION_REMOVE_FUNC pfnRemove)
 {
 	m_vFileEntries.clear();
 	str_copy(m_aFileDesc, pFileDesc);
@@ -39,7 +39,10 @@ void CFileCollection::Init(IStorage *pStorage, const char *pPath, const char *pF
 			str_format(aBuf, sizeof(aBuf), "%s/%s_%s%s", m_aPath, m_aFileDesc, aTimestring, m_aFileExt);
 		}
 
-		m_pStorage->RemoveFile(aBuf, IStorage::TYPE_SAVE);
+		if(pfnRemove)
+			pfnRemove(m_pStorage, aBuf, IStorage::TYPE_SAVE);
+		else
+			m_pStorage->RemoveFile(aBuf, IStorage::TYPE_SAVE);
 		FilesDeleted++;
 	}
 }
@@ -11,6 +11,8 @@
 
 class IStorage;
 
+typedef bool (*FILECOLLECTION_REMOVE_FUNC)(IStorage *pStorage, const char *pFilename, int StorageType);
+
 class CFileCollection
 {
 	enum
@@ -41,7 +43,8 @@ class CFileCollection
 	bool ParseFilename(const char *pFilename, time_t *pTimestamp);
 
 public:
-	void Init(IStorage *pStorage, const char *pPath, const char *pFileDesc, const char *pFileExt, int MaxEntries);
+	// pfnRemove deletes the files together with files that belong to them, IStorage::RemoveFile is used if it is nullptr
+	void Init(IStorage *pStorage, const char *pPath, const char *pFileDesc, const char *pFileExt, int MaxEntries, FILECOLLECTION_REMOVE_FUNC pfnRemove = nullptr);
 
 	static int FilelistCallback(const char *pFilename, int IsDir, int StorageType, void *pUser);
 };
@@ -0,0 +1,93 @@
+#include "gzip_writer.h"
+
+#include <zlib.h>
+
+CGzipWriter::CGzipWriter(IOHANDLE File, int Level) :
+	m_File(File), m_Level(Level)
+{
+	m_pThread = thread_init(ThreadFunc, this, "gzip writer");
+}
+
+CGzipWriter::~CGzipWriter()
+{
+	Close();
+}
+
+void CGzipWriter::Write(const void *pData, int DataSize)
+{
+	if(DataSize <= 0 || !m_pThread)
+		return;
+	const unsigned char *pBytes = (const unsigned char *)pData;
+	{
+		const CLockScope LockScope(m_Lock);
+		m_Queue.emplace_back(pBytes, pBytes + DataSize);
+	}
+	m_NumQueued.Signal();
+}
+
+void CGzipWriter::Close()
+{
+	if(!m_pThread)
+		return;
+	{
+		const CLockScope LockScope(m_Lock);
+		m_Queue.emplace_back();
+	}
+	m_NumQueued.Signal();
+	thread_wait(m_pThread);
+	m_pThread = nullptr;
+	if(io_close(m_File) != 0 && m_Error.load() == 0)
+		m_Error.store(-1);
+}
+
+void CGzipWriter::ThreadFunc(void *pUser)
+{
+	static_cast<CGzipWriter *>(pUser)->Run();
+}
+
+void CGzipWriter::Run()
+{
+	z_stream Stream = {};
+	// 16 selects the gzip header instead of the zlib one
+	if(deflateInit2(&Stream, m_Level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		m_Error.store(Z_STREAM_ERROR);
+
+	unsigned char aOut[64 * 1024];
+	bool Finished = false;
+	while(!Finished)
+	{
+		m_NumQueued.Wait();
+		std::vector<unsigned char> vData;
+		{
+			const CLockScope LockScope(m_Lock);
+			vData = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+		Finished = vData.empty();
+		if(m_Error.load() != 0)
+			continue;
+
+		Stream.next_in = vData.data();
+		Stream.avail_in = vData.size();
+		const int Flush = Finished ? Z_FINISH : Z_NO_FLUSH;
+		int Result;
+		do
+		{
+			Stream.next_out = aOut;
+			Stream.avail_out = sizeof(aOut);
+			Result = deflate(&Stream, Flush);
+			if(Result == Z_STREAM_ERROR)
+			{
+				m_Error.store(Result);
+				break;
+			}
+			const unsigned Size = sizeof(aOut) - Stream.avail_out;
+			if(Size > 0 && io_write(m_File, aOut, Size) != Size)
+			{
+				m_Error.store(-1);
+				break;
+			}
+		} while(Stream.avail_out == 0 || (Finished && Result != Z_STREAM_END));
+	}
+	deflateEnd(&Stream);
+}
@@ -0,0 +1,42 @@
+#ifndef ENGINE_SHARED_GZIP_WRITER_H
+#define ENGINE_SHARED_GZIP_WRITER_H
+
+#include <base/lock.h>
+#include <base/system.h>
+#include <base/tl/threading.h>
+
+#include <atomic>
+#include <deque>
+#include <vector>
+
+// Writes a gzip stream to a file. Compression and file I/O happen on a
+// background thread, Write only copies the data into the queue.
+class CGzipWriter
+{
+public:
+	// takes ownership of File, Level is a zlib compression level (1-9)
+	CGzipWriter(IOHANDLE File, int Level);
+	~CGzipWriter();
+
+	void Write(const void *pData, int DataSize);
+	// finishes the gzip stream and waits until everything is written
+	void Close();
+	// non-zero after compressing or writing failed
+	int Error() const { return m_Error.load(); }
+
+private:
+	static void ThreadFunc(void *pUser);
+	void Run();
+
+	IOHANDLE m_File;
+	int m_Level;
+	void *m_pThread = nullptr;
+	std::atomic<int> m_Error{0};
+
+	CLock m_Lock;
+	// an empty buffer finishes the stream
+	std::deque<std::vector<unsigned char>> m_Queue GUARDED_BY(m_Lock);
+	CSemaphore m_NumQueued;
+};
+
+#endif
@@ -4,6 +4,8 @@
 #include <algorithm>
 #include <base/system.h>
 
+#include <cstdint>
+
 const unsigned CHuffman::ms_aFreqTable[HUFFMAN_MAX_SYMBOLS] = {
 	1 << 30, 4545, 2657, 431, 1950, 919, 444, 482, 2244, 617, 838, 542, 715, 1814, 304, 240, 754, 212, 647, 186,
 	283, 131, 146, 166, 543, 164, 167, 136, 179, 859, 363, 113, 157, 154, 204, 108, 137, 180, 202, 176,
@@ -94,110 +96,128 @@ void CHuffman::Init(const unsigned *pFrequencies)
 {
 	// make sure to cleanout every thing
 	mem_zero(m_aNodes, sizeof(m_aNodes));
-	mem_zero(m_apDecodeLut, sizeof(m_apDecodeLut));
+	mem_zero(m_aDecodeLut, sizeof(m_aDecodeLut));
 	m_pStartNode = nullptr;
 	m_NumNodes = 0;
 
 	// construct the tree
 	ConstructTree(pFrequencies);
+	for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+		dbg_assert(m_aNodes[i].m_NumBits <= HUFFMAN_MAX_CODE_BITS, "huffman code too long");
 
-	// build decode LUT
+	// build decode LUT, decoding as many symbols as fit into the bits
 	for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
 	{
+		CDecodeEntry &Entry = m_aDecodeLut[i];
 		unsigned Bits = i;
-		int k;
-		CNode *pNode = m_pStartNode;
-		for(k = 0; k < HUFFMAN_LUTBITS; k++)
+		unsigned NumBits = 0;
+		while(Entry.m_NumSymbols < HUFFMAN_LUTSYMBOLS)
 		{
-			pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
-			Bits >>= 1;
-
-			if(!pNode)
-				break;
+			const CNode *pNode = m_pStartNode;
+			unsigned CodeBits = 0;
+			while(!pNode->m_NumBits && NumBits + CodeBits < HUFFMAN_LUTBITS)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[(Bits >> CodeBits) & 1]];
+				CodeBits++;
+			}
 
-			if(pNode->m_NumBits)
+			const bool Complete = pNode->m_NumBits != 0;
+			if(!Complete || pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL])
 			{
-				m_apDecodeLut[i] = pNode;
+				// the first code is handled on its own
+				if(Entry.m_NumSymbols == 0)
+				{
+					Entry.m_NumBits = CodeBits;
+					Entry.m_Node = pNode - m_aNodes;
+				}
 				break;
 			}
-		}
 
-		if(k == HUFFMAN_LUTBITS)
-			m_apDecodeLut[i] = pNode;
+			Entry.m_aSymbols[Entry.m_NumSymbols++] = pNode->m_Symbol;
+			Bits >>= CodeBits;
+			NumBits += CodeBits;
+			Entry.m_NumBits = NumBits;
+		}
 	}
+
+	const CNode *pNode = m_pStartNode;
+	while(!pNode->m_NumBits)
+		pNode = &m_aNodes[pNode->m_aLeafs[0]];
+	m_ZerosDecodeEof = pNode == &m_aNodes[HUFFMAN_EOF_SYMBOL];
+}
+
+static inline void WriteBits(unsigned char *pDst, uint64_t Bits)
+{
+	// compiles to a single store on little endian
+	for(int i = 0; i < 8; i++)
+		pDst[i] = Bits >> (i * 8);
+}
+
+static inline uint64_t ReadBits(const unsigned char *pSrc)
+{
+	uint64_t Bits = 0;
+	for(int i = 0; i < 8; i++)
+		Bits |= (uint64_t)pSrc[i] << (i * 8);
+	return Bits;
 }
 
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	do \
-	{ \
-		Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-		Bitcount += m_aNodes[Sym].m_NumBits; \
-	} while(0)
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	do \
-	{ \
-		while(Bitcount >= 8) \
-		{ \
-			*pDst++ = (unsigned char)(Bits & 0xff); \
-			if(pDst == pDstEnd) \
-				return -1; \
-			Bits >>= 8; \
-			Bitcount -= 8; \
-		} \
-	} while(0)
-
 	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
+	if(OutputSize <= 0)
+		return -1;
+
 	// symbol variables
-	unsigned Bits = 0;
+	uint64_t Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	// two codes per store while the whole bit buffer fits into the output,
+	// the output can't get full here
+	while(pSrcEnd - pSrc >= 2 && pDstEnd - pDst > 8)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
+		const CNode &First = m_aNodes[pSrc[0]];
+		const CNode &Second = m_aNodes[pSrc[1]];
+		pSrc += 2;
+		Bits |= (uint64_t)First.m_Bits << Bitcount;
+		Bitcount += First.m_NumBits;
+		Bits |= (uint64_t)Second.m_Bits << Bitcount;
+		Bitcount += Second.m_NumBits;
+
+		WriteBits(pDst, Bits);
+		pDst += Bitcount / 8;
+		Bits >>= Bitcount & ~7u;
+		Bitcount &= 7;
+	}
 
-		while(pSrc != pSrcEnd)
+	// byte by byte for the rest and the EOF symbol
+	while(true)
+	{
+		const int Symbol = pSrc != pSrcEnd ? *pSrc++ : (int)HUFFMAN_EOF_SYMBOL;
+		Bits |= (uint64_t)m_aNodes[Symbol].m_Bits << Bitcount;
+		Bitcount += m_aNodes[Symbol].m_NumBits;
+		while(Bitcount >= 8)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE();
+			*pDst++ = (unsigned char)(Bits & 0xff);
+			if(pDst == pDstEnd)
+				return -1;
+			Bits >>= 8;
+			Bitcount -= 8;
 		}
-
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol);
-		HUFFMAN_MACRO_WRITE();
+		if(Symbol == HUFFMAN_EOF_SYMBOL)
+			break;
 	}
 
-	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL);
-	HUFFMAN_MACRO_WRITE();
-
 	// write out the last bits
 	*pDst++ = Bits;
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
-
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
 }
 
 //***************************************************************
@@ -205,77 +225,106 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	unsigned Bits = 0;
-	unsigned Bitcount = 0;
+	// goes negative when decoding the zeros after the input
+	uint64_t Bits = 0;
+	int Bitcount = 0;
 
 	const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
 
 	while(true)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		const CNode *pNode = nullptr;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
-		{
-			Bits |= (*pSrc++) << Bitcount;
-			Bitcount += 8;
-		}
-
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		if(!pNode)
-			return -1;
-
-		// {D} check if we hit a symbol already
-		if(pNode->m_NumBits)
+		// fill with new bits, the bits above the count are the next ones
+		if(pSrcEnd - pSrc >= 8)
 		{
-			// remove the bits for that symbol
-			Bits >>= pNode->m_NumBits;
-			Bitcount -= pNode->m_NumBits;
+			Bits |= ReadBits(pSrc) << Bitcount;
+			pSrc += (63 - Bitcount) / 8;
+			Bitcount |= 56;
 		}
 		else
 		{
-			// remove the bits that the lut checked up for us
-			Bits >>= HUFFMAN_LUTBITS;
-			Bitcount -= HUFFMAN_LUTBITS;
+			while(Bitcount <= 56 && pSrc != pSrcEnd)
+			{
+				Bits |= (uint64_t)*pSrc++ << Bitcount;
+				Bitcount += 8;
+			}
+		}
 
-			// walk the tree bit by bit
-			while(true)
+		if(pSrc == pSrcEnd && Bitcount < HUFFMAN_MAX_CODE_BITS)
+		{
+			// only zeros left, they repeat the same symbol
+			if(Bitcount <= 0)
+				return m_ZerosDecodeEof ? (int)(pDst - (const unsigned char *)pOutput) : -1;
+
+			// decode the end of the input code by code
+			const CNode *pNode = m_pStartNode;
+			int NumBits = 0;
+			while(!pNode->m_NumBits)
 			{
-				// traverse tree
-				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+				pNode = &m_aNodes[pNode->m_aLeafs[(Bits >> NumBits) & 1]];
+				NumBits++;
+			}
+			if(Bitcount > HUFFMAN_LEGACY_LUTBITS && Bitcount < NumBits)
+				return -1;
+			Bits >>= NumBits;
+			Bitcount -= NumBits;
 
-				// remove bit
-				Bitcount--;
-				Bits >>= 1;
+			if(pNode == pEof)
+				break;
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
+			continue;
+		}
 
-				// check if we hit a symbol
-				if(pNode->m_NumBits)
-					break;
+		// the buffered bits hold any code
+		while(Bitcount >= HUFFMAN_MAX_CODE_BITS)
+		{
+			const CDecodeEntry &Entry = m_aDecodeLut[Bits & HUFFMAN_LUTMASK];
+			if(Entry.m_NumSymbols)
+			{
+				if(pDstEnd - pDst >= HUFFMAN_LUTSYMBOLS)
+				{
+					mem_copy(pDst, Entry.m_aSymbols, HUFFMAN_LUTSYMBOLS);
+					pDst += Entry.m_NumSymbols;
+				}
+				else
+				{
+					for(int i = 0; i < Entry.m_NumSymbols; i++)
+					{
+						if(pDst == pDstEnd)
+							return -1;
+						*pDst++ = Entry.m_aSymbols[i];
+					}
+				}
+				Bits >>= Entry.m_NumBits;
+				Bitcount -= Entry.m_NumBits;
+				continue;
+			}
 
-				// no more bits, decoding error
-				if(Bitcount == 0)
-					return -1;
+			// walk the tree bit by bit for a long code
+			const CNode *pNode = &m_aNodes[Entry.m_Node];
+			int NumBits = Entry.m_NumBits;
+			while(!pNode->m_NumBits)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[(Bits >> NumBits) & 1]];
+				NumBits++;
 			}
-		}
+			Bits >>= NumBits;
+			Bitcount -= NumBits;
 
-		// check for eof
-		if(pNode == pEof)
-			break;
+			// check for eof
+			if(pNode == pEof)
+				return (int)(pDst - (const unsigned char *)pOutput);
 
-		// output character
-		if(pDst == pDstEnd)
-			return -1;
-		*pDst++ = pNode->m_Symbol;
+			// output character
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
+		}
 	}
 
 	// return the size of the decompressed buffer
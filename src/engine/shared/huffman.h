@@ -12,9 +12,17 @@ class CHuffman
 		HUFFMAN_MAX_SYMBOLS = HUFFMAN_EOF_SYMBOL + 1,
 		HUFFMAN_MAX_NODES = HUFFMAN_MAX_SYMBOLS * 2 - 1,
 
-		HUFFMAN_LUTBITS = 10,
+		// longer codes don't fit into the bit buffers
+		HUFFMAN_MAX_CODE_BITS = 24,
+
+		HUFFMAN_LUTBITS = 12,
 		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1),
+		HUFFMAN_LUTSYMBOLS = 8,
+
+		// earlier decoders resolved this many bits at once and failed if
+		// the input ended within a longer code
+		HUFFMAN_LEGACY_LUTBITS = 10,
 	};
 
 	struct CNode
@@ -30,17 +38,30 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
-	static const unsigned ms_aFreqTable[HUFFMAN_MAX_SYMBOLS];
+	// the symbols of all codes that fit into the lookup bits, or the node
+	// of the first code if it doesn't fit or is the EOF symbol
+	struct CDecodeEntry
+	{
+		unsigned char m_aSymbols[HUFFMAN_LUTSYMBOLS];
+		unsigned char m_NumSymbols;
+		unsigned char m_NumBits;
+		unsigned short m_Node;
+	};
 
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
-	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CDecodeEntry m_aDecodeLut[HUFFMAN_LUTSIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
+	// missing input bits are decoded as zeros
+	bool m_ZerosDecodeEof;
 
 	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
 	void ConstructTree(const unsigned *pFrequencies);
 
 public:
+	// the byte frequencies of the network traffic
+	static const unsigned ms_aFreqTable[HUFFMAN_MAX_SYMBOLS];
+
 	/*
 		Function: Init
 			Inits the compressor/decompressor.
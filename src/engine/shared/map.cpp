@@ -1,9 +1,12 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include "map.h"
+#include "map_cache.h"
 
 #include <base/log.h>
+#include <base/system.h>
 
+#include <engine/engine.h>
 #include <engine/storage.h>
 
 #include <game/mapitems.h>
@@ -40,6 +43,11 @@ int CMap::NumData() const
 	return m_DataFile.NumData();
 }
 
+void CMap::PreloadData(const std::vector<int> &vIndices)
+{
+	m_DataFile.PreloadData(Kernel()->RequestInterface<IEngine>(), vIndices);
+}
+
 int CMap::GetItemSize(int Index)
 {
 	return m_DataFile.GetItemSize(Index);
@@ -79,7 +87,7 @@ bool CMap::Load(const char *pMapName)
 	// Ensure current datafile is not left in an inconsistent state if loading fails,
 	// by loading the new datafile separately first.
 	CDataFileReader NewDataFile;
-	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL))
+	if(!NewDataFile.Open(pStorage, pMapName, IStorage::TYPE_ALL, true))
 		return false;
 
 	// Check version
@@ -91,10 +99,52 @@ bool CMap::Load(const char *pMapName)
 		return false;
 	}
 
-	// Replace compressed tile layers with uncompressed ones
+	// The data of another process which loaded the same map before is
+	// already decompressed and extracted
+	char aCacheFilename[IO_MAX_PATH_LENGTH] = "";
+	if(m_aCacheDirectory[0] != '\0')
+	{
+		CMapCacheFile::Path(aCacheFilename, sizeof(aCacheFilename), m_aCacheDirectory, NewDataFile.Sha256(), "mapdata");
+		if(fs_is_file(aCacheFilename) && NewDataFile.LoadCachedData(aCacheFilename))
+		{
+			NewDataFile.ReleaseMapping();
+			m_DataFile.Close();
+			m_DataFile = std::move(NewDataFile);
+			return true;
+		}
+	}
+
+	// Decompress all tile data at once, it is needed right away by the tile
+	// extraction below and by the collision
 	int GroupsStart, GroupsNum, LayersStart, LayersNum;
 	NewDataFile.GetType(MAPITEMTYPE_GROUP, &GroupsStart, &GroupsNum);
 	NewDataFile.GetType(MAPITEMTYPE_LAYER, &LayersStart, &LayersNum);
+	std::vector<int> vTileData;
+	for(int l = 0; l < LayersNum; l++)
+	{
+		const CMapItemLayer *pLayer = static_cast<CMapItemLayer *>(NewDataFile.GetItem(LayersStart + l));
+		if(pLayer->m_Type != LAYERTYPE_TILES)
+			continue;
+		const CMapItemLayerTilemap *pTilemap = reinterpret_cast<const CMapItemLayerTilemap *>(pLayer);
+		vTileData.push_back(pTilemap->m_Data);
+		// older versions store the game layer data elsewhere, they are rare enough to be loaded on demand
+		if(pTilemap->m_Version > 2 && NewDataFile.GetItemSize(LayersStart + l) >= (int)sizeof(CMapItemLayerTilemap))
+		{
+			if(pTilemap->m_Flags & TILESLAYERFLAG_TELE)
+				vTileData.push_back(pTilemap->m_Tele);
+			if(pTilemap->m_Flags & TILESLAYERFLAG_SPEEDUP)
+				vTileData.push_back(pTilemap->m_Speedup);
+			if(pTilemap->m_Flags & TILESLAYERFLAG_FRONT)
+				vTileData.push_back(pTilemap->m_Front);
+			if(pTilemap->m_Flags & TILESLAYERFLAG_SWITCH)
+				vTileData.push_back(pTilemap->m_Switch);
+			if(pTilemap->m_Flags & TILESLAYERFLAG_TUNE)
+				vTileData.push_back(pTilemap->m_Tune);
+		}
+	}
+	NewDataFile.PreloadData(Kernel()->RequestInterface<IEngine>(), vTileData);
+
+	// Replace compressed tile layers with uncompressed ones
 	for(int g = 0; g < GroupsNum; g++)
 	{
 		const CMapItemGroup *pGroup = static_cast<CMapItemGroup *>(NewDataFile.GetItem(GroupsStart + g));
@@ -124,12 +174,24 @@ bool CMap::Load(const char *pMapName)
 		}
 	}
 
+	if(aCacheFilename[0] != '\0')
+		NewDataFile.SaveLoadedData(aCacheFilename);
+
+	// The map file can be overwritten while it is loaded, the data that is
+	// loaded later is read from it without the mapping
+	NewDataFile.ReleaseMapping();
+
 	// Replace existing datafile with new datafile
 	m_DataFile.Close();
 	m_DataFile = std::move(NewDataFile);
 	return true;
 }
 
+void CMap::SetCacheDirectory(const char *pDirectory)
+{
+	str_copy(m_aCacheDirectory, pDirectory);
+}
+
 void CMap::Unload()
 {
 	m_DataFile.Close();
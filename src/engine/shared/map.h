@@ -11,6 +11,7 @@
 class CMap : public IEngineMap
 {
 	CDataFileReader m_DataFile;
+	char m_aCacheDirectory[IO_MAX_PATH_LENGTH] = "";
 
 public:
 	CMap();
@@ -23,6 +24,7 @@ public:
 	const char *GetDataString(int Index) override;
 	void UnloadData(int Index) override;
 	int NumData() const override;
+	void PreloadData(const std::vector<int> &vIndices) override;
 
 	int GetItemSize(int Index) override;
 	void *GetItem(int Index, int *pType = nullptr, int *pId = nullptr) override;
@@ -32,6 +34,7 @@ public:
 	int NumItems() const override;
 
 	bool Load(const char *pMapName) override;
+	void SetCacheDirectory(const char *pDirectory) override;
 	void Unload() override;
 	bool IsLoaded() const override;
 	IOHANDLE File() const override;
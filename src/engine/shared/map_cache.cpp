@@ -0,0 +1,134 @@
+#include "map_cache.h"
+
+#include <base/log.h>
+#include <base/system.h>
+
+CMapCacheFile::~CMapCacheFile()
+{
+	if(m_File)
+	{
+		io_close(m_File);
+		fs_remove(m_aTempPath);
+	}
+}
+
+void CMapCacheFile::Path(char *pBuffer, int BufferSize, const char *pDirectory, const SHA256_DIGEST &Sha256, const char *pExtension)
+{
+	char aSha256[SHA256_MAXSTRSIZE];
+	sha256_str(Sha256, aSha256, sizeof(aSha256));
+	str_format(pBuffer, BufferSize, "%s/%s.%s", pDirectory, aSha256, pExtension);
+}
+
+bool CMapCacheFile::Map(const char *pPath, void **ppData, unsigned *pSize)
+{
+	IOHANDLE File = io_open(pPath, IOFLAG_READ);
+	if(!File)
+		return false;
+	// the mapping stays valid after the file is closed
+	const bool Result = io_map(File, ppData, pSize);
+	io_close(File);
+	// the age of a cache file counts from its last use
+	if(Result && fs_file_touch(pPath) != 0)
+		log_warn("map_cache", "failed to update the modification time of '%s'", pPath);
+	return Result;
+}
+
+// <sha256>.<extension> as written by Finish, or <that>.<pid>.tmp as
+// written by Begin
+static bool IsCacheFileName(const char *pName)
+{
+	for(int i = 0; i < SHA256_DIGEST_LENGTH * 2; i++)
+	{
+		if(!((pName[i] >= '0' && pName[i] <= '9') || (pName[i] >= 'a' && pName[i] <= 'f')))
+			return false;
+	}
+	const char *pRest = pName + SHA256_DIGEST_LENGTH * 2;
+	const char *pTemp = nullptr;
+	for(const char *pExtension : {".map", ".map7", ".mapdata"})
+	{
+		if(str_comp(pRest, pExtension) == 0)
+			return true;
+		if(str_startswith(pRest, pExtension) && pRest[str_length(pExtension)] == '.')
+			pTemp = pRest + str_length(pExtension) + 1;
+	}
+	if(!pTemp || !str_isnum(*pTemp))
+		return false;
+	while(str_isnum(*pTemp))
+		pTemp++;
+	return str_comp(pTemp, ".tmp") == 0;
+}
+
+struct CRemoveOldData
+{
+	const char *m_pDirectory;
+	time_t m_Before;
+};
+
+static int RemoveOldCallback(const CFsFileInfo *pInfo, int IsDir, int DirType, void *pUser)
+{
+	const CRemoveOldData *pData = static_cast<const CRemoveOldData *>(pUser);
+	if(IsDir || pInfo->m_TimeModified >= pData->m_Before)
+		return 0;
+	// leave files alone that weren't written by the cache
+	if(!IsCacheFileName(pInfo->m_pName))
+		return 0;
+
+	char aPath[IO_MAX_PATH_LENGTH];
+	str_format(aPath, sizeof(aPath), "%s/%s", pData->m_pDirectory, pInfo->m_pName);
+	if(fs_remove(aPath) != 0)
+		log_error("map_cache", "failed to remove '%s'", aPath);
+	else
+		log_info("map_cache", "removed '%s'", aPath);
+	return 0;
+}
+
+void CMapCacheFile::RemoveOld(const char *pDirectory, time_t Before)
+{
+	CRemoveOldData Data = {pDirectory, Before};
+	fs_listdir_fileinfo(pDirectory, RemoveOldCallback, 0, &Data);
+}
+
+bool CMapCacheFile::Begin(const char *pPath)
+{
+	dbg_assert(!m_File, "cache file already open");
+	str_copy(m_aPath, pPath);
+	// processes that write the same file at once must not write into the same temporary file
+	str_format(m_aTempPath, sizeof(m_aTempPath), "%s.%d.tmp", pPath, pid());
+	if(fs_makedir_rec_for(m_aTempPath) < 0)
+	{
+		log_error("map_cache", "failed to create the directory for '%s'", m_aTempPath);
+		return false;
+	}
+	m_File = io_open(m_aTempPath, IOFLAG_WRITE);
+	if(!m_File)
+	{
+		log_error("map_cache", "failed to open '%s' for writing", m_aTempPath);
+		return false;
+	}
+	m_Error = false;
+	return true;
+}
+
+bool CMapCacheFile::Write(const void *pData, unsigned Size)
+{
+	dbg_assert(m_File, "cache file not open");
+	if(!m_Error && io_write(m_File, pData, Size) != Size)
+		m_Error = true;
+	return !m_Error;
+}
+
+bool CMapCacheFile::Finish()
+{
+	dbg_assert(m_File, "cache file not open");
+	if(io_close(m_File) != 0)
+		m_Error = true;
+	m_File = nullptr;
+	// the file appears at once, another process never maps a partial file
+	if(m_Error || fs_rename(m_aTempPath, m_aPath) != 0)
+	{
+		log_error("map_cache", "failed to write '%s'", m_aPath);
+		fs_remove(m_aTempPath);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,37 @@
+#ifndef ENGINE_SHARED_MAP_CACHE_H
+#define ENGINE_SHARED_MAP_CACHE_H
+
+#include <base/hash.h>
+#include <base/system.h>
+
+// Files in a directory shared by the processes of one host, named after the
+// hash of the map they belong to. They are written once through a temporary
+// file and only mapped after that, so all processes which load the same map
+// use the same memory.
+class CMapCacheFile
+{
+	IOHANDLE m_File = nullptr;
+	bool m_Error = false;
+	char m_aPath[IO_MAX_PATH_LENGTH];
+	char m_aTempPath[IO_MAX_PATH_LENGTH];
+
+public:
+	~CMapCacheFile();
+
+	static void Path(char *pBuffer, int BufferSize, const char *pDirectory, const SHA256_DIGEST &Sha256, const char *pExtension);
+	// the mapping must be released with io_unmap. Updates the modification
+	// time of the file, so it counts as used.
+	static bool Map(const char *pPath, void **ppData, unsigned *pSize);
+	// removes the cache files in pDirectory that were last used before
+	// Before (seconds since the UNIX epoch). Only files named like the ones
+	// the cache writes are removed. Processes that still map a removed file
+	// keep their mapping, the next one writes the file again.
+	static void RemoveOld(const char *pDirectory, time_t Before);
+
+	bool Begin(const char *pPath);
+	bool Write(const void *pData, unsigned Size);
+	// moves the file into place, removes it instead if a write failed
+	bool Finish();
+};
+
+#endif
@@ -456,8 +456,15 @@ public:
 	//
 	int Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken);
 	int Send(CNetChunk *pChunk);
+	// queues one chunk for several clients and flushes them after all chunks are queued,
+	// the clients with pSixup set get the data of pChunkSixup
+	int SendToClients(const CNetChunk *pChunk, const CNetChunk *pChunkSixup, const int *pClientIds, const bool *pSixup, int NumClientIds);
 	int Update();
 
+	// collect outgoing packets and send them together, returns the number of syscalls saved
+	void BeginBatch() { net_udp_batch_begin(m_Socket); }
+	int FlushBatch() { return net_udp_batch_flush(m_Socket); }
+
 	//
 	int Drop(int ClientId, const char *pReason);
 
@@ -1,6 +1,7 @@
 /* (c) Magnus Auvinen. See licence.txt in the root of the distribution for more information. */
 /* If you are missing that file, acquire a complete release at teeworlds.com.                */
 #include <base/hash_ctxt.h>
+#include <base/math.h>
 #include <base/system.h>
 
 #include "config.h"
@@ -751,6 +752,46 @@ int CNetServer::Send(CNetChunk *pChunk)
 	return 0;
 }
 
+int CNetServer::SendToClients(const CNetChunk *pChunk, const CNetChunk *pChunkSixup, const int *pClientIds, const bool *pSixup, int NumClientIds)
+{
+	dbg_assert(!(pChunk->m_Flags & NETSENDFLAG_CONNLESS), "connless chunks can't be sent to clients");
+
+	// a payload that is too big only drops the packet for the clients of its protocol
+	const bool TooBig = pChunk->m_DataSize >= NET_MAX_PAYLOAD;
+	const bool TooBigSixup = pChunkSixup->m_DataSize >= NET_MAX_PAYLOAD;
+	if(TooBig)
+		dbg_msg("netserver", "packet payload too big. %d. dropping packet", pChunk->m_DataSize);
+	if(TooBigSixup)
+		dbg_msg("netserver", "0.7 packet payload too big. %d. dropping packet", pChunkSixup->m_DataSize);
+
+	int Flags = 0;
+	if(pChunk->m_Flags & NETSENDFLAG_VITAL)
+		Flags = NET_CHUNKFLAG_VITAL;
+
+	bool aQueued[NET_MAX_CLIENTS];
+	for(int i = 0; i < NumClientIds; i++)
+	{
+		const int ClientId = pClientIds[i];
+		dbg_assert(ClientId >= 0 && ClientId < MaxClients(), "erroneous client id");
+		aQueued[i] = false;
+		if(pSixup[i] ? TooBigSixup : TooBig)
+			continue;
+		const CNetChunk *pClientChunk = pSixup[i] ? pChunkSixup : pChunk;
+		aQueued[i] = m_aSlots[ClientId].m_Connection.QueueChunk(Flags, pClientChunk->m_DataSize, pClientChunk->m_pData) == 0;
+	}
+
+	// send the packets of all clients in one go, so they can be batched
+	if(pChunk->m_Flags & NETSENDFLAG_FLUSH)
+	{
+		for(int i = 0; i < NumClientIds; i++)
+		{
+			if(aQueued[i])
+				m_aSlots[pClientIds[i]].m_Connection.Flush();
+		}
+	}
+	return TooBig || TooBigSixup ? -1 : 0;
+}
+
 void CNetServer::SendTokenSixup(NETADDR &Addr, SECURITY_TOKEN Token)
 {
 	SECURITY_TOKEN MyToken = GetToken(Addr);
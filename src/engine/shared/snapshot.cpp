@@ -13,8 +13,25 @@
 #include <game/generated/protocol7.h>
 #include <game/generated/protocolglue.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SNAPSHOT_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SNAPSHOT_NEON
+#include <arm_neon.h>
+#endif
+
 // CSnapshot
 
+static int LookupItemTypeUuid(const CSnapshotItem *pTypeItem)
+{
+	CUuid Uuid;
+	for(size_t i = 0; i < sizeof(CUuid) / sizeof(int32_t); i++)
+		uint_to_bytes_be(&Uuid.m_aData[i * sizeof(int32_t)], pTypeItem->Data()[i]);
+
+	return g_UuidManager.LookupUuid(Uuid);
+}
+
 const CSnapshotItem *CSnapshot::GetItem(int Index) const
 {
 	return (const CSnapshotItem *)(DataStart() + Offsets()[Index]);
@@ -47,17 +64,12 @@ int CSnapshot::GetExternalItemType(int InternalType) const
 	{
 		return InternalType;
 	}
-	const CSnapshotItem *pTypeItem = GetItem(TypeItemIndex);
-	CUuid Uuid;
-	for(size_t i = 0; i < sizeof(CUuid) / sizeof(int32_t); i++)
-		uint_to_bytes_be(&Uuid.m_aData[i * sizeof(int32_t)], pTypeItem->Data()[i]);
-
-	return g_UuidManager.LookupUuid(Uuid);
+	return LookupItemTypeUuid(GetItem(TypeItemIndex));
 }
 
 int CSnapshot::GetItemIndex(int Key) const
 {
-	// TODO: OPT: this should not be a linear search. very bad
+	// use CSnapshotItemIndex for repeated lookups
 	for(int i = 0; i < m_NumItems; i++)
 	{
 		if(GetItem(i)->Key() == Key)
@@ -159,6 +171,120 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 	return true;
 }
 
+// CSnapshotItemIndex
+
+void CSnapshotItemIndex::Build(const CSnapshot *pSnapshot)
+{
+	m_pSnapshot = pSnapshot;
+	m_NumExtendedTypes = 0;
+	m_ExtendedTypesOverflow = false;
+	for(short &Index : m_aIndices)
+		Index = -1;
+
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pSnapshot->GetItem(i);
+		const int Key = pItem->Key();
+
+		// linear probing, the first item with a key wins like in CSnapshot::GetItemIndex
+		unsigned Slot = HashKey(Key);
+		bool Duplicate = false;
+		while(m_aIndices[Slot] != -1)
+		{
+			if(m_aKeys[Slot] == Key)
+			{
+				Duplicate = true;
+				break;
+			}
+			Slot = (Slot + 1) % HASH_SIZE;
+		}
+		if(Duplicate)
+			continue;
+		m_aKeys[Slot] = Key;
+		m_aIndices[Slot] = i;
+
+		if(pItem->Type() != 0 || pItem->Id() < CSnapshot::OFFSET_UUID_TYPE) // NETOBJTYPE_EX
+			continue;
+		if(pSnapshot->GetItemSize(i) < (int)sizeof(CUuid))
+			continue;
+		const int ExternalType = LookupItemTypeUuid(pItem);
+		bool Known = false;
+		for(int Type = 0; Type < m_NumExtendedTypes; Type++)
+			Known |= m_aExtendedExternalTypes[Type] == ExternalType;
+		if(Known)
+			continue;
+		if(m_NumExtendedTypes == MAX_EXTENDED_TYPES)
+		{
+			m_ExtendedTypesOverflow = true;
+			continue;
+		}
+		m_aExtendedExternalTypes[m_NumExtendedTypes] = ExternalType;
+		m_aExtendedInternalTypes[m_NumExtendedTypes] = pItem->Id();
+		m_NumExtendedTypes++;
+	}
+}
+
+int CSnapshotItemIndex::GetItemIndex(int Key) const
+{
+	unsigned Slot = HashKey(Key);
+	while(m_aIndices[Slot] != -1)
+	{
+		if(m_aKeys[Slot] == Key)
+			return m_aIndices[Slot];
+		Slot = (Slot + 1) % HASH_SIZE;
+	}
+	return -1;
+}
+
+int CSnapshotItemIndex::GetItemType(int Index) const
+{
+	return GetExternalItemType(m_pSnapshot->GetItem(Index)->Type());
+}
+
+int CSnapshotItemIndex::GetExternalItemType(int InternalType) const
+{
+	if(InternalType < CSnapshot::OFFSET_UUID_TYPE)
+		return InternalType;
+
+	if(!m_ExtendedTypesOverflow)
+	{
+		for(int Type = 0; Type < m_NumExtendedTypes; Type++)
+		{
+			if(m_aExtendedInternalTypes[Type] == InternalType)
+				return m_aExtendedExternalTypes[Type];
+		}
+	}
+
+	const int TypeItemIndex = GetItemIndex(InternalType); // NETOBJTYPE_EX
+	if(TypeItemIndex == -1 || m_pSnapshot->GetItemSize(TypeItemIndex) < (int)sizeof(CUuid))
+		return InternalType;
+	return LookupItemTypeUuid(m_pSnapshot->GetItem(TypeItemIndex));
+}
+
+const void *CSnapshotItemIndex::FindItem(int Type, int Id) const
+{
+	int InternalType = Type;
+	if(Type >= OFFSET_UUID)
+	{
+		if(m_ExtendedTypesOverflow)
+			return m_pSnapshot->FindItem(Type, Id);
+
+		InternalType = -1;
+		for(int i = 0; i < m_NumExtendedTypes; i++)
+		{
+			if(m_aExtendedExternalTypes[i] == Type)
+			{
+				InternalType = m_aExtendedInternalTypes[i];
+				break;
+			}
+		}
+		if(InternalType == -1)
+			return nullptr;
+	}
+	const int Index = GetItemIndex((InternalType << 16) | Id);
+	return Index < 0 ? nullptr : m_pSnapshot->GetItem(Index)->Data();
+}
+
 // CSnapshotDelta
 
 enum
@@ -216,6 +342,34 @@ static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
 int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
+#if defined(SNAPSHOT_SSE2)
+	__m128i NeededVec = _mm_setzero_si128();
+	for(; Size >= 4; Size -= 4)
+	{
+		const __m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)pCurrent), _mm_loadu_si128((const __m128i *)pPast));
+		_mm_storeu_si128((__m128i *)pOut, Diff);
+		NeededVec = _mm_or_si128(NeededVec, Diff);
+		pOut += 4;
+		pPast += 4;
+		pCurrent += 4;
+	}
+	NeededVec = _mm_or_si128(NeededVec, _mm_srli_si128(NeededVec, 8));
+	NeededVec = _mm_or_si128(NeededVec, _mm_srli_si128(NeededVec, 4));
+	Needed = _mm_cvtsi128_si32(NeededVec);
+#elif defined(SNAPSHOT_NEON)
+	uint32x4_t NeededVec = vdupq_n_u32(0);
+	for(; Size >= 4; Size -= 4)
+	{
+		const uint32x4_t Diff = vsubq_u32(vld1q_u32((const uint32_t *)pCurrent), vld1q_u32((const uint32_t *)pPast));
+		vst1q_u32((uint32_t *)pOut, Diff);
+		NeededVec = vorrq_u32(NeededVec, Diff);
+		pOut += 4;
+		pPast += 4;
+		pCurrent += 4;
+	}
+	const uint32x2_t NeededHalf = vorr_u32(vget_low_u32(NeededVec), vget_high_u32(NeededVec));
+	Needed = vget_lane_u32(vorr_u32(NeededHalf, vrev64_u32(NeededHalf)), 0);
+#endif
 	while(Size)
 	{
 		// subtraction with wrapping by casting to unsigned
@@ -232,6 +386,57 @@ int CSnapshotDelta::DiffItem(const int *pPast, const int *pCurrent, int *pOut, i
 
 void CSnapshotDelta::UndiffItem(const int *pPast, const int *pDiff, int *pOut, int Size, uint64_t *pDataRate)
 {
+	// the data rate counts one bit for unchanged ints and the bits of the packed diff otherwise
+#if defined(SNAPSHOT_SSE2)
+	__m128i DataRateVec = _mm_setzero_si128();
+	for(; Size >= 4; Size -= 4)
+	{
+		const __m128i Diff = _mm_loadu_si128((const __m128i *)pDiff);
+		_mm_storeu_si128((__m128i *)pOut, _mm_add_epi32(_mm_loadu_si128((const __m128i *)pPast), Diff));
+
+		// the number of packed bytes is one plus the number of size limits the magnitude exceeds
+		const __m128i Magnitude = _mm_xor_si128(Diff, _mm_srai_epi32(Diff, 31));
+		__m128i NumBytes = _mm_set1_epi32(1);
+		NumBytes = _mm_sub_epi32(NumBytes, _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32((1 << 6) - 1)));
+		NumBytes = _mm_sub_epi32(NumBytes, _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32((1 << 13) - 1)));
+		NumBytes = _mm_sub_epi32(NumBytes, _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32((1 << 20) - 1)));
+		NumBytes = _mm_sub_epi32(NumBytes, _mm_cmpgt_epi32(Magnitude, _mm_set1_epi32((1 << 27) - 1)));
+		const __m128i Unchanged = _mm_cmpeq_epi32(Diff, _mm_setzero_si128());
+		const __m128i Bits = _mm_or_si128(_mm_andnot_si128(Unchanged, _mm_slli_epi32(NumBytes, 3)), _mm_and_si128(Unchanged, _mm_set1_epi32(1)));
+		DataRateVec = _mm_add_epi32(DataRateVec, Bits);
+
+		pOut += 4;
+		pPast += 4;
+		pDiff += 4;
+	}
+	// at most 40 bits per int, the sum does not overflow for items of any size
+	DataRateVec = _mm_add_epi32(DataRateVec, _mm_srli_si128(DataRateVec, 8));
+	DataRateVec = _mm_add_epi32(DataRateVec, _mm_srli_si128(DataRateVec, 4));
+	*pDataRate += (unsigned)_mm_cvtsi128_si32(DataRateVec);
+#elif defined(SNAPSHOT_NEON)
+	uint32x4_t DataRateVec = vdupq_n_u32(0);
+	for(; Size >= 4; Size -= 4)
+	{
+		const int32x4_t Diff = vld1q_s32(pDiff);
+		vst1q_s32(pOut, vreinterpretq_s32_u32(vaddq_u32(vld1q_u32((const uint32_t *)pPast), vreinterpretq_u32_s32(Diff))));
+
+		// the number of packed bytes is one plus the number of size limits the magnitude exceeds
+		const int32x4_t Magnitude = veorq_s32(Diff, vshrq_n_s32(Diff, 31));
+		uint32x4_t NumBytes = vdupq_n_u32(1);
+		NumBytes = vsubq_u32(NumBytes, vcgtq_s32(Magnitude, vdupq_n_s32((1 << 6) - 1)));
+		NumBytes = vsubq_u32(NumBytes, vcgtq_s32(Magnitude, vdupq_n_s32((1 << 13) - 1)));
+		NumBytes = vsubq_u32(NumBytes, vcgtq_s32(Magnitude, vdupq_n_s32((1 << 20) - 1)));
+		NumBytes = vsubq_u32(NumBytes, vcgtq_s32(Magnitude, vdupq_n_s32((1 << 27) - 1)));
+		const uint32x4_t Unchanged = vceqzq_s32(Diff);
+		DataRateVec = vaddq_u32(DataRateVec, vbslq_u32(Unchanged, vdupq_n_u32(1), vshlq_n_u32(NumBytes, 3)));
+
+		pOut += 4;
+		pPast += 4;
+		pDiff += 4;
+	}
+	// at most 40 bits per int, the sum does not overflow for items of any size
+	*pDataRate += vaddvq_u32(DataRateVec);
+#endif
 	while(Size)
 	{
 		// addition with wrapping by casting to unsigned
@@ -515,6 +720,9 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 	CSnapshotBuilder Builder;
 	Builder.Init();
 
+	CSnapshotItemIndex FromIndex;
+	FromIndex.Build(pFrom);
+
 	// unpack deleted stuff
 	int *pDeleted = pData;
 	if(pDelta->m_NumDeletedItems < 0)
@@ -589,11 +797,11 @@ int CSnapshotDelta::UnpackDelta(const CSnapshot *pFrom, CSnapshot *pTo, const vo
 		if(!pNewData)
 			return -302;
 
-		const int FromIndex = pFrom->GetItemIndex(Key);
-		if(FromIndex != -1)
+		const int FromItemIndex = FromIndex.GetItemIndex(Key);
+		if(FromItemIndex != -1)
 		{
 			// we got an update so we need to apply the diff
-			UndiffItem(pFrom->GetItem(FromIndex)->Data(), pData, pNewData, ItemSize / sizeof(int32_t), &m_aSnapshotDataRate[Type]);
+			UndiffItem(pFrom->GetItem(FromItemIndex)->Data(), pData, pNewData, ItemSize / sizeof(int32_t), &m_aSnapshotDataRate[Type]);
 		}
 		else // no previous, just copy the pData
 		{
@@ -624,6 +832,7 @@ void CSnapshotStorage::PurgeAll()
 		CHolder *pNext = m_pFirst->m_pNext;
 		free(m_pFirst->m_pSnap);
 		free(m_pFirst->m_pAltSnap);
+		delete m_pFirst->m_pAltIndex;
 		free(m_pFirst);
 		m_pFirst = pNext;
 	}
@@ -641,6 +850,7 @@ void CSnapshotStorage::PurgeUntil(int Tick)
 			return; // no more to remove
 		free(pHolder->m_pSnap);
 		free(pHolder->m_pAltSnap);
+		delete pHolder->m_pAltIndex;
 		free(pHolder);
 
 		// did we come to the end of the list?
@@ -675,11 +885,14 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, size_t DataSize, const voi
 		pHolder->m_pAltSnap = static_cast<CSnapshot *>(malloc(AltDataSize));
 		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
 		pHolder->m_AltSnapSize = AltDataSize;
+		pHolder->m_pAltIndex = new CSnapshotItemIndex();
+		pHolder->m_pAltIndex->Build(pHolder->m_pAltSnap);
 	}
 	else
 	{
 		pHolder->m_pAltSnap = nullptr;
 		pHolder->m_AltSnapSize = 0;
+		pHolder->m_pAltIndex = nullptr;
 	}
 
 	// link
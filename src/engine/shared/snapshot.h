@@ -68,6 +68,43 @@ public:
 	static const CSnapshot *EmptySnapshot() { return &ms_EmptySnapshot; }
 };
 
+// CSnapshotItemIndex
+
+// Hashed key to index lookup for the items of one snapshot, built once and
+// then reused instead of scanning the snapshot for every lookup. Also caches
+// the mapping between internal and external (UUID) item types.
+// Must be rebuilt whenever the item keys of the snapshot change.
+class CSnapshotItemIndex
+{
+	enum
+	{
+		HASH_SIZE = 2 * CSnapshot::MAX_ITEMS,
+		MAX_EXTENDED_TYPES = 64,
+	};
+
+	const CSnapshot *m_pSnapshot = nullptr;
+
+	int m_aKeys[HASH_SIZE];
+	short m_aIndices[HASH_SIZE];
+
+	// external type and internal type of each NETOBJTYPE_EX item
+	int m_aExtendedExternalTypes[MAX_EXTENDED_TYPES];
+	int m_aExtendedInternalTypes[MAX_EXTENDED_TYPES];
+	int m_NumExtendedTypes = 0;
+	bool m_ExtendedTypesOverflow = false;
+
+	static unsigned HashKey(int Key) { return (((unsigned)Key * 2654435761u) >> 16) % HASH_SIZE; }
+
+public:
+	void Build(const CSnapshot *pSnapshot);
+	const CSnapshot *Snapshot() const { return m_pSnapshot; }
+
+	int GetItemIndex(int Key) const;
+	int GetItemType(int Index) const;
+	int GetExternalItemType(int InternalType) const;
+	const void *FindItem(int Type, int Id) const;
+};
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -128,6 +165,9 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+
+		// only built if an alternative snapshot is stored
+		CSnapshotItemIndex *m_pAltIndex;
 	};
 
 	CHolder *m_pFirst;
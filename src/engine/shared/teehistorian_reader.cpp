@@ -0,0 +1,295 @@
+#include "teehistorian_reader.h"
+
+#include <engine/shared/compression.h>
+#include <engine/shared/json.h>
+#include <engine/shared/teehistorian_ex.h>
+
+#include <cstring>
+
+#include <zlib.h>
+
+static const CUuid TEEHISTORIAN_UUID = CalculateUuid("teehistorian@ddnet.tw");
+
+static bool Gunzip(const std::vector<unsigned char> &vCompressed, std::vector<unsigned char> &vOut)
+{
+	z_stream Stream = {};
+	// 16 expects the gzip header instead of the zlib one
+	if(inflateInit2(&Stream, 15 + 16) != Z_OK)
+		return false;
+	Stream.next_in = (Bytef *)vCompressed.data();
+	Stream.avail_in = vCompressed.size();
+	int Result;
+	do
+	{
+		const size_t OldSize = vOut.size();
+		vOut.resize(OldSize + 256 * 1024);
+		Stream.next_out = vOut.data() + OldSize;
+		Stream.avail_out = vOut.size() - OldSize;
+		Result = inflate(&Stream, Z_NO_FLUSH);
+		vOut.resize(vOut.size() - Stream.avail_out);
+	} while(Result == Z_OK);
+	inflateEnd(&Stream);
+	return Result == Z_STREAM_END;
+}
+
+CTeeHistorianReader::CTeeHistorianReader()
+{
+	mem_zero(m_aPlayers, sizeof(m_aPlayers));
+}
+
+CTeeHistorianReader::~CTeeHistorianReader()
+{
+	if(m_pHeader)
+		json_value_free(m_pHeader);
+}
+
+bool CTeeHistorianReader::Load(std::vector<unsigned char> &&vData, char *pError, int ErrorSize)
+{
+	if(vData.size() >= 2 && vData[0] == 0x1f && vData[1] == 0x8b)
+	{
+		if(!Gunzip(vData, m_vData))
+		{
+			str_copy(pError, "failed to decompress gzip stream", ErrorSize);
+			return false;
+		}
+	}
+	else
+	{
+		m_vData = std::move(vData);
+	}
+
+	if(m_vData.size() < sizeof(CUuid) || mem_comp(m_vData.data(), &TEEHISTORIAN_UUID, sizeof(CUuid)) != 0)
+	{
+		str_copy(pError, "not a teehistorian file", ErrorSize);
+		return false;
+	}
+	const unsigned char *pJson = m_vData.data() + sizeof(CUuid);
+	const unsigned char *pJsonEnd = (const unsigned char *)std::memchr(pJson, 0, m_vData.size() - sizeof(CUuid));
+	if(!pJsonEnd)
+	{
+		str_copy(pError, "unterminated header", ErrorSize);
+		return false;
+	}
+	m_pHeader = json_parse((const char *)pJson, pJsonEnd - pJson);
+	if(!m_pHeader || m_pHeader->type != json_object)
+	{
+		str_copy(pError, "invalid header", ErrorSize);
+		return false;
+	}
+
+	m_pCurrent = pJsonEnd + 1;
+	m_pEnd = m_vData.data() + m_vData.size();
+	m_Tick = 0;
+	m_MaxClientId = MAX_CLIENTS;
+	m_InputsStarted = false;
+	return true;
+}
+
+const char *CTeeHistorianReader::HeaderString(const char *pName) const
+{
+	const json_value *pValue = json_object_get(m_pHeader, pName);
+	return pValue->type == json_string ? json_string_get(pValue) : nullptr;
+}
+
+bool CTeeHistorianReader::GetInt(int *pInt)
+{
+	const unsigned char *pNext = CVariableInt::Unpack(m_pCurrent, pInt, m_pEnd - m_pCurrent);
+	if(!pNext)
+	{
+		m_Error = true;
+		return false;
+	}
+	m_pCurrent = pNext;
+	return true;
+}
+
+const unsigned char *CTeeHistorianReader::GetRaw(int Size)
+{
+	if(Size < 0 || Size > m_pEnd - m_pCurrent)
+	{
+		m_Error = true;
+		return nullptr;
+	}
+	const unsigned char *pData = m_pCurrent;
+	m_pCurrent += Size;
+	return pData;
+}
+
+const char *CTeeHistorianReader::GetString()
+{
+	const unsigned char *pNul = (const unsigned char *)std::memchr(m_pCurrent, 0, m_pEnd - m_pCurrent);
+	if(!pNul)
+	{
+		m_Error = true;
+		return nullptr;
+	}
+	const char *pString = (const char *)m_pCurrent;
+	m_pCurrent = pNul + 1;
+	return pString;
+}
+
+void CTeeHistorianReader::PlayerRecord(int ClientId)
+{
+	if(m_InputsStarted || ClientId <= m_MaxClientId)
+	{
+		// implicit tick
+		m_Tick++;
+		m_InputsStarted = false;
+	}
+	m_MaxClientId = ClientId;
+}
+
+bool CTeeHistorianReader::Next(CRecord *pRecord)
+{
+	while(!m_Error && !m_Finished)
+	{
+		if(m_pCurrent >= m_pEnd)
+		{
+			// the server didn't finish the file, e.g. because it crashed
+			m_Finished = true;
+			return false;
+		}
+
+		int Type;
+		if(!GetInt(&Type))
+			return false;
+
+		if(Type >= 0 || Type == -TEEHISTORIAN_PLAYER_NEW || Type == -TEEHISTORIAN_PLAYER_OLD)
+		{
+			int ClientId = Type;
+			if(Type < 0 && !GetInt(&ClientId))
+				return false;
+			if(ClientId < 0 || ClientId >= MAX_CLIENTS)
+			{
+				m_Error = true;
+				return false;
+			}
+			PlayerRecord(ClientId);
+			CPlayer *pPlayer = &m_aPlayers[ClientId];
+			if(Type == -TEEHISTORIAN_PLAYER_OLD)
+			{
+				pRecord->m_Type = RECORD_PLAYER_OLD;
+			}
+			else
+			{
+				int x, y;
+				if(!GetInt(&x) || !GetInt(&y))
+					return false;
+				if(Type >= 0)
+				{
+					x += pPlayer->m_X;
+					y += pPlayer->m_Y;
+				}
+				pPlayer->m_X = x;
+				pPlayer->m_Y = y;
+				pRecord->m_Type = RECORD_PLAYER;
+				pRecord->m_X = x;
+				pRecord->m_Y = y;
+			}
+			pRecord->m_Tick = m_Tick;
+			pRecord->m_ClientId = ClientId;
+			return true;
+		}
+
+		if(Type == -TEEHISTORIAN_TICK_SKIP)
+		{
+			int Dt;
+			if(!GetInt(&Dt))
+				return false;
+			m_Tick += Dt + 1;
+			m_MaxClientId = -1;
+			m_InputsStarted = false;
+			continue;
+		}
+
+		if(Type == -TEEHISTORIAN_FINISH)
+		{
+			m_Finished = true;
+			pRecord->m_Type = RECORD_FINISH;
+			pRecord->m_Tick = m_Tick;
+			return true;
+		}
+
+		m_InputsStarted = true;
+		pRecord->m_Tick = m_Tick;
+		switch(-Type)
+		{
+		case TEEHISTORIAN_INPUT_DIFF:
+		case TEEHISTORIAN_INPUT_NEW:
+		{
+			int ClientId;
+			if(!GetInt(&ClientId))
+				return false;
+			if(ClientId < 0 || ClientId >= MAX_CLIENTS)
+			{
+				m_Error = true;
+				return false;
+			}
+			int *pInput = m_aPlayers[ClientId].m_aInput;
+			for(int i = 0; i < NUM_INPUT_INTS; i++)
+			{
+				int Value;
+				if(!GetInt(&Value))
+					return false;
+				pInput[i] = Type == -TEEHISTORIAN_INPUT_DIFF ? pInput[i] + Value : Value;
+			}
+			pRecord->m_Type = RECORD_INPUT;
+			pRecord->m_ClientId = ClientId;
+			mem_copy(pRecord->m_aInput, pInput, sizeof(pRecord->m_aInput));
+			return true;
+		}
+		case TEEHISTORIAN_MESSAGE:
+		{
+			if(!GetInt(&pRecord->m_ClientId) || !GetInt(&pRecord->m_DataSize))
+				return false;
+			pRecord->m_pData = GetRaw(pRecord->m_DataSize);
+			if(!pRecord->m_pData)
+				return false;
+			pRecord->m_Type = RECORD_MESSAGE;
+			return true;
+		}
+		case TEEHISTORIAN_JOIN:
+			if(!GetInt(&pRecord->m_ClientId))
+				return false;
+			pRecord->m_Type = RECORD_JOIN;
+			return true;
+		case TEEHISTORIAN_DROP:
+			if(!GetInt(&pRecord->m_ClientId) || !(pRecord->m_pString = GetString()))
+				return false;
+			pRecord->m_Type = RECORD_DROP;
+			return true;
+		case TEEHISTORIAN_CONSOLE_COMMAND:
+		{
+			int NumArgs;
+			if(!GetInt(&pRecord->m_ClientId) || !GetInt(&pRecord->m_FlagMask) || !(pRecord->m_pString = GetString()) || !GetInt(&NumArgs))
+				return false;
+			pRecord->m_vpArgs.clear();
+			for(int i = 0; i < NumArgs; i++)
+			{
+				const char *pArg = GetString();
+				if(!pArg)
+					return false;
+				pRecord->m_vpArgs.push_back(pArg);
+			}
+			pRecord->m_Type = RECORD_CONSOLE_COMMAND;
+			return true;
+		}
+		case TEEHISTORIAN_EX:
+		{
+			const unsigned char *pUuid = GetRaw(sizeof(CUuid));
+			if(!pUuid || !GetInt(&pRecord->m_DataSize))
+				return false;
+			mem_copy(&pRecord->m_Uuid, pUuid, sizeof(CUuid));
+			pRecord->m_pData = GetRaw(pRecord->m_DataSize);
+			if(!pRecord->m_pData)
+				return false;
+			pRecord->m_Type = RECORD_EX;
+			return true;
+		}
+		default:
+			m_Error = true;
+			return false;
+		}
+	}
+	return false;
+}
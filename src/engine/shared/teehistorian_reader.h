@@ -0,0 +1,93 @@
+#ifndef ENGINE_SHARED_TEEHISTORIAN_READER_H
+#define ENGINE_SHARED_TEEHISTORIAN_READER_H
+
+#include <base/system.h>
+#include <engine/shared/protocol.h>
+#include <engine/shared/uuid_manager.h>
+
+#include <vector>
+
+typedef struct _json_value json_value;
+
+// Reads a teehistorian file record by record, resolving the implicit ticks
+// and the position and input deltas of the stream. Both uncompressed and
+// gzip compressed files are supported.
+class CTeeHistorianReader
+{
+public:
+	enum
+	{
+		NUM_INPUT_INTS = 10,
+	};
+
+	enum
+	{
+		RECORD_PLAYER, // m_ClientId, m_X, m_Y
+		RECORD_PLAYER_OLD, // m_ClientId
+		RECORD_INPUT, // m_ClientId, m_aInput
+		RECORD_MESSAGE, // m_ClientId, m_pData, m_DataSize
+		RECORD_JOIN, // m_ClientId
+		RECORD_DROP, // m_ClientId, m_pString (reason)
+		RECORD_CONSOLE_COMMAND, // m_ClientId, m_FlagMask, m_pString (command), m_vpArgs
+		RECORD_EX, // m_Uuid, m_pData, m_DataSize
+		RECORD_FINISH,
+	};
+
+	struct CRecord
+	{
+		int m_Type;
+		int m_Tick;
+		int m_ClientId;
+		int m_X;
+		int m_Y;
+		int m_aInput[NUM_INPUT_INTS];
+		int m_FlagMask;
+		CUuid m_Uuid;
+		const unsigned char *m_pData;
+		int m_DataSize;
+		const char *m_pString;
+		std::vector<const char *> m_vpArgs;
+	};
+
+	CTeeHistorianReader();
+	~CTeeHistorianReader();
+
+	// takes the content of the file, returns false if it isn't a teehistorian
+	bool Load(std::vector<unsigned char> &&vData, char *pError, int ErrorSize);
+	// the parsed header, see CTeeHistorian::WriteHeader
+	const json_value *Header() const { return m_pHeader; }
+	const char *HeaderString(const char *pName) const;
+
+	// returns false at the end of the file or on error
+	bool Next(CRecord *pRecord);
+	bool Error() const { return m_Error; }
+
+private:
+	bool GetInt(int *pInt);
+	const unsigned char *GetRaw(int Size);
+	const char *GetString();
+	void PlayerRecord(int ClientId);
+
+	std::vector<unsigned char> m_vData;
+	json_value *m_pHeader = nullptr;
+	const unsigned char *m_pCurrent = nullptr;
+	const unsigned char *m_pEnd = nullptr;
+	bool m_Error = false;
+	bool m_Finished = false;
+
+	int m_Tick;
+	// highest client id with player data in the current tick, a lower
+	// one starts the next tick
+	int m_MaxClientId;
+	// player data after the inputs of a tick starts the next tick
+	bool m_InputsStarted;
+	struct CPlayer
+	{
+		int m_X;
+		int m_Y;
+		int m_aInput[NUM_INPUT_INTS];
+	};
+	CPlayer m_aPlayers[MAX_CLIENTS];
+};
+
+#endif // ENGINE_SHARED_TEEHISTORIAN_READER_H
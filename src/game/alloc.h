@@ -9,7 +9,7 @@
 #ifndef __has_feature
 #define __has_feature(x) 0
 #endif
-#if __has_feature(address_sanitizer)
+#if __has_feature(address_sanitizer) || defined(__SANITIZE_ADDRESS__)
 #include <sanitizer/asan_interface.h>
 #else
 #define ASAN_POISON_MEMORY_REGION(addr, size) \
@@ -33,6 +33,124 @@ public: \
 \
 private:
 
+/*
+	Class: CAllocFreeList
+		Keeps the memory of deleted objects to hand it out again for the
+		next object of the same size, so objects that are created and
+		destroyed at a high rate, like the entities of the prediction
+		worlds, don't go through malloc and free every time. The lists
+		are per thread and only grow, the memory is released when the
+		thread exits.
+*/
+class CAllocFreeList
+{
+	enum
+	{
+		MAX_SIZES = 16,
+	};
+
+	struct CBlock
+	{
+		CBlock *m_pNext;
+	};
+
+	struct CList
+	{
+		size_t m_Size;
+		CBlock *m_pFirst;
+	};
+
+	// trivially destructible, so it can still be read while the other
+	// thread locals are destroyed
+	static inline thread_local bool s_ListsDestroyed = false;
+
+	struct CLists
+	{
+		CList m_aLists[MAX_SIZES] = {};
+
+		~CLists()
+		{
+			for(CList &List : m_aLists)
+			{
+				while(List.m_pFirst)
+				{
+					ASAN_UNPOISON_MEMORY_REGION(List.m_pFirst, sizeof(CBlock));
+					CBlock *pNext = List.m_pFirst->m_pNext;
+					free(List.m_pFirst);
+					List.m_pFirst = pNext;
+				}
+			}
+			s_ListsDestroyed = true;
+		}
+	};
+
+	static CList *FindList(size_t Size)
+	{
+		if(s_ListsDestroyed)
+			return nullptr;
+		thread_local CLists s_Lists;
+		for(CList &List : s_Lists.m_aLists)
+		{
+			if(List.m_Size == 0)
+				List.m_Size = Size;
+			if(List.m_Size == Size)
+				return &List;
+		}
+		return nullptr;
+	}
+
+public:
+	static void *Allocate(size_t Size)
+	{
+		void *pObj;
+		CList *pList = FindList(Size);
+		if(pList && pList->m_pFirst)
+		{
+			pObj = pList->m_pFirst;
+			ASAN_UNPOISON_MEMORY_REGION(pObj, Size < sizeof(CBlock) ? sizeof(CBlock) : Size);
+			pList->m_pFirst = pList->m_pFirst->m_pNext;
+		}
+		else
+		{
+			pObj = malloc(Size < sizeof(CBlock) ? sizeof(CBlock) : Size);
+		}
+		mem_zero(pObj, Size);
+		return pObj;
+	}
+
+	static void Free(void *pObj, size_t Size)
+	{
+		if(!pObj)
+			return;
+		CList *pList = FindList(Size);
+		if(!pList)
+		{
+			free(pObj);
+			return;
+		}
+		CBlock *pBlock = static_cast<CBlock *>(pObj);
+		pBlock->m_pNext = pList->m_pFirst;
+		pList->m_pFirst = pBlock;
+		// accesses to deleted objects are still reported
+		ASAN_POISON_MEMORY_REGION(pObj, Size < sizeof(CBlock) ? sizeof(CBlock) : Size);
+	}
+};
+
+// the sized delete gets the size of the most derived class as long as the
+// destructor is virtual
+#define MACRO_ALLOC_FREELIST() \
+public: \
+	void *operator new(size_t Size) \
+	{ \
+		return CAllocFreeList::Allocate(Size); \
+	} \
+	void operator delete(void *pPtr, size_t Size) \
+	{ \
+		CAllocFreeList::Free(pPtr, Size); \
+	} \
+\
+private:
+
 #define MACRO_ALLOC_POOL_ID() \
 public: \
 	void *operator new(size_t Size, int Id); \
@@ -41,7 +159,7 @@ public: \
 \
 private:
 
-#if __has_feature(address_sanitizer)
+#if __has_feature(address_sanitizer) || defined(__SANITIZE_ADDRESS__)
 #define MACRO_ALLOC_GET_SIZE(POOLTYPE) ((sizeof(POOLTYPE) + 7) & ~7)
 #else
 #define MACRO_ALLOC_GET_SIZE(POOLTYPE) (sizeof(POOLTYPE))
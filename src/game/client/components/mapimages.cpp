@@ -15,6 +15,9 @@
 #include <game/localization.h>
 #include <game/mapitems.h>
 
+// upper bound for the decompressed size of the images that are preloaded together
+static constexpr size_t IMAGE_PRELOAD_BATCH_SIZE = 64 * 1024 * 1024;
+
 CMapImages::CMapImages()
 {
 	m_Count = 0;
@@ -91,6 +94,11 @@ void CMapImages::OnMapLoadImpl(class CLayers *pLayers, IMap *pMap)
 
 	const int TextureLoadFlag = Graphics()->Uses2DTextureArrays() ? IGraphics::TEXLOAD_TO_2D_ARRAY_TEXTURE : IGraphics::TEXLOAD_TO_3D_TEXTURE;
 
+	// the embedded images are decompressed in parallel before uploading them
+	// one by one, in batches so that not all of them are in memory at once
+	std::vector<int> vImageData;
+	int PreloadedUntil = 0;
+
 	// load new textures
 	bool ShowWarning = false;
 	for(int i = 0; i < m_Count; i++)
@@ -101,6 +109,25 @@ void CMapImages::OnMapLoadImpl(class CLayers *pLayers, IMap *pMap)
 			continue;
 		}
 
+		if(i >= PreloadedUntil)
+		{
+			// every image of the batch is unloaded again after its upload
+			vImageData.clear();
+			size_t BatchSize = 0;
+			for(PreloadedUntil = i; PreloadedUntil < m_Count; PreloadedUntil++)
+			{
+				const CMapItemImage_v2 *pPreloadImg = static_cast<const CMapItemImage_v2 *>(pMap->GetItem(Start + PreloadedUntil));
+				if(aTextureUsedByTileOrQuadLayerFlag[PreloadedUntil] == 0 || pPreloadImg->m_External || (pPreloadImg->m_Version > 1 && pPreloadImg->m_MustBe1 != 1))
+					continue;
+				const size_t DataSize = maximum(pMap->GetDataSize(pPreloadImg->m_ImageData), 0);
+				if(!vImageData.empty() && BatchSize + DataSize > IMAGE_PRELOAD_BATCH_SIZE)
+					break;
+				BatchSize += DataSize;
+				vImageData.push_back(pPreloadImg->m_ImageData);
+			}
+			pMap->PreloadData(vImageData);
+		}
+
 		const int LoadFlag = (((aTextureUsedByTileOrQuadLayerFlag[i] & 1) != 0) ? TextureLoadFlag : 0) | (((aTextureUsedByTileOrQuadLayerFlag[i] & 2) != 0) ? 0 : (Graphics()->HasTextureArraysSupport() ? IGraphics::TEXLOAD_NO_2D_TEXTURE : 0));
 		const CMapItemImage_v2 *pImg = static_cast<const CMapItemImage_v2 *>(pMap->GetItem(Start + i));
 
@@ -48,6 +48,16 @@ void CMapSounds::OnMapLoad()
 
 	m_Count = clamp<int>(m_Count, 0, MAX_MAPSOUNDS);
 
+	// decompress the embedded samples in parallel
+	std::vector<int> vSoundData;
+	for(int i = 0; i < m_Count; i++)
+	{
+		const CMapItemSound *pSound = (CMapItemSound *)pMap->GetItem(Start + i);
+		if(!pSound->m_External)
+			vSoundData.push_back(pSound->m_SoundData);
+	}
+	pMap->PreloadData(vSoundData);
+
 	// load new samples
 	bool ShowWarning = false;
 	for(int i = 0; i < m_Count; i++)
@@ -20,6 +20,7 @@
 #include <engine/keys.h>
 #include <engine/serverbrowser.h>
 #include <engine/shared/config.h>
+#include <engine/shared/demo.h>
 #include <engine/storage.h>
 #include <engine/textrender.h>
 
@@ -1605,7 +1606,7 @@ void CMenus::RenderPopupFullscreen(CUIRect Screen)
 			{
 				PopupMessage(Localize("Error"), Localize("A folder with this name already exists"), Localize("Ok"), POPUP_RENAME_DEMO);
 			}
-			else if(Storage()->RenameFile(aBufOld, aBufNew, m_vpFilteredDemos[m_DemolistSelectedIndex]->m_StorageType))
+			else if(m_vpFilteredDemos[m_DemolistSelectedIndex]->m_IsDir ? Storage()->RenameFile(aBufOld, aBufNew, m_vpFilteredDemos[m_DemolistSelectedIndex]->m_StorageType) : RenameDemoFile(Storage(), aBufOld, aBufNew, m_vpFilteredDemos[m_DemolistSelectedIndex]->m_StorageType))
 			{
 				str_copy(m_aCurrentDemoSelectionName, m_DemoRenameInput.GetString());
 				if(!m_vpFilteredDemos[m_DemolistSelectedIndex]->m_IsDir)
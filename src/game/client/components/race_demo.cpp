@@ -4,6 +4,7 @@
 
 #include <base/system.h>
 #include <engine/shared/config.h>
+#include <engine/shared/demo.h>
 #include <engine/storage.h>
 
 #include <game/client/race.h>
@@ -179,10 +180,10 @@ void CRaceDemo::StopRecord(int Time)
 			char aNewFilename[512];
 			GetPath(aNewFilename, sizeof(aNewFilename), m_Time);
 
-			Storage()->RenameFile(m_aTmpFilename, aNewFilename, IStorage::TYPE_SAVE);
+			RenameDemoFile(Storage(), m_aTmpFilename, aNewFilename, IStorage::TYPE_SAVE);
 		}
 		else // no new record
-			Storage()->RemoveFile(m_aTmpFilename, IStorage::TYPE_SAVE);
+			RemoveDemoFile(Storage(), m_aTmpFilename, IStorage::TYPE_SAVE);
 
 		m_aTmpFilename[0] = '\0';
 	}
@@ -30,7 +30,9 @@
 #include <base/vmath.h>
 
 #include "gameclient.h"
+#include "laser_data.h"
 #include "lineinput.h"
+#include "projectile_data.h"
 #include "race.h"
 #include "render.h"
 
@@ -76,6 +78,9 @@
 #include "components/statboard.h"
 #include "components/voting.h"
 #include "prediction/entities/character.h"
+#include "prediction/entities/dragger.h"
+#include "prediction/entities/laser.h"
+#include "prediction/entities/pickup.h"
 #include "prediction/entities/projectile.h"
 
 #include "game/client/python/ScriptsScanner.h"
@@ -691,6 +696,8 @@ void CGameClient::OnReset()
 	m_GameWorld.m_WorldConfig.m_InfiniteAmmo = true;
 	m_PredictedWorld.CopyWorld(&m_GameWorld);
 	m_PrevPredictedWorld.CopyWorld(&m_PredictedWorld);
+	ResetPredictedTicks();
+	m_vpUnusedPredictedWorlds.clear();
 
 	m_vSnapEntities.clear();
 
@@ -1142,6 +1149,7 @@ void CGameClient::OnMessage(int MsgId, CUnpacker *pUnpacker, int Conn, bool Dumm
 			if(CCharacter *pChar = m_GameWorld.GetCharacterById(pMsg->m_Victim))
 				pChar->ResetPrediction();
 			m_GameWorld.ReleaseHooked(pMsg->m_Victim);
+			m_GameWorld.OnModified();
 		}
 
 		// if we are spectating a static id set (team 0) and somebody killed, and its not a guy in solo, we remove him from the list
@@ -1187,6 +1195,7 @@ void CGameClient::OnMessage(int MsgId, CUnpacker *pUnpacker, int Conn, bool Dumm
 				m_GameWorld.ReleaseHooked(i);
 			}
 		}
+		m_GameWorld.OnModified();
 		std::stable_sort(vStrongWeakSorted.begin(), vStrongWeakSorted.end(), [](auto &Left, auto &Right) { return Left.second > Right.second; });
 		for(auto Id : vStrongWeakSorted)
 		{
@@ -2303,6 +2312,180 @@ void CGameClient::UpdateEditorIngameMoved()
 	}
 }
 
+void CGameClient::ResetPredictedTicks()
+{
+	DropPredictedWorlds(std::numeric_limits<int>::max());
+	m_PredictionHistory.Reset();
+}
+
+void CGameClient::StorePredictedWorld()
+{
+	std::unique_ptr<CGameWorld> pWorld;
+	if(m_vpUnusedPredictedWorlds.empty())
+	{
+		pWorld = std::make_unique<CGameWorld>();
+	}
+	else
+	{
+		pWorld = std::move(m_vpUnusedPredictedWorlds.back());
+		m_vpUnusedPredictedWorlds.pop_back();
+	}
+	pWorld->CopyWorldUnlinked(&m_PredictedWorld);
+	m_vPredictedWorlds.emplace_back(m_PredictedWorld.GameTick(), std::move(pWorld));
+}
+
+void CGameClient::DropPredictedWorlds(int BeforeTick)
+{
+	auto It = m_vPredictedWorlds.begin();
+	for(; It != m_vPredictedWorlds.end() && It->first < BeforeTick; ++It)
+		m_vpUnusedPredictedWorlds.push_back(std::move(It->second));
+	m_vPredictedWorlds.erase(m_vPredictedWorlds.begin(), It);
+}
+
+CGameWorld *CGameClient::PredictedTickWorld(int Tick)
+{
+	if(!m_PredictionHistory.Empty() && Tick == m_PredictionHistory.LastTick())
+		return &m_PredictedWorld;
+	for(auto &[WorldTick, pWorld] : m_vPredictedWorlds)
+		if(WorldTick == Tick)
+			return pWorld.get();
+	return nullptr;
+}
+
+// fills in what the snapshot tells about an entity, returns the number of values
+static int PredictionEntityData(CEntity *pEnt, int Type, int *pData)
+{
+	if(Type == CGameWorld::ENTTYPE_PROJECTILE)
+	{
+		const CProjectileData Data = ((CProjectile *)pEnt)->GetData();
+		pData[0] = round_to_int(Data.m_StartPos.x);
+		pData[1] = round_to_int(Data.m_StartPos.y);
+		pData[2] = round_to_int(Data.m_StartVel.x * 256.0f);
+		pData[3] = round_to_int(Data.m_StartVel.y * 256.0f);
+		pData[4] = Data.m_Type;
+		pData[5] = Data.m_StartTick;
+		pData[6] = Data.m_Owner;
+		pData[7] = (int)Data.m_Explosive | (int)Data.m_Freeze << 1 | Data.m_Bouncing << 2;
+		return 8;
+	}
+	else if(Type == CGameWorld::ENTTYPE_LASER)
+	{
+		const CLaserData Data = ((CLaser *)pEnt)->GetData();
+		pData[0] = round_to_int(Data.m_From.x);
+		pData[1] = round_to_int(Data.m_From.y);
+		pData[2] = round_to_int(Data.m_To.x);
+		pData[3] = round_to_int(Data.m_To.y);
+		pData[4] = Data.m_StartTick;
+		pData[5] = Data.m_Owner;
+		pData[6] = Data.m_Type;
+		return 7;
+	}
+	else if(Type == CGameWorld::ENTTYPE_PICKUP)
+	{
+		CNetObj_Pickup Pickup;
+		((CPickup *)pEnt)->FillInfo(&Pickup);
+		pData[0] = Pickup.m_X;
+		pData[1] = Pickup.m_Y;
+		pData[2] = Pickup.m_Type;
+		pData[3] = Pickup.m_Subtype;
+		return 4;
+	}
+	else if(Type == CGameWorld::ENTTYPE_DRAGGER)
+	{
+		CDragger *pDragger = (CDragger *)pEnt;
+		pData[0] = round_to_int(pDragger->m_Pos.x);
+		pData[1] = round_to_int(pDragger->m_Pos.y);
+		pData[2] = round_to_int(pDragger->GetStrength() * 100.0f);
+		pData[3] = pDragger->m_Number;
+		pData[4] = pDragger->TargetId();
+		return 5;
+	}
+	pData[0] = round_to_int(pEnt->m_Pos.x);
+	pData[1] = round_to_int(pEnt->m_Pos.y);
+	return 2;
+}
+
+void CGameClient::GetPredictionState(CGameWorld *pWorld, bool Filter, CPredictionHistory::CState *pState)
+{
+	pState->Clear();
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CCharacter *pChar = pWorld->GetCharacterById(i);
+		if(!pChar)
+			continue;
+		// the prediction doesn't contain inactive players, or entities from other teams
+		if(Filter && ((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i)))
+			continue;
+		pState->AddCharacter(i, *pChar->Core(), pChar->m_FreezeTime);
+	}
+	for(int Type = 0; Type < CGameWorld::NUM_ENTTYPES; Type++)
+	{
+		if(Type == CGameWorld::ENTTYPE_CHARACTER)
+			continue;
+		for(CEntity *pEnt = pWorld->FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+		{
+			if(Filter && Type == CGameWorld::ENTTYPE_PROJECTILE && IsOtherTeam(((CProjectile *)pEnt)->GetOwner()))
+				continue;
+			int aData[CPredictionHistory::CState::MAX_ENTITY_DATA];
+			pState->AddEntity(Type, pEnt->GetId(), aData, PredictionEntityData(pEnt, Type, aData));
+		}
+	}
+}
+
+CPredictionHistory::FGetInput CGameClient::PredictionInput(int DummyId)
+{
+	return [this, DummyId](int Tick, int Dummy) -> const int * {
+		if(Dummy != 0 && DummyId < 0)
+			return nullptr;
+		return Client()->GetInput(Tick, m_IsDummySwapping ^ Dummy);
+	};
+}
+
+bool CGameClient::CanContinuePrediction(int PredictionTick, int DummyId)
+{
+	if(m_PredictionHistory.Empty())
+		return false;
+	if(m_PredictedTicksDummy != g_Config.m_ClDummy || m_PredictedTicksDummySwapping != m_IsDummySwapping || m_PredictedTicksLocalId != m_Snap.m_LocalClientId || m_PredictedTicksDummyId != DummyId)
+		return false;
+
+	// the last ticks are predicted differently when some movement in freeze is allowed
+	if(g_Config.m_ClPredictFreeze == 2)
+		return false;
+
+	const int LastTick = m_PredictionHistory.LastTick();
+	if(LastTick != m_PredictedWorld.GameTick() || LastTick > Client()->PredGameTick(g_Config.m_ClDummy))
+		return false;
+
+	const int SnapTick = Client()->GameTick(g_Config.m_ClDummy);
+	if(m_PredictionHistory.FirstTick() == SnapTick)
+	{
+		// the predicted world must still be a copy of the snapshot
+		if(!m_PredictedWorld.m_IsValidCopy || m_PredictedWorld.m_pParent != &m_GameWorld)
+			return false;
+	}
+	else
+	{
+		// a newer snapshot arrived, the predicted ticks after it can be kept
+		// if the snapshot was predicted correctly
+		CPredictionHistory::CState SnapState;
+		GetPredictionState(&m_GameWorld, true, &SnapState);
+		if(!m_PredictionHistory.Matches(SnapTick, SnapState) || !m_PredictedWorld.SameRules(&m_GameWorld))
+			return false;
+	}
+
+	if(PredictionTick <= LastTick && (!PredictedTickWorld(PredictionTick - 1) || !PredictedTickWorld(PredictionTick)))
+		return false;
+
+	// the ticks after the snapshot must have been predicted with the same
+	// inputs, the history is reset otherwise
+	m_PredictionHistory.Rebase(SnapTick);
+	if(!m_PredictionHistory.SameInputs(PredictionInput(DummyId)))
+		return false;
+
+	m_PredictedWorld.RelinkCopy(&m_GameWorld);
+	return true;
+}
+
 void CGameClient::OnPredict()
 {
 	// store the previous values so we can detect prediction errors
@@ -2335,34 +2518,70 @@ void CGameClient::OnPredict()
 
 	// init
 	bool Dummy = g_Config.m_ClDummy ^ m_IsDummySwapping;
-	m_PredictedWorld.CopyWorld(&m_GameWorld);
+	int PredictionTick = Client()->GetPredictionTick();
+	const int DummyId = PredictDummy() ? m_PredictedDummyId : -1;
+	// keep the worlds of the ticks that can become the prediction tick of the next frames
+	const bool StoreTicks = g_Config.m_ClPredictFreeze != 2;
+	int FirstTick = Client()->GameTick(g_Config.m_ClDummy) + 1;
+	if(CanContinuePrediction(PredictionTick, DummyId))
+	{
+		// the last prediction is still valid, only predict the new ticks
+		FirstTick = m_PredictedWorld.GameTick() + 1;
+		DropPredictedWorlds(PredictionTick - 1);
+	}
+	else
+	{
+		m_PredictedWorld.CopyWorld(&m_GameWorld);
 
-	// don't predict inactive players, or entities from other teams
-	for(int i = 0; i < MAX_CLIENTS; i++)
-		if(CCharacter *pChar = m_PredictedWorld.GetCharacterById(i))
-			if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
-				pChar->Destroy();
+		// don't predict inactive players, or entities from other teams
+		for(int i = 0; i < MAX_CLIENTS; i++)
+			if(CCharacter *pChar = m_PredictedWorld.GetCharacterById(i))
+				if((!m_Snap.m_aCharacters[i].m_Active && pChar->m_SnapTicks > 10) || IsOtherTeam(i))
+					pChar->Destroy();
 
-	CProjectile *pProjNext = nullptr;
-	for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
-	{
-		pProjNext = (CProjectile *)pProj->TypeNext();
-		if(IsOtherTeam(pProj->GetOwner()))
+		CProjectile *pProjNext = nullptr;
+		for(CProjectile *pProj = (CProjectile *)m_PredictedWorld.FindFirst(CGameWorld::ENTTYPE_PROJECTILE); pProj; pProj = pProjNext)
 		{
-			pProj->Destroy();
+			pProjNext = (CProjectile *)pProj->TypeNext();
+			if(IsOtherTeam(pProj->GetOwner()))
+			{
+				pProj->Destroy();
+			}
 		}
+
+		ResetPredictedTicks();
+		m_PredictedTicksDummy = g_Config.m_ClDummy;
+		m_PredictedTicksDummySwapping = m_IsDummySwapping;
+		m_PredictedTicksLocalId = m_Snap.m_LocalClientId;
+		m_PredictedTicksDummyId = DummyId;
+		if(StoreTicks)
+			m_PredictionHistory.Start(FirstTick - 1);
 	}
 
 	CCharacter *pLocalChar = m_PredictedWorld.GetCharacterById(m_Snap.m_LocalClientId);
 	if(!pLocalChar)
 		return;
 	CCharacter *pDummyChar = nullptr;
-	if(PredictDummy())
-		pDummyChar = m_PredictedWorld.GetCharacterById(m_PredictedDummyId);
+	if(DummyId >= 0)
+		pDummyChar = m_PredictedWorld.GetCharacterById(DummyId);
+
+	// the prediction tick was predicted already, fetch the characters from the stored worlds
+	if(PredictionTick < FirstTick)
+	{
+		CGameWorld *pPrevWorld = PredictedTickWorld(PredictionTick - 1);
+		CGameWorld *pWorld = PredictedTickWorld(PredictionTick);
+		for(int i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(CCharacter *pChar = pPrevWorld->GetCharacterById(i))
+				m_aClients[i].m_PrevPredicted = pChar->GetCore();
+			if(CCharacter *pChar = pWorld->GetCharacterById(i))
+				m_aClients[i].m_Predicted = pChar->GetCore();
+		}
+		m_PrevPredictedWorld.CopyWorld(pWorld);
+	}
 
-	int PredictionTick = Client()->GetPredictionTick();
 	// predict
-	for(int Tick = Client()->GameTick(g_Config.m_ClDummy) + 1; Tick <= Client()->PredGameTick(g_Config.m_ClDummy); Tick++)
+	for(int Tick = FirstTick; Tick <= Client()->PredGameTick(g_Config.m_ClDummy); Tick++)
 	{
 		// fetch the previous characters
 		if(Tick == PredictionTick)
@@ -2381,6 +2600,10 @@ void CGameClient::OnPredict()
 				m_aClients[m_PredictedDummyId].m_PrevPredicted = pDummyChar->GetCore();
 		}
 
+		// keep the world before the tick while it can become the prediction tick
+		if(StoreTicks && Tick - 1 >= PredictionTick - 1)
+			StorePredictedWorld();
+
 		// optionally allow some movement in freeze by not predicting freeze the last one to two ticks
 		if(g_Config.m_ClPredictFreeze == 2 && Client()->PredGameTick(g_Config.m_ClDummy) - 1 - Client()->PredGameTick(g_Config.m_ClDummy) % 2 <= Tick)
 			pLocalChar->m_CanMoveInFreeze = true;
@@ -2402,6 +2625,12 @@ void CGameClient::OnPredict()
 		if(pDummyInputData)
 			pDummyChar->OnPredictedInput(pDummyInputData);
 		m_PredictedWorld.Tick();
+		if(StoreTicks)
+		{
+			CPredictionHistory::CState State;
+			GetPredictionState(&m_PredictedWorld, false, &State);
+			m_PredictionHistory.Add(Tick, PredictionInput(DummyId), &State);
+		}
 
 		// fetch the current characters
 		if(Tick == PredictionTick)
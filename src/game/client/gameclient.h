@@ -15,6 +15,7 @@
 #include <game/gamecore.h>
 #include <game/layers.h>
 #include <game/mapbugs.h>
+#include <game/prediction_history.h>
 #include <game/teamscore.h>
 
 #include <game/client/prediction/gameworld.h>
@@ -70,6 +71,7 @@
 #include "game/client/python/PythonController.h"
 #include "game/client/python/PythonRender.h"
 
+#include <memory>
 #include <vector>
 
 class CGameInfo
@@ -882,6 +884,26 @@ private:
 
 	void UpdatePrediction();
 	void UpdateSpectatorCursor();
+
+	// the ticks of the last prediction, so the next prediction can continue
+	// after the last predicted tick
+	CPredictionHistory m_PredictionHistory;
+	// the worlds after the predicted ticks that can still become the
+	// prediction tick, ordered by tick. The world after the last predicted
+	// tick is m_PredictedWorld.
+	std::vector<std::pair<int, std::unique_ptr<CGameWorld>>> m_vPredictedWorlds;
+	std::vector<std::unique_ptr<CGameWorld>> m_vpUnusedPredictedWorlds;
+	int m_PredictedTicksDummy;
+	int m_PredictedTicksDummySwapping;
+	int m_PredictedTicksLocalId;
+	int m_PredictedTicksDummyId;
+	void ResetPredictedTicks();
+	void StorePredictedWorld();
+	void DropPredictedWorlds(int BeforeTick);
+	CGameWorld *PredictedTickWorld(int Tick);
+	void GetPredictionState(CGameWorld *pWorld, bool Filter, CPredictionHistory::CState *pState);
+	CPredictionHistory::FGetInput PredictionInput(int DummyId);
+	bool CanContinuePrediction(int PredictionTick, int DummyId);
 	void UpdateRenderedCharacters();
 
 	int m_aLastUpdateTick[MAX_CLIENTS] = {0};
@@ -605,7 +605,7 @@ void CCharacter::TickDeferred()
 {
 	m_Core.Move();
 	m_Core.Quantize();
-	m_Pos = m_Core.m_Pos;
+	SetPos(m_Core.m_Pos);
 }
 
 bool CCharacter::TakeDamage(vec2 Force, int Dmg, int From, int Weapon)
@@ -1369,7 +1369,7 @@ void CCharacter::Read(CNetObj_Character *pChar, CNetObj_DDNetCharacter *pExtende
 	}
 
 	vec2 PosBefore = m_Pos;
-	m_Pos = m_Core.m_Pos;
+	SetPos(m_Core.m_Pos);
 
 	if(distance(PosBefore, m_Pos) > 2.f) // misprediction, don't use prevpos
 		m_PrevPos = m_Pos;
@@ -14,7 +14,7 @@ void CDragger::Tick()
 	if(GameWorld()->GameTick() % (int)(GameWorld()->GameTickSpeed() * 0.15f) == 0)
 	{
 		Collision()->MoverSpeed(m_Pos.x, m_Pos.y, &m_Core);
-		m_Pos += m_Core;
+		SetPos(m_Pos + m_Core);
 
 		LookForPlayersToDrag();
 	}
@@ -145,7 +145,7 @@ CDragger::CDragger(CGameWorld *pGameWorld, int Id, const CLaserData *pData) :
 
 void CDragger::Read(const CLaserData *pData)
 {
-	m_Pos = pData->m_From;
+	SetPos(pData->m_From);
 	m_TargetId = pData->m_Owner;
 }
 
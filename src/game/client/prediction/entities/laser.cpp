@@ -12,7 +12,7 @@
 CLaser::CLaser(CGameWorld *pGameWorld, vec2 Pos, vec2 Direction, float StartEnergy, int Owner, int Type) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Owner = Owner;
 	m_Energy = StartEnergy;
 	if(pGameWorld->m_WorldConfig.m_IsFNG && m_Energy < 10.f)
@@ -43,7 +43,7 @@ bool CLaser::HitCharacter(vec2 From, vec2 To)
 	if(!pHit || (pHit == pOwnerChar && g_Config.m_SvOldLaser) || (pHit != pOwnerChar && pOwnerChar ? (pOwnerChar->LaserHitDisabled() && m_Type == WEAPON_LASER) || (pOwnerChar->ShotgunHitDisabled() && m_Type == WEAPON_SHOTGUN) : !g_Config.m_SvHit))
 		return false;
 	m_From = From;
-	m_Pos = At;
+	SetPos(At);
 	m_Energy = -1;
 	if(m_Type == WEAPON_SHOTGUN)
 	{
@@ -112,7 +112,7 @@ void CLaser::DoBounce()
 		{
 			// intersected
 			m_From = m_Pos;
-			m_Pos = To;
+			SetPos(To);
 
 			vec2 TempPos = m_Pos;
 			vec2 TempDir = m_Dir * 4.0f;
@@ -128,7 +128,7 @@ void CLaser::DoBounce()
 			{
 				Collision()->SetCollisionAt(round_to_int(Coltile.x), round_to_int(Coltile.y), f);
 			}
-			m_Pos = TempPos;
+			SetPos(TempPos);
 			m_Dir = normalize(TempDir);
 
 			const float Distance = distance(m_From, m_Pos);
@@ -156,7 +156,7 @@ void CLaser::DoBounce()
 		if(!HitCharacter(m_Pos, To))
 		{
 			m_From = m_Pos;
-			m_Pos = To;
+			SetPos(To);
 			m_Energy = -1;
 		}
 	}
@@ -181,7 +181,7 @@ void CLaser::Tick()
 CLaser::CLaser(CGameWorld *pGameWorld, int Id, CLaserData *pLaser) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
-	m_Pos = pLaser->m_To;
+	SetPos(pLaser->m_To);
 	m_From = pLaser->m_From;
 	m_EvalTick = pLaser->m_StartTick;
 	m_TuneZone = GameWorld()->m_WorldConfig.m_UseTuneZones ? Collision()->IsTune(Collision()->GetMapIndex(m_Pos)) : 0;
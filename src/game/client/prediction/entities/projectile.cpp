@@ -25,7 +25,7 @@ CProjectile::CProjectile(
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_PROJECTILE)
 {
 	m_Type = Type;
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Direction = Dir;
 	m_LifeSpan = Span;
 	m_Owner = Owner;
@@ -117,7 +117,7 @@ void CProjectile::Tick()
 		if(Collide && m_Bouncing != 0)
 		{
 			m_StartTick = GameWorld()->GameTick();
-			m_Pos = NewPos + (-(m_Direction * 4));
+			SetPos(NewPos + (-(m_Direction * 4)));
 			if(m_Bouncing == 1)
 				m_Direction.x = -m_Direction.x;
 			else if(m_Bouncing == 2)
@@ -126,7 +126,7 @@ void CProjectile::Tick()
 				m_Direction.x = 0;
 			if(absolute(m_Direction.y) < 1e-6f)
 				m_Direction.y = 0;
-			m_Pos += m_Direction;
+			SetPos(m_Pos + m_Direction);
 		}
 		else if(m_Type == WEAPON_GUN)
 		{
@@ -158,7 +158,7 @@ void CProjectile::SetBouncing(int Value)
 CProjectile::CProjectile(CGameWorld *pGameWorld, int Id, const CProjectileData *pProj) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_PROJECTILE)
 {
-	m_Pos = pProj->m_StartPos;
+	SetPos(pProj->m_StartPos);
 	m_Direction = pProj->m_StartVel;
 	if(pProj->m_ExtraInfo)
 	{
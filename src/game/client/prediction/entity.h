@@ -11,13 +11,17 @@
 
 class CEntity
 {
-	MACRO_ALLOC_HEAP()
+	MACRO_ALLOC_FREELIST()
 
 private:
 	friend CGameWorld; // entity list handling
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	template<typename TEntity>
+	friend class CEntityGrid;
+	CEntityGridNode m_GridNode;
+
 protected:
 	CGameWorld *m_pGameWorld;
 	bool m_MarkedForDestroy;
@@ -40,6 +44,7 @@ public:
 	CEntity *TypePrev() { return m_pPrevTypeEntity; }
 	const vec2 &GetPos() const { return m_Pos; }
 	float GetProximityRadius() const { return m_ProximityRadius; }
+	void SetPos(vec2 Pos);
 
 	void Destroy() { delete this; }
 	virtual void PreTick() {}
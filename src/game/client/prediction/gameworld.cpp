@@ -27,6 +27,11 @@ CGameWorld::CGameWorld()
 		pFirstEntityType = nullptr;
 	for(auto &pCharacter : m_apCharacters)
 		pCharacter = nullptr;
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		m_aFirstEntityOrder[i] = 0;
+		m_aLastEntityOrder[i] = 0;
+	}
 	m_pCollision = nullptr;
 	m_GameTick = 0;
 	m_pParent = nullptr;
@@ -65,7 +70,8 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	QueryEntities(Type, Pos, Pos, Radius, m_vpQueryEntities);
+	for(CEntity *pEnt : m_vpQueryEntities)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
@@ -80,6 +86,15 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 	return Num;
 }
 
+void CGameWorld::QueryEntities(int Type, vec2 Pos0, vec2 Pos1, float Radius, std::vector<CEntity *> &vpEnts)
+{
+	if(m_aEntityGrids[Type].Query(Pos0, Pos1, Radius, vpEnts))
+		return;
+
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		vpEnts.push_back(pEnt);
+}
+
 void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 {
 	pEnt->m_pGameWorld = this;
@@ -111,6 +126,10 @@ void CGameWorld::InsertEntity(CEntity *pEnt, bool Last)
 		pEnt->m_pNextTypeEntity = nullptr;
 	}
 
+	// order keys follow the list, so grid queries can return entities in list order
+	const int64_t Order = Last ? ++m_aLastEntityOrder[pEnt->m_ObjType] : --m_aFirstEntityOrder[pEnt->m_ObjType];
+	m_aEntityGrids[pEnt->m_ObjType].Insert(pEnt, pEnt->m_ProximityRadius, Order);
+
 	if(pEnt->m_ObjType == ENTTYPE_CHARACTER)
 	{
 		auto *pChar = (CCharacter *)pEnt;
@@ -131,6 +150,7 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 		return;
 
 	// remove
+	m_aEntityGrids[pEnt->m_ObjType].Remove(pEnt);
 	if(pEnt->m_pPrevTypeEntity)
 		pEnt->m_pPrevTypeEntity->m_pNextTypeEntity = pEnt->m_pNextTypeEntity;
 	else
@@ -159,6 +179,11 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	}
 }
 
+void CGameWorld::UpdateEntityGrid(CEntity *pEnt)
+{
+	m_aEntityGrids[pEnt->m_ObjType].Update(pEnt);
+}
+
 void CGameWorld::RemoveCharacter(CCharacter *pChar)
 {
 	int Id = pChar->GetCid();
@@ -252,9 +277,10 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = nullptr;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	QueryEntities(ENTTYPE_CHARACTER, Pos0, Pos1, Radius, m_vpQueryEntities);
+	for(CEntity *pEnt : m_vpQueryEntities)
 	{
+		auto *p = static_cast<CCharacter *>(pEnt);
 		if(p == pNotThis)
 			continue;
 
@@ -287,9 +313,10 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	QueryEntities(ENTTYPE_CHARACTER, Pos0, Pos1, Radius, m_vpQueryEntities);
+	for(CEntity *pEnt : m_vpQueryEntities)
 	{
+		auto *pChr = static_cast<CCharacter *>(pEnt);
 		if(pChr == pNotThis)
 			continue;
 
@@ -480,7 +507,7 @@ void CGameWorld::NetObjAdd(int ObjId, int ObjType, const void *pObjData, const C
 		{
 			if(NetPickup.Match(pPickup))
 			{
-				pPickup->m_Pos = NetPickup.m_Pos;
+				pPickup->SetPos(NetPickup.m_Pos);
 				pPickup->Keep();
 				return;
 			}
@@ -523,7 +550,7 @@ void CGameWorld::NetObjAdd(int ObjId, int ObjType, const void *pObjData, const C
 				{
 					// if the laser stopped earlier than predicted, set the energy to 0
 					pMatching->m_Energy = 0.f;
-					pMatching->m_Pos = NetLaser.m_Pos;
+					pMatching->SetPos(NetLaser.m_Pos);
 				}
 			}
 		}
@@ -555,7 +582,8 @@ void CGameWorld::NetObjEnd()
 				if(CCharacter *pHookedChar = GetCharacterById(pChar->m_Core.HookedPlayer()))
 					if(pHookedChar->m_MarkedForDestroy)
 					{
-						pHookedChar->m_Pos = pHookedChar->m_Core.m_Pos = pChar->m_Core.m_HookPos;
+						pHookedChar->m_Core.m_Pos = pChar->m_Core.m_HookPos;
+						pHookedChar->SetPos(pHookedChar->m_Core.m_Pos);
 						pHookedChar->ResetVelocity();
 						mem_zero(&pHookedChar->m_SavedInput, sizeof(pHookedChar->m_SavedInput));
 						pHookedChar->m_SavedInput.m_TargetY = -1;
@@ -585,12 +613,77 @@ void CGameWorld::CopyWorld(CGameWorld *pFrom)
 {
 	if(pFrom == this || !pFrom)
 		return;
+	SetParent(pFrom);
+	CopyEntities(pFrom, true);
+	m_IsValidCopy = true;
+}
+
+void CGameWorld::CopyWorldUnlinked(CGameWorld *pFrom)
+{
+	if(pFrom == this || !pFrom)
+		return;
+	OnModified();
+	UnlinkParent();
+	CopyEntities(pFrom, false);
+}
+
+void CGameWorld::RelinkCopy(CGameWorld *pFrom)
+{
+	if(pFrom == this || !pFrom)
+		return;
+	UnlinkParent();
+	SetParent(pFrom);
+	// entities that were created since the copy have no parent
+	for(int Type = 0; Type < NUM_ENTTYPES; Type++)
+	{
+		for(CEntity *pEnt = FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+		{
+			if(pEnt->m_Id < 0)
+				continue;
+			CEntity *pParent = pFrom->GetEntity(pEnt->m_Id, Type);
+			if(!pParent || pParent->m_pChild)
+				continue;
+			pEnt->m_pParent = pParent;
+			pParent->m_pChild = pEnt;
+		}
+	}
+	m_IsValidCopy = true;
+}
+
+void CGameWorld::SetParent(CGameWorld *pFrom)
+{
 	m_IsValidCopy = false;
+	if(m_pParent != pFrom)
+		UnlinkParent();
+	// the entities of a previous copy of pFrom must not stay linked to its
+	// entities, only one world can be linked to them
+	if(pFrom->m_pChild && pFrom->m_pChild != this)
+		pFrom->m_pChild->UnlinkParent();
 	m_pParent = pFrom;
-	if(m_pParent->m_pChild && m_pParent->m_pChild != this)
-		m_pParent->m_pChild->m_IsValidCopy = false;
 	pFrom->m_pChild = this;
+}
+
+void CGameWorld::UnlinkParent()
+{
+	m_IsValidCopy = false;
+	for(CEntity *pFirst : m_apFirstEntityTypes)
+	{
+		for(CEntity *pEnt = pFirst; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			if(!pEnt->m_pParent)
+				continue;
+			if(pEnt->m_pParent->m_pChild == pEnt)
+				pEnt->m_pParent->m_pChild = nullptr;
+			pEnt->m_pParent = nullptr;
+		}
+	}
+	if(m_pParent && m_pParent->m_pChild == this)
+		m_pParent->m_pChild = nullptr;
+	m_pParent = nullptr;
+}
 
+void CGameWorld::CopyEntities(CGameWorld *pFrom, bool Link)
+{
 	m_GameTick = pFrom->m_GameTick;
 	m_pCollision = pFrom->m_pCollision;
 	m_WorldConfig = pFrom->m_WorldConfig;
@@ -630,13 +723,45 @@ void CGameWorld::CopyWorld(CGameWorld *pFrom)
 				pCopy = new CPickup(*((CPickup *)pEnt));
 			if(pCopy)
 			{
-				pCopy->m_pParent = pEnt;
-				pEnt->m_pChild = pCopy;
+				// the copied links belong to pEnt
+				pCopy->m_pParent = nullptr;
+				pCopy->m_pChild = nullptr;
+				if(Link)
+				{
+					pCopy->m_pParent = pEnt;
+					pEnt->m_pChild = pCopy;
+				}
 				this->InsertEntity(pCopy);
 			}
 		}
 	}
-	m_IsValidCopy = true;
+}
+
+bool CGameWorld::SameRules(CGameWorld *pOther)
+{
+	if(m_WorldConfig.m_IsDDRace != pOther->m_WorldConfig.m_IsDDRace ||
+		m_WorldConfig.m_IsVanilla != pOther->m_WorldConfig.m_IsVanilla ||
+		m_WorldConfig.m_IsFNG != pOther->m_WorldConfig.m_IsFNG ||
+		m_WorldConfig.m_InfiniteAmmo != pOther->m_WorldConfig.m_InfiniteAmmo ||
+		m_WorldConfig.m_PredictTiles != pOther->m_WorldConfig.m_PredictTiles ||
+		m_WorldConfig.m_PredictFreeze != pOther->m_WorldConfig.m_PredictFreeze ||
+		m_WorldConfig.m_PredictWeapons != pOther->m_WorldConfig.m_PredictWeapons ||
+		m_WorldConfig.m_PredictDDRace != pOther->m_WorldConfig.m_PredictDDRace ||
+		m_WorldConfig.m_IsSolo != pOther->m_WorldConfig.m_IsSolo ||
+		m_WorldConfig.m_UseTuneZones != pOther->m_WorldConfig.m_UseTuneZones ||
+		m_WorldConfig.m_BugDDRaceInput != pOther->m_WorldConfig.m_BugDDRaceInput ||
+		m_WorldConfig.m_NoWeakHookAndBounce != pOther->m_WorldConfig.m_NoWeakHookAndBounce)
+		return false;
+	if(m_pCollision != pOther->m_pCollision || m_pTuningList != pOther->m_pTuningList || m_pMapBugs != pOther->m_pMapBugs)
+		return false;
+	if(mem_comp(m_Core.m_aTuning, pOther->m_Core.m_aTuning, sizeof(m_Core.m_aTuning)) != 0)
+		return false;
+	if(m_Teams.m_IsDDRace16 != pOther->m_Teams.m_IsDDRace16)
+		return false;
+	for(int i = 0; i < MAX_CLIENTS; i++)
+		if(m_Teams.Team(i) != pOther->m_Teams.Team(i) || m_Teams.GetSolo(i) != pOther->m_Teams.GetSolo(i))
+			return false;
+	return true;
 }
 
 CEntity *CGameWorld::FindMatch(int ObjId, int ObjType, const void *pObjData)
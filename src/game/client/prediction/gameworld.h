@@ -3,9 +3,11 @@
 #ifndef GAME_CLIENT_PREDICTION_GAMEWORLD_H
 #define GAME_CLIENT_PREDICTION_GAMEWORLD_H
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 #include <game/teamscore.h>
 
+#include <cstdint>
 #include <list>
 #include <vector>
 
@@ -44,6 +46,7 @@ public:
 	CCharacter *IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, vec2 &NewPos, const CCharacter *pNotThis = nullptr, int CollideWith = -1, const CCharacter *pThisOnly = nullptr);
 	void InsertEntity(CEntity *pEntity, bool Last = false);
 	void RemoveEntity(CEntity *pEntity);
+	void UpdateEntityGrid(CEntity *pEntity);
 	void RemoveCharacter(CCharacter *pChar);
 	void Tick();
 
@@ -97,6 +100,12 @@ public:
 	void NetObjAdd(int ObjId, int ObjType, const void *pObjData, const CNetObj_EntityEx *pDataEx);
 	void NetObjEnd();
 	void CopyWorld(CGameWorld *pFrom);
+	// a copy that isn't linked to pFrom, pFrom keeps its linked copy
+	void CopyWorldUnlinked(CGameWorld *pFrom);
+	// makes the world a valid copy of pFrom again after it was checked to
+	// match, links the entities by their id
+	void RelinkCopy(CGameWorld *pFrom);
+	bool SameRules(CGameWorld *pOther);
 	CEntity *FindMatch(int ObjId, int ObjType, const void *pObjData);
 	void Clear();
 
@@ -109,10 +118,20 @@ public:
 
 private:
 	void RemoveEntities();
+	void SetParent(CGameWorld *pFrom);
+	void UnlinkParent();
+	void CopyEntities(CGameWorld *pFrom, bool Link);
+	void QueryEntities(int Type, vec2 Pos0, vec2 Pos1, float Radius, std::vector<CEntity *> &vpEnts);
 
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// spatial index of each entity list, entities can be inserted at both ends
+	CEntityGrid<CEntity> m_aEntityGrids[NUM_ENTTYPES];
+	int64_t m_aFirstEntityOrder[NUM_ENTTYPES];
+	int64_t m_aLastEntityOrder[NUM_ENTTYPES];
+	std::vector<CEntity *> m_vpQueryEntities;
+
 	CCharacter *m_apCharacters[MAX_CLIENTS];
 };
 
@@ -109,11 +109,10 @@ void CCollision::Init(class CLayers *pLayers)
 
 			Index = m_pSwitch[i].m_Type;
 
-			if(Index <= TILE_NPH_ENABLE)
+			// only write when something changes, the map data can be shared with other processes
+			if(Index != 0 && Index <= TILE_NPH_ENABLE)
 			{
-				if((Index >= TILE_JUMP && Index <= TILE_SUBTRACT_TIME) || Index == TILE_ALLOW_TELE_GUN || Index == TILE_ALLOW_BLUE_TELE_GUN)
-					m_pSwitch[i].m_Type = Index;
-				else
+				if(!((Index >= TILE_JUMP && Index <= TILE_SUBTRACT_TIME) || Index == TILE_ALLOW_TELE_GUN || Index == TILE_ALLOW_BLUE_TELE_GUN))
 					m_pSwitch[i].m_Type = 0;
 			}
 		}
@@ -255,15 +255,17 @@ class CDataFileWriterFinishJob : public IJob
 	char m_aRealFileName[IO_MAX_PATH_LENGTH];
 	char m_aTempFileName[IO_MAX_PATH_LENGTH];
 	CDataFileWriter m_Writer;
+	IEngine *m_pEngine;
 
 	void Run() override
 	{
-		m_Writer.Finish();
+		m_Writer.Finish(m_pEngine);
 	}
 
 public:
-	CDataFileWriterFinishJob(const char *pRealFileName, const char *pTempFileName, CDataFileWriter &&Writer) :
-		m_Writer(std::move(Writer))
+	CDataFileWriterFinishJob(const char *pRealFileName, const char *pTempFileName, CDataFileWriter &&Writer, IEngine *pEngine) :
+		m_Writer(std::move(Writer)),
+		m_pEngine(pEngine)
 	{
 		str_copy(m_aRealFileName, pRealFileName);
 		str_copy(m_aTempFileName, pTempFileName);
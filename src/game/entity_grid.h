@@ -0,0 +1,200 @@
+#ifndef GAME_ENTITY_GRID_H
+#define GAME_ENTITY_GRID_H
+
+#include <base/vmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+	Struct: CEntityGridNode
+		Per entity bookkeeping of CEntityGrid. Being part of a grid is
+		not a property of the entity's state, so copies of an entity
+		start out unlinked.
+*/
+struct CEntityGridNode
+{
+	int m_Bucket = -1;
+	int m_Index = -1;
+	int64_t m_Order = 0;
+
+	CEntityGridNode() = default;
+	CEntityGridNode(const CEntityGridNode &) {}
+	CEntityGridNode &operator=(const CEntityGridNode &) { return *this; }
+};
+
+/*
+	Class: CEntityGrid
+		Uniform grid over the entities of one type, used to answer
+		proximity queries of the game worlds without walking every
+		entity. Cells are hashed into a fixed number of buckets, so the
+		grid does not depend on the map size.
+
+		Entities are kept in their bucket by the game world whenever
+		their position changes. Query returns the candidates sorted by
+		their order key, which the world assigns such that it matches
+		the order of its entity list. This keeps the results of the
+		world queries identical to a linear scan.
+*/
+template<typename TEntity>
+class CEntityGrid
+{
+public:
+	enum
+	{
+		CELL_SIZE = 256,
+		CELL_LIMIT = 1 << 16,
+		NUM_BUCKETS = 1024,
+		MAX_QUERY_CELLS = 64,
+	};
+
+	/*
+		Function: Insert
+			Adds an entity to the grid.
+
+		Arguments:
+			pEnt - Entity to add, must not be part of a grid yet.
+			Radius - Proximity radius of the entity.
+			Order - Position of the entity in the world's entity list.
+	*/
+	void Insert(TEntity *pEnt, float Radius, int64_t Order)
+	{
+		if(m_vvBuckets.empty())
+			m_vvBuckets.resize(NUM_BUCKETS);
+		m_MaxRadius = std::max(m_MaxRadius, Radius);
+		pEnt->m_GridNode.m_Order = Order;
+		Link(pEnt, BucketIndex(pEnt->m_Pos));
+	}
+
+	void Remove(TEntity *pEnt)
+	{
+		if(pEnt->m_GridNode.m_Bucket < 0)
+			return;
+		Unlink(pEnt);
+	}
+
+	/*
+		Function: Update
+			Moves the entity to the bucket of its current position.
+			Does nothing if the entity is not part of the grid.
+	*/
+	void Update(TEntity *pEnt)
+	{
+		if(pEnt->m_GridNode.m_Bucket < 0)
+			return;
+		int Bucket = BucketIndex(pEnt->m_Pos);
+		if(Bucket == pEnt->m_GridNode.m_Bucket)
+			return;
+		Unlink(pEnt);
+		Link(pEnt, Bucket);
+	}
+
+	/*
+		Function: Query
+			Collects all entities that could be closer than Radius plus
+			their proximity radius to the line from Pos0 to Pos1.
+
+		Arguments:
+			Pos0 - Start position
+			Pos1 - End position, same as Pos0 for a point query.
+			Radius - Search radius.
+			vpEnts - Filled with the candidates in entity list order.
+
+		Returns:
+			False if the area spans too many cells to be worth it, the
+			caller has to fall back to walking the entity list then.
+	*/
+	bool Query(vec2 Pos0, vec2 Pos1, float Radius, std::vector<TEntity *> &vpEnts)
+	{
+		vpEnts.clear();
+		if(m_vvBuckets.empty())
+			return true;
+
+		// one pixel of slack guards against rounding in the distance checks
+		const float Range = Radius + m_MaxRadius + 1.0f;
+		const int MinX = CellCoord(std::min(Pos0.x, Pos1.x) - Range);
+		const int MinY = CellCoord(std::min(Pos0.y, Pos1.y) - Range);
+		const int MaxX = CellCoord(std::max(Pos0.x, Pos1.x) + Range);
+		const int MaxY = CellCoord(std::max(Pos0.y, Pos1.y) + Range);
+		if(MaxX < MinX || MaxY < MinY)
+			return true;
+		if((int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1) > MAX_QUERY_CELLS)
+			return false;
+
+		m_vQueryEntries.clear();
+		for(int y = MinY; y <= MaxY; y++)
+		{
+			for(int x = MinX; x <= MaxX; x++)
+			{
+				const std::vector<CEntry> &vBucket = m_vvBuckets[HashCell(x, y)];
+				m_vQueryEntries.insert(m_vQueryEntries.end(), vBucket.begin(), vBucket.end());
+			}
+		}
+
+		// cells can share a bucket, so the same entity might show up twice
+		std::sort(m_vQueryEntries.begin(), m_vQueryEntries.end(), [](const CEntry &Left, const CEntry &Right) { return Left.m_Order < Right.m_Order; });
+		for(size_t i = 0; i < m_vQueryEntries.size(); i++)
+		{
+			if(i == 0 || m_vQueryEntries[i].m_pEntity != m_vQueryEntries[i - 1].m_pEntity)
+				vpEnts.push_back(m_vQueryEntries[i].m_pEntity);
+		}
+		return true;
+	}
+
+private:
+	struct CEntry
+	{
+		TEntity *m_pEntity;
+		int64_t m_Order;
+	};
+
+	static int CellCoord(float Value)
+	{
+		// also maps NaN to the first cell
+		if(!(Value > -(float)CELL_LIMIT * CELL_SIZE))
+			return -CELL_LIMIT;
+		if(!(Value < (float)CELL_LIMIT * CELL_SIZE))
+			return CELL_LIMIT;
+		return (int)std::floor(Value / CELL_SIZE);
+	}
+
+	static int HashCell(int x, int y)
+	{
+		return (int)(((unsigned)x * 73856093u ^ (unsigned)y * 19349663u) % NUM_BUCKETS);
+	}
+
+	static int BucketIndex(vec2 Pos)
+	{
+		return HashCell(CellCoord(Pos.x), CellCoord(Pos.y));
+	}
+
+	void Link(TEntity *pEnt, int Bucket)
+	{
+		std::vector<CEntry> &vBucket = m_vvBuckets[Bucket];
+		pEnt->m_GridNode.m_Bucket = Bucket;
+		pEnt->m_GridNode.m_Index = vBucket.size();
+		vBucket.push_back({pEnt, pEnt->m_GridNode.m_Order});
+	}
+
+	void Unlink(TEntity *pEnt)
+	{
+		std::vector<CEntry> &vBucket = m_vvBuckets[pEnt->m_GridNode.m_Bucket];
+		const int Index = pEnt->m_GridNode.m_Index;
+		if(Index != (int)vBucket.size() - 1)
+		{
+			vBucket[Index] = vBucket.back();
+			vBucket[Index].m_pEntity->m_GridNode.m_Index = Index;
+		}
+		vBucket.pop_back();
+		pEnt->m_GridNode.m_Bucket = -1;
+		pEnt->m_GridNode.m_Index = -1;
+	}
+
+	std::vector<std::vector<CEntry>> m_vvBuckets;
+	std::vector<CEntry> m_vQueryEntries;
+	float m_MaxRadius = 0.0f;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "prediction_history.h"
+
+#include <base/system.h>
+
+#include <algorithm>
+
+void CPredictionHistory::CState::Clear()
+{
+	m_vCharacters.clear();
+	m_vEntities.clear();
+}
+
+// the abilities of a character that the snapshot can change
+static int CharacterFlags(const CCharacterCore &Core)
+{
+	const bool aFlags[] = {
+		Core.m_Solo,
+		Core.m_Jetpack,
+		Core.m_CollisionDisabled,
+		Core.m_EndlessHook,
+		Core.m_EndlessJump,
+		Core.m_HammerHitDisabled,
+		Core.m_GrenadeHitDisabled,
+		Core.m_LaserHitDisabled,
+		Core.m_ShotgunHitDisabled,
+		Core.m_HookHitDisabled,
+		Core.m_Super,
+		Core.m_Invincible,
+		Core.m_HasTelegunGun,
+		Core.m_HasTelegunGrenade,
+		Core.m_HasTelegunLaser,
+		Core.m_DeepFrozen,
+		Core.m_LiveFrozen,
+	};
+	int Flags = 0;
+	int Bit = 0;
+	for(bool Flag : aFlags)
+		Flags |= (int)Flag << Bit++;
+	for(const auto &Weapon : Core.m_aWeapons)
+		Flags |= (int)Weapon.m_Got << Bit++;
+	return Flags;
+}
+
+void CPredictionHistory::CState::AddCharacter(int ClientId, const CCharacterCore &Core, int FreezeTime)
+{
+	CCharacterState &Character = m_vCharacters.emplace_back();
+	Character.m_ClientId = ClientId;
+	mem_zero(&Character.m_Core, sizeof(Character.m_Core));
+	Core.Write(&Character.m_Core);
+	Character.m_ActiveWeapon = Core.m_ActiveWeapon;
+	Character.m_Flags = CharacterFlags(Core);
+	Character.m_FreezeTime = FreezeTime;
+}
+
+bool CPredictionHistory::CState::EntityLess(const CEntityState &a, const CEntityState &b)
+{
+	if(a.m_Type != b.m_Type)
+		return a.m_Type < b.m_Type;
+	if(a.m_Id != b.m_Id)
+		return a.m_Id < b.m_Id;
+	return std::lexicographical_compare(std::begin(a.m_aData), std::end(a.m_aData), std::begin(b.m_aData), std::end(b.m_aData));
+}
+
+void CPredictionHistory::CState::AddEntity(int Type, int Id, const int *pData, int NumData)
+{
+	dbg_assert(NumData <= MAX_ENTITY_DATA, "too much entity data");
+	CEntityState Entity;
+	Entity.m_Type = Type;
+	Entity.m_Id = Id;
+	for(int i = 0; i < MAX_ENTITY_DATA; i++)
+		Entity.m_aData[i] = i < NumData ? pData[i] : 0;
+	m_vEntities.insert(std::upper_bound(m_vEntities.begin(), m_vEntities.end(), Entity, EntityLess), Entity);
+}
+
+bool CPredictionHistory::CState::operator==(const CState &Other) const
+{
+	if(m_vCharacters.size() != Other.m_vCharacters.size() || m_vEntities.size() != Other.m_vEntities.size())
+		return false;
+	for(size_t i = 0; i < m_vCharacters.size(); i++)
+	{
+		const CCharacterState &Character = m_vCharacters[i];
+		const CCharacterState &OtherCharacter = Other.m_vCharacters[i];
+		if(Character.m_ClientId != OtherCharacter.m_ClientId || Character.m_ActiveWeapon != OtherCharacter.m_ActiveWeapon || Character.m_Flags != OtherCharacter.m_Flags || Character.m_FreezeTime != OtherCharacter.m_FreezeTime)
+			return false;
+		if(mem_comp(&Character.m_Core, &OtherCharacter.m_Core, sizeof(Character.m_Core)) != 0)
+			return false;
+	}
+	for(size_t i = 0; i < m_vEntities.size(); i++)
+	{
+		if(mem_comp(&m_vEntities[i], &Other.m_vEntities[i], sizeof(CEntityState)) != 0)
+			return false;
+	}
+	return true;
+}
+
+void CPredictionHistory::Reset()
+{
+	m_vTicks.clear();
+}
+
+void CPredictionHistory::Start(int Tick)
+{
+	m_vTicks.clear();
+	CTick &First = m_vTicks.emplace_back();
+	First.m_Tick = Tick;
+	for(bool &HasInput : First.m_aHasInput)
+		HasInput = false;
+	First.m_HasState = false;
+}
+
+void CPredictionHistory::Add(int Tick, const FGetInput &GetInput, const CState *pState)
+{
+	dbg_assert(!m_vTicks.empty() && Tick == LastTick() + 1, "predicted ticks must be added in order");
+	CTick &PredictedTick = m_vTicks.emplace_back();
+	PredictedTick.m_Tick = Tick;
+	for(int Dummy = 0; Dummy < NUM_DUMMIES; Dummy++)
+	{
+		const int *pInput = GetInput(Tick, Dummy);
+		PredictedTick.m_aHasInput[Dummy] = pInput != nullptr;
+		if(pInput)
+			mem_copy(&PredictedTick.m_aInputs[Dummy], pInput, sizeof(CNetObj_PlayerInput));
+	}
+	PredictedTick.m_HasState = pState != nullptr;
+	if(pState)
+		PredictedTick.m_State = *pState;
+}
+
+bool CPredictionHistory::SameInputs(const FGetInput &GetInput) const
+{
+	for(size_t i = 1; i < m_vTicks.size(); i++)
+	{
+		const CTick &PredictedTick = m_vTicks[i];
+		for(int Dummy = 0; Dummy < NUM_DUMMIES; Dummy++)
+		{
+			const int *pInput = GetInput(PredictedTick.m_Tick, Dummy);
+			if((pInput != nullptr) != PredictedTick.m_aHasInput[Dummy])
+				return false;
+			if(pInput && mem_comp(&PredictedTick.m_aInputs[Dummy], pInput, sizeof(CNetObj_PlayerInput)) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+const CPredictionHistory::CTick *CPredictionHistory::Find(int Tick) const
+{
+	if(m_vTicks.empty() || Tick < FirstTick() || Tick > LastTick())
+		return nullptr;
+	return &m_vTicks[Tick - FirstTick()];
+}
+
+bool CPredictionHistory::Matches(int Tick, const CState &Snapshot) const
+{
+	const CTick *pTick = Find(Tick);
+	return pTick && pTick->m_HasState && pTick->m_State == Snapshot;
+}
+
+void CPredictionHistory::Rebase(int Tick)
+{
+	if(m_vTicks.empty())
+		return;
+	const int NumDropped = std::clamp(Tick - FirstTick(), 0, (int)m_vTicks.size());
+	m_vTicks.erase(m_vTicks.begin(), m_vTicks.begin() + NumDropped);
+}
@@ -0,0 +1,103 @@
+#ifndef GAME_PREDICTION_HISTORY_H
+#define GAME_PREDICTION_HISTORY_H
+
+#include <engine/client/enums.h>
+#include <game/gamecore.h>
+#include <game/generated/protocol.h>
+
+#include <functional>
+#include <vector>
+
+/*
+	Class: CPredictionHistory
+		The ticks of the last client prediction, starting with the
+		snapshot tick it was predicted from. The next prediction can
+		continue after the last predicted tick instead of predicting
+		everything again from the snapshot, as long as the inputs of the
+		predicted ticks didn't change. When a newer snapshot arrives, the
+		prediction stays valid if it predicted the snapshot correctly.
+*/
+class CPredictionHistory
+{
+public:
+	/*
+		Class: CState
+			The part of a world after a tick that a snapshot is compared
+			with.
+	*/
+	class CState
+	{
+	public:
+		enum
+		{
+			MAX_ENTITY_DATA = 8,
+		};
+
+		void Clear();
+		// characters must be added in order of their client id
+		void AddCharacter(int ClientId, const CCharacterCore &Core, int FreezeTime);
+		// pData holds up to MAX_ENTITY_DATA values that describe the entity
+		void AddEntity(int Type, int Id, const int *pData, int NumData);
+
+		bool operator==(const CState &Other) const;
+
+	private:
+		struct CCharacterState
+		{
+			int m_ClientId;
+			CNetObj_CharacterCore m_Core;
+			int m_ActiveWeapon;
+			int m_Flags;
+			int m_FreezeTime;
+		};
+		struct CEntityState
+		{
+			int m_Type;
+			int m_Id;
+			int m_aData[MAX_ENTITY_DATA];
+		};
+		std::vector<CCharacterState> m_vCharacters;
+		// sorted, the order of the entity lists differs between worlds
+		std::vector<CEntityState> m_vEntities;
+
+		static bool EntityLess(const CEntityState &a, const CEntityState &b);
+	};
+
+	// returns the input the tick is predicted with, or nullptr
+	typedef std::function<const int *(int Tick, int Dummy)> FGetInput;
+
+	void Reset();
+	// starts over from the snapshot at Tick
+	void Start(int Tick);
+	// adds the next predicted tick, pState can be nullptr if the tick
+	// can't become a snapshot tick
+	void Add(int Tick, const FGetInput &GetInput, const CState *pState);
+
+	bool Empty() const { return m_vTicks.empty(); }
+	int FirstTick() const { return m_vTicks.front().m_Tick; }
+	int LastTick() const { return m_vTicks.back().m_Tick; }
+
+	// whether the ticks after the first one would be predicted with the
+	// same inputs again
+	bool SameInputs(const FGetInput &GetInput) const;
+	// whether the prediction of Tick matches its snapshot
+	bool Matches(int Tick, const CState &Snapshot) const;
+	// drops the ticks before Tick, the snapshot at Tick becomes the one
+	// the prediction started from
+	void Rebase(int Tick);
+
+private:
+	struct CTick
+	{
+		int m_Tick;
+		bool m_aHasInput[NUM_DUMMIES];
+		CNetObj_PlayerInput m_aInputs[NUM_DUMMIES];
+		bool m_HasState;
+		CState m_State;
+	};
+	std::vector<CTick> m_vTicks;
+
+	const CTick *Find(int Tick) const;
+};
+
+#endif
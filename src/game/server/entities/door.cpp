@@ -14,7 +14,7 @@ CDoor::CDoor(CGameWorld *pGameWorld, vec2 Pos, float Rotation, int Length,
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
 	m_Number = Number;
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Length = Length;
 	m_Direction = vec2(std::sin(Rotation), std::cos(Rotation));
 	vec2 To = Pos + normalize(m_Direction) * m_Length;
@@ -45,6 +45,13 @@ void CDoor::Reset()
 	m_MarkedForDestroy = true;
 }
 
+bool CDoor::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = vec2(minimum(m_Pos.x, m_To.x), minimum(m_Pos.y, m_To.y));
+	*pMax = vec2(maximum(m_Pos.x, m_To.x), maximum(m_Pos.y, m_To.y));
+	return true;
+}
+
 void CDoor::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient, m_Pos) && NetworkClipped(SnappingClient, m_To))
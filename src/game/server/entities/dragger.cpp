@@ -17,7 +17,7 @@ CDragger::CDragger(CGameWorld *pGameWorld, vec2 Pos, float Strength, bool Ignore
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
 	m_Core = vec2(0.0f, 0.0f);
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Strength = Strength;
 	m_IgnoreWalls = IgnoreWalls;
 	m_Layer = Layer;
@@ -38,7 +38,7 @@ void CDragger::Tick()
 	{
 		m_EvalTick = Server()->Tick();
 		GameServer()->Collision()->MoverSpeed(m_Pos.x, m_Pos.y, &m_Core);
-		m_Pos += m_Core;
+		SetPos(m_Pos + m_Core);
 
 		// Adopt the new position for all outgoing laser beams
 		for(auto &DraggerBeam : m_apDraggerBeam)
@@ -186,6 +186,12 @@ void CDragger::Reset()
 	m_MarkedForDestroy = true;
 }
 
+bool CDragger::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = *pMax = m_Pos;
+	return true;
+}
+
 void CDragger::Snap(int SnappingClient)
 {
 	// Only players with the dragger in their field of view or who want to see everything will receive the snap
@@ -17,7 +17,7 @@ CDraggerBeam::CDraggerBeam(CGameWorld *pGameWorld, CDragger *pDragger, vec2 Pos,
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
 	m_pDragger = pDragger;
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Strength = Strength;
 	m_IgnoreWalls = IgnoreWalls;
 	m_ForClientId = ForClientId;
@@ -76,11 +76,6 @@ void CDraggerBeam::Tick()
 	}
 }
 
-void CDraggerBeam::SetPos(vec2 Pos)
-{
-	m_Pos = Pos;
-}
-
 void CDraggerBeam::Reset()
 {
 	m_MarkedForDestroy = true;
@@ -17,7 +17,7 @@ CGun::CGun(CGameWorld *pGameWorld, vec2 Pos, bool Freeze, bool Explosive, int La
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
 	m_Core = vec2(0.0f, 0.0f);
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Freeze = Freeze;
 	m_Explosive = Explosive;
 	m_Layer = Layer;
@@ -35,7 +35,7 @@ void CGun::Tick()
 	{
 		m_EvalTick = Server()->Tick();
 		GameServer()->Collision()->MoverSpeed(m_Pos.x, m_Pos.y, &m_Core);
-		m_Pos += m_Core;
+		SetPos(m_Pos + m_Core);
 	}
 	if(g_Config.m_SvPlasmaPerSec > 0)
 	{
@@ -138,6 +138,12 @@ void CGun::Reset()
 	m_MarkedForDestroy = true;
 }
 
+bool CGun::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = *pMax = m_Pos;
+	return true;
+}
+
 void CGun::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
@@ -14,7 +14,7 @@
 CLaser::CLaser(CGameWorld *pGameWorld, vec2 Pos, vec2 Direction, float StartEnergy, int Owner, int Type) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Owner = Owner;
 	m_Energy = StartEnergy;
 	m_Dir = Direction;
@@ -51,7 +51,7 @@ bool CLaser::HitCharacter(vec2 From, vec2 To)
 	if(!pHit || (pHit == pOwnerChar && g_Config.m_SvOldLaser) || (pHit != pOwnerChar && pOwnerChar ? (pOwnerChar->LaserHitDisabled() && m_Type == WEAPON_LASER) || (pOwnerChar->ShotgunHitDisabled() && m_Type == WEAPON_SHOTGUN) : !g_Config.m_SvHit))
 		return false;
 	m_From = From;
-	m_Pos = At;
+	SetPos(At);
 	m_Energy = -1;
 	if(m_Type == WEAPON_SHOTGUN)
 	{
@@ -116,7 +116,7 @@ void CLaser::DoBounce()
 	if(m_WasTele)
 	{
 		m_PrevPos = m_TelePos;
-		m_Pos = m_TelePos;
+		SetPos(m_TelePos);
 		m_TelePos = vec2(0, 0);
 	}
 
@@ -130,7 +130,7 @@ void CLaser::DoBounce()
 		{
 			// intersected
 			m_From = m_Pos;
-			m_Pos = To;
+			SetPos(To);
 
 			vec2 TempPos = m_Pos;
 			vec2 TempDir = m_Dir * 4.0f;
@@ -146,7 +146,7 @@ void CLaser::DoBounce()
 			{
 				GameServer()->Collision()->SetCollisionAt(round_to_int(Coltile.x), round_to_int(Coltile.y), f);
 			}
-			m_Pos = TempPos;
+			SetPos(TempPos);
 			m_Dir = normalize(TempDir);
 
 			const float Distance = distance(m_From, m_Pos);
@@ -192,7 +192,7 @@ void CLaser::DoBounce()
 		if(!HitCharacter(m_Pos, To))
 		{
 			m_From = m_Pos;
-			m_Pos = To;
+			SetPos(To);
 			m_Energy = -1;
 		}
 	}
@@ -290,6 +290,13 @@ void CLaser::TickPaused()
 	++m_EvalTick;
 }
 
+bool CLaser::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = vec2(minimum(m_Pos.x, m_From.x), minimum(m_Pos.y, m_From.y));
+	*pMax = vec2(maximum(m_Pos.x, m_From.x), maximum(m_Pos.y, m_From.y));
+	return true;
+}
+
 void CLaser::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient) && NetworkClipped(SnappingClient, m_From))
@@ -20,7 +20,7 @@ CLight::CLight(CGameWorld *pGameWorld, vec2 Pos, float Rotation, int Length,
 	m_Layer = Layer;
 	m_Number = Number;
 	m_Tick = (Server()->TickSpeed() * 0.15f);
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Rotation = Rotation;
 	m_Length = Length;
 	m_EvalTick = Server()->Tick();
@@ -88,13 +88,20 @@ void CLight::Tick()
 	{
 		m_EvalTick = Server()->Tick();
 		GameServer()->Collision()->MoverSpeed(m_Pos.x, m_Pos.y, &m_Core);
-		m_Pos += m_Core;
+		SetPos(m_Pos + m_Core);
 		Step();
 	}
 
 	HitCharacter();
 }
 
+bool CLight::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = vec2(minimum(m_Pos.x, m_To.x), minimum(m_Pos.y, m_To.y));
+	*pMax = vec2(maximum(m_Pos.x, m_To.x), maximum(m_Pos.y, m_To.y));
+	return true;
+}
+
 void CLight::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient, m_Pos) && NetworkClipped(SnappingClient, m_To))
@@ -163,6 +163,12 @@ void CPickup::TickPaused()
 {
 }
 
+bool CPickup::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = *pMax = m_Pos;
+	return true;
+}
+
 void CPickup::Snap(int SnappingClient)
 {
 	if(NetworkClipped(SnappingClient))
@@ -191,6 +197,6 @@ void CPickup::Move()
 	if(Server()->Tick() % (int)(Server()->TickSpeed() * 0.15f) == 0)
 	{
 		GameServer()->Collision()->MoverSpeed(m_Pos.x, m_Pos.y, &m_Core);
-		m_Pos += m_Core;
+		SetPos(m_Pos + m_Core);
 	}
 }
@@ -15,7 +15,7 @@ CPlasma::CPlasma(CGameWorld *pGameWorld, vec2 Pos, vec2 Dir, bool Freeze,
 	bool Explosive, int ForClientId) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_LASER)
 {
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Core = Dir;
 	m_Freeze = Freeze;
 	m_Explosive = Explosive;
@@ -50,7 +50,7 @@ void CPlasma::Tick()
 
 void CPlasma::Move()
 {
-	m_Pos += m_Core;
+	SetPos(m_Pos + m_Core);
 	m_Core *= PLASMA_ACCEL;
 }
 
@@ -105,6 +105,12 @@ void CPlasma::Reset()
 	m_MarkedForDestroy = true;
 }
 
+bool CPlasma::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	*pMin = *pMax = m_Pos;
+	return true;
+}
+
 void CPlasma::Snap(int SnappingClient)
 {
 	// Only players who can see the targeted player can see the plasma bullet
@@ -27,7 +27,7 @@ CProjectile::CProjectile(
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_PROJECTILE)
 {
 	m_Type = Type;
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Direction = Dir;
 	m_LifeSpan = Span;
 	m_Owner = Owner;
@@ -224,7 +224,7 @@ void CProjectile::Tick()
 		if(Collide && m_Bouncing != 0)
 		{
 			m_StartTick = Server()->Tick();
-			m_Pos = NewPos + (-(m_Direction * 4));
+			SetPos(NewPos + (-(m_Direction * 4)));
 			if(m_Bouncing == 1)
 				m_Direction.x = -m_Direction.x;
 			else if(m_Bouncing == 2)
@@ -233,7 +233,7 @@ void CProjectile::Tick()
 				m_Direction.x = 0;
 			if(absolute(m_Direction.y) < 1e-6f)
 				m_Direction.y = 0;
-			m_Pos += m_Direction;
+			SetPos(m_Pos + m_Direction);
 		}
 		else if(m_Type == WEAPON_GUN)
 		{
@@ -281,7 +281,7 @@ void CProjectile::Tick()
 	if(z && !GameServer()->Collision()->TeleOuts(z - 1).empty())
 	{
 		int TeleOut = GameServer()->m_World.m_Core.RandomOr0(GameServer()->Collision()->TeleOuts(z - 1).size());
-		m_Pos = GameServer()->Collision()->TeleOuts(z - 1)[TeleOut];
+		SetPos(GameServer()->Collision()->TeleOuts(z - 1)[TeleOut]);
 		m_StartTick = Server()->Tick();
 	}
 }
@@ -301,6 +301,13 @@ void CProjectile::FillInfo(CNetObj_Projectile *pProj)
 	pProj->m_Type = m_Type;
 }
 
+bool CProjectile::GetSnapBounds(vec2 *pMin, vec2 *pMax)
+{
+	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
+	*pMin = *pMax = GetPos(Ct);
+	return true;
+}
+
 void CProjectile::Snap(int SnappingClient)
 {
 	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
@@ -29,6 +29,7 @@ public:
 	virtual void Tick() override;
 	virtual void TickPaused() override;
 	virtual void Snap(int SnappingClient) override;
+	virtual bool GetSnapBounds(vec2 *pMin, vec2 *pMax) override;
 	virtual void SwapClients(int Client1, int Client2) override;
 
 private:
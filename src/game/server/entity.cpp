@@ -30,6 +30,12 @@ CEntity::~CEntity()
 	Server()->SnapFreeId(m_Id);
 }
 
+void CEntity::SetPos(vec2 Pos)
+{
+	m_Pos = Pos;
+	m_pGameWorld->UpdateEntityGrid(this);
+}
+
 bool CEntity::NetworkClipped(int SnappingClient) const
 {
 	return ::NetworkClipped(m_pGameWorld->GameServer(), SnappingClient, m_Pos);
@@ -26,6 +26,10 @@ private:
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	template<typename TEntity>
+	friend class CEntityGrid;
+	CEntityGridNode m_GridNode;
+
 	/* Identity */
 	CGameWorld *m_pGameWorld;
 	CCollision *m_pCCollision;
@@ -70,6 +74,13 @@ public: // TODO: Maybe make protected
 	class IServer *Server() { return m_pGameWorld->Server(); }
 	CCollision *Collision() { return m_pCCollision; }
 
+	/*
+		Function: SetPos
+			Moves the entity. Use this instead of assigning m_Pos, so
+			the game world can keep its spatial index up to date.
+	*/
+	void SetPos(vec2 Pos);
+
 	/* Getters */
 	CEntity *TypeNext() { return m_pNextTypeEntity; }
 	CEntity *TypePrev() { return m_pPrevTypeEntity; }
@@ -158,6 +169,22 @@ public: // TODO: Maybe make protected
 	*/
 	virtual int GetOwnerId() const { return -1; }
 
+	/*
+		Function: GetSnapBounds
+			Reports the area whose visibility decides whether Snap
+			produces anything for a client. Snap has to return early
+			for every client that doesn't see any point of this area.
+
+		Arguments:
+			pMin - Receives the top left corner.
+			pMax - Receives the bottom right corner.
+
+		Returns:
+			False if the entity has to be snapped regardless of the
+			client's view.
+	*/
+	virtual bool GetSnapBounds(vec2 *pMin, vec2 *pMax) { return false; }
+
 	/*
 		Function: NetworkClipped
 			Performs a series of test to see if a client can see the
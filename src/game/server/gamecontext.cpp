@@ -15,6 +15,7 @@
 #include <engine/server/server.h>
 #include <engine/shared/config.h>
 #include <engine/shared/datafile.h>
+#include <engine/shared/gzip_writer.h>
 #include <engine/shared/json.h>
 #include <engine/shared/linereader.h>
 #include <engine/shared/memheap.h>
@@ -190,7 +191,10 @@ void CGameContext::Clear()
 void CGameContext::TeeHistorianWrite(const void *pData, int DataSize, void *pUser)
 {
 	CGameContext *pSelf = (CGameContext *)pUser;
-	aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
+	if(pSelf->m_pTeeHistorianGzip)
+		pSelf->m_pTeeHistorianGzip->Write(pData, DataSize);
+	else
+		aio_write(pSelf->m_pTeeHistorianFile, pData, DataSize);
 }
 
 void CGameContext::CommandCallback(int ClientId, int FlagMask, const char *pCmd, IConsole::IResult *pResult, void *pUser)
@@ -1022,7 +1026,7 @@ void CGameContext::OnTick()
 
 	if(m_TeeHistorianActive)
 	{
-		int Error = aio_error(m_pTeeHistorianFile);
+		int Error = m_pTeeHistorianGzip ? m_pTeeHistorianGzip->Error() : aio_error(m_pTeeHistorianFile);
 		if(Error)
 		{
 			dbg_msg("teehistorian", "error writing to file, err=%d", Error);
@@ -3982,7 +3986,7 @@ void CGameContext::OnInit(const void *pPersistentData)
 		FormatUuid(m_GameUuid, aGameUuid, sizeof(aGameUuid));
 
 		char aFilename[IO_MAX_PATH_LENGTH];
-		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian", aGameUuid);
+		str_format(aFilename, sizeof(aFilename), "teehistorian/%s.teehistorian%s", aGameUuid, g_Config.m_SvTeeHistorianCompression ? ".gz" : "");
 
 		IOHANDLE THFile = Storage()->OpenFile(aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
 		if(!THFile)
@@ -3995,7 +3999,10 @@ void CGameContext::OnInit(const void *pPersistentData)
 		{
 			dbg_msg("teehistorian", "recording to '%s'", aFilename);
 		}
-		m_pTeeHistorianFile = aio_new(THFile);
+		if(g_Config.m_SvTeeHistorianCompression)
+			m_pTeeHistorianGzip = std::make_unique<CGzipWriter>(THFile, g_Config.m_SvTeeHistorianCompression);
+		else
+			m_pTeeHistorianFile = aio_new(THFile);
 
 		char aVersion[128];
 		if(GIT_SHORTREV_HASH)
@@ -4307,15 +4314,25 @@ void CGameContext::OnShutdown(void *pPersistentData)
 	if(m_TeeHistorianActive)
 	{
 		m_TeeHistorian.Finish();
-		aio_close(m_pTeeHistorianFile);
-		aio_wait(m_pTeeHistorianFile);
-		int Error = aio_error(m_pTeeHistorianFile);
+		int Error;
+		if(m_pTeeHistorianGzip)
+		{
+			m_pTeeHistorianGzip->Close();
+			Error = m_pTeeHistorianGzip->Error();
+			m_pTeeHistorianGzip = nullptr;
+		}
+		else
+		{
+			aio_close(m_pTeeHistorianFile);
+			aio_wait(m_pTeeHistorianFile);
+			Error = aio_error(m_pTeeHistorianFile);
+			aio_free(m_pTeeHistorianFile);
+		}
 		if(Error)
 		{
 			dbg_msg("teehistorian", "error closing file, err=%d", Error);
 			Server()->SetErrorShutdown("teehistorian close error");
 		}
-		aio_free(m_pTeeHistorianFile);
 	}
 
 	// Stop any demos being recorded.
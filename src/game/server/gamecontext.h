@@ -42,6 +42,7 @@
 */
 
 class CCharacter;
+class CGzipWriter;
 class IConfigManager;
 class CConfig;
 class CHeap;
@@ -90,6 +91,8 @@ class CGameContext : public IGameServer
 	bool m_TeeHistorianActive;
 	CTeeHistorian m_TeeHistorian;
 	ASYNCIO *m_pTeeHistorianFile;
+	// used instead of m_pTeeHistorianFile for compressed teehistorian files
+	std::unique_ptr<CGzipWriter> m_pTeeHistorianGzip;
 	CUuid m_GameUuid;
 	CMapBugs m_MapBugs;
 	CPrng m_Prng;
@@ -6,12 +6,39 @@
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
+#include "player.h"
 
 #include <engine/shared/config.h>
 
 #include <algorithm>
+#include <cmath>
 #include <utility>
 
+// cells of the snapshot visibility index
+static constexpr float SNAP_CELL_SIZE = 512.0f;
+static constexpr int SNAP_CELL_LIMIT = 1 << 14;
+static constexpr int NUM_SNAP_BUCKETS = 256;
+static constexpr int MAX_SNAP_ENTITY_CELLS = 16;
+static constexpr int MAX_SNAP_VIEW_CELLS = 64;
+
+static bool SnapCellRange(vec2 Min, vec2 Max, int *pMinX, int *pMinY, int *pMaxX, int *pMaxY)
+{
+	// also rejects NaN, which NetworkClipped never clips
+	const float Limit = SNAP_CELL_SIZE * SNAP_CELL_LIMIT;
+	if(!(Min.x > -Limit && Min.y > -Limit && Max.x < Limit && Max.y < Limit))
+		return false;
+	*pMinX = (int)std::floor(Min.x / SNAP_CELL_SIZE);
+	*pMinY = (int)std::floor(Min.y / SNAP_CELL_SIZE);
+	*pMaxX = (int)std::floor(Max.x / SNAP_CELL_SIZE);
+	*pMaxY = (int)std::floor(Max.y / SNAP_CELL_SIZE);
+	return true;
+}
+
+static int SnapBucket(int x, int y)
+{
+	return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u) % NUM_SNAP_BUCKETS;
+}
+
 //////////////////////////////////////////////////
 // game world
 //////////////////////////////////////////////////
@@ -25,6 +52,8 @@ CGameWorld::CGameWorld()
 	m_ResetRequested = false;
 	for(auto &pFirstEntityType : m_apFirstEntityTypes)
 		pFirstEntityType = nullptr;
+	for(auto &FirstEntityOrder : m_aFirstEntityOrder)
+		FirstEntityOrder = 0;
 }
 
 CGameWorld::~CGameWorld()
@@ -53,7 +82,8 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+	QueryEntities(Type, Pos, Pos, Radius, m_vpQueryEntities);
+	for(CEntity *pEnt : m_vpQueryEntities)
 	{
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
@@ -68,6 +98,15 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 	return Num;
 }
 
+void CGameWorld::QueryEntities(int Type, vec2 Pos0, vec2 Pos1, float Radius, std::vector<CEntity *> &vpEnts)
+{
+	if(m_aEntityGrids[Type].Query(Pos0, Pos1, Radius, vpEnts))
+		return;
+
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		vpEnts.push_back(pEnt);
+}
+
 void CGameWorld::InsertEntity(CEntity *pEnt)
 {
 #ifdef CONF_DEBUG
@@ -81,6 +120,9 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = nullptr;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+
+	m_aEntityGrids[pEnt->m_ObjType].Insert(pEnt, pEnt->m_ProximityRadius, --m_aFirstEntityOrder[pEnt->m_ObjType]);
+	InvalidateSnapIndex();
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
@@ -90,6 +132,8 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 		return;
 
 	// remove
+	m_aEntityGrids[pEnt->m_ObjType].Remove(pEnt);
+	InvalidateSnapIndex();
 	if(pEnt->m_pPrevTypeEntity)
 		pEnt->m_pPrevTypeEntity->m_pNextTypeEntity = pEnt->m_pNextTypeEntity;
 	else
@@ -105,9 +149,108 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	pEnt->m_pPrevTypeEntity = nullptr;
 }
 
+void CGameWorld::UpdateEntityGrid(CEntity *pEnt)
+{
+	m_aEntityGrids[pEnt->m_ObjType].Update(pEnt);
+	InvalidateSnapIndex();
+}
+
+void CGameWorld::BuildSnapIndex()
+{
+	m_vSnapEntities.clear();
+	m_vSnapUnbounded.clear();
+	m_vvSnapBuckets.resize(NUM_SNAP_BUCKETS);
+	for(auto &vBucket : m_vvSnapBuckets)
+		vBucket.clear();
+
+	auto &&AddEntities = [&](int Type) {
+		for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		{
+			const int Index = m_vSnapEntities.size();
+			CSnapEntity Entity;
+			Entity.m_pEntity = pEnt;
+			Entity.m_Bounded = pEnt->GetSnapBounds(&Entity.m_Min, &Entity.m_Max);
+
+			// entities spanning many cells are checked for every client instead
+			int MinX, MinY, MaxX, MaxY;
+			if(Entity.m_Bounded && (!SnapCellRange(Entity.m_Min, Entity.m_Max, &MinX, &MinY, &MaxX, &MaxY) || (int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1) > MAX_SNAP_ENTITY_CELLS))
+				Entity.m_Bounded = false;
+
+			if(Entity.m_Bounded)
+			{
+				for(int y = MinY; y <= MaxY; y++)
+					for(int x = MinX; x <= MaxX; x++)
+						m_vvSnapBuckets[SnapBucket(x, y)].push_back(Index);
+			}
+			else
+			{
+				m_vSnapUnbounded.push_back(Index);
+			}
+			m_vSnapEntities.push_back(Entity);
+		}
+	};
+
+	// same order as the traversal in Snap
+	AddEntities(ENTTYPE_CHARACTER);
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		if(i != ENTTYPE_CHARACTER)
+			AddEntities(i);
+	}
+
+	m_SnapIndexValid = true;
+	m_SnapIndexTick = Server()->Tick();
+}
+
+bool CGameWorld::SnapVisible(int SnappingClient)
+{
+	if(SnappingClient == SERVER_DEMO_CLIENT)
+		return false;
+	const CPlayer *pPlayer = GameServer()->m_apPlayers[SnappingClient];
+	if(!pPlayer || pPlayer->m_ShowAll)
+		return false;
+
+	// one pixel of slack guards against rounding in NetworkClipped
+	const vec2 ViewMin = pPlayer->m_ViewPos - pPlayer->m_ShowDistance - vec2(1.0f, 1.0f);
+	const vec2 ViewMax = pPlayer->m_ViewPos + pPlayer->m_ShowDistance + vec2(1.0f, 1.0f);
+	int MinX, MinY, MaxX, MaxY;
+	if(!SnapCellRange(ViewMin, ViewMax, &MinX, &MinY, &MaxX, &MaxY))
+		return false;
+	if((int64_t)(MaxX - MinX + 1) * (MaxY - MinY + 1) > MAX_SNAP_VIEW_CELLS)
+		return false;
+
+	if(!m_SnapIndexValid || m_SnapIndexTick != Server()->Tick())
+		BuildSnapIndex();
+
+	m_vSnapCandidates = m_vSnapUnbounded;
+	for(int y = MinY; y <= MaxY; y++)
+	{
+		for(int x = MinX; x <= MaxX; x++)
+		{
+			const std::vector<int> &vBucket = m_vvSnapBuckets[SnapBucket(x, y)];
+			m_vSnapCandidates.insert(m_vSnapCandidates.end(), vBucket.begin(), vBucket.end());
+		}
+	}
+	std::sort(m_vSnapCandidates.begin(), m_vSnapCandidates.end());
+	m_vSnapCandidates.erase(std::unique(m_vSnapCandidates.begin(), m_vSnapCandidates.end()), m_vSnapCandidates.end());
+
+	for(int Index : m_vSnapCandidates)
+	{
+		const CSnapEntity &Entity = m_vSnapEntities[Index];
+		if(Entity.m_Bounded && (Entity.m_Max.x < ViewMin.x || Entity.m_Min.x > ViewMax.x || Entity.m_Max.y < ViewMin.y || Entity.m_Min.y > ViewMax.y))
+			continue;
+		Entity.m_pEntity->Snap(SnappingClient);
+		dbg_assert(m_SnapIndexValid, "entities must not be added, removed or moved while snapping");
+	}
+	return true;
+}
+
 //
 void CGameWorld::Snap(int SnappingClient)
 {
+	if(SnapVisible(SnappingClient))
+		return;
+
 	for(CEntity *pEnt = m_apFirstEntityTypes[ENTTYPE_CHARACTER]; pEnt;)
 	{
 		m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
@@ -131,6 +274,7 @@ void CGameWorld::Snap(int SnappingClient)
 
 void CGameWorld::PostSnap()
 {
+	InvalidateSnapIndex();
 	for(auto *pEnt : m_apFirstEntityTypes)
 	{
 		for(; pEnt;)
@@ -206,6 +350,8 @@ void CGameWorld::RemoveEntities()
 
 void CGameWorld::Tick()
 {
+	InvalidateSnapIndex();
+
 	if(m_ResetRequested)
 		Reset();
 
@@ -301,9 +447,10 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = nullptr;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	QueryEntities(ENTTYPE_CHARACTER, Pos0, Pos1, Radius, m_vpQueryEntities);
+	for(CEntity *pEnt : m_vpQueryEntities)
 	{
+		auto *p = static_cast<CCharacter *>(pEnt);
 		if(p == pNotThis)
 			continue;
 
@@ -339,9 +486,10 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = nullptr;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
+	QueryEntities(ENTTYPE_CHARACTER, Pos, Pos, Radius, m_vpQueryEntities);
+	for(CEntity *pEnt : m_vpQueryEntities)
 	{
+		auto *p = static_cast<CCharacter *>(pEnt);
 		if(p == pNotThis)
 			continue;
 
@@ -362,9 +510,10 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, const CEntity *
 std::vector<CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2 Pos1, float Radius, const CEntity *pNotThis)
 {
 	std::vector<CCharacter *> vpCharacters;
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
+	QueryEntities(ENTTYPE_CHARACTER, Pos0, Pos1, Radius, m_vpQueryEntities);
+	for(CEntity *pEnt : m_vpQueryEntities)
 	{
+		auto *pChr = static_cast<CCharacter *>(pEnt);
 		if(pChr == pNotThis)
 			continue;
 
@@ -3,10 +3,12 @@
 #ifndef GAME_SERVER_GAMEWORLD_H
 #define GAME_SERVER_GAMEWORLD_H
 
+#include <game/entity_grid.h>
 #include <game/gamecore.h>
 
 #include "save.h"
 
+#include <cstdint>
 #include <vector>
 
 class CEntity;
@@ -37,6 +39,48 @@ private:
 	CEntity *m_pNextTraverseEntity = nullptr;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// spatial index of each entity list, see QueryEntities
+	CEntityGrid<CEntity> m_aEntityGrids[NUM_ENTTYPES];
+	int64_t m_aFirstEntityOrder[NUM_ENTTYPES];
+	std::vector<CEntity *> m_vpQueryEntities;
+
+	/*
+		Function: QueryEntities
+			Collects the entities of a type that could be closer than
+			Radius plus their proximity radius to the line from Pos0 to
+			Pos1, in the order of the entity list. Falls back to the
+			whole list if the area is too large for the grid.
+	*/
+	void QueryEntities(int Type, vec2 Pos0, vec2 Pos1, float Radius, std::vector<CEntity *> &vpEnts);
+
+	// visibility index of the snapshot phase, built once per tick, see SnapVisible
+	struct CSnapEntity
+	{
+		CEntity *m_pEntity;
+		bool m_Bounded;
+		vec2 m_Min;
+		vec2 m_Max;
+	};
+	std::vector<CSnapEntity> m_vSnapEntities;
+	std::vector<std::vector<int>> m_vvSnapBuckets;
+	std::vector<int> m_vSnapUnbounded;
+	std::vector<int> m_vSnapCandidates;
+	bool m_SnapIndexValid = false;
+	int m_SnapIndexTick = -1;
+
+	void BuildSnapIndex();
+	void InvalidateSnapIndex() { m_SnapIndexValid = false; }
+
+	/*
+		Function: SnapVisible
+			Snaps only the entities whose snap bounds intersect the view
+			of the client, in the same order as a full traversal.
+
+		Returns:
+			False if the view can't be culled, nothing was snapped then.
+	*/
+	bool SnapVisible(int SnappingClient);
+
 	class CGameContext *m_pGameServer;
 	class CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -121,6 +165,15 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: UpdateEntityGrid
+			Keeps the spatial index in sync after an entity moved.
+
+		Arguments:
+			pEntity - Entity that changed its position
+	*/
+	void UpdateEntityGrid(CEntity *pEntity);
+
 	void RemoveEntitiesFromPlayer(int PlayerId);
 	void RemoveEntitiesFromPlayers(int PlayerIds[], int NumPlayers);
 
@@ -2,6 +2,7 @@
 #include "gamemodes/DDRace.h"
 #include "player.h"
 #include "save.h"
+#include "scoreleaderboard.h"
 #include "scoreworker.h"
 
 #include <base/system.h>
@@ -41,6 +42,7 @@ void CScore::ExecPlayerThread(
 	str_copy(Tmp->m_aServer, g_Config.m_SvSqlServerName, sizeof(Tmp->m_aServer));
 	str_copy(Tmp->m_aRequestingPlayer, Server()->ClientName(ClientId), sizeof(Tmp->m_aRequestingPlayer));
 	Tmp->m_Offset = Offset;
+	Tmp->m_pLeaderboard = m_pLeaderboard;
 
 	m_pPool->Execute(pFuncPtr, std::move(Tmp), pThreadName);
 }
@@ -73,6 +75,9 @@ CScore::CScore(CGameContext *pGameServer, CDbConnectionPool *pPool) :
 	m_pGameServer(pGameServer),
 	m_pServer(pGameServer->Server())
 {
+	if(g_Config.m_SvSqlLeaderboardCache > 0)
+		m_pLeaderboard = std::make_shared<CScoreLeaderboard>(g_Config.m_SvSqlLeaderboardCache);
+
 	LoadBestTime();
 
 	uint64_t aSeed[2];
@@ -162,6 +167,7 @@ void CScore::SaveScore(int ClientId, int TimeTicks, const char *pTimestamp, cons
 	str_copy(Tmp->m_aTimestamp, pTimestamp, sizeof(Tmp->m_aTimestamp));
 	for(int i = 0; i < NUM_CHECKPOINTS; i++)
 		Tmp->m_aCurrentTimeCp[i] = aTimeCp[i];
+	Tmp->m_pLeaderboard = m_pLeaderboard;
 
 	m_pPool->ExecuteWrite(CScoreWorker::SaveScore, std::move(Tmp), "save score");
 }
@@ -15,6 +15,8 @@ class CScore
 {
 	CPlayerData m_aPlayerData[MAX_CLIENTS];
 	CDbConnectionPool *m_pPool;
+	// shared with the database workers, nullptr if disabled
+	std::shared_ptr<CScoreLeaderboard> m_pLeaderboard;
 
 	CGameContext *GameServer() const { return m_pGameServer; }
 	IServer *Server() const { return m_pServer; }
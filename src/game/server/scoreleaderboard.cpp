@@ -0,0 +1,305 @@
+#include "scoreleaderboard.h"
+
+#include <base/system.h>
+#include <engine/server/databases/connection.h>
+#include <engine/shared/protocol.h>
+
+#include <algorithm>
+
+static bool EntryLess(const CScoreRanking::CEntry &a, const CScoreRanking::CEntry &b)
+{
+	if(a.m_Score != b.m_Score)
+		return a.m_Score < b.m_Score;
+	return a.m_Name < b.m_Name;
+}
+
+void CScoreRanking::AddTop(const char *pName, double Score)
+{
+	m_vTop.push_back({pName, Score});
+}
+
+void CScoreRanking::Sort()
+{
+	std::sort(m_vScores.begin(), m_vScores.end());
+	std::sort(m_vTop.begin(), m_vTop.end(), EntryLess);
+}
+
+void CScoreRanking::Update(const char *pName, std::optional<double> OldScore, double Score)
+{
+	if(OldScore)
+	{
+		auto It = std::lower_bound(m_vScores.begin(), m_vScores.end(), *OldScore);
+		if(It != m_vScores.end() && *It == *OldScore)
+			m_vScores.erase(It);
+	}
+	m_vScores.insert(std::upper_bound(m_vScores.begin(), m_vScores.end(), Score), Score);
+
+	// scores only improve, so a player never drops out of the top. The top
+	// holds all players as long as it isn't full.
+	auto It = std::find_if(m_vTop.begin(), m_vTop.end(), [pName](const CEntry &Entry) { return Entry.m_Name == pName; });
+	const bool WasTop = It != m_vTop.end();
+	if(WasTop)
+		m_vTop.erase(It);
+	const CEntry Entry = {pName, Score};
+	if(WasTop || m_vTop.size() < MAX_TOP || EntryLess(Entry, m_vTop.back()))
+	{
+		m_vTop.insert(std::lower_bound(m_vTop.begin(), m_vTop.end(), Entry, EntryLess), Entry);
+		if(m_vTop.size() > MAX_TOP)
+			m_vTop.pop_back();
+	}
+}
+
+bool CScoreRanking::HasTop(int Start, int Count, bool Descending) const
+{
+	if(NumTop() == Size())
+		return true;
+	return !Descending && Start + Count <= NumTop();
+}
+
+int CScoreRanking::Rank(double Score) const
+{
+	return (std::lower_bound(m_vScores.begin(), m_vScores.end(), Score) - m_vScores.begin()) + 1;
+}
+
+float CScoreRanking::PercentRank(double Score) const
+{
+	if(m_vScores.size() <= 1)
+		return 0.0f;
+	return (float)(Rank(Score) - 1) / (float)(m_vScores.size() - 1);
+}
+
+bool CScorePlayerTimes::Load(IDbConnection *pSqlServer, const char *pMap, const char *pName, char *pError, int ErrorSize)
+{
+	m_vTimes.clear();
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf),
+		"SELECT Server, MIN(Time) "
+		"FROM %s_race "
+		"WHERE Map = ? AND Name = ? "
+		"GROUP BY Server",
+		pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pMap);
+	pSqlServer->BindString(2, pName);
+
+	bool End;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		char aServer[32];
+		pSqlServer->GetString(1, aServer, sizeof(aServer));
+		m_vTimes.emplace_back(aServer, pSqlServer->GetFloat(2));
+	}
+	return !End;
+}
+
+std::optional<double> CScorePlayerTimes::Best(const char *pServer) const
+{
+	std::optional<double> Result;
+	for(const auto &[Server, Time] : m_vTimes)
+	{
+		if(str_find_nocase(Server.c_str(), pServer) && (!Result || Time < *Result))
+			Result = Time;
+	}
+	return Result;
+}
+
+// loads the scores of all players with pScoresQuery and the best players
+// with pTopQuery, both return the score in their last column
+template<typename FBind>
+static std::unique_ptr<CScoreRanking> LoadRanking(IDbConnection *pSqlServer, const char *pScoresQuery, const char *pTopQuery, double Sign, FBind &&Bind, char *pError, int ErrorSize)
+{
+	auto pRanking = std::make_unique<CScoreRanking>();
+
+	if(pSqlServer->PrepareStatement(pScoresQuery, pError, ErrorSize))
+	{
+		return nullptr;
+	}
+	Bind();
+	bool End;
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		pRanking->AddScore(Sign * pSqlServer->GetFloat(1));
+	}
+	if(!End)
+	{
+		return nullptr;
+	}
+
+	if(pSqlServer->PrepareStatement(pTopQuery, pError, ErrorSize))
+	{
+		return nullptr;
+	}
+	Bind();
+	while(!pSqlServer->Step(&End, pError, ErrorSize) && !End)
+	{
+		char aName[MAX_NAME_LENGTH];
+		pSqlServer->GetString(1, aName, sizeof(aName));
+		pRanking->AddTop(aName, Sign * pSqlServer->GetFloat(2));
+	}
+	if(!End)
+	{
+		return nullptr;
+	}
+
+	pRanking->Sort();
+	return pRanking;
+}
+
+CScoreLeaderboard::CScoreLeaderboard(int MaxAge) :
+	m_MaxAge((int64_t)MaxAge * time_freq())
+{
+}
+
+bool CScoreLeaderboard::IsFresh(const CCached &Cached) const
+{
+	return Cached.m_pRanking != nullptr && ddnet_time_get() - Cached.m_LoadTime < m_MaxAge;
+}
+
+bool CScoreLeaderboard::CanUpdate(const CCached &Cached, int64_t WriteStart)
+{
+	// loads that ended before the write started can't contain it
+	return Cached.m_LoadEndTime < WriteStart;
+}
+
+bool CScoreLeaderboard::Race(IDbConnection *pSqlServer, const char *pMap, const char *pServer, char *pError, int ErrorSize, const FRankingCallback &Fn)
+{
+	auto Key = std::make_pair(std::string(pMap), std::string(pServer));
+	int64_t Serial;
+	{
+		const CLockScope LockScope(m_Lock);
+		auto It = m_Race.find(Key);
+		if(It != m_Race.end() && IsFresh(It->second))
+		{
+			Fn(*It->second.m_pRanking);
+			return false;
+		}
+		Serial = m_Serial;
+	}
+
+	const int64_t LoadTime = ddnet_time_get();
+	char aServerLike[16];
+	str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pServer);
+	char aScoresQuery[256];
+	str_format(aScoresQuery, sizeof(aScoresQuery),
+		"SELECT MIN(Time) "
+		"FROM %s_race "
+		"WHERE Map = ? AND Server LIKE ? "
+		"GROUP BY Name",
+		pSqlServer->GetPrefix());
+	char aTopQuery[256];
+	str_format(aTopQuery, sizeof(aTopQuery),
+		"SELECT Name, MIN(Time) AS BestTime "
+		"FROM %s_race "
+		"WHERE Map = ? AND Server LIKE ? "
+		"GROUP BY Name "
+		"ORDER BY BestTime ASC, Name ASC "
+		"LIMIT %d",
+		pSqlServer->GetPrefix(), (int)CScoreRanking::MAX_TOP);
+	auto pRanking = LoadRanking(
+		pSqlServer, aScoresQuery, aTopQuery, 1.0, [&]() {
+			pSqlServer->BindString(1, pMap);
+			pSqlServer->BindString(2, aServerLike);
+		},
+		pError, ErrorSize);
+	if(!pRanking)
+	{
+		return true;
+	}
+
+	const CLockScope LockScope(m_Lock);
+	Fn(*pRanking);
+	if(Serial == m_Serial)
+	{
+		if(m_Race.size() >= MAX_RACE_RANKINGS && m_Race.find(Key) == m_Race.end())
+		{
+			auto Oldest = std::min_element(m_Race.begin(), m_Race.end(), [](const auto &a, const auto &b) {
+				return a.second.m_LoadTime < b.second.m_LoadTime;
+			});
+			m_Race.erase(Oldest);
+		}
+		m_Race[Key] = {std::move(pRanking), LoadTime, ddnet_time_get()};
+	}
+	return false;
+}
+
+bool CScoreLeaderboard::Points(IDbConnection *pSqlServer, char *pError, int ErrorSize, const FRankingCallback &Fn)
+{
+	int64_t Serial;
+	{
+		const CLockScope LockScope(m_Lock);
+		if(IsFresh(m_Points))
+		{
+			Fn(*m_Points.m_pRanking);
+			return false;
+		}
+		Serial = m_Serial;
+	}
+
+	const int64_t LoadTime = ddnet_time_get();
+	char aScoresQuery[128];
+	str_format(aScoresQuery, sizeof(aScoresQuery), "SELECT Points FROM %s_points", pSqlServer->GetPrefix());
+	char aTopQuery[256];
+	str_format(aTopQuery, sizeof(aTopQuery),
+		"SELECT Name, Points FROM %s_points "
+		"ORDER BY Points DESC, Name ASC "
+		"LIMIT %d",
+		pSqlServer->GetPrefix(), (int)CScoreRanking::MAX_TOP);
+	auto pRanking = LoadRanking(
+		pSqlServer, aScoresQuery, aTopQuery, -1.0, []() {}, pError, ErrorSize);
+	if(!pRanking)
+	{
+		return true;
+	}
+
+	const CLockScope LockScope(m_Lock);
+	Fn(*pRanking);
+	if(Serial == m_Serial)
+		m_Points = {std::move(pRanking), LoadTime, ddnet_time_get()};
+	return false;
+}
+
+void CScoreLeaderboard::OnScoreSaved(const char *pMap, const char *pServer, const char *pName, float Time, const CScorePlayerTimes &Previous, int64_t WriteStart)
+{
+	// the time is inserted with two decimals, keep the cache consistent
+	// with what a reload would return
+	char aTime[32];
+	str_format(aTime, sizeof(aTime), "%.2f", Time);
+	Time = str_tofloat(aTime);
+
+	const CLockScope LockScope(m_Lock);
+	m_Serial++;
+	for(auto &[Key, Cached] : m_Race)
+	{
+		if(!Cached.m_pRanking || Key.first != pMap || !str_find_nocase(pServer, Key.second.c_str()))
+			continue;
+		if(!CanUpdate(Cached, WriteStart))
+		{
+			Cached.m_pRanking = nullptr;
+			continue;
+		}
+		const std::optional<double> OldTime = Previous.Best(Key.second.c_str());
+		if(OldTime && *OldTime <= Time)
+			continue;
+		Cached.m_pRanking->Update(pName, OldTime, Time);
+	}
+}
+
+void CScoreLeaderboard::OnPointsAdded(const char *pName, std::optional<int> OldPoints, int Points, int64_t WriteStart)
+{
+	const CLockScope LockScope(m_Lock);
+	m_Serial++;
+	if(!m_Points.m_pRanking)
+		return;
+	if(!CanUpdate(m_Points, WriteStart))
+	{
+		m_Points.m_pRanking = nullptr;
+		return;
+	}
+	std::optional<double> OldScore;
+	if(OldPoints)
+		OldScore = -*OldPoints;
+	m_Points.m_pRanking->Update(pName, OldScore, -(OldPoints.value_or(0) + Points));
+}
@@ -0,0 +1,130 @@
+#ifndef GAME_SERVER_SCORELEADERBOARD_H
+#define GAME_SERVER_SCORELEADERBOARD_H
+
+#include <base/lock.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+class IDbConnection;
+
+// Ranking of players sorted from best to worst by score, lower scores are
+// better. Points are stored negated, race times as they are.
+//
+// Only the scores of all players are kept, which is enough to rank any
+// score, and the names of the best MAX_TOP players for the top lists.
+class CScoreRanking
+{
+public:
+	enum
+	{
+		MAX_TOP = 100,
+	};
+
+	struct CEntry
+	{
+		std::string m_Name;
+		double m_Score;
+	};
+
+	// call Sort after adding all scores and the top entries
+	void AddScore(double Score) { m_vScores.push_back(Score); }
+	void AddTop(const char *pName, double Score);
+	void Sort();
+	// pName improved from OldScore to Score, OldScore is empty if pName
+	// wasn't ranked yet
+	void Update(const char *pName, std::optional<double> OldScore, double Score);
+
+	int Size() const { return m_vScores.size(); }
+	int NumTop() const { return m_vTop.size(); }
+	const CEntry &Top(int Index) const { return m_vTop[Index]; }
+	// whether the entries a `LIMIT Start, Count` query in the given order
+	// would return are all known
+	bool HasTop(int Start, int Count, bool Descending) const;
+	// same as RANK(), players with equal scores share the better rank
+	int Rank(double Score) const;
+	// same as PERCENT_RANK()
+	float PercentRank(double Score) const;
+
+private:
+	std::vector<double> m_vScores;
+	std::vector<CEntry> m_vTop;
+};
+
+// Best times of one player on a map, per server.
+class CScorePlayerTimes
+{
+public:
+	bool Load(IDbConnection *pSqlServer, const char *pMap, const char *pName, char *pError, int ErrorSize);
+	bool Empty() const { return m_vTimes.empty(); }
+	// best time on servers that contain pServer (like `Server LIKE '%pServer%'`)
+	std::optional<double> Best(const char *pServer) const;
+
+private:
+	std::vector<std::pair<std::string, double>> m_vTimes;
+};
+
+// In-memory cache of the race and points leaderboards, so that rank and top
+// requests don't need to run window functions over the whole race table.
+// Rankings are loaded on first use, updated by the write worker after each
+// saved score and reloaded after MaxAge seconds to pick up finishes from
+// other servers sharing the database.
+//
+// Read and write workers access it concurrently. Rankings are updated in
+// place, they are only accessed with the lock held.
+class CScoreLeaderboard
+{
+public:
+	typedef std::function<void(const CScoreRanking &Ranking)> FRankingCallback;
+
+	CScoreLeaderboard(int MaxAge);
+
+	// calls Fn with the best times of every player on pMap, only counting
+	// finishes on servers that contain pServer (like `Server LIKE '%pServer%'`).
+	// Returns true on database failure.
+	bool Race(IDbConnection *pSqlServer, const char *pMap, const char *pServer, char *pError, int ErrorSize, const FRankingCallback &Fn);
+	// Returns true on database failure.
+	bool Points(IDbConnection *pSqlServer, char *pError, int ErrorSize, const FRankingCallback &Fn);
+
+	// called after the score has been committed to the database. Previous
+	// are the times of the player before the score was saved, WriteStart is
+	// the time the write started. Rankings loaded while the write was in
+	// progress might already contain it and are dropped instead of updated.
+	void OnScoreSaved(const char *pMap, const char *pServer, const char *pName, float Time, const CScorePlayerTimes &Previous, int64_t WriteStart);
+	void OnPointsAdded(const char *pName, std::optional<int> OldPoints, int Points, int64_t WriteStart);
+
+private:
+	enum
+	{
+		MAX_RACE_RANKINGS = 16,
+	};
+
+	struct CCached
+	{
+		std::unique_ptr<CScoreRanking> m_pRanking;
+		int64_t m_LoadTime = 0;
+		int64_t m_LoadEndTime = 0;
+	};
+
+	bool IsFresh(const CCached &Cached) const;
+	// returns false if the ranking has to be dropped instead of updated
+	static bool CanUpdate(const CCached &Cached, int64_t WriteStart);
+
+	int64_t m_MaxAge;
+
+	CLock m_Lock;
+	// keyed by map and server filter
+	std::map<std::pair<std::string, std::string>, CCached> m_Race GUARDED_BY(m_Lock);
+	CCached m_Points GUARDED_BY(m_Lock);
+	// incremented on every update, loads that overlap with an update are
+	// not published because they might miss it
+	int64_t m_Serial GUARDED_BY(m_Lock) = 0;
+};
+
+#endif // GAME_SERVER_SCORELEADERBOARD_H
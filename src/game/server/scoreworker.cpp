@@ -1,4 +1,5 @@
 #include "scoreworker.h"
+#include "scoreleaderboard.h"
 
 #include <base/log.h>
 #include <base/system.h>
@@ -489,6 +490,28 @@ bool CScoreWorker::MapInfo(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	return false;
 }
 
+// points of pName, empty if pName has none yet
+static bool GetPoints(IDbConnection *pSqlServer, const char *pName, std::optional<int> *pPoints, char *pError, int ErrorSize)
+{
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "SELECT Points FROM %s_points WHERE Name = ?", pSqlServer->GetPrefix());
+	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+	{
+		return true;
+	}
+	pSqlServer->BindString(1, pName);
+
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize))
+	{
+		return true;
+	}
+	pPoints->reset();
+	if(!End)
+		*pPoints = pSqlServer->GetInt(1);
+	return false;
+}
+
 bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlScoreData *>(pGameData);
@@ -564,25 +587,17 @@ bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameDat
 		return false;
 	}
 
+	const int64_t WriteStart = ddnet_time_get();
+	CScorePlayerTimes PreviousTimes;
+	std::optional<int> OldPoints;
+	int AddedPoints = 0;
 	if(w == Write::NORMAL)
 	{
-		str_format(aBuf, sizeof(aBuf),
-			"SELECT COUNT(*) AS NumFinished FROM %s_race WHERE Map=? AND Name=? ORDER BY time ASC LIMIT 1",
-			pSqlServer->GetPrefix());
-		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-		{
-			return true;
-		}
-		pSqlServer->BindString(1, pData->m_aMap);
-		pSqlServer->BindString(2, pData->m_aName);
-
-		bool End;
-		if(pSqlServer->Step(&End, pError, ErrorSize))
+		if(PreviousTimes.Load(pSqlServer, pData->m_aMap, pData->m_aName, pError, ErrorSize))
 		{
 			return true;
 		}
-		int NumFinished = pSqlServer->GetInt(1);
-		if(NumFinished == 0)
+		if(PreviousTimes.Empty())
 		{
 			str_format(aBuf, sizeof(aBuf), "SELECT Points FROM %s_maps WHERE Map=?", pSqlServer->GetPrefix());
 			if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
@@ -591,18 +606,23 @@ bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameDat
 			}
 			pSqlServer->BindString(1, pData->m_aMap);
 
-			bool End2;
-			if(pSqlServer->Step(&End2, pError, ErrorSize))
+			bool End;
+			if(pSqlServer->Step(&End, pError, ErrorSize))
 			{
 				return true;
 			}
-			if(!End2)
+			if(!End)
 			{
 				int Points = pSqlServer->GetInt(1);
+				if(pData->m_pLeaderboard && GetPoints(pSqlServer, pData->m_aName, &OldPoints, pError, ErrorSize))
+				{
+					return true;
+				}
 				if(pSqlServer->AddPoints(pData->m_aName, Points, pError, ErrorSize))
 				{
 					return true;
 				}
+				AddedPoints = Points;
 				str_format(paMessages[0], sizeof(paMessages[0]),
 					"You earned %d point%s for finishing this map!",
 					Points, Points == 1 ? "" : "s");
@@ -645,7 +665,20 @@ bool CScoreWorker::SaveScore(IDbConnection *pSqlServer, const ISqlData *pGameDat
 	pSqlServer->BindString(5, pData->m_aGameUuid);
 	pSqlServer->Print();
 	int NumInserted;
-	return pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize);
+	if(pSqlServer->ExecuteUpdate(&NumInserted, pError, ErrorSize))
+	{
+		return true;
+	}
+	if(w == Write::NORMAL && pData->m_pLeaderboard)
+	{
+		// the write might still be rolled back as part of a group commit
+		pData->m_OnCommitted = [pData, Server = std::string(g_Config.m_SvSqlServerName), PreviousTimes, OldPoints, AddedPoints, WriteStart]() {
+			pData->m_pLeaderboard->OnScoreSaved(pData->m_aMap, Server.c_str(), pData->m_aName, pData->m_Time, PreviousTimes, WriteStart);
+			if(AddedPoints != 0)
+				pData->m_pLeaderboard->OnPointsAdded(pData->m_aName, OldPoints, AddedPoints, WriteStart);
+		};
+	}
+	return false;
 }
 
 bool CScoreWorker::SaveTeamScore(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
@@ -822,69 +855,119 @@ bool CScoreWorker::ShowRank(IDbConnection *pSqlServer, const ISqlData *pGameData
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
 
-	char aServerLike[16];
-	str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_aServer);
-
-	// check sort method
-	char aBuf[600];
-	str_format(aBuf, sizeof(aBuf),
-		"SELECT Ranking, Time, PercentRank "
-		"FROM ("
-		"  SELECT RANK() OVER w AS Ranking, PERCENT_RANK() OVER w as PercentRank, MIN(Time) AS Time, Name "
-		"  FROM %s_race "
-		"  WHERE Map = ? "
-		"  AND Server LIKE ? "
-		"  GROUP BY Name "
-		"  WINDOW w AS (ORDER BY MIN(Time))"
-		") as a "
-		"WHERE Name = ?",
-		pSqlServer->GetPrefix());
-
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_aMap);
-	pSqlServer->BindString(2, aServerLike);
-	pSqlServer->BindString(3, pData->m_aName);
-
-	bool End;
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
-	}
-
 	char aRegionalRank[16];
-	if(End)
-	{
+	bool Ranked;
+	int Rank = 0;
+	float Time = 0.0f;
+	float PercentRank = 0.0f;
+	if(pData->m_pLeaderboard)
+	{
+		CScorePlayerTimes Times;
+		if(Times.Load(pSqlServer, pData->m_aMap, pData->m_aName, pError, ErrorSize))
+		{
+			return true;
+		}
+
+		const std::optional<double> RegionalTime = Times.Best(pData->m_aServer);
 		str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+		if(RegionalTime)
+		{
+			bool Failed = pData->m_pLeaderboard->Race(pSqlServer, pData->m_aMap, pData->m_aServer, pError, ErrorSize, [&](const CScoreRanking &Regional) {
+				str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", Regional.Rank(*RegionalTime));
+			});
+			if(Failed)
+			{
+				return true;
+			}
+		}
+
+		const std::optional<double> GlobalTime = Times.Best("");
+		Ranked = GlobalTime.has_value();
+		if(Ranked)
+		{
+			bool Failed = pData->m_pLeaderboard->Race(pSqlServer, pData->m_aMap, "", pError, ErrorSize, [&](const CScoreRanking &Global) {
+				Rank = Global.Rank(*GlobalTime);
+				PercentRank = Global.PercentRank(*GlobalTime);
+			});
+			if(Failed)
+			{
+				return true;
+			}
+			Time = *GlobalTime;
+		}
 	}
 	else
 	{
-		str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", pSqlServer->GetInt(1));
-	}
+		char aServerLike[16];
+		str_format(aServerLike, sizeof(aServerLike), "%%%s%%", pData->m_aServer);
 
-	const char *pAny = "%";
+		// check sort method
+		char aBuf[600];
+		str_format(aBuf, sizeof(aBuf),
+			"SELECT Ranking, Time, PercentRank "
+			"FROM ("
+			"  SELECT RANK() OVER w AS Ranking, PERCENT_RANK() OVER w as PercentRank, MIN(Time) AS Time, Name "
+			"  FROM %s_race "
+			"  WHERE Map = ? "
+			"  AND Server LIKE ? "
+			"  GROUP BY Name "
+			"  WINDOW w AS (ORDER BY MIN(Time))"
+			") as a "
+			"WHERE Name = ?",
+			pSqlServer->GetPrefix());
 
-	if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
-	{
-		return true;
-	}
-	pSqlServer->BindString(1, pData->m_aMap);
-	pSqlServer->BindString(2, pAny);
-	pSqlServer->BindString(3, pData->m_aName);
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_aMap);
+		pSqlServer->BindString(2, aServerLike);
+		pSqlServer->BindString(3, pData->m_aName);
 
-	if(pSqlServer->Step(&End, pError, ErrorSize))
-	{
-		return true;
+		bool End;
+		if(pSqlServer->Step(&End, pError, ErrorSize))
+		{
+			return true;
+		}
+
+		if(End)
+		{
+			str_copy(aRegionalRank, "unranked", sizeof(aRegionalRank));
+		}
+		else
+		{
+			str_format(aRegionalRank, sizeof(aRegionalRank), "rank %d", pSqlServer->GetInt(1));
+		}
+
+		const char *pAny = "%";
+
+		if(pSqlServer->PrepareStatement(aBuf, pError, ErrorSize))
+		{
+			return true;
+		}
+		pSqlServer->BindString(1, pData->m_aMap);
+		pSqlServer->BindString(2, pAny);
+		pSqlServer->BindString(3, pData->m_aName);
+
+		if(pSqlServer->Step(&End, pError, ErrorSize))
+		{
+			return true;
+		}
+
+		Ranked = !End;
+		if(Ranked)
+		{
+			Rank = pSqlServer->GetInt(1);
+			Time = pSqlServer->GetFloat(2);
+			PercentRank = pSqlServer->GetFloat(3);
+		}
 	}
 
-	if(!End)
+	if(Ranked)
 	{
-		int Rank = pSqlServer->GetInt(1);
-		float Time = pSqlServer->GetFloat(2);
 		// CEIL and FLOOR are not supported in SQLite
-		int BetterThanPercent = std::floor(100.0f - 100.0f * pSqlServer->GetFloat(3));
+		int BetterThanPercent = std::floor(100.0f - 100.0f * PercentRank);
+		char aBuf[128];
 		str_time_float(Time, TIME_HOURS_CENTISECS, aBuf, sizeof(aBuf));
 		if(g_Config.m_SvHideScore)
 		{
@@ -1012,6 +1095,22 @@ bool CScoreWorker::ShowTeamRank(IDbConnection *pSqlServer, const ISqlData *pGame
 	return false;
 }
 
+// Formats the entries a `ORDER BY Ranking LIMIT Start, Count` query would
+// return, starting with paMessages[Line]. Returns the next line.
+static int FormatRaceTop(const CScoreRanking &Ranking, int Start, int Count, bool Descending, char (*paMessages)[512], int Line)
+{
+	char aTime[32];
+	for(int i = Start; i < Start + Count && i < Ranking.Size(); i++)
+	{
+		const CScoreRanking::CEntry &Entry = Ranking.Top(Descending ? Ranking.Size() - 1 - i : i);
+		str_time_float(Entry.m_Score, TIME_HOURS_CENTISECS, aTime, sizeof(aTime));
+		str_format(paMessages[Line], sizeof(paMessages[Line]),
+			"%d. %s Time: %s", Ranking.Rank(Entry.m_Score), Entry.m_Name.c_str(), aTime);
+		Line++;
+	}
+	return Line;
+}
+
 bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
 {
 	const auto *pData = dynamic_cast<const CSqlPlayerRequest *>(pGameData);
@@ -1021,6 +1120,52 @@ bool CScoreWorker::ShowTop(IDbConnection *pSqlServer, const ISqlData *pGameData,
 	const char *pOrder = pData->m_Offset >= 0 ? "ASC" : "DESC";
 	const char *pAny = "%";
 
+	if(pData->m_pLeaderboard)
+	{
+		// only the best players are cached, fall back to the database for
+		// anything beyond them
+		const bool Descending = pData->m_Offset < 0;
+		bool Cached = true;
+		int Line = 0;
+		str_copy(pResult->m_Data.m_aaMessages[Line], "------------ Global Top ------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+		bool Failed = pData->m_pLeaderboard->Race(pSqlServer, pData->m_aMap, "", pError, ErrorSize, [&](const CScoreRanking &Global) {
+			Cached = Global.HasTop(LimitStart, 5, Descending);
+			if(Cached)
+				Line = FormatRaceTop(Global, LimitStart, 5, Descending, pResult->m_Data.m_aaMessages, Line + 1);
+		});
+		if(Failed)
+		{
+			return true;
+		}
+
+		if(Cached && !g_Config.m_SvRegionalRankings)
+		{
+			str_copy(pResult->m_Data.m_aaMessages[Line], "-----------------------------------------", sizeof(pResult->m_Data.m_aaMessages[Line]));
+			return false;
+		}
+
+		if(Cached)
+		{
+			str_format(pResult->m_Data.m_aaMessages[Line], sizeof(pResult->m_Data.m_aaMessages[Line]),
+				"------------ %s Top ------------", pData->m_aServer);
+			Failed = pData->m_pLeaderboard->Race(pSqlServer, pData->m_aMap, pData->m_aServer, pError, ErrorSize, [&](const CScoreRanking &Regional) {
+				Cached = Regional.HasTop(LimitStart, 3, Descending);
+				if(Cached)
+					FormatRaceTop(Regional, LimitStart, 3, Descending, pResult->m_Data.m_aaMessages, Line + 1);
+			});
+			if(Failed)
+			{
+				return true;
+			}
+		}
+
+		if(Cached)
+		{
+			return false;
+		}
+		pResult->SetVariant(CScorePlayerResult::DIRECT);
+	}
+
 	// check sort method
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
@@ -1411,6 +1556,36 @@ bool CScoreWorker::ShowPoints(IDbConnection *pSqlServer, const ISqlData *pGameDa
 	auto *pResult = dynamic_cast<CScorePlayerResult *>(pGameData->m_pResult.get());
 	auto *paMessages = pResult->m_Data.m_aaMessages;
 
+	if(pData->m_pLeaderboard)
+	{
+		std::optional<int> Points;
+		if(GetPoints(pSqlServer, pData->m_aName, &Points, pError, ErrorSize))
+		{
+			return true;
+		}
+		if(Points)
+		{
+			int Rank = 0;
+			bool Failed = pData->m_pLeaderboard->Points(pSqlServer, pError, ErrorSize, [&](const CScoreRanking &Ranking) {
+				Rank = Ranking.Rank(-*Points);
+			});
+			if(Failed)
+			{
+				return true;
+			}
+			pResult->m_MessageKind = CScorePlayerResult::ALL;
+			str_format(paMessages[0], sizeof(paMessages[0]),
+				"%d. %s Points: %d, requested by %s",
+				Rank, pData->m_aName, *Points, pData->m_aRequestingPlayer);
+		}
+		else
+		{
+			str_format(paMessages[0], sizeof(paMessages[0]),
+				"%s has not collected any points so far", pData->m_aName);
+		}
+		return false;
+	}
+
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
 		"SELECT ("
@@ -1458,6 +1633,34 @@ bool CScoreWorker::ShowTopPoints(IDbConnection *pSqlServer, const ISqlData *pGam
 
 	int LimitStart = maximum(pData->m_Offset - 1, 0);
 
+	if(pData->m_pLeaderboard)
+	{
+		bool Cached = true;
+		bool Failed = pData->m_pLeaderboard->Points(pSqlServer, pError, ErrorSize, [&](const CScoreRanking &Ranking) {
+			Cached = Ranking.HasTop(LimitStart, 5, false);
+			if(!Cached)
+				return;
+			str_copy(paMessages[0], "-------- Top Points --------", sizeof(paMessages[0]));
+			int Line = 1;
+			for(int i = LimitStart; i < LimitStart + 5 && i < Ranking.Size(); i++)
+			{
+				const CScoreRanking::CEntry &Entry = Ranking.Top(i);
+				str_format(paMessages[Line], sizeof(paMessages[Line]),
+					"%d. %s Points: %d", Ranking.Rank(Entry.m_Score), Entry.m_Name.c_str(), (int)-Entry.m_Score);
+				Line++;
+			}
+			str_copy(paMessages[Line], "-------------------------------", sizeof(paMessages[Line]));
+		});
+		if(Failed)
+		{
+			return true;
+		}
+		if(Cached)
+		{
+			return false;
+		}
+	}
+
 	char aBuf[512];
 	str_format(aBuf, sizeof(aBuf),
 		"SELECT RANK() OVER (ORDER BY a.Points DESC) as Ranking, Points, Name "
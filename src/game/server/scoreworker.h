@@ -14,6 +14,7 @@
 #include <game/server/save.h>
 #include <game/voting.h>
 
+class CScoreLeaderboard;
 class IDbConnection;
 class IGameController;
 
@@ -98,6 +99,8 @@ struct CSqlPlayerRequest : ISqlData
 	// relevant for /top5 kind of requests
 	int m_Offset;
 	char m_aServer[5];
+	// answers rank and top requests from memory if set
+	std::shared_ptr<CScoreLeaderboard> m_pLeaderboard;
 };
 
 struct CScoreRandomMapResult : ISqlResult
@@ -146,6 +149,8 @@ struct CSqlScoreData : ISqlData
 	int m_Num;
 	bool m_Search;
 	char m_aRequestingPlayer[MAX_NAME_LENGTH];
+	// updated after the score is saved if set
+	std::shared_ptr<CScoreLeaderboard> m_pLeaderboard;
 };
 
 struct CScoreSaveResult : ISqlResult
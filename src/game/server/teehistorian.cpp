@@ -6,6 +6,7 @@
 #include <engine/shared/json.h>
 #include <engine/shared/packer.h>
 #include <engine/shared/snapshot.h>
+#include <engine/shared/teehistorian_ex.h>
 
 #include <game/gamecore.h>
 
@@ -30,22 +31,6 @@ static const char TEEHISTORIAN_VERSION_MINOR[] = "9";
 #include <engine/shared/teehistorian_ex_chunks.h>
 #undef UUID
 
-enum
-{
-	TEEHISTORIAN_NONE,
-	TEEHISTORIAN_FINISH,
-	TEEHISTORIAN_TICK_SKIP,
-	TEEHISTORIAN_PLAYER_NEW,
-	TEEHISTORIAN_PLAYER_OLD,
-	TEEHISTORIAN_INPUT_DIFF,
-	TEEHISTORIAN_INPUT_NEW,
-	TEEHISTORIAN_MESSAGE,
-	TEEHISTORIAN_JOIN,
-	TEEHISTORIAN_DROP,
-	TEEHISTORIAN_CONSOLE_COMMAND,
-	TEEHISTORIAN_EX,
-};
-
 CTeeHistorian::CTeeHistorian()
 {
 	m_State = STATE_START;
@@ -79,8 +64,10 @@ void CTeeHistorian::Reset(const CGameInfo *pGameInfo, WRITE_CALLBACK pfnWriteCal
 	}
 	m_pfnWriteCallback = pfnWriteCallback;
 	m_pWriteCallbackUserdata = pUser;
+	m_vWriteBuffer.clear();
 
 	WriteHeader(pGameInfo);
+	Flush();
 
 	m_State = STATE_START;
 }
@@ -393,7 +380,21 @@ void CTeeHistorian::RecordTeamPractice(int Team, bool Practice)
 
 void CTeeHistorian::Write(const void *pData, int DataSize)
 {
-	m_pfnWriteCallback(pData, DataSize, m_pWriteCallbackUserdata);
+	const unsigned char *pBytes = (const unsigned char *)pData;
+	m_vWriteBuffer.insert(m_vWriteBuffer.end(), pBytes, pBytes + DataSize);
+	// don't let huge ticks (e.g. a lot of antibot data) pile up
+	if(m_vWriteBuffer.size() >= 64 * 1024)
+	{
+		Flush();
+	}
+}
+
+void CTeeHistorian::Flush()
+{
+	if(m_vWriteBuffer.empty())
+		return;
+	m_pfnWriteCallback(m_vWriteBuffer.data(), m_vWriteBuffer.size(), m_pWriteCallbackUserdata);
+	m_vWriteBuffer.clear();
 }
 
 void CTeeHistorian::EnsureTickWritten()
@@ -732,6 +733,7 @@ void CTeeHistorian::EndInputs()
 void CTeeHistorian::EndTick()
 {
 	dbg_assert(m_State == STATE_BEFORE_ENDTICK, "invalid teehistorian state");
+	Flush();
 	m_State = STATE_BEFORE_TICK;
 }
 
@@ -876,4 +878,5 @@ void CTeeHistorian::Finish()
 	}
 
 	Write(Buffer.Data(), Buffer.Size());
+	Flush();
 }
@@ -7,6 +7,7 @@
 #include <game/generated/protocol.h>
 
 #include <ctime>
+#include <vector>
 
 class CConfig;
 class CTuningParams;
@@ -51,6 +52,9 @@ public:
 
 	void Reset(const CGameInfo *pGameInfo, WRITE_CALLBACK pfnWriteCallback, void *pUser);
 	void Finish();
+	// passes everything recorded so far to the write callback, done
+	// automatically at the end of each tick
+	void Flush();
 
 	bool Starting() const { return m_State == STATE_START; }
 
@@ -136,6 +140,8 @@ private:
 
 	WRITE_CALLBACK m_pfnWriteCallback;
 	void *m_pWriteCallbackUserdata;
+	// records of the current tick, written out in one callback
+	std::vector<unsigned char> m_vWriteBuffer;
 
 	int m_State;
 
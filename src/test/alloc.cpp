@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include <game/alloc.h>
+
+class CFreeListObject
+{
+	MACRO_ALLOC_FREELIST()
+
+public:
+	int m_aData[8];
+	virtual ~CFreeListObject() = default;
+};
+
+class CFreeListDerived : public CFreeListObject
+{
+public:
+	int m_aMoreData[32];
+};
+
+TEST(AllocFreeList, Reuse)
+{
+	CFreeListObject *pObj = new CFreeListObject();
+	pObj->m_aData[0] = 123;
+	void *pMemory = pObj;
+	delete pObj;
+
+	// same size gets the same block back, zeroed
+	CFreeListObject *pSecond = new CFreeListObject();
+	EXPECT_EQ(pSecond, pMemory);
+	EXPECT_EQ(pSecond->m_aData[0], 0);
+
+	// other sizes use their own list
+	CFreeListObject *pDerived = new CFreeListDerived();
+	EXPECT_NE(pDerived, pMemory);
+	void *pDerivedMemory = pDerived;
+	delete pDerived;
+	CFreeListDerived *pDerivedSecond = new CFreeListDerived();
+	EXPECT_EQ(pDerivedSecond, pDerivedMemory);
+	for(int Value : pDerivedSecond->m_aMoreData)
+		EXPECT_EQ(Value, 0);
+
+	delete pDerivedSecond;
+	delete pSecond;
+}
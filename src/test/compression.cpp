@@ -1,7 +1,13 @@
 #include <gtest/gtest.h>
 
+#include <base/system.h>
+
 #include <engine/shared/compression.h>
 
+#include <game/prng.h>
+
+#include <vector>
+
 static const int DATA[] = {0, 1, -1, 32, 64, 256, -512, 12345, -123456, 1234567, 12345678, 123456789, 2147483647, (-2147483647 - 1)};
 static const int NUM = std::size(DATA);
 static const int SIZES[NUM] = {1, 1, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4, 5, 5};
@@ -82,3 +88,104 @@ TEST(CVariableInt, DecompressBufferTooSmall)
 	long CompressedSize = CVariableInt::Decompress(aCompressed, sizeof(aCompressed), aUncompressed, sizeof(aUncompressed));
 	ASSERT_EQ(CompressedSize, -1);
 }
+
+// mostly small ints with a few large ones like in snapshot deltas
+static int RandomInt(CPrng *pRng)
+{
+	const unsigned Bits = pRng->RandomBits();
+	switch(Bits % 8)
+	{
+	case 0:
+		return (int)pRng->RandomBits();
+	case 1:
+		return (int)(pRng->RandomBits() % 20000) - 10000;
+	case 2:
+		return (int)(pRng->RandomBits() % 256) - 128;
+	default:
+		return (int)(Bits >> 8) % 128 - 64;
+	}
+}
+
+static long CompressScalar(const int *pSrc, int Num, unsigned char *pDst, int DstSize)
+{
+	unsigned char *pDstStart = pDst;
+	for(int i = 0; i < Num; i++)
+	{
+		pDst = CVariableInt::Pack(pDst, pSrc[i], DstSize - (pDst - pDstStart));
+		if(!pDst)
+			return -1;
+	}
+	return pDst - pDstStart;
+}
+
+static long DecompressScalar(const unsigned char *pSrc, int SrcSize, int *pDst, int DstSize)
+{
+	const unsigned char *pSrcEnd = pSrc + SrcSize;
+	int Num = 0;
+	while(pSrc < pSrcEnd)
+	{
+		if(Num >= DstSize)
+			return -1;
+		pSrc = CVariableInt::Unpack(pSrc, &pDst[Num], pSrcEnd - pSrc);
+		if(!pSrc)
+			return -1;
+		Num++;
+	}
+	return Num * sizeof(int);
+}
+
+TEST(CVariableInt, CompressMatchesPack)
+{
+	uint64_t aSeed[2] = {0x1234567, 0x89ABCDEF};
+	CPrng Rng;
+	Rng.Seed(aSeed);
+	for(int Run = 0; Run < 5000; Run++)
+	{
+		std::vector<int> vData(Rng.RandomBits() % 100);
+		for(int &Value : vData)
+			Value = RandomInt(&Rng);
+		const int Num = vData.size();
+
+		// also too small buffers
+		const int DstSize = Run % 4 == 0 ? Rng.RandomBits() % (Num * 2 + 1) : Num * CVariableInt::MAX_BYTES_PACKED;
+		std::vector<unsigned char> vExpected(DstSize + 1), vCompressed(DstSize + 1);
+		const long ExpectedSize = CompressScalar(vData.data(), Num, vExpected.data(), DstSize);
+		const long Size = CVariableInt::Compress(vData.data(), Num * sizeof(int), vCompressed.data(), DstSize);
+		ASSERT_EQ(Size, ExpectedSize);
+		if(Size < 0)
+			continue;
+		EXPECT_EQ(mem_comp(vCompressed.data(), vExpected.data(), Size), 0);
+
+		std::vector<int> vDecompressed(Num + 1);
+		EXPECT_EQ(CVariableInt::Decompress(vCompressed.data(), Size, vDecompressed.data(), Num * sizeof(int)), (long)(Num * sizeof(int)));
+		vDecompressed.pop_back();
+		EXPECT_EQ(vDecompressed, vData);
+	}
+}
+
+TEST(CVariableInt, DecompressMatchesUnpack)
+{
+	uint64_t aSeed[2] = {0x7654321, 0xFEDCBA98};
+	CPrng Rng;
+	Rng.Seed(aSeed);
+	for(int Run = 0; Run < 5000; Run++)
+	{
+		// random bytes with rare extend bits, so that they also end in the middle of ints
+		std::vector<unsigned char> vData(Rng.RandomBits() % 100);
+		for(unsigned char &Byte : vData)
+		{
+			const unsigned Bits = Rng.RandomBits();
+			Byte = Bits % 8 == 0 ? Bits >> 8 : (Bits >> 8) & 0x7F;
+		}
+		const int SrcSize = vData.size();
+
+		const int DstNum = Run % 4 == 0 ? Rng.RandomBits() % (SrcSize + 1) : SrcSize;
+		std::vector<int> vExpected(DstNum, 0), vDecompressed(DstNum, 0);
+		const long ExpectedSize = DecompressScalar(vData.data(), SrcSize, vExpected.data(), DstNum);
+		EXPECT_EQ(CVariableInt::Decompress(vData.data(), SrcSize, vDecompressed.data(), DstNum * sizeof(int)), ExpectedSize);
+		if(ExpectedSize >= 0)
+		{
+			EXPECT_EQ(mem_comp(vDecompressed.data(), vExpected.data(), ExpectedSize), 0);
+		}
+	}
+}
@@ -0,0 +1,185 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/console.h>
+#include <engine/kernel.h>
+#include <engine/shared/config.h>
+#include <engine/storage.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+class CTestConsole : public ::testing::Test
+{
+protected:
+	CTestInfo m_Info;
+	std::unique_ptr<IKernel> m_pKernel;
+	IStorage *m_pStorage;
+	IConsole *m_pConsole;
+
+	std::vector<int> m_vValues;
+
+	CTestConsole()
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		m_pStorage = CreateLocalStorage();
+		m_pKernel->RegisterInterface(m_pStorage);
+		m_pConsole = CreateConsole(CFGFLAG_SERVER).release();
+		m_pKernel->RegisterInterface(m_pConsole);
+		m_pConsole->Init();
+		m_pConsole->StoreCommands(false);
+	}
+
+	~CTestConsole()
+	{
+		m_pStorage->RemoveFile(m_Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+
+	void WriteFile(const char *pContent)
+	{
+		IOHANDLE File = m_pStorage->OpenFile(m_Info.m_aFilename, IOFLAG_WRITE, IStorage::TYPE_SAVE);
+		ASSERT_TRUE(File);
+		io_write(File, pContent, str_length(pContent));
+		io_close(File);
+	}
+
+	static void ConValue(IConsole::IResult *pResult, void *pUserData)
+	{
+		static_cast<CTestConsole *>(pUserData)->m_vValues.push_back(pResult->GetInteger(0));
+	}
+
+	static void ConNegativeValue(IConsole::IResult *pResult, void *pUserData)
+	{
+		static_cast<CTestConsole *>(pUserData)->m_vValues.push_back(-pResult->GetInteger(0));
+	}
+};
+
+TEST_F(CTestConsole, LookupIgnoresCase)
+{
+	m_pConsole->Register("Test_Value", "i[value]", CFGFLAG_SERVER, ConValue, this, "");
+	m_pConsole->ExecuteLine("test_value 1");
+	m_pConsole->ExecuteLine("TEST_VALUE 2; Test_Value 3");
+	EXPECT_EQ(m_vValues, std::vector<int>({1, 2, 3}));
+
+	EXPECT_NE(m_pConsole->GetCommandInfo("tEsT_vAlUe", CFGFLAG_SERVER, false), nullptr);
+	EXPECT_EQ(m_pConsole->GetCommandInfo("test_value", CFGFLAG_CLIENT, false), nullptr);
+	EXPECT_EQ(m_pConsole->GetCommandInfo("test_valu", CFGFLAG_SERVER, false), nullptr);
+}
+
+TEST_F(CTestConsole, ExecFileRepeatedly)
+{
+	m_pConsole->Register("value", "i[value] ?r[text]", CFGFLAG_SERVER, ConValue, this, "");
+	WriteFile(
+		"value 1\n"
+		"value 2; value \"3\" some text # value 4\n"
+		"\n"
+		"value invalid; value 5\n"
+		"value 6;; value 7\n"
+		"mc;value 8;value 9\n");
+
+	const std::vector<int> vExpected = {1, 2, 3, 5, 6, 8, 9};
+	EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+	EXPECT_EQ(m_vValues, vExpected);
+	m_vValues.clear();
+	EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+	EXPECT_EQ(m_vValues, vExpected);
+
+	// registering the command again must be picked up by the compiled file
+	m_pConsole->Register("value", "i[value] ?r[text]", CFGFLAG_SERVER, ConNegativeValue, this, "");
+	m_vValues.clear();
+	EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+	EXPECT_EQ(m_vValues, std::vector<int>({-1, -2, -3, -5, -6, -8, -9}));
+
+	// so must changes to the file
+	WriteFile("value 10\n");
+	m_vValues.clear();
+	EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+	EXPECT_EQ(m_vValues, std::vector<int>({-10}));
+}
+
+TEST_F(CTestConsole, ExecFileStrokeCommand)
+{
+	m_pConsole->Register("+stroke", "", CFGFLAG_SERVER, ConValue, this, "");
+	m_pConsole->Register("value", "i[value]", CFGFLAG_SERVER, ConValue, this, "");
+	WriteFile("+stroke; value 5\n");
+	for(int i = 0; i < 2; i++)
+	{
+		m_vValues.clear();
+		EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+		EXPECT_EQ(m_vValues, std::vector<int>({1, 5, 0}));
+	}
+}
+
+TEST_F(CTestConsole, ExecFileAccessLevel)
+{
+	m_pConsole->Register("value", "i[value]", CFGFLAG_SERVER, ConValue, this, "");
+	WriteFile("value 1\n");
+	EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+	m_pConsole->SetAccessLevel(IConsole::ACCESS_LEVEL_MOD);
+	EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+	m_pConsole->SetAccessLevel(IConsole::ACCESS_LEVEL_ADMIN);
+	EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+	EXPECT_EQ(m_vValues, std::vector<int>({1, 1}));
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(CTestConsole, DISABLED_BenchmarkExec)
+{
+	const CConfig OldConfig = g_Config;
+	IConfigManager *pConfigManager = CreateConfigManager();
+	m_pKernel->RegisterInterface(pConfigManager);
+	pConfigManager->Init();
+
+	// an autoexec setting the config variables over and over
+	std::vector<const char *> vpIntVariables;
+	std::vector<const char *> vpStrVariables;
+	for(const IConsole::CCommandInfo *pInfo = m_pConsole->FirstCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER); pInfo; pInfo = pInfo->NextCommandInfo(IConsole::ACCESS_LEVEL_ADMIN, CFGFLAG_SERVER))
+	{
+		if(str_comp(pInfo->m_pParams, "?i") == 0)
+			vpIntVariables.push_back(pInfo->m_pName);
+		else if(str_comp(pInfo->m_pParams, "?r") == 0)
+			vpStrVariables.push_back(pInfo->m_pName);
+	}
+	ASSERT_FALSE(vpIntVariables.empty());
+	ASSERT_FALSE(vpStrVariables.empty());
+
+	const int NumLines = 5000;
+	std::string Autoexec;
+	for(int i = 0; i < NumLines; i++)
+	{
+		char aLine[256];
+		if(i % 4 == 3)
+			str_format(aLine, sizeof(aLine), "%s \"text %d\" # comment\n", vpStrVariables[i % vpStrVariables.size()], i);
+		else
+			str_format(aLine, sizeof(aLine), "%s %d\n", vpIntVariables[i % vpIntVariables.size()], i % 2);
+		Autoexec += aLine;
+	}
+	WriteFile(Autoexec.c_str());
+
+	const int NumRuns = 10;
+	{
+		std::vector<std::string> vLines;
+		for(size_t Start = 0, End; (End = Autoexec.find('\n', Start)) != std::string::npos; Start = End + 1)
+			vLines.push_back(Autoexec.substr(Start, End - Start));
+		const auto Start = time_get_nanoseconds();
+		for(int Run = 0; Run < NumRuns; Run++)
+			for(const std::string &Line : vLines)
+				m_pConsole->ExecuteLine(Line.c_str());
+		const auto Time = time_get_nanoseconds() - Start;
+		dbg_msg("console", "%d lines with ExecuteLine: %.2fms", NumLines, std::chrono::duration<double, std::milli>(Time).count() / NumRuns);
+	}
+	for(int Run = 0; Run < NumRuns; Run++)
+	{
+		const auto Start = time_get_nanoseconds();
+		EXPECT_TRUE(m_pConsole->ExecuteFile(m_Info.m_aFilename));
+		const auto Time = time_get_nanoseconds() - Start;
+		if(Run == 0 || Run == NumRuns - 1)
+			dbg_msg("console", "%d lines with exec, run %d: %.2fms", NumLines, Run + 1, std::chrono::duration<double, std::milli>(Time).count());
+	}
+
+	g_Config = OldConfig;
+}
@@ -1,8 +1,15 @@
 #include "test.h"
 #include <gtest/gtest.h>
+
+#include <chrono>
 #include <memory>
+#include <vector>
+
+#include <base/system.h>
 
+#include <engine/engine.h>
 #include <engine/shared/datafile.h>
+#include <engine/shared/linereader.h>
 #include <engine/storage.h>
 #include <game/mapitems_ex.h>
 
@@ -105,3 +112,444 @@ TEST(Datafile, StringData)
 		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
 	}
 }
+
+static void FillData(std::vector<char> &vData, size_t Size, unsigned Seed)
+{
+	vData.resize(Size);
+	for(size_t i = 0; i < Size; i++)
+	{
+		// compressible but not trivial
+		Seed = Seed * 1103515245 + 12345;
+		vData[i] = (char)((Seed >> 16) % 8);
+	}
+}
+
+TEST(Datafile, MappedMatchesRead)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	// sizes that used to be handled differently
+	const size_t aSizes[] = {1, 3, 100, 4096, 100000, 300000, 2 * 1024 * 1024, 17};
+	std::vector<char> avData[std::size(aSizes)];
+	for(size_t i = 0; i < std::size(aSizes); i++)
+		FillData(avData[i], aSizes[i], i);
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		for(const auto &vData : avData)
+			Writer.AddData(vData.size(), vData.data());
+		Writer.Finish();
+	}
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL));
+	CDataFileReader MappedReader;
+	ASSERT_TRUE(MappedReader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+
+	EXPECT_EQ(Reader.Sha256(), MappedReader.Sha256());
+	EXPECT_EQ(Reader.Crc(), MappedReader.Crc());
+	EXPECT_EQ(Reader.MapSize(), MappedReader.MapSize());
+	ASSERT_EQ(MappedReader.NumData(), (int)std::size(aSizes));
+
+	for(int i = 0; i < MappedReader.NumData(); i++)
+	{
+		ASSERT_EQ(MappedReader.GetDataSize(i), (int)aSizes[i]);
+		const char *pData = (const char *)MappedReader.GetData(i);
+		ASSERT_TRUE(pData);
+		EXPECT_EQ(mem_comp(pData, avData[i].data(), aSizes[i]), 0);
+		EXPECT_EQ(mem_comp(pData, Reader.GetData(i), aSizes[i]), 0);
+		EXPECT_EQ(MappedReader.GetData(i), pData);
+	}
+
+	// unloading and replacing must work for all kinds of data
+	for(int i = 0; i < MappedReader.NumData(); i++)
+	{
+		MappedReader.UnloadData(i);
+		const char *pData = (const char *)MappedReader.GetData(i);
+		ASSERT_TRUE(pData);
+		EXPECT_EQ(mem_comp(pData, avData[i].data(), aSizes[i]), 0);
+
+		char *pReplacement = (char *)malloc(4);
+		str_copy(pReplacement, "abc", 4);
+		MappedReader.ReplaceData(i, pReplacement, 4);
+		EXPECT_EQ(MappedReader.GetDataSize(i), 4);
+		EXPECT_STREQ((const char *)MappedReader.GetData(i), "abc");
+	}
+
+	MappedReader.Close();
+	Reader.Close();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, ReleasedMappingSurvivesTruncation)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	std::vector<char> avData[4];
+	for(size_t i = 0; i < std::size(avData); i++)
+		FillData(avData[i], 100000, i);
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		for(const auto &vData : avData)
+			Writer.AddData(vData.size(), vData.data());
+		Writer.Finish();
+	}
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+	ASSERT_TRUE(Reader.GetData(0));
+	ASSERT_TRUE(Reader.GetData(1));
+	Reader.ReleaseMapping();
+	// data loaded after the mapping was released is read from the file
+	const char *pData = (const char *)Reader.GetData(2);
+	ASSERT_TRUE(pData);
+	EXPECT_EQ(mem_comp(pData, avData[2].data(), avData[2].size()), 0);
+
+	// overwrite the file in place like cp does
+	IOHANDLE File = io_open(Info.m_aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	io_write(File, "DATA", 4);
+	io_close(File);
+
+	for(int i = 0; i < 3; i++)
+	{
+		pData = (const char *)Reader.GetData(i);
+		ASSERT_TRUE(pData);
+		EXPECT_EQ(mem_comp(pData, avData[i].data(), avData[i].size()), 0);
+	}
+	EXPECT_FALSE(Reader.GetData(3));
+	Reader.Close();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+#if defined(CONF_PLATFORM_LINUX)
+// returns how much of the mappings of the file has been copied into
+// anonymous memory, or -1 if the file is not mapped
+static int64_t MappedAnonymousBytes(const char *pFilename)
+{
+	char aSuffix[IO_MAX_PATH_LENGTH];
+	str_format(aSuffix, sizeof(aSuffix), "/%s", pFilename);
+	CLineReader LineReader;
+	if(!LineReader.OpenFile(io_open("/proc/self/smaps", IOFLAG_READ)))
+		return -1;
+	int64_t Result = -1;
+	bool InMapping = false;
+	while(const char *pLine = LineReader.Get())
+	{
+		// the fields of a mapping follow the line with its address range
+		const char *pDash = str_find(pLine, "-");
+		const char *pSpace = str_find(pLine, " ");
+		if(pDash && pSpace && pDash < pSpace)
+		{
+			InMapping = str_endswith(pLine, aSuffix) != nullptr;
+			if(InMapping && Result < 0)
+				Result = 0;
+		}
+		else if(InMapping && str_startswith(pLine, "Anonymous:"))
+		{
+			Result += str_toint(pLine + str_length("Anonymous:")) * (int64_t)1024;
+		}
+	}
+	return Result;
+}
+
+TEST(Datafile, MappedDataIsShared)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		std::vector<char> vData;
+		for(int i = 0; i < 8; i++)
+		{
+			FillData(vData, 1024 * 1024, i);
+			Writer.AddData(vData.size(), vData.data());
+		}
+		Writer.Finish();
+	}
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+	for(int i = 0; i < Reader.NumData(); i++)
+		ASSERT_TRUE(Reader.GetData(i));
+	// reading the compressed data must not copy the file
+	EXPECT_EQ(MappedAnonymousBytes(Info.m_aFilename), 0);
+	Reader.Close();
+	EXPECT_EQ(MappedAnonymousBytes(Info.m_aFilename), -1);
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+#endif
+
+TEST(Datafile, CachedDataMatchesLoaded)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+	char aOther[IO_MAX_PATH_LENGTH], aCache[IO_MAX_PATH_LENGTH], aCachePath[IO_MAX_PATH_LENGTH];
+	Info.Filename(aOther, sizeof(aOther), "-other.map");
+	Info.Filename(aCache, sizeof(aCache), ".mapdata");
+	pStorage->GetCompletePath(IStorage::TYPE_SAVE, aCache, aCachePath, sizeof(aCachePath));
+
+	const size_t aSizes[] = {1, 100, 4096, 300000, 17};
+	std::vector<char> avData[std::size(aSizes)];
+	for(size_t i = 0; i < std::size(aSizes); i++)
+		FillData(avData[i], aSizes[i], i);
+
+	for(const char *pFilename : {(const char *)Info.m_aFilename, (const char *)aOther})
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), pFilename);
+		for(const auto &vData : avData)
+			Writer.AddData(vData.size(), vData.data());
+		// the other file differs in one byte
+		Writer.AddData(1, pFilename == Info.m_aFilename ? "a" : "b");
+		Writer.Finish();
+	}
+
+	CDataFileReader Reader;
+	ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+	// one item is left unloaded and one is replaced, like the tile layers of maps
+	for(int i = 0; i < Reader.NumData(); i++)
+	{
+		if(i != 2)
+		{
+			ASSERT_TRUE(Reader.GetData(i));
+		}
+	}
+	char *pReplacement = (char *)malloc(4);
+	str_copy(pReplacement, "abc", 4);
+	Reader.ReplaceData(1, pReplacement, 4);
+	ASSERT_TRUE(Reader.SaveLoadedData(aCachePath));
+
+	CDataFileReader CachedReader;
+	ASSERT_TRUE(CachedReader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, true));
+	ASSERT_TRUE(CachedReader.LoadCachedData(aCachePath));
+	for(CDataFileReader *pReader : {&Reader, &CachedReader})
+	{
+		ASSERT_EQ(pReader->NumData(), (int)std::size(aSizes) + 1);
+		for(int i = 0; i < pReader->NumData(); i++)
+		{
+			const char *pData = (const char *)pReader->GetData(i);
+			ASSERT_TRUE(pData);
+			if(i == 1)
+			{
+				EXPECT_EQ(pReader->GetDataSize(i), 4);
+				EXPECT_STREQ(pData, "abc");
+			}
+			else if(i < (int)std::size(aSizes))
+			{
+				ASSERT_EQ(pReader->GetDataSize(i), (int)aSizes[i]);
+				EXPECT_EQ(mem_comp(pData, avData[i].data(), aSizes[i]), 0);
+			}
+		}
+	}
+
+#if defined(CONF_PLATFORM_LINUX)
+	// reading the cached data must not copy it, so other processes share it
+	EXPECT_EQ(MappedAnonymousBytes(aCache), 0);
+#endif
+
+	// the cache belongs to a different file
+	CDataFileReader OtherReader;
+	ASSERT_TRUE(OtherReader.Open(pStorage.get(), aOther, IStorage::TYPE_ALL, true));
+	EXPECT_FALSE(OtherReader.LoadCachedData(aCachePath));
+	EXPECT_EQ(mem_comp(OtherReader.GetData(std::size(aSizes)), "b", 1), 0);
+
+	OtherReader.Close();
+	CachedReader.Close();
+	Reader.Close();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aOther, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aCache, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Datafile, PreloadMatchesLoad)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	auto pEngine = std::unique_ptr<IEngine>(CreateTestEngine("ddnet-test", 4));
+	CTestInfo Info;
+
+	const size_t aSizes[] = {1, 100, 4096, 100000, 300000, 2 * 1024 * 1024, 17, 5000};
+	std::vector<char> avData[std::size(aSizes)];
+	for(size_t i = 0; i < std::size(aSizes); i++)
+		FillData(avData[i], aSizes[i], i);
+
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		for(const auto &vData : avData)
+			Writer.AddData(vData.size(), vData.data());
+		Writer.Finish();
+	}
+
+	for(bool MapFile : {false, true})
+	{
+		CDataFileReader Reader;
+		ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, MapFile));
+
+		// already loaded, invalid and duplicate indices are skipped
+		const void *pLoaded = Reader.GetData(2);
+		Reader.PreloadData(pEngine.get(), {-1, 0, 2, 3, 3, 5, 100});
+		EXPECT_EQ(Reader.GetData(2), pLoaded);
+		Reader.PreloadAllData(nullptr);
+
+		for(int i = 0; i < Reader.NumData(); i++)
+		{
+			ASSERT_EQ(Reader.GetDataSize(i), (int)aSizes[i]);
+			const char *pData = (const char *)Reader.GetData(i);
+			ASSERT_TRUE(pData);
+			EXPECT_EQ(mem_comp(pData, avData[i].data(), aSizes[i]), 0);
+		}
+		Reader.Close();
+	}
+
+	pEngine->ShutdownJobs();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+	}
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(Datafile, DISABLED_BenchmarkMappedLoad)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	// roughly the data of a big map, many small layers and some large images
+	{
+		CDataFileWriter Writer;
+		Writer.Open(pStorage.get(), Info.m_aFilename);
+		std::vector<char> vData;
+		for(int i = 0; i < 2000; i++)
+		{
+			FillData(vData, 16 * 1024, i);
+			Writer.AddData(vData.size(), vData.data());
+		}
+		for(int i = 0; i < 20; i++)
+		{
+			FillData(vData, 4 * 1024 * 1024, i);
+			Writer.AddData(vData.size(), vData.data());
+		}
+		Writer.Finish();
+	}
+
+	for(bool MapFile : {false, true})
+	{
+		const int NumRuns = 5;
+		std::chrono::nanoseconds OpenTime(0);
+		std::chrono::nanoseconds DataTime(0);
+		for(int Run = 0; Run < NumRuns; Run++)
+		{
+			CDataFileReader Reader;
+			const auto OpenStart = time_get_nanoseconds();
+			ASSERT_TRUE(Reader.Open(pStorage.get(), Info.m_aFilename, IStorage::TYPE_ALL, MapFile));
+			const auto DataStart = time_get_nanoseconds();
+			for(int i = 0; i < Reader.NumData(); i++)
+				ASSERT_TRUE(Reader.GetData(i));
+			OpenTime += DataStart - OpenStart;
+			DataTime += time_get_nanoseconds() - DataStart;
+		}
+		dbg_msg("datafile", "%s: open=%.2fms data=%.2fms per load", MapFile ? "mapped" : "read",
+			std::chrono::duration<double, std::milli>(OpenTime).count() / NumRuns,
+			std::chrono::duration<double, std::milli>(DataTime).count() / NumRuns);
+	}
+
+	pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+}
+
+static void WriteSyntheticMap(IStorage *pStorage, const char *pFilename, IEngine *pEngine, int NumThreads, int NumLayers, int NumImages)
+{
+	// many small layers and some large images
+	CDataFileWriter Writer;
+	ASSERT_TRUE(Writer.Open(pStorage, pFilename));
+	std::vector<char> vData;
+	for(int i = 0; i < NumLayers; i++)
+	{
+		FillData(vData, 16 * 1024, i);
+		Writer.AddData(vData.size(), vData.data());
+	}
+	for(int i = 0; i < NumImages; i++)
+	{
+		FillData(vData, 2 * 1024 * 1024, i);
+		Writer.AddData(vData.size(), vData.data(), i % 2 ? CDataFileWriter::COMPRESSION_BEST : CDataFileWriter::COMPRESSION_DEFAULT);
+	}
+	Writer.Finish(pEngine, NumThreads);
+}
+
+TEST(Datafile, ParallelFinishMatchesSerial)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	auto pEngine = std::unique_ptr<IEngine>(CreateTestEngine("ddnet-test", 2));
+	CTestInfo Info;
+	char aSerial[IO_MAX_PATH_LENGTH], aThreads[IO_MAX_PATH_LENGTH], aJobs[IO_MAX_PATH_LENGTH];
+	Info.Filename(aSerial, sizeof(aSerial), "-serial.tmp");
+	Info.Filename(aThreads, sizeof(aThreads), "-threads.tmp");
+	Info.Filename(aJobs, sizeof(aJobs), "-jobs.tmp");
+
+	WriteSyntheticMap(pStorage.get(), aSerial, nullptr, 1, 40, 1);
+	WriteSyntheticMap(pStorage.get(), aThreads, nullptr, 4, 40, 1);
+	WriteSyntheticMap(pStorage.get(), aJobs, pEngine.get(), 4, 40, 1);
+	pEngine->ShutdownJobs();
+
+	CDataFileReader Serial, Threads, Jobs;
+	ASSERT_TRUE(Serial.Open(pStorage.get(), aSerial, IStorage::TYPE_ALL));
+	ASSERT_TRUE(Threads.Open(pStorage.get(), aThreads, IStorage::TYPE_ALL));
+	ASSERT_TRUE(Jobs.Open(pStorage.get(), aJobs, IStorage::TYPE_ALL));
+	EXPECT_EQ(Serial.Sha256(), Threads.Sha256());
+	EXPECT_EQ(Serial.Sha256(), Jobs.Sha256());
+	Serial.Close();
+	Threads.Close();
+	Jobs.Close();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(aSerial, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aThreads, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aJobs, IStorage::TYPE_SAVE);
+	}
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(Datafile, DISABLED_BenchmarkFinish)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+
+	for(int NumThreads : {1, 2, 4, 8})
+	{
+		const int NumRuns = 3;
+		std::chrono::nanoseconds Time(0);
+		for(int Run = 0; Run < NumRuns; Run++)
+		{
+			const auto Start = time_get_nanoseconds();
+			WriteSyntheticMap(pStorage.get(), Info.m_aFilename, nullptr, NumThreads, 500, 8);
+			Time += time_get_nanoseconds() - Start;
+		}
+		dbg_msg("datafile", "threads=%d: %.2fms per save", NumThreads, std::chrono::duration<double, std::milli>(Time).count() / NumRuns);
+	}
+
+	pStorage->RemoveFile(Info.m_aFilename, IStorage::TYPE_SAVE);
+}
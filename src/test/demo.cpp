@@ -0,0 +1,250 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <engine/shared/demo.h>
+#include <engine/shared/network.h>
+#include <engine/shared/snapshot.h>
+#include <engine/storage.h>
+
+#include <game/generated/protocol.h>
+#include <game/version.h>
+
+#include <memory>
+#include <vector>
+
+static void RecordTick(CDemoRecorder *pRecorder, int Tick)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	CNetObj_Flag *pFlag = static_cast<CNetObj_Flag *>(Builder.NewItem(CNetObj_Flag::ms_MsgId, 0, sizeof(CNetObj_Flag)));
+	ASSERT_TRUE(pFlag);
+	pFlag->m_X = Tick;
+	pFlag->m_Y = Tick / 100;
+	pFlag->m_Team = 0;
+
+	char aData[CSnapshot::MAX_SIZE];
+	const int Size = Builder.Finish(aData);
+	pRecorder->RecordSnapshot(Tick, aData, Size);
+
+	if(Tick % 100 == 1)
+	{
+		char aMessage[32];
+		str_format(aMessage, sizeof(aMessage), "message %d", Tick);
+		pRecorder->RecordMessage(aMessage, str_length(aMessage));
+	}
+}
+
+static void StartDemo(CDemoRecorder *pRecorder, IStorage *pStorage, const char *pFilename)
+{
+	// demo chunks are huffman compressed
+	CNetBase::Init();
+
+	unsigned char aMapData[1] = {0};
+	ASSERT_EQ(pRecorder->Start(pStorage, nullptr, pFilename, GAME_NETVERSION, "test", SHA256_ZEROED, 0, "server", sizeof(aMapData), aMapData, nullptr, nullptr, nullptr), 0);
+}
+
+static void RecordDemo(IStorage *pStorage, const char *pFilename, int NumTicks, bool Async = false)
+{
+	CSnapshotDelta SnapshotDelta;
+	CDemoRecorder Recorder(&SnapshotDelta, true, Async);
+	StartDemo(&Recorder, pStorage, pFilename);
+
+	// one snapshot every few ticks, keyframes come every 5 seconds
+	for(int Tick = 1; Tick <= NumTicks; Tick += 10)
+		RecordTick(&Recorder, Tick);
+	ASSERT_EQ(Recorder.Stop(IDemoRecorder::EStopMode::KEEP_FILE), 0);
+}
+
+// returns whether the two demos only differ in the timestamp
+static bool SameDemo(IStorage *pStorage, const char *pFilename1, const char *pFilename2)
+{
+	void *apData[2];
+	unsigned aSize[2];
+	if(!pStorage->ReadFile(pFilename1, IStorage::TYPE_SAVE, &apData[0], &aSize[0]))
+		return false;
+	if(!pStorage->ReadFile(pFilename2, IStorage::TYPE_SAVE, &apData[1], &aSize[1]))
+	{
+		free(apData[0]);
+		return false;
+	}
+	bool Same = aSize[0] == aSize[1] && aSize[0] > sizeof(CDemoHeader);
+	if(Same)
+	{
+		for(void *pData : apData)
+			mem_zero(((CDemoHeader *)pData)->m_aTimestamp, sizeof(CDemoHeader::m_aTimestamp));
+		Same = mem_comp(apData[0], apData[1], aSize[0]) == 0;
+	}
+	free(apData[0]);
+	free(apData[1]);
+	return Same;
+}
+
+TEST(Demo, SeekIndexMatchesScan)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+	char aDemo[IO_MAX_PATH_LENGTH], aIndex[IO_MAX_PATH_LENGTH];
+	Info.Filename(aDemo, sizeof(aDemo), ".demo");
+	Info.Filename(aIndex, sizeof(aIndex), ".demo.idx");
+
+	// long enough to get a seek index
+	RecordDemo(pStorage.get(), aDemo, 150 * SERVER_TICK_SPEED * 6);
+	ASSERT_TRUE(pStorage->FileExists(aIndex, IStorage::TYPE_SAVE));
+
+	CSnapshotDelta SnapshotDelta;
+	CDemoPlayer Indexed(&SnapshotDelta, false);
+	ASSERT_EQ(Indexed.Load(pStorage.get(), nullptr, aDemo, IStorage::TYPE_ALL), 0);
+
+	ASSERT_TRUE(pStorage->RemoveFile(aIndex, IStorage::TYPE_SAVE));
+	CDemoPlayer Scanned(&SnapshotDelta, false);
+	ASSERT_EQ(Scanned.Load(pStorage.get(), nullptr, aDemo, IStorage::TYPE_ALL), 0);
+
+	EXPECT_EQ(Indexed.BaseInfo()->m_FirstTick, Scanned.BaseInfo()->m_FirstTick);
+	EXPECT_EQ(Indexed.BaseInfo()->m_LastTick, Scanned.BaseInfo()->m_LastTick);
+
+	for(float Percent : {0.0f, 0.1f, 0.5f, 0.77f, 1.0f})
+	{
+		EXPECT_EQ(Indexed.SeekPercent(Percent), 0);
+		EXPECT_EQ(Scanned.SeekPercent(Percent), 0);
+		EXPECT_EQ(Indexed.BaseInfo()->m_CurrentTick, Scanned.BaseInfo()->m_CurrentTick);
+		EXPECT_EQ(Indexed.Info()->m_NextTick, Scanned.Info()->m_NextTick);
+	}
+
+	Indexed.Stop();
+	Scanned.Stop();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(aDemo, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Demo, SeekIndexOnlyForLongDemos)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+	char aDemo[IO_MAX_PATH_LENGTH], aIndex[IO_MAX_PATH_LENGTH];
+	Info.Filename(aDemo, sizeof(aDemo), ".demo");
+	Info.Filename(aIndex, sizeof(aIndex), ".demo.idx");
+
+	RecordDemo(pStorage.get(), aDemo, 150 * SERVER_TICK_SPEED * 6);
+	ASSERT_TRUE(pStorage->FileExists(aIndex, IStorage::TYPE_SAVE));
+
+	// the index of the previous demo must not be used for the new one
+	RecordDemo(pStorage.get(), aDemo, SERVER_TICK_SPEED * 60);
+	EXPECT_FALSE(pStorage->FileExists(aIndex, IStorage::TYPE_SAVE));
+
+	CSnapshotDelta SnapshotDelta;
+	CDemoPlayer Player(&SnapshotDelta, false);
+	ASSERT_EQ(Player.Load(pStorage.get(), nullptr, aDemo, IStorage::TYPE_ALL), 0);
+	EXPECT_EQ(Player.BaseInfo()->m_FirstTick, 1);
+	EXPECT_EQ(Player.BaseInfo()->m_LastTick, 1 + (SERVER_TICK_SPEED * 60 - 1) / 10 * 10);
+	Player.Stop();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(aDemo, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Demo, SeekIndexMovesWithDemo)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+	char aDemo[IO_MAX_PATH_LENGTH], aIndex[IO_MAX_PATH_LENGTH], aRenamed[IO_MAX_PATH_LENGTH], aRenamedIndex[IO_MAX_PATH_LENGTH];
+	Info.Filename(aDemo, sizeof(aDemo), ".demo");
+	Info.Filename(aIndex, sizeof(aIndex), ".demo.idx");
+	Info.Filename(aRenamed, sizeof(aRenamed), "-renamed.demo");
+	Info.Filename(aRenamedIndex, sizeof(aRenamedIndex), "-renamed.demo.idx");
+
+	RecordDemo(pStorage.get(), aDemo, 150 * SERVER_TICK_SPEED * 6);
+	ASSERT_TRUE(pStorage->FileExists(aIndex, IStorage::TYPE_SAVE));
+
+	ASSERT_TRUE(RenameDemoFile(pStorage.get(), aDemo, aRenamed, IStorage::TYPE_SAVE));
+	EXPECT_FALSE(pStorage->FileExists(aIndex, IStorage::TYPE_SAVE));
+	EXPECT_TRUE(pStorage->FileExists(aRenamedIndex, IStorage::TYPE_SAVE));
+
+	CSnapshotDelta SnapshotDelta;
+	CDemoPlayer Player(&SnapshotDelta, false);
+	ASSERT_EQ(Player.Load(pStorage.get(), nullptr, aRenamed, IStorage::TYPE_ALL), 0);
+	EXPECT_EQ(Player.SeekPercent(0.5f), 0);
+	Player.Stop();
+
+	ASSERT_TRUE(RemoveDemoFile(pStorage.get(), aRenamed, IStorage::TYPE_SAVE));
+	EXPECT_FALSE(pStorage->FileExists(aRenamed, IStorage::TYPE_SAVE));
+	EXPECT_FALSE(pStorage->FileExists(aRenamedIndex, IStorage::TYPE_SAVE));
+}
+
+TEST(Demo, AsyncMatchesSync)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+	char aSync[IO_MAX_PATH_LENGTH], aAsync[IO_MAX_PATH_LENGTH];
+	Info.Filename(aSync, sizeof(aSync), "-sync.demo");
+	Info.Filename(aAsync, sizeof(aAsync), "-async.demo");
+
+	RecordDemo(pStorage.get(), aSync, SERVER_TICK_SPEED * 120);
+	RecordDemo(pStorage.get(), aAsync, SERVER_TICK_SPEED * 120, true);
+
+	EXPECT_TRUE(SameDemo(pStorage.get(), aSync, aAsync));
+
+	CSnapshotDelta SnapshotDelta;
+	CDemoPlayer Player(&SnapshotDelta, false);
+	ASSERT_EQ(Player.Load(pStorage.get(), nullptr, aAsync, IStorage::TYPE_ALL), 0);
+	EXPECT_EQ(Player.BaseInfo()->m_FirstTick, 1);
+	EXPECT_EQ(Player.BaseInfo()->m_LastTick, 1 + (SERVER_TICK_SPEED * 120 - 1) / 10 * 10);
+	Player.Stop();
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(aSync, IStorage::TYPE_SAVE);
+		pStorage->RemoveFile(aAsync, IStorage::TYPE_SAVE);
+	}
+}
+
+TEST(Demo, AsyncRecordersShareWriter)
+{
+	auto pStorage = std::unique_ptr<IStorage>(CreateLocalStorage());
+	CTestInfo Info;
+	char aSync[IO_MAX_PATH_LENGTH];
+	Info.Filename(aSync, sizeof(aSync), "-sync.demo");
+	RecordDemo(pStorage.get(), aSync, SERVER_TICK_SPEED * 60);
+
+	// interleaved recordings that stop at different times, the last one
+	// starts again after the others stopped
+	enum
+	{
+		NUM_RECORDERS = 4,
+	};
+	CSnapshotDelta SnapshotDelta;
+	std::vector<std::unique_ptr<CDemoRecorder>> vpRecorders;
+	char aaFilenames[NUM_RECORDERS + 1][IO_MAX_PATH_LENGTH];
+	for(int i = 0; i < NUM_RECORDERS; i++)
+	{
+		char aSuffix[32];
+		str_format(aSuffix, sizeof(aSuffix), "-async%d.demo", i);
+		Info.Filename(aaFilenames[i], sizeof(aaFilenames[i]), aSuffix);
+		vpRecorders.push_back(std::make_unique<CDemoRecorder>(&SnapshotDelta, true, true));
+		StartDemo(vpRecorders[i].get(), pStorage.get(), aaFilenames[i]);
+	}
+	for(int Tick = 1; Tick <= SERVER_TICK_SPEED * 60; Tick += 10)
+		for(auto &pRecorder : vpRecorders)
+			RecordTick(pRecorder.get(), Tick);
+	for(int i = NUM_RECORDERS - 1; i >= 0; i--)
+		ASSERT_EQ(vpRecorders[i]->Stop(IDemoRecorder::EStopMode::KEEP_FILE), 0);
+
+	Info.Filename(aaFilenames[NUM_RECORDERS], sizeof(aaFilenames[NUM_RECORDERS]), "-restarted.demo");
+	RecordDemo(pStorage.get(), aaFilenames[NUM_RECORDERS], SERVER_TICK_SPEED * 60, true);
+
+	for(const auto &aFilename : aaFilenames)
+		EXPECT_TRUE(SameDemo(pStorage.get(), aSync, aFilename)) << aFilename;
+
+	if(!HasFailure())
+	{
+		pStorage->RemoveFile(aSync, IStorage::TYPE_SAVE);
+		for(const auto &aFilename : aaFilenames)
+			pStorage->RemoveFile(aFilename, IStorage::TYPE_SAVE);
+	}
+}
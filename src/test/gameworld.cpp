@@ -14,9 +14,13 @@
 #include <engine/shared/assertion_logger.h>
 #include <engine/shared/config.h>
 #include <game/generated/protocol.h>
+#include <game/prng.h>
 #include <game/server/entities/character.h>
+#include <game/server/entities/pickup.h>
+#include <game/server/entities/projectile.h>
 #include <game/server/gamecontext.h>
 #include <game/server/gameworld.h>
+#include <game/server/player.h>
 #include <game/version.h>
 
 #include <memory>
@@ -146,3 +150,184 @@ TEST_F(CTestGameWorld, ClosestCharacter)
 	CCharacter *pClosest = GameServer()->m_World.ClosestCharacter(vec2(1, 1), 20, nullptr);
 	EXPECT_EQ(pClosest, pChr1);
 }
+
+static vec2 RandomPos(CPrng &Prng, float Size)
+{
+	return vec2(Prng.RandomBits() % 100000 / 100000.0f * Size, Prng.RandomBits() % 100000 / 100000.0f * Size);
+}
+
+static int FindEntitiesLinear(CGameWorld *pWorld, vec2 Pos, float Radius, CEntity **ppEnts, int Max, int Type)
+{
+	int Num = 0;
+	for(CEntity *pEnt = pWorld->FindFirst(Type); pEnt && Num < Max; pEnt = pEnt->TypeNext())
+	{
+		if(distance(pEnt->GetPos(), Pos) < Radius + pEnt->GetProximityRadius())
+			ppEnts[Num++] = pEnt;
+	}
+	return Num;
+}
+
+TEST_F(CTestGameWorld, EntityGridMatchesLinearScan)
+{
+	CGameWorld *pWorld = &GameServer()->m_World;
+	uint64_t aSeed[2] = {1, 2};
+	CPrng Prng;
+	Prng.Seed(aSeed);
+
+	CNetObj_PlayerInput Input = {};
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		CCharacter *pChr = new(i) CCharacter(pWorld, Input);
+		pChr->m_Pos = RandomPos(Prng, 3000.0f);
+		pWorld->InsertEntity(pChr);
+	}
+
+	const float aRadii[] = {0.0f, 20.0f, 135.0f, 700.0f, 10000.0f};
+	for(int Round = 0; Round < 20; Round++)
+	{
+		// move some characters across cells, some only a little
+		for(CEntity *pEnt = pWorld->FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+		{
+			if(Prng.RandomBits() % 2)
+				pEnt->SetPos(RandomPos(Prng, 3000.0f));
+			else
+				pEnt->SetPos(pEnt->GetPos() + RandomPos(Prng, 8.0f));
+		}
+
+		for(int Query = 0; Query < 50; Query++)
+		{
+			const vec2 Pos = RandomPos(Prng, 3000.0f);
+			const vec2 To = Pos + RandomPos(Prng, 800.0f) - vec2(400.0f, 400.0f);
+			for(float Radius : aRadii)
+			{
+				CEntity *apExpected[MAX_CLIENTS];
+				CEntity *apFound[MAX_CLIENTS];
+				for(int Max : {4, (int)MAX_CLIENTS})
+				{
+					const int NumExpected = FindEntitiesLinear(pWorld, Pos, Radius, apExpected, Max, CGameWorld::ENTTYPE_CHARACTER);
+					const int NumFound = pWorld->FindEntities(Pos, Radius, apFound, Max, CGameWorld::ENTTYPE_CHARACTER);
+					ASSERT_EQ(NumFound, NumExpected);
+					for(int i = 0; i < NumFound; i++)
+						EXPECT_EQ(apFound[i], apExpected[i]);
+				}
+
+				CCharacter *pClosest = nullptr;
+				float ClosestRange = Radius * 2;
+				CCharacter *pIntersected = nullptr;
+				float ClosestLen = distance(Pos, To) * 100.0f;
+				std::vector<CCharacter *> vpIntersected;
+				for(CEntity *pEnt = pWorld->FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+				{
+					float Len = distance(Pos, pEnt->GetPos());
+					if(Len < pEnt->GetProximityRadius() + Radius && Len < ClosestRange)
+					{
+						ClosestRange = Len;
+						pClosest = (CCharacter *)pEnt;
+					}
+					vec2 IntersectPos;
+					if(closest_point_on_line(Pos, To, pEnt->GetPos(), IntersectPos) && distance(pEnt->GetPos(), IntersectPos) < pEnt->GetProximityRadius() + Radius)
+					{
+						vpIntersected.push_back((CCharacter *)pEnt);
+						if(distance(Pos, IntersectPos) < ClosestLen)
+						{
+							ClosestLen = distance(Pos, IntersectPos);
+							pIntersected = (CCharacter *)pEnt;
+						}
+					}
+				}
+				EXPECT_EQ(pWorld->ClosestCharacter(Pos, Radius, nullptr), pClosest);
+				vec2 NewPos;
+				EXPECT_EQ(pWorld->IntersectCharacter(Pos, To, Radius, NewPos), pIntersected);
+				EXPECT_EQ(pWorld->IntersectedCharacters(Pos, To, Radius), vpIntersected);
+			}
+		}
+	}
+}
+
+TEST_F(CTestGameWorld, SnapVisibleMatchesFullTraversal)
+{
+	CGameWorld *pWorld = &GameServer()->m_World;
+	uint64_t aSeed[2] = {5, 6};
+	CPrng Prng;
+	Prng.Seed(aSeed);
+
+	CPlayer *pPlayer = new(0) CPlayer(GameServer(), 0, 0, TEAM_RED);
+	GameServer()->m_apPlayers[0] = pPlayer;
+	for(int i = 0; i < 300; i++)
+	{
+		CPickup *pPickup = new CPickup(pWorld, POWERUP_HEALTH);
+		pPickup->SetPos(RandomPos(Prng, 6000.0f));
+	}
+	for(int i = 0; i < 300; i++)
+		new CProjectile(pWorld, WEAPON_GRENADE, -1, RandomPos(Prng, 6000.0f), vec2(1, 0), 1000, false, true, -1, vec2(1, 0));
+
+	const vec2 aShowDistances[] = {vec2(1200, 800), vec2(0, 0), vec2(-10, -10), vec2(3000, 3000), vec2(100000, 100000)};
+	for(int Round = 0; Round < 20; Round++)
+	{
+		pPlayer->m_ViewPos = RandomPos(Prng, 6000.0f);
+		pPlayer->m_ShowDistance = aShowDistances[Round % std::size(aShowDistances)];
+		pPlayer->m_ShowAll = Round % 7 == 0;
+
+		static char s_aExpected[CSnapshot::MAX_SIZE];
+		m_pServer->m_SnapshotBuilder.Init();
+		for(CEntity *pEnt = pWorld->FindFirst(CGameWorld::ENTTYPE_CHARACTER); pEnt; pEnt = pEnt->TypeNext())
+			pEnt->Snap(0);
+		for(int Type = 0; Type < CGameWorld::NUM_ENTTYPES; Type++)
+		{
+			if(Type == CGameWorld::ENTTYPE_CHARACTER)
+				continue;
+			for(CEntity *pEnt = pWorld->FindFirst(Type); pEnt; pEnt = pEnt->TypeNext())
+				pEnt->Snap(0);
+		}
+		const int ExpectedSize = m_pServer->m_SnapshotBuilder.Finish(s_aExpected);
+
+		static char s_aSnapped[CSnapshot::MAX_SIZE];
+		m_pServer->m_SnapshotBuilder.Init();
+		pWorld->Snap(0);
+		const int Size = m_pServer->m_SnapshotBuilder.Finish(s_aSnapped);
+
+		ASSERT_EQ(Size, ExpectedSize);
+		EXPECT_EQ(mem_comp(s_aSnapped, s_aExpected, Size), 0);
+		pWorld->PostSnap();
+	}
+
+	GameServer()->m_apPlayers[0] = nullptr;
+	delete pPlayer;
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST_F(CTestGameWorld, DISABLED_Benchmark)
+{
+	CGameWorld *pWorld = &GameServer()->m_World;
+	uint64_t aSeed[2] = {3, 4};
+	CPrng Prng;
+	Prng.Seed(aSeed);
+
+	const int NumProjectiles = 5000;
+	const int NumQueries = 20000;
+	for(int i = 0; i < NumProjectiles; i++)
+		new CProjectile(pWorld, WEAPON_GRENADE, -1, RandomPos(Prng, 16000.0f), vec2(1, 0), 1000, false, true, -1, vec2(1, 0));
+
+	std::vector<vec2> vQueries;
+	for(int i = 0; i < NumQueries; i++)
+		vQueries.push_back(RandomPos(Prng, 16000.0f));
+
+	const int MaxEnts = 256;
+	CEntity *apEnts[MaxEnts];
+	int NumLinear = 0;
+	const auto LinearStart = time_get_nanoseconds();
+	for(vec2 Pos : vQueries)
+		NumLinear += FindEntitiesLinear(pWorld, Pos, 135.0f, apEnts, MaxEnts, CGameWorld::ENTTYPE_PROJECTILE);
+	const auto LinearTime = time_get_nanoseconds() - LinearStart;
+
+	int NumGrid = 0;
+	const auto GridStart = time_get_nanoseconds();
+	for(vec2 Pos : vQueries)
+		NumGrid += pWorld->FindEntities(Pos, 135.0f, apEnts, MaxEnts, CGameWorld::ENTTYPE_PROJECTILE);
+	const auto GridTime = time_get_nanoseconds() - GridStart;
+
+	EXPECT_EQ(NumGrid, NumLinear);
+	dbg_msg("gameworld", "%d entities, %d queries: linear=%.2fms grid=%.2fms", NumProjectiles, NumQueries,
+		std::chrono::duration<double, std::milli>(LinearTime).count(),
+		std::chrono::duration<double, std::milli>(GridTime).count());
+}
@@ -2,6 +2,11 @@
 
 #include <base/system.h>
 #include <engine/shared/huffman.h>
+#include <game/prng.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
 
 TEST(Huffman, CompressionShouldNotChangeData)
 {
@@ -46,3 +51,290 @@ TEST(Huffman, CompressionCompatible)
 	EXPECT_EQ(match, 0) << "The compression is not compatible with older/other implementations anymore";
 	EXPECT_EQ(Size, 15);
 }
+
+// the previous implementation, the output must stay the same
+class CLegacyHuffman
+{
+	enum
+	{
+		HUFFMAN_EOF_SYMBOL = 256,
+		HUFFMAN_MAX_SYMBOLS = HUFFMAN_EOF_SYMBOL + 1,
+		HUFFMAN_MAX_NODES = HUFFMAN_MAX_SYMBOLS * 2 - 1,
+		HUFFMAN_LUTBITS = 10,
+		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+	};
+
+	struct CNode
+	{
+		unsigned m_Bits;
+		unsigned m_NumBits;
+		unsigned short m_aLeafs[2];
+		unsigned char m_Symbol;
+	};
+
+	struct CConstructNode
+	{
+		unsigned short m_NodeId;
+		int m_Frequency;
+	};
+
+	CNode m_aNodes[HUFFMAN_MAX_NODES];
+	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CNode *m_pStartNode;
+	int m_NumNodes;
+
+	void Setbits_r(CNode *pNode, int Bits, unsigned Depth)
+	{
+		if(pNode->m_aLeafs[1] != 0xffff)
+			Setbits_r(&m_aNodes[pNode->m_aLeafs[1]], Bits | (1 << Depth), Depth + 1);
+		if(pNode->m_aLeafs[0] != 0xffff)
+			Setbits_r(&m_aNodes[pNode->m_aLeafs[0]], Bits, Depth + 1);
+		if(pNode->m_NumBits)
+		{
+			pNode->m_Bits = Bits;
+			pNode->m_NumBits = Depth;
+		}
+	}
+
+public:
+	void Init(const unsigned *pFrequencies)
+	{
+		mem_zero(m_aNodes, sizeof(m_aNodes));
+		mem_zero(m_apDecodeLut, sizeof(m_apDecodeLut));
+
+		CConstructNode aNodesLeftStorage[HUFFMAN_MAX_SYMBOLS];
+		CConstructNode *apNodesLeft[HUFFMAN_MAX_SYMBOLS];
+		int NumNodesLeft = HUFFMAN_MAX_SYMBOLS;
+		for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+		{
+			m_aNodes[i].m_NumBits = 0xFFFFFFFF;
+			m_aNodes[i].m_Symbol = i;
+			m_aNodes[i].m_aLeafs[0] = 0xffff;
+			m_aNodes[i].m_aLeafs[1] = 0xffff;
+			aNodesLeftStorage[i].m_Frequency = i == HUFFMAN_EOF_SYMBOL ? 1 : pFrequencies[i];
+			aNodesLeftStorage[i].m_NodeId = i;
+			apNodesLeft[i] = &aNodesLeftStorage[i];
+		}
+		m_NumNodes = HUFFMAN_MAX_SYMBOLS;
+		while(NumNodesLeft > 1)
+		{
+			std::stable_sort(apNodesLeft, apNodesLeft + NumNodesLeft, [](const CConstructNode *pNode1, const CConstructNode *pNode2) {
+				return pNode2->m_Frequency < pNode1->m_Frequency;
+			});
+			m_aNodes[m_NumNodes].m_NumBits = 0;
+			m_aNodes[m_NumNodes].m_aLeafs[0] = apNodesLeft[NumNodesLeft - 1]->m_NodeId;
+			m_aNodes[m_NumNodes].m_aLeafs[1] = apNodesLeft[NumNodesLeft - 2]->m_NodeId;
+			apNodesLeft[NumNodesLeft - 2]->m_NodeId = m_NumNodes;
+			apNodesLeft[NumNodesLeft - 2]->m_Frequency = apNodesLeft[NumNodesLeft - 1]->m_Frequency + apNodesLeft[NumNodesLeft - 2]->m_Frequency;
+			m_NumNodes++;
+			NumNodesLeft--;
+		}
+		m_pStartNode = &m_aNodes[m_NumNodes - 1];
+		Setbits_r(m_pStartNode, 0, 0);
+
+		for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
+		{
+			unsigned Bits = i;
+			int k;
+			CNode *pNode = m_pStartNode;
+			for(k = 0; k < HUFFMAN_LUTBITS; k++)
+			{
+				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+				Bits >>= 1;
+				if(pNode->m_NumBits)
+				{
+					m_apDecodeLut[i] = pNode;
+					break;
+				}
+			}
+			if(k == HUFFMAN_LUTBITS)
+				m_apDecodeLut[i] = pNode;
+		}
+	}
+
+	int Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
+	{
+		const unsigned char *pSrc = (const unsigned char *)pInput;
+		const unsigned char *pSrcEnd = pSrc + InputSize;
+		unsigned char *pDst = (unsigned char *)pOutput;
+		unsigned char *pDstEnd = pDst + OutputSize;
+		unsigned Bits = 0;
+		unsigned Bitcount = 0;
+		for(int i = 0; i <= InputSize; i++)
+		{
+			const int Symbol = pSrc != pSrcEnd ? *pSrc++ : (int)HUFFMAN_EOF_SYMBOL;
+			Bits |= m_aNodes[Symbol].m_Bits << Bitcount;
+			Bitcount += m_aNodes[Symbol].m_NumBits;
+			while(Bitcount >= 8)
+			{
+				*pDst++ = (unsigned char)(Bits & 0xff);
+				if(pDst == pDstEnd)
+					return -1;
+				Bits >>= 8;
+				Bitcount -= 8;
+			}
+		}
+		*pDst++ = Bits;
+		return (int)(pDst - (const unsigned char *)pOutput);
+	}
+
+	int Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize) const
+	{
+		unsigned char *pDst = (unsigned char *)pOutput;
+		const unsigned char *pSrc = (const unsigned char *)pInput;
+		unsigned char *pDstEnd = pDst + OutputSize;
+		const unsigned char *pSrcEnd = pSrc + InputSize;
+		unsigned Bits = 0;
+		unsigned Bitcount = 0;
+		const CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+		while(true)
+		{
+			const CNode *pNode = nullptr;
+			if(Bitcount >= HUFFMAN_LUTBITS)
+				pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+			while(Bitcount < 24 && pSrc != pSrcEnd)
+			{
+				Bits |= (*pSrc++) << Bitcount;
+				Bitcount += 8;
+			}
+			if(!pNode)
+				pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+			if(pNode->m_NumBits)
+			{
+				Bits >>= pNode->m_NumBits;
+				Bitcount -= pNode->m_NumBits;
+			}
+			else
+			{
+				Bits >>= HUFFMAN_LUTBITS;
+				Bitcount -= HUFFMAN_LUTBITS;
+				while(true)
+				{
+					pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+					Bitcount--;
+					Bits >>= 1;
+					if(pNode->m_NumBits)
+						break;
+					if(Bitcount == 0)
+						return -1;
+				}
+			}
+			if(pNode == pEof)
+				break;
+			if(pDst == pDstEnd)
+				return -1;
+			*pDst++ = pNode->m_Symbol;
+		}
+		return (int)(pDst - (const unsigned char *)pOutput);
+	}
+};
+
+// packet like data, mostly small integers and zeros
+static std::vector<unsigned char> RandomPacket(CPrng &Prng, int Size)
+{
+	std::vector<unsigned char> vData(Size);
+	for(unsigned char &Byte : vData)
+	{
+		const unsigned Value = Prng.RandomBits();
+		Byte = Value % 4 == 0 ? Value >> 8 : (Value % 4 == 1 ? (Value >> 8) % 16 : 0);
+	}
+	return vData;
+}
+
+static std::vector<unsigned char> RandomBytes(CPrng &Prng, int Size)
+{
+	std::vector<unsigned char> vData(Size);
+	for(unsigned char &Byte : vData)
+		Byte = Prng.RandomBits();
+	return vData;
+}
+
+TEST(Huffman, MatchesLegacy)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+	CLegacyHuffman Legacy;
+	Legacy.Init(CHuffman::ms_aFreqTable);
+
+	uint64_t aSeed[2] = {7, 8};
+	CPrng Prng;
+	Prng.Seed(aSeed);
+
+	unsigned char aOutput[2048], aLegacyOutput[2048];
+	for(int Run = 0; Run < 20000; Run++)
+	{
+		const int Size = Prng.RandomBits() % 1400;
+		const std::vector<unsigned char> vData = Run % 2 ? RandomPacket(Prng, Size) : RandomBytes(Prng, Size);
+
+		// including too small output buffers
+		const int OutputSize = Run % 5 == 0 ? 1 + Prng.RandomBits() % (Size + 16) : (int)sizeof(aOutput);
+		const int CompressedSize = Huffman.Compress(vData.data(), vData.size(), aOutput, OutputSize);
+		ASSERT_EQ(CompressedSize, Legacy.Compress(vData.data(), vData.size(), aLegacyOutput, OutputSize)) << "run " << Run;
+		if(CompressedSize < 0)
+			continue;
+		ASSERT_EQ(mem_comp(aOutput, aLegacyOutput, CompressedSize), 0) << "run " << Run;
+
+		const int DecompressedSize = Huffman.Decompress(aOutput, CompressedSize, aLegacyOutput, sizeof(aLegacyOutput));
+		ASSERT_EQ(DecompressedSize, Size) << "run " << Run;
+		ASSERT_EQ(mem_comp(aLegacyOutput, vData.data(), Size), 0) << "run " << Run;
+	}
+
+	// the same result for broken input
+	for(int Run = 0; Run < 20000; Run++)
+	{
+		const std::vector<unsigned char> vData = RandomBytes(Prng, Prng.RandomBits() % 64);
+		const int OutputSize = 1 + Prng.RandomBits() % sizeof(aOutput);
+		const int Size = Huffman.Decompress(vData.data(), vData.size(), aOutput, OutputSize);
+		ASSERT_EQ(Size, Legacy.Decompress(vData.data(), vData.size(), aLegacyOutput, OutputSize)) << "run " << Run;
+		if(Size > 0)
+		{
+			ASSERT_EQ(mem_comp(aOutput, aLegacyOutput, Size), 0) << "run " << Run;
+		}
+	}
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(Huffman, DISABLED_BenchmarkPackets)
+{
+	CHuffman Huffman;
+	Huffman.Init();
+	CLegacyHuffman Legacy;
+	Legacy.Init(CHuffman::ms_aFreqTable);
+
+	uint64_t aSeed[2] = {9, 10};
+	CPrng Prng;
+	Prng.Seed(aSeed);
+	std::vector<std::vector<unsigned char>> vvPackets;
+	size_t TotalSize = 0;
+	for(int i = 0; i < 1000; i++)
+	{
+		vvPackets.push_back(RandomPacket(Prng, 100 + Prng.RandomBits() % 1200));
+		TotalSize += vvPackets.back().size();
+	}
+
+	unsigned char aCompressed[2048], aDecompressed[2048];
+	const int NumRuns = 20;
+	auto Measure = [&](const char *pName, auto &&Codec) {
+		auto CompressTime = std::chrono::nanoseconds::zero();
+		auto DecompressTime = std::chrono::nanoseconds::zero();
+		for(int Run = 0; Run < NumRuns; Run++)
+		{
+			for(const auto &vPacket : vvPackets)
+			{
+				const auto Start = time_get_nanoseconds();
+				const int Size = Codec.Compress(vPacket.data(), vPacket.size(), aCompressed, sizeof(aCompressed));
+				const auto Middle = time_get_nanoseconds();
+				EXPECT_EQ(Codec.Decompress(aCompressed, Size, aDecompressed, sizeof(aDecompressed)), (int)vPacket.size());
+				CompressTime += Middle - Start;
+				DecompressTime += time_get_nanoseconds() - Middle;
+			}
+		}
+		const double Megabytes = TotalSize * NumRuns / 1e6;
+		dbg_msg("huffman", "%s: compress %.1f MB/s, decompress %.1f MB/s", pName,
+			Megabytes / std::chrono::duration<double>(CompressTime).count(),
+			Megabytes / std::chrono::duration<double>(DecompressTime).count());
+	};
+	Measure("legacy", Legacy);
+	Measure("current", Huffman);
+}
@@ -0,0 +1,62 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/map_cache.h>
+
+static void WriteFile(const char *pDirectory, const char *pName)
+{
+	char aPath[IO_MAX_PATH_LENGTH];
+	str_format(aPath, sizeof(aPath), "%s/%s", pDirectory, pName);
+	IOHANDLE File = io_open(aPath, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	io_write(File, "data", 4);
+	io_close(File);
+}
+
+static bool Exists(const char *pDirectory, const char *pName)
+{
+	char aPath[IO_MAX_PATH_LENGTH];
+	str_format(aPath, sizeof(aPath), "%s/%s", pDirectory, pName);
+	return fs_is_file(aPath);
+}
+
+TEST(MapCache, RemoveOld)
+{
+	CTestInfo Info;
+	char aDirectory[IO_MAX_PATH_LENGTH];
+	Info.Filename(aDirectory, sizeof(aDirectory), "-cache");
+	ASSERT_EQ(fs_makedir(aDirectory), 0);
+
+#define HASH "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"
+	const char *apCacheFiles[] = {HASH ".map", HASH ".map7", HASH ".mapdata", HASH ".map.123.tmp"};
+	// other files are never removed, even if they look like maps
+	const char *apOtherFiles[] = {"keep.txt", "foo.map", "foo.map.123.tmp", HASH ".map.tmp", HASH ".map.12a.tmp", HASH ".txt", "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF.map", "0123456789abcdef.map"};
+#undef HASH
+	for(const char *pName : apCacheFiles)
+		WriteFile(aDirectory, pName);
+	for(const char *pName : apOtherFiles)
+		WriteFile(aDirectory, pName);
+
+	// files written after the time stay
+	CMapCacheFile::RemoveOld(aDirectory, time_timestamp() - 60 * 60);
+	for(const char *pName : apCacheFiles)
+		EXPECT_TRUE(Exists(aDirectory, pName)) << pName;
+
+	CMapCacheFile::RemoveOld(aDirectory, time_timestamp() + 60 * 60);
+	for(const char *pName : apCacheFiles)
+		EXPECT_FALSE(Exists(aDirectory, pName)) << pName;
+	for(const char *pName : apOtherFiles)
+		EXPECT_TRUE(Exists(aDirectory, pName)) << pName;
+
+	if(!HasFailure())
+	{
+		for(const char *pName : apOtherFiles)
+		{
+			char aPath[IO_MAX_PATH_LENGTH];
+			str_format(aPath, sizeof(aPath), "%s/%s", aDirectory, pName);
+			fs_remove(aPath);
+		}
+		fs_removedir(aDirectory);
+	}
+}
@@ -48,3 +48,64 @@ TEST(Net, Ipv4AndIpv6Work)
 	net_udp_close(Socket1);
 	net_udp_close(Socket2);
 }
+
+TEST(Net, BatchedSend)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4 | NETTYPE_IPV6;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR TargetV4;
+	NETADDR TargetV6;
+	ASSERT_FALSE(net_addr_from_str(&TargetV4, "127.0.0.1"));
+	ASSERT_FALSE(net_addr_from_str(&TargetV6, "[::1]"));
+	TargetV4.port = Bindaddr.port;
+	TargetV6.port = Bindaddr.port;
+
+	// more packets than fit into one batch, and both address families
+	const int NumPackets = 300;
+	net_udp_batch_begin(Socket2);
+	for(int i = 0; i < NumPackets; i++)
+	{
+		char aBuf[16];
+		str_format(aBuf, sizeof(aBuf), "%d", i);
+		EXPECT_EQ(net_udp_send(Socket2, i < 200 ? &TargetV4 : &TargetV6, aBuf, str_length(aBuf)), str_length(aBuf));
+	}
+	const int Saved = net_udp_batch_flush(Socket2);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_GE(Saved, NumPackets - 4);
+#else
+	EXPECT_EQ(Saved, 0);
+#endif
+
+	int aNext[2] = {0, 200};
+	for(int i = 0; i < NumPackets; i++)
+	{
+		NETADDR Addr;
+		unsigned char *pData;
+		// received packets can already be buffered, only wait if there are none
+		int Size = net_udp_recv(Socket1, &Addr, &pData);
+		if(Size <= 0)
+		{
+			ASSERT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+			Size = net_udp_recv(Socket1, &Addr, &pData);
+		}
+		ASSERT_GT(Size, 0);
+		char aBuf[16];
+		str_truncate(aBuf, sizeof(aBuf), (const char *)pData, Size);
+		const int Family = Addr.type == NETTYPE_IPV4 ? 0 : 1;
+		EXPECT_EQ(str_toint(aBuf), aNext[Family]++);
+	}
+	EXPECT_EQ(aNext[0], 200);
+	EXPECT_EQ(aNext[1], NumPackets);
+
+	net_udp_close(Socket1);
+	net_udp_close(Socket2);
+}
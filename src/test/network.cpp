@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <engine/shared/network.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+class NetServer : public ::testing::Test
+{
+protected:
+	CNetServer m_Server;
+	NETADDR m_ServerAddr;
+	CNetClient m_Client;
+	CNetClient m_ClientSixup;
+	// server side client ids, in the order the connections were accepted
+	std::vector<int> m_vClientIds;
+	std::vector<bool> m_vSixup;
+	CConfig m_OldConfig;
+
+	static int NewClient(int ClientId, void *pUser, bool Sixup)
+	{
+		NetServer *pThis = static_cast<NetServer *>(pUser);
+		pThis->m_vClientIds.push_back(ClientId);
+		pThis->m_vSixup.push_back(Sixup);
+		return 0;
+	}
+	static int NewClientNoAuth(int ClientId, void *pUser)
+	{
+		return NewClient(ClientId, pUser, false);
+	}
+	static int ClientRejoin(int ClientId, void *pUser)
+	{
+		return 0;
+	}
+	static int DelClient(int ClientId, const char *pReason, void *pUser)
+	{
+		return 0;
+	}
+
+	void SetUp() override
+	{
+		// the network code reads these, the config isn't loaded in tests
+		m_OldConfig = g_Config;
+		g_Config.m_ConnTimeout = CConfig::ms_ConnTimeout;
+		g_Config.m_ConnTimeoutProtection = CConfig::ms_ConnTimeoutProtection;
+		g_Config.m_SvConnlimit = CConfig::ms_SvConnlimit;
+		g_Config.m_SvConnlimitTime = CConfig::ms_SvConnlimitTime;
+		g_Config.m_SvSixup = CConfig::ms_SvSixup;
+		g_Config.m_SvVanConnPerSecond = CConfig::ms_SvVanConnPerSecond;
+		g_Config.m_SvVanillaAntiSpoof = CConfig::ms_SvVanillaAntiSpoof;
+		CNetBase::Init();
+
+		ASSERT_FALSE(net_addr_from_str(&m_ServerAddr, "127.0.0.1"));
+		do
+		{
+			m_ServerAddr.port = secure_rand() % 64511 + 1024;
+		} while(!m_Server.Open(m_ServerAddr, nullptr, 4, 4));
+		m_Server.SetCallbacks(NewClient, NewClientNoAuth, ClientRejoin, DelClient, this);
+
+		NETADDR BindAddr = {};
+		BindAddr.type = NETTYPE_IPV4;
+		ASSERT_TRUE(m_Client.Open(BindAddr));
+		ASSERT_TRUE(m_ClientSixup.Open(BindAddr));
+		m_Client.Connect(&m_ServerAddr, 1);
+		NETADDR ServerAddrSixup = m_ServerAddr;
+		ServerAddrSixup.type |= NETTYPE_TW7;
+		m_ClientSixup.Connect7(&ServerAddrSixup, 1);
+
+		for(int i = 0; i < 1000 && (m_Client.State() != NETSTATE_ONLINE || m_ClientSixup.State() != NETSTATE_ONLINE || m_vClientIds.size() < 2); i++)
+		{
+			Pump();
+			std::this_thread::sleep_for(1ms);
+		}
+		ASSERT_EQ(m_Client.State(), NETSTATE_ONLINE) << m_Client.ErrorString();
+		ASSERT_EQ(m_ClientSixup.State(), NETSTATE_ONLINE);
+		ASSERT_EQ(m_vClientIds.size(), 2u);
+		// the connections are accepted in any order
+		ASSERT_NE(m_vSixup[0], m_vSixup[1]);
+	}
+
+	void TearDown() override
+	{
+		m_Client.Close();
+		m_ClientSixup.Close();
+		m_Server.Close();
+		g_Config = m_OldConfig;
+	}
+
+	void Pump()
+	{
+		CNetChunk Chunk;
+		SECURITY_TOKEN Token;
+		m_Server.Update();
+		while(m_Server.Recv(&Chunk, &Token))
+		{
+		}
+		m_Client.Update();
+		while(m_Client.Recv(&Chunk, &Token, false))
+		{
+		}
+		m_ClientSixup.Update();
+		while(m_ClientSixup.Recv(&Chunk, &Token, true))
+		{
+		}
+	}
+
+	// returns the chunks the client received without updating the server
+	static std::vector<std::string> Receive(CNetClient *pClient, bool Sixup)
+	{
+		std::vector<std::string> vChunks;
+		CNetChunk Chunk;
+		SECURITY_TOKEN Token;
+		for(int i = 0; i < 100; i++)
+		{
+			while(pClient->Recv(&Chunk, &Token, Sixup))
+				vChunks.emplace_back((const char *)Chunk.m_pData, Chunk.m_DataSize);
+			std::this_thread::sleep_for(1ms);
+		}
+		return vChunks;
+	}
+
+	void SendToClients(const void *pData, int DataSize, const void *pDataSixup, int DataSizeSixup)
+	{
+		CNetChunk Chunk = {};
+		Chunk.m_Flags = NETSENDFLAG_VITAL | NETSENDFLAG_FLUSH;
+		CNetChunk ChunkSixup = Chunk;
+		Chunk.m_pData = pData;
+		Chunk.m_DataSize = DataSize;
+		ChunkSixup.m_pData = pDataSixup;
+		ChunkSixup.m_DataSize = DataSizeSixup;
+		const bool aSixup[] = {m_vSixup[0], m_vSixup[1]};
+		m_Server.SendToClients(&Chunk, &ChunkSixup, m_vClientIds.data(), aSixup, (int)m_vClientIds.size());
+	}
+};
+
+TEST_F(NetServer, SendToClientsMatchingPayload)
+{
+	SendToClients("six", 3, "seven", 5);
+	EXPECT_EQ(Receive(&m_Client, false), std::vector<std::string>{"six"});
+	EXPECT_EQ(Receive(&m_ClientSixup, true), std::vector<std::string>{"seven"});
+}
+
+TEST_F(NetServer, SendToClientsDropsTooBigPayloadPerProtocol)
+{
+	static char s_aBig[NET_MAX_PAYLOAD] = {};
+	SendToClients("six", 3, s_aBig, sizeof(s_aBig));
+	EXPECT_EQ(Receive(&m_Client, false), std::vector<std::string>{"six"});
+	EXPECT_TRUE(Receive(&m_ClientSixup, true).empty());
+
+	SendToClients(s_aBig, sizeof(s_aBig), "seven", 5);
+	EXPECT_TRUE(Receive(&m_Client, false).empty());
+	EXPECT_EQ(Receive(&m_ClientSixup, true), std::vector<std::string>{"seven"});
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/prediction_history.h>
+
+static CPredictionHistory::CState State(int Tick, int FreezeTime = 0, int NumProjectiles = 0)
+{
+	CCharacterCore Core{};
+	Core.m_Pos = vec2(Tick * 2.0f, 64.0f);
+	Core.m_Vel = vec2(2.0f, 0.0f);
+	Core.m_aWeapons[WEAPON_HAMMER].m_Got = true;
+	Core.m_aWeapons[WEAPON_GUN].m_Got = true;
+	Core.m_ActiveWeapon = WEAPON_GUN;
+
+	CPredictionHistory::CState Result;
+	Result.AddCharacter(0, Core, FreezeTime);
+	for(int i = 0; i < NumProjectiles; i++)
+	{
+		const int aData[] = {Tick * 4, 64, i};
+		Result.AddEntity(0, i, aData, std::size(aData));
+	}
+	return Result;
+}
+
+class PredictionHistory : public ::testing::Test
+{
+protected:
+	CNetObj_PlayerInput m_aInputs[200];
+	CPredictionHistory m_History;
+
+	PredictionHistory()
+	{
+		mem_zero(m_aInputs, sizeof(m_aInputs));
+		for(int Tick = 0; Tick < (int)std::size(m_aInputs); Tick++)
+			m_aInputs[Tick].m_Direction = 1;
+	}
+
+	CPredictionHistory::FGetInput GetInput()
+	{
+		return [this](int Tick, int Dummy) -> const int * {
+			if(Dummy != 0)
+				return nullptr;
+			return (const int *)&m_aInputs[Tick];
+		};
+	}
+
+	// predicts the ticks after the last one, up to LastTick
+	void Predict(int LastTick)
+	{
+		for(int Tick = m_History.LastTick() + 1; Tick <= LastTick; Tick++)
+		{
+			const CPredictionHistory::CState TickState = State(Tick);
+			m_History.Add(Tick, GetInput(), &TickState);
+		}
+	}
+};
+
+TEST_F(PredictionHistory, Continue)
+{
+	EXPECT_TRUE(m_History.Empty());
+	m_History.Start(100);
+	Predict(105);
+	EXPECT_EQ(m_History.FirstTick(), 100);
+	EXPECT_EQ(m_History.LastTick(), 105);
+	EXPECT_TRUE(m_History.SameInputs(GetInput()));
+
+	m_aInputs[103].m_Jump = 1;
+	EXPECT_FALSE(m_History.SameInputs(GetInput()));
+	m_aInputs[103].m_Jump = 0;
+	EXPECT_TRUE(m_History.SameInputs(GetInput()));
+
+	// the input of the snapshot tick isn't predicted
+	m_aInputs[100].m_Jump = 1;
+	EXPECT_TRUE(m_History.SameInputs(GetInput()));
+}
+
+TEST_F(PredictionHistory, MatchingSnapshot)
+{
+	m_History.Start(100);
+	Predict(105);
+
+	EXPECT_TRUE(m_History.Matches(102, State(102)));
+	m_History.Rebase(102);
+	EXPECT_EQ(m_History.FirstTick(), 102);
+	EXPECT_EQ(m_History.LastTick(), 105);
+	EXPECT_TRUE(m_History.SameInputs(GetInput()));
+
+	// a changed input before the new snapshot doesn't matter anymore
+	m_aInputs[102].m_Jump = 1;
+	EXPECT_TRUE(m_History.SameInputs(GetInput()));
+
+	Predict(107);
+	EXPECT_TRUE(m_History.Matches(107, State(107)));
+	m_History.Rebase(107);
+	EXPECT_EQ(m_History.FirstTick(), 107);
+	EXPECT_EQ(m_History.LastTick(), 107);
+}
+
+TEST_F(PredictionHistory, MismatchingSnapshot)
+{
+	m_History.Start(100);
+	Predict(105);
+	EXPECT_TRUE(m_History.Matches(102, State(102)));
+	m_History.Rebase(102);
+	Predict(106);
+
+	EXPECT_FALSE(m_History.Matches(104, State(105)));
+	EXPECT_FALSE(m_History.Matches(104, State(104, 1)));
+	EXPECT_FALSE(m_History.Matches(104, State(104, 0, 1)));
+	EXPECT_FALSE(m_History.Matches(104, CPredictionHistory::CState()));
+
+	CPredictionHistory::CState TwoCharacters = State(104);
+	CCharacterCore Core{};
+	TwoCharacters.AddCharacter(1, Core, 0);
+	EXPECT_FALSE(m_History.Matches(104, TwoCharacters));
+
+	// ticks that weren't predicted can't match
+	EXPECT_FALSE(m_History.Matches(101, State(101)));
+	EXPECT_FALSE(m_History.Matches(107, State(107)));
+
+	// after a mismatch the prediction starts over from the snapshot
+	m_History.Start(104);
+	Predict(106);
+	EXPECT_EQ(m_History.FirstTick(), 104);
+	EXPECT_FALSE(m_History.Matches(104, State(104)));
+	EXPECT_TRUE(m_History.Matches(105, State(105)));
+}
+
+TEST_F(PredictionHistory, ChangedAbilities)
+{
+	m_History.Start(100);
+	Predict(102);
+
+	CCharacterCore Core{};
+	Core.m_Pos = vec2(101 * 2.0f, 64.0f);
+	Core.m_Vel = vec2(2.0f, 0.0f);
+	Core.m_aWeapons[WEAPON_HAMMER].m_Got = true;
+	Core.m_aWeapons[WEAPON_GUN].m_Got = true;
+	Core.m_ActiveWeapon = WEAPON_GUN;
+	CPredictionHistory::CState Snapshot;
+	Snapshot.AddCharacter(0, Core, 0);
+	EXPECT_TRUE(m_History.Matches(101, Snapshot));
+
+	Core.m_Jetpack = true;
+	Snapshot.Clear();
+	Snapshot.AddCharacter(0, Core, 0);
+	EXPECT_FALSE(m_History.Matches(101, Snapshot));
+
+	Core.m_Jetpack = false;
+	Core.m_ActiveWeapon = WEAPON_HAMMER;
+	Snapshot.Clear();
+	Snapshot.AddCharacter(0, Core, 0);
+	EXPECT_FALSE(m_History.Matches(101, Snapshot));
+}
+
+TEST_F(PredictionHistory, Entities)
+{
+	m_History.Start(100);
+	for(int Tick = 101; Tick <= 102; Tick++)
+	{
+		const CPredictionHistory::CState TickState = State(Tick, 0, 2);
+		m_History.Add(Tick, GetInput(), &TickState);
+	}
+	EXPECT_TRUE(m_History.Matches(101, State(101, 0, 2)));
+	EXPECT_FALSE(m_History.Matches(101, State(101, 0, 1)));
+	EXPECT_FALSE(m_History.Matches(101, State(101, 0, 3)));
+
+	// the order the entities are added in doesn't matter
+	CPredictionHistory::CState Reversed = State(101);
+	for(int i = 1; i >= 0; i--)
+	{
+		const int aData[] = {101 * 4, 64, i};
+		Reversed.AddEntity(0, i, aData, std::size(aData));
+	}
+	EXPECT_TRUE(m_History.Matches(101, Reversed));
+
+	// same number of entities, but one moved, has another id or type
+	const int aaChanges[][5] = {
+		{0, 0, 101 * 4 + 1, 64, 0},
+		{0, 2, 101 * 4, 64, 0},
+		{1, 0, 101 * 4, 64, 0},
+	};
+	for(const auto &aChange : aaChanges)
+	{
+		CPredictionHistory::CState Changed = State(101);
+		const int aData[] = {101 * 4, 64, 1};
+		Changed.AddEntity(0, 1, aData, std::size(aData));
+		Changed.AddEntity(aChange[0], aChange[1], aChange + 2, 3);
+		EXPECT_FALSE(m_History.Matches(101, Changed));
+	}
+}
@@ -1,10 +1,13 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "test.h"
+
 #include <base/detect.h>
 #include <engine/server/databases/connection.h>
 #include <engine/server/databases/connection_pool.h>
 #include <engine/shared/config.h>
+#include <game/server/scoreleaderboard.h>
 #include <game/server/scoreworker.h>
 
 #include <sqlite3.h>
@@ -260,6 +263,111 @@ TEST_P(SingleScore, TimesDoesntExist)
 	ExpectLines(m_pPlayerResult, {"There are no times in the specified range"});
 }
 
+struct CachedScore : public SingleScore
+{
+	CachedScore()
+	{
+		m_PlayerRequest.m_pLeaderboard = m_pLeaderboard;
+	}
+
+	void InsertCachedRank(const char *pName, float Time)
+	{
+		CSqlScoreData ScoreData(std::make_shared<CScorePlayerResult>());
+		str_copy(ScoreData.m_aMap, "Kobra 3", sizeof(ScoreData.m_aMap));
+		str_copy(ScoreData.m_aGameUuid, "8d300ecf-5873-4297-bee5-95668fdff320", sizeof(ScoreData.m_aGameUuid));
+		str_copy(ScoreData.m_aName, pName, sizeof(ScoreData.m_aName));
+		ScoreData.m_ClientId = 0;
+		ScoreData.m_Time = Time;
+		str_copy(ScoreData.m_aTimestamp, "2021-11-24 19:24:08", sizeof(ScoreData.m_aTimestamp));
+		for(auto &TimeCp : ScoreData.m_aCurrentTimeCp)
+			TimeCp = 0;
+		ScoreData.m_pLeaderboard = m_pLeaderboard;
+		ASSERT_FALSE(CScoreWorker::SaveScore(m_pConn, &ScoreData, Write::NORMAL, m_aError, sizeof(m_aError))) << m_aError;
+		ASSERT_TRUE(ScoreData.m_OnCommitted);
+		ScoreData.m_OnCommitted();
+	}
+
+	std::shared_ptr<CScoreLeaderboard> m_pLeaderboard{std::make_shared<CScoreLeaderboard>(3600)};
+};
+
+TEST_P(CachedScore, RankRegional)
+{
+	g_Config.m_SvRegionalRankings = true;
+	ASSERT_FALSE(CScoreWorker::ShowRank(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(m_pPlayerResult, {"nameless tee - 01:40.00 - better than 100% - requested by brainless tee", "Global rank 1 - GER unranked"}, true);
+}
+
+TEST_P(CachedScore, TopServerRegional)
+{
+	g_Config.m_SvRegionalRankings = true;
+	str_copy(m_PlayerRequest.m_aServer, "USA", sizeof(m_PlayerRequest.m_aServer));
+	ASSERT_FALSE(CScoreWorker::ShowTop(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(m_pPlayerResult,
+		{"------------ Global Top ------------",
+			"1. nameless tee Time: 01:40.00",
+			"------------ USA Top ------------",
+			"1. nameless tee Time: 01:40.00"});
+}
+
+TEST_P(CachedScore, UpdatedBySaveScore)
+{
+	g_Config.m_SvRegionalRankings = false;
+	ASSERT_FALSE(CScoreWorker::ShowTop(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+
+	InsertCachedRank("brainless tee", 50.0);
+	InsertCachedRank("nameless tee", 120.0);
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	ASSERT_FALSE(CScoreWorker::ShowTop(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(m_pPlayerResult,
+		{"------------ Global Top ------------",
+			"1. brainless tee Time: 50.00",
+			"2. nameless tee Time: 01:40.00",
+			"-----------------------------------------"});
+
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	ASSERT_FALSE(CScoreWorker::ShowRank(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(m_pPlayerResult, {"nameless tee - 01:40.00 - better than 0% - requested by brainless tee", "Global rank 2"}, true);
+}
+
+TEST_P(CachedScore, NotReloaded)
+{
+	g_Config.m_SvRegionalRankings = false;
+	ASSERT_FALSE(CScoreWorker::ShowRank(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+
+	// bypasses the leaderboard like a finish on another server would
+	ASSERT_FALSE(m_pConn->PrepareStatement(
+		"INSERT INTO record_race(Map, Name, Timestamp, Time, Server) "
+		"VALUES ('Kobra 3', 'brainless tee', '2021-11-24 19:24:08', 50.0, 'USA')",
+		m_aError, sizeof(m_aError)))
+		<< m_aError;
+	int NumInserted;
+	ASSERT_FALSE(m_pConn->ExecuteUpdate(&NumInserted, m_aError, sizeof(m_aError))) << m_aError;
+
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	ASSERT_FALSE(CScoreWorker::ShowRank(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(m_pPlayerResult, {"nameless tee - 01:40.00 - better than 100% - requested by brainless tee", "Global rank 1"}, true);
+}
+
+TEST_P(CachedScore, TopBeyondCache)
+{
+	g_Config.m_SvRegionalRankings = false;
+	for(int i = 0; i < CScoreRanking::MAX_TOP; i++)
+	{
+		char aName[MAX_NAME_LENGTH];
+		str_format(aName, sizeof(aName), "tee %03d", i);
+		InsertCachedRank(aName, 10.0f + i * 0.5f);
+	}
+
+	m_PlayerRequest.m_Offset = CScoreRanking::MAX_TOP - 1;
+	ASSERT_FALSE(CScoreWorker::ShowTop(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(m_pPlayerResult,
+		{"------------ Global Top ------------",
+			"99. tee 098 Time: 59.00",
+			"100. tee 099 Time: 59.50",
+			"101. nameless tee Time: 01:40.00",
+			"-----------------------------------------"});
+}
+
 struct TeamScore : public Score
 {
 	void SetUp() override
@@ -538,6 +646,28 @@ TEST_P(Points, EqualPoints)
 	ExpectLines(m_pPlayerResult, {"1. nameless tee Points: 3, requested by brainless tee"}, true);
 }
 
+TEST_P(Points, CachedPointsTop)
+{
+	auto pLeaderboard = std::make_shared<CScoreLeaderboard>(3600);
+	m_PlayerRequest.m_pLeaderboard = pLeaderboard;
+	m_pConn->AddPoints("nameless tee", 2, m_aError, sizeof(m_aError));
+	m_pConn->AddPoints("brainless tee", 3, m_aError, sizeof(m_aError));
+	ASSERT_FALSE(CScoreWorker::ShowTopPoints(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	const int64_t WriteStart = ddnet_time_get();
+	m_pConn->AddPoints("nameless tee", 1, m_aError, sizeof(m_aError));
+	pLeaderboard->OnPointsAdded("nameless tee", 2, 1, WriteStart);
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	ASSERT_FALSE(CScoreWorker::ShowTopPoints(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(m_pPlayerResult,
+		{"-------- Top Points --------",
+			"1. brainless tee Points: 3",
+			"1. nameless tee Points: 3",
+			"-------------------------------"});
+	m_pPlayerResult->SetVariant(CScorePlayerResult::DIRECT);
+	ASSERT_FALSE(CScoreWorker::ShowPoints(m_pConn, &m_PlayerRequest, m_aError, sizeof(m_aError))) << m_aError;
+	ExpectLines(m_pPlayerResult, {"1. nameless tee Points: 3, requested by brainless tee"}, true);
+}
+
 TEST_P(Points, EqualPointsTop)
 {
 	m_pConn->AddPoints("nameless tee", 2, m_aError, sizeof(m_aError));
@@ -645,8 +775,241 @@ auto g_TestValues
 		})
 
 INSTANTIATE(SingleScore);
+INSTANTIATE(CachedScore);
 INSTANTIATE(TeamScore);
 INSTANTIATE(MapInfo);
 INSTANTIATE(MapVote);
 INSTANTIATE(Points);
 INSTANTIATE(RandomMap);
+
+struct CPoolTestResult : ISqlResult
+{
+	int m_Count = -1;
+	int m_NumCommitted = 0;
+};
+
+struct CPoolTestData : ISqlData
+{
+	CPoolTestData(std::shared_ptr<ISqlResult> pResult, int Value) :
+		ISqlData(std::move(pResult)), m_Value(Value)
+	{
+	}
+	int m_Value;
+	int m_AbortValue = -1;
+};
+
+static bool PoolTestWrite(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CPoolTestData *>(pGameData);
+	if(pSqlServer->PrepareStatement("CREATE TABLE IF NOT EXISTS pool_test (Value INTEGER NOT NULL)", pError, ErrorSize))
+		return true;
+	int NumUpdated;
+	if(pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize))
+		return true;
+	if(pSqlServer->PrepareStatement("INSERT INTO pool_test (Value) VALUES (?)", pError, ErrorSize))
+		return true;
+	pSqlServer->BindInt(1, pData->m_Value);
+	return pSqlServer->ExecuteUpdate(&NumUpdated, pError, ErrorSize);
+}
+
+static bool PoolTestCount(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	auto *pResult = dynamic_cast<CPoolTestResult *>(pGameData->m_pResult.get());
+	if(pSqlServer->PrepareStatement("SELECT COUNT(*) FROM sqlite_master WHERE name = 'pool_test'", pError, ErrorSize))
+		return true;
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize) || End)
+		return true;
+	pResult->m_Count = pSqlServer->GetInt(1);
+	return false;
+}
+
+TEST(SqlPool, WritesKeepOrderWithParallelReads)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+
+	std::vector<std::shared_ptr<CPoolTestResult>> vpResults;
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::READ, aFilename);
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+		for(int i = 0; i < 64; i++)
+		{
+			Pool.ExecuteWrite(PoolTestWrite, std::make_unique<CPoolTestData>(nullptr, i), "pool test write");
+			auto pResult = std::make_shared<CPoolTestResult>();
+			vpResults.push_back(pResult);
+			Pool.Execute(PoolTestCount, std::make_unique<CPoolTestData>(pResult, i), "pool test read");
+		}
+		for(auto &pResult : vpResults)
+			while(!pResult->m_Completed.load())
+				thread_yield();
+		Pool.OnShutdown();
+	}
+	for(auto &pResult : vpResults)
+	{
+		EXPECT_TRUE(pResult->m_Success);
+		EXPECT_GE(pResult->m_Count, 0);
+	}
+
+	auto pConn = CreateSqliteConnection(aFilename, false);
+	char aError[256];
+	ASSERT_FALSE(pConn->Connect(aError, sizeof(aError))) << aError;
+	ASSERT_FALSE(pConn->PrepareStatement("SELECT Value FROM pool_test ORDER BY rowid", aError, sizeof(aError))) << aError;
+	bool End;
+	for(int i = 0; i < 64; i++)
+	{
+		ASSERT_FALSE(pConn->Step(&End, aError, sizeof(aError))) << aError;
+		ASSERT_FALSE(End);
+		EXPECT_EQ(pConn->GetInt(1), i);
+	}
+	ASSERT_FALSE(pConn->Step(&End, aError, sizeof(aError))) << aError;
+	EXPECT_TRUE(End);
+	pConn->Disconnect();
+	pConn.reset();
+	fs_remove(aFilename);
+}
+
+static bool PoolTestCountRows(IDbConnection *pSqlServer, const ISqlData *pGameData, char *pError, int ErrorSize)
+{
+	auto *pResult = dynamic_cast<CPoolTestResult *>(pGameData->m_pResult.get());
+	if(pSqlServer->PrepareStatement("SELECT COUNT(*) FROM pool_test", pError, ErrorSize))
+		return true;
+	bool End;
+	if(pSqlServer->Step(&End, pError, ErrorSize) || End)
+		return true;
+	pResult->m_Count = pSqlServer->GetInt(1);
+	return false;
+}
+
+TEST(SqlPool, ReadsSeeEarlierWrites)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+
+	std::vector<std::shared_ptr<CPoolTestResult>> vpResults;
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::READ, aFilename);
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+		for(int i = 0; i < 32; i++)
+		{
+			Pool.ExecuteWrite(PoolTestWrite, std::make_unique<CPoolTestData>(nullptr, i), "pool test write");
+			auto pResult = std::make_shared<CPoolTestResult>();
+			vpResults.push_back(pResult);
+			Pool.Execute(PoolTestCountRows, std::make_unique<CPoolTestData>(pResult, i), "pool test read");
+		}
+		for(auto &pResult : vpResults)
+			while(!pResult->m_Completed.load())
+				thread_yield();
+		Pool.OnShutdown();
+	}
+	for(int i = 0; i < 32; i++)
+	{
+		EXPECT_TRUE(vpResults[i]->m_Success) << i;
+		EXPECT_GE(vpResults[i]->m_Count, i + 1) << i;
+	}
+	fs_remove(aFilename);
+}
+
+static bool PoolTestFailingWrite(IDbConnection *pSqlServer, const ISqlData *pGameData, Write w, char *pError, int ErrorSize)
+{
+	const auto *pData = dynamic_cast<const CPoolTestData *>(pGameData);
+	if(PoolTestWrite(pSqlServer, pGameData, w, pError, ErrorSize))
+		return true;
+	// fail after inserting, the insert must be rolled back
+	if(pData->m_Value % 3 == 0)
+	{
+		str_copy(pError, "failing on purpose", ErrorSize);
+		return true;
+	}
+	// aborts the whole group commit, all writes are retried one by one
+	if(pData->m_Value == pData->m_AbortValue)
+	{
+		pSqlServer->Execute("ROLLBACK", pError, ErrorSize);
+	}
+	auto *pResult = dynamic_cast<CPoolTestResult *>(pData->m_pResult.get());
+	pData->m_OnCommitted = [pResult]() { pResult->m_NumCommitted++; };
+	return false;
+}
+
+// restores the group commit settings when the test ends, even if it fails
+class CGroupCommitConfig
+{
+	int m_GroupCommit = g_Config.m_SvSqlGroupCommit;
+	int m_GroupCommitWindow = g_Config.m_SvSqlGroupCommitWindow;
+
+public:
+	~CGroupCommitConfig()
+	{
+		g_Config.m_SvSqlGroupCommit = m_GroupCommit;
+		g_Config.m_SvSqlGroupCommitWindow = m_GroupCommitWindow;
+	}
+};
+
+static void ExpectGroupCommit(int AbortValue)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".sqlite");
+
+	// wait long enough for all writes to end up in the same group
+	const CGroupCommitConfig OldConfig;
+	g_Config.m_SvSqlGroupCommit = 32;
+	g_Config.m_SvSqlGroupCommitWindow = 1000;
+	std::vector<std::shared_ptr<CPoolTestResult>> vpResults;
+	{
+		CDbConnectionPool Pool;
+		Pool.RegisterSqliteDatabase(CDbConnectionPool::WRITE, aFilename);
+		for(int i = 1; i <= 32; i++)
+		{
+			auto pResult = std::make_shared<CPoolTestResult>();
+			vpResults.push_back(pResult);
+			auto pData = std::make_unique<CPoolTestData>(pResult, i);
+			pData->m_AbortValue = AbortValue;
+			Pool.ExecuteWrite(PoolTestFailingWrite, std::move(pData), "pool test write");
+		}
+		for(auto &pResult : vpResults)
+			while(!pResult->m_Completed.load())
+				thread_yield();
+		Pool.OnShutdown();
+	}
+	for(int i = 1; i <= 32; i++)
+	{
+		EXPECT_EQ(vpResults[i - 1]->m_Success, i % 3 != 0) << i;
+		EXPECT_EQ(vpResults[i - 1]->m_NumCommitted, i % 3 != 0 ? 1 : 0) << i;
+	}
+
+	auto pConn = CreateSqliteConnection(aFilename, false);
+	char aError[256];
+	ASSERT_FALSE(pConn->Connect(aError, sizeof(aError))) << aError;
+	ASSERT_FALSE(pConn->PrepareStatement("SELECT Value FROM pool_test ORDER BY rowid", aError, sizeof(aError))) << aError;
+	bool End;
+	for(int i = 1; i <= 32; i++)
+	{
+		// writes executed one by one aren't in a transaction, failed ones
+		// keep their insert
+		if(i % 3 == 0 && AbortValue < 0)
+			continue;
+		ASSERT_FALSE(pConn->Step(&End, aError, sizeof(aError))) << aError;
+		ASSERT_FALSE(End);
+		EXPECT_EQ(pConn->GetInt(1), i);
+	}
+	ASSERT_FALSE(pConn->Step(&End, aError, sizeof(aError))) << aError;
+	EXPECT_TRUE(End);
+	pConn->Disconnect();
+	pConn.reset();
+	fs_remove(aFilename);
+}
+
+TEST(SqlPool, GroupCommitRollsBackFailedWrites)
+{
+	ExpectGroupCommit(-1);
+}
+
+TEST(SqlPool, AbortedGroupCommitRunsCallbacksOnce)
+{
+	ExpectGroupCommit(16);
+}
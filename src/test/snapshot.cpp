@@ -1,8 +1,12 @@
 #include <gtest/gtest.h>
 
 #include <base/system.h>
+#include <engine/shared/compression.h>
 #include <engine/shared/snapshot.h>
 #include <game/generated/protocol.h>
+#include <game/prng.h>
+
+#include <vector>
 
 TEST(Snapshot, CrcOneInt)
 {
@@ -83,3 +87,324 @@ TEST(Snapshot, CrcOverflow)
 
 	ASSERT_EQ(pSnapshot->Crc(), 1);
 }
+
+static int BuildLargeSnapshot(CSnapshot *pSnapshot, int NumItems)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int i = 0; i < NumItems / 2; i++)
+	{
+		CNetObj_Projectile *pProjectile = static_cast<CNetObj_Projectile *>(Builder.NewItem(NETOBJTYPE_PROJECTILE, i, sizeof(CNetObj_Projectile)));
+		if(!pProjectile)
+			break;
+		pProjectile->m_X = i;
+		CNetObj_DDNetLaser *pLaser = static_cast<CNetObj_DDNetLaser *>(Builder.NewItem(NETOBJTYPE_DDNETLASER, i, sizeof(CNetObj_DDNetLaser)));
+		if(!pLaser)
+			break;
+		pLaser->m_ToX = i;
+	}
+	return Builder.Finish(pSnapshot);
+}
+
+TEST(SnapshotItemIndex, MatchesLinearSearch)
+{
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnapshot = (CSnapshot *)aData;
+	BuildLargeSnapshot(pSnapshot, 600);
+
+	CSnapshotItemIndex Index;
+	Index.Build(pSnapshot);
+
+	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	{
+		const int Key = pSnapshot->GetItem(i)->Key();
+		EXPECT_EQ(Index.GetItemIndex(Key), pSnapshot->GetItemIndex(Key));
+		EXPECT_EQ(Index.GetItemType(i), pSnapshot->GetItemType(i));
+	}
+	EXPECT_EQ(Index.GetItemIndex((NETOBJTYPE_FLAG << 16) | 0), -1);
+
+	for(int Id = 0; Id < 300; Id++)
+	{
+		EXPECT_EQ(Index.FindItem(NETOBJTYPE_PROJECTILE, Id), pSnapshot->FindItem(NETOBJTYPE_PROJECTILE, Id));
+		EXPECT_EQ(Index.FindItem(NETOBJTYPE_DDNETLASER, Id), pSnapshot->FindItem(NETOBJTYPE_DDNETLASER, Id));
+		EXPECT_NE(Index.FindItem(NETOBJTYPE_DDNETLASER, Id), nullptr);
+	}
+	EXPECT_EQ(Index.FindItem(NETOBJTYPE_DDNETLASER, 300), nullptr);
+	EXPECT_EQ(Index.FindItem(NETOBJTYPE_DDNETPICKUP, 0), nullptr);
+}
+
+TEST(SnapshotItemIndex, Empty)
+{
+	CSnapshotItemIndex Index;
+	Index.Build(CSnapshot::EmptySnapshot());
+	EXPECT_EQ(Index.GetItemIndex(0), -1);
+	EXPECT_EQ(Index.FindItem(NETOBJTYPE_PROJECTILE, 0), nullptr);
+	EXPECT_EQ(Index.FindItem(NETOBJTYPE_DDNETLASER, 0), nullptr);
+}
+
+TEST(SnapshotItemIndex, DuplicateKeysReturnFirst)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	ASSERT_NE(Builder.NewItem(NETOBJTYPE_FLAG, 3, sizeof(CNetObj_Flag)), nullptr);
+	ASSERT_NE(Builder.NewItem(NETOBJTYPE_FLAG, 3, sizeof(CNetObj_Flag)), nullptr);
+
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnapshot = (CSnapshot *)aData;
+	Builder.Finish(pSnapshot);
+
+	CSnapshotItemIndex Index;
+	Index.Build(pSnapshot);
+	EXPECT_EQ(Index.GetItemIndex((NETOBJTYPE_FLAG << 16) | 3), 0);
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(SnapshotItemIndex, DISABLED_Benchmark)
+{
+	char aData[CSnapshot::MAX_SIZE];
+	CSnapshot *pSnapshot = (CSnapshot *)aData;
+	BuildLargeSnapshot(pSnapshot, CSnapshot::MAX_ITEMS - 16);
+	const int NumItems = pSnapshot->NumItems();
+	const int Rounds = 20;
+
+	int64_t Sum = 0;
+	std::chrono::nanoseconds Start = time_get_nanoseconds();
+	for(int Round = 0; Round < Rounds; Round++)
+	{
+		for(int Id = 0; Id < NumItems / 2; Id++)
+		{
+			Sum += pSnapshot->FindItem(NETOBJTYPE_PROJECTILE, Id) != nullptr;
+			Sum += pSnapshot->FindItem(NETOBJTYPE_DDNETLASER, Id) != nullptr;
+		}
+	}
+	const std::chrono::nanoseconds LinearTime = time_get_nanoseconds() - Start;
+
+	Start = time_get_nanoseconds();
+	for(int Round = 0; Round < Rounds; Round++)
+	{
+		CSnapshotItemIndex Index;
+		Index.Build(pSnapshot);
+		for(int Id = 0; Id < NumItems / 2; Id++)
+		{
+			Sum -= Index.FindItem(NETOBJTYPE_PROJECTILE, Id) != nullptr;
+			Sum -= Index.FindItem(NETOBJTYPE_DDNETLASER, Id) != nullptr;
+		}
+	}
+	const std::chrono::nanoseconds HashedTime = time_get_nanoseconds() - Start;
+
+	EXPECT_EQ(Sum, 0);
+	dbg_msg("snapshot", "%d items, %d rounds: linear=%.3fms hashed=%.3fms", NumItems, Rounds,
+		LinearTime.count() / 1000000.0, HashedTime.count() / 1000000.0);
+}
+
+TEST(SnapshotDelta, DiffItemMatchesScalar)
+{
+	uint64_t aSeed[2] = {0x2468ACE, 0x13579BDF};
+	CPrng Rng;
+	Rng.Seed(aSeed);
+	for(int Run = 0; Run < 1000; Run++)
+	{
+		const int Size = Run % 40;
+		int aPast[40], aCurrent[40], aOut[40];
+		for(int i = 0; i < Size; i++)
+		{
+			aPast[i] = Rng.RandomBits();
+			// unchanged items give 0
+			aCurrent[i] = Run % 3 ? aPast[i] : (int)Rng.RandomBits();
+		}
+		int Expected = 0;
+		for(int i = 0; i < Size; i++)
+			Expected |= (int)((unsigned)aCurrent[i] - (unsigned)aPast[i]);
+		EXPECT_EQ(CSnapshotDelta::DiffItem(aPast, aCurrent, aOut, Size), Expected);
+		for(int i = 0; i < Size; i++)
+			EXPECT_EQ(aOut[i], (int)((unsigned)aCurrent[i] - (unsigned)aPast[i]));
+	}
+}
+
+// a running server with all players moving around and shooting
+static int BuildServerSnapshot(CSnapshot *pSnapshot, int Tick)
+{
+	CSnapshotBuilder Builder;
+	Builder.Init();
+	for(int Id = 0; Id < 64; Id++)
+	{
+		CNetObj_PlayerInfo *pPlayerInfo = static_cast<CNetObj_PlayerInfo *>(Builder.NewItem(NETOBJTYPE_PLAYERINFO, Id, sizeof(CNetObj_PlayerInfo)));
+		pPlayerInfo->m_Local = 0;
+		pPlayerInfo->m_ClientId = Id;
+		pPlayerInfo->m_Team = 0;
+		pPlayerInfo->m_Score = -9999;
+		pPlayerInfo->m_Latency = 20 + (Tick / 50 + Id) % 7;
+
+		CNetObj_ClientInfo *pClientInfo = static_cast<CNetObj_ClientInfo *>(Builder.NewItem(NETOBJTYPE_CLIENTINFO, Id, sizeof(CNetObj_ClientInfo)));
+		mem_zero(pClientInfo, sizeof(*pClientInfo));
+		pClientInfo->m_Name0 = 0x54656521 + Id;
+		pClientInfo->m_Skin0 = 0x64656661;
+		pClientInfo->m_ColorBody = 0x1B6F74;
+		pClientInfo->m_ColorFeet = 0x1C873E;
+
+		// a third of the players is standing still
+		const int Speed = Id % 3 ? Id % 5 + 1 : 0;
+		CNetObj_Character *pCharacter = static_cast<CNetObj_Character *>(Builder.NewItem(NETOBJTYPE_CHARACTER, Id, sizeof(CNetObj_Character)));
+		mem_zero(pCharacter, sizeof(*pCharacter));
+		pCharacter->m_Tick = Speed ? Tick : 100;
+		pCharacter->m_X = 1000 + Id * 64 + (Tick * Speed * 3) % 2000;
+		pCharacter->m_Y = 2000 + (Tick * Speed) % 300;
+		pCharacter->m_VelX = Speed * 256;
+		pCharacter->m_VelY = Speed ? (Tick % 50) * 40 - 1000 : 0;
+		pCharacter->m_Angle = Speed ? (Tick * Speed * 7) % 1608 - 804 : 0;
+		pCharacter->m_Direction = Speed ? 1 : 0;
+		pCharacter->m_HookedPlayer = -1;
+		pCharacter->m_HookState = Speed && Tick % 40 < 20 ? 1 : 0;
+		pCharacter->m_HookX = pCharacter->m_X + pCharacter->m_HookState * 100;
+		pCharacter->m_HookY = pCharacter->m_Y - pCharacter->m_HookState * 200;
+		pCharacter->m_PlayerFlags = 1;
+		pCharacter->m_Health = 10;
+		pCharacter->m_Weapon = (Tick / 200 + Id) % 6;
+		pCharacter->m_AmmoCount = -1;
+		pCharacter->m_AttackTick = Tick - Tick % 17;
+
+		CNetObj_DDNetCharacter *pDDNetCharacter = static_cast<CNetObj_DDNetCharacter *>(Builder.NewItem(NETOBJTYPE_DDNETCHARACTER, Id, sizeof(CNetObj_DDNetCharacter)));
+		mem_zero(pDDNetCharacter, sizeof(*pDDNetCharacter));
+		pDDNetCharacter->m_Flags = 0x3F00;
+		pDDNetCharacter->m_Jumps = 2;
+		pDDNetCharacter->m_JumpedTotal = Speed ? Tick % 3 : 0;
+		pDDNetCharacter->m_TargetX = Speed ? pCharacter->m_Angle / 4 : 0;
+		pDDNetCharacter->m_TargetY = Speed ? 64 - (Tick * Speed) % 128 : 0;
+		pDDNetCharacter->m_StrongWeakId = Id;
+		pDDNetCharacter->m_FreezeEnd = -1;
+	}
+	for(int Id = 0; Id < 100; Id++)
+	{
+		if((Tick / 10 + Id) % 4 == 0)
+			continue;
+		CNetObj_Projectile *pProjectile = static_cast<CNetObj_Projectile *>(Builder.NewItem(NETOBJTYPE_PROJECTILE, Id, sizeof(CNetObj_Projectile)));
+		pProjectile->m_X = 1000 + Id * 20;
+		pProjectile->m_Y = 2000;
+		pProjectile->m_VelX = 3000;
+		pProjectile->m_VelY = -100;
+		pProjectile->m_Type = 2;
+		pProjectile->m_StartTick = Tick - Tick % 10;
+	}
+	return Builder.Finish(pSnapshot);
+}
+
+// the data rate counts one bit for each unchanged int and the packed size otherwise
+static uint64_t ExpectedDataRate(const CSnapshot *pFrom, const CSnapshot *pTo, int Type)
+{
+	uint64_t DataRate = 0;
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pTo->GetItem(i);
+		if(pItem->Type() != Type)
+			continue;
+		const int NumInts = pTo->GetItemSize(i) / sizeof(int32_t);
+		const int FromIndex = pFrom->GetItemIndex(pItem->Key());
+		if(FromIndex == -1)
+		{
+			DataRate += NumInts * 32;
+			continue;
+		}
+		const int *pPast = pFrom->GetItem(FromIndex)->Data();
+		bool Changed = false;
+		for(int j = 0; j < NumInts; j++)
+			Changed |= pItem->Data()[j] != pPast[j];
+		for(int j = 0; Changed && j < NumInts; j++)
+		{
+			const int Diff = (unsigned)pItem->Data()[j] - (unsigned)pPast[j];
+			unsigned char aBuf[CVariableInt::MAX_BYTES_PACKED];
+			DataRate += Diff ? (CVariableInt::Pack(aBuf, Diff, sizeof(aBuf)) - aBuf) * 8 : 1;
+		}
+	}
+	return DataRate;
+}
+
+TEST(SnapshotDelta, UnpackDeltaRoundtrip)
+{
+	char aFrom[CSnapshot::MAX_SIZE], aTo[CSnapshot::MAX_SIZE], aUnpacked[CSnapshot::MAX_SIZE];
+	CSnapshot *pFrom = (CSnapshot *)aFrom;
+	CSnapshot *pTo = (CSnapshot *)aTo;
+	CSnapshot *pUnpacked = (CSnapshot *)aUnpacked;
+	std::vector<char> vDelta(CSnapshot::MAX_SIZE * 2);
+
+	for(int Tick = 1; Tick < 200; Tick += 7)
+	{
+		BuildServerSnapshot(pFrom, Tick);
+		const int Size = BuildServerSnapshot(pTo, Tick + Tick % 3 + 1);
+		CSnapshotDelta Delta;
+		const int DeltaSize = Delta.CreateDelta(pFrom, pTo, vDelta.data());
+		ASSERT_GT(DeltaSize, 0);
+		ASSERT_EQ(Delta.UnpackDelta(pFrom, pUnpacked, vDelta.data(), DeltaSize, false), Size);
+		// the items of extended types can be in a different order
+		ASSERT_EQ(pUnpacked->NumItems(), pTo->NumItems());
+		for(int i = 0; i < pTo->NumItems(); i++)
+		{
+			const int Index = pUnpacked->GetItemIndex(pTo->GetItem(i)->Key());
+			ASSERT_NE(Index, -1);
+			ASSERT_EQ(pUnpacked->GetItemSize(Index), pTo->GetItemSize(i));
+			EXPECT_EQ(mem_comp(pUnpacked->GetItem(Index)->Data(), pTo->GetItem(i)->Data(), pTo->GetItemSize(i)), 0);
+		}
+		for(int Type : {NETOBJTYPE_CHARACTER, NETOBJTYPE_PLAYERINFO, NETOBJTYPE_PROJECTILE})
+			EXPECT_EQ(Delta.GetDataRate(Type), ExpectedDataRate(pFrom, pTo, Type)) << "type " << Type << " tick " << Tick;
+	}
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(SnapshotDelta, DISABLED_Benchmark)
+{
+	const int NumTicks = 500;
+	std::vector<char> vSnapshots((NumTicks + 1) * CSnapshot::MAX_SIZE);
+	for(int Tick = 0; Tick <= NumTicks; Tick++)
+		BuildServerSnapshot((CSnapshot *)&vSnapshots[Tick * CSnapshot::MAX_SIZE], Tick + 1000);
+	const auto Snapshot = [&](int Tick) { return (CSnapshot *)&vSnapshots[Tick * CSnapshot::MAX_SIZE]; };
+
+	CSnapshotDelta Delta;
+	std::vector<int> vDelta(CSnapshot::MAX_SIZE / sizeof(int) * 2);
+	std::vector<unsigned char> vCompressed(CSnapshot::MAX_SIZE * 10);
+	std::vector<int> vDecompressed(vDelta.size());
+	char aUnpacked[CSnapshot::MAX_SIZE];
+
+	// every tick a delta to the previous one like for a client without packet loss
+	int64_t TotalDelta = 0, TotalCompressed = 0;
+	std::chrono::nanoseconds CreateTime(0), CompressTime(0), DecompressTime(0), UnpackTime(0), PackScalarTime(0), UnpackScalarTime(0);
+	for(int Tick = 1; Tick <= NumTicks; Tick++)
+	{
+		std::chrono::nanoseconds Start = time_get_nanoseconds();
+		const int DeltaSize = Delta.CreateDelta(Snapshot(Tick - 1), Snapshot(Tick), vDelta.data());
+		CreateTime += time_get_nanoseconds() - Start;
+		ASSERT_GT(DeltaSize, 0);
+
+		Start = time_get_nanoseconds();
+		const long CompressedSize = CVariableInt::Compress(vDelta.data(), DeltaSize, vCompressed.data(), vCompressed.size());
+		CompressTime += time_get_nanoseconds() - Start;
+		ASSERT_GT(CompressedSize, 0);
+
+		Start = time_get_nanoseconds();
+		ASSERT_EQ(CVariableInt::Decompress(vCompressed.data(), CompressedSize, vDecompressed.data(), vDecompressed.size() * sizeof(int)), DeltaSize);
+		DecompressTime += time_get_nanoseconds() - Start;
+
+		Start = time_get_nanoseconds();
+		ASSERT_GT(Delta.UnpackDelta(Snapshot(Tick - 1), (CSnapshot *)aUnpacked, vDecompressed.data(), DeltaSize, false), 0);
+		UnpackTime += time_get_nanoseconds() - Start;
+
+		// the int at a time packing for comparison
+		Start = time_get_nanoseconds();
+		unsigned char *pDst = vCompressed.data();
+		for(int i = 0; i < DeltaSize / (int)sizeof(int); i++)
+			pDst = CVariableInt::Pack(pDst, vDelta[i], vCompressed.data() + vCompressed.size() - pDst);
+		PackScalarTime += time_get_nanoseconds() - Start;
+		ASSERT_EQ(pDst - vCompressed.data(), CompressedSize);
+
+		Start = time_get_nanoseconds();
+		const unsigned char *pSrc = vCompressed.data();
+		for(int i = 0; pSrc < vCompressed.data() + CompressedSize; i++)
+			pSrc = CVariableInt::Unpack(pSrc, &vDecompressed[i], vCompressed.data() + CompressedSize - pSrc);
+		UnpackScalarTime += time_get_nanoseconds() - Start;
+
+		TotalDelta += DeltaSize;
+		TotalCompressed += CompressedSize;
+	}
+
+	dbg_msg("snapshot", "%d deltas, %" PRId64 " bytes, packed to %" PRId64 " bytes", NumTicks, TotalDelta, TotalCompressed);
+	dbg_msg("snapshot", "create=%.3fms compress=%.3fms (pack=%.3fms)", CreateTime.count() / 1000000.0, CompressTime.count() / 1000000.0, PackScalarTime.count() / 1000000.0);
+	dbg_msg("snapshot", "decompress=%.3fms (unpack=%.3fms) unpack delta=%.3fms", DecompressTime.count() / 1000000.0, UnpackScalarTime.count() / 1000000.0, UnpackTime.count() / 1000000.0);
+}
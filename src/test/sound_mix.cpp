@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+
+#include <engine/client/sound_mix.h>
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+static std::vector<short> RandomSamples(unsigned Num)
+{
+	std::vector<short> vSamples(Num);
+	unsigned Seed = 123456789;
+	for(short &Sample : vSamples)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		Sample = (short)(Seed >> 16);
+	}
+	return vSamples;
+}
+
+TEST(SoundMix, MatchesScalar)
+{
+	// odd frame counts to cover the tails after the vector loops
+	for(unsigned Frames : {0u, 1u, 7u, 8u, 9u, 33u, 1027u})
+	{
+		const std::vector<short> vMono = RandomSamples(Frames);
+		const std::vector<short> vStereo = RandomSamples(Frames * 2);
+		std::vector<int> vMix(Frames * 2, 1000);
+		std::vector<int> vExpected(Frames * 2, 1000);
+
+		SoundMixMono(vMix.data(), vMono.data(), Frames, 255, 17);
+		SoundMixStereo(vMix.data(), vStereo.data(), Frames, 0, 200);
+		for(unsigned i = 0; i < Frames; i++)
+		{
+			vExpected[i * 2] += vMono[i] * 255 + vStereo[i * 2] * 0;
+			vExpected[i * 2 + 1] += vMono[i] * 17 + vStereo[i * 2 + 1] * 200;
+		}
+		EXPECT_EQ(vMix, vExpected);
+
+		std::vector<short> vOut(Frames * 2);
+		for(int MasterVol : {0, 57, 100})
+		{
+			SoundMixClamp(vOut.data(), vMix.data(), Frames * 2, MasterVol);
+			for(unsigned i = 0; i < Frames * 2; i++)
+				EXPECT_EQ(vOut[i], clamp<int64_t>(((int64_t)vMix[i] * MasterVol / 101) >> 8, std::numeric_limits<short>::min(), std::numeric_limits<short>::max()));
+		}
+	}
+}
+
+TEST(SoundMix, Clamp)
+{
+	const int aMix[] = {std::numeric_limits<int>::max(), std::numeric_limits<int>::min(), 4 * 255 * 32767, -4 * 255 * 32768, -1, 1, -25856, 25856, -300, 0};
+	const short aExpected[] = {32767, -32768, 32767, -32768, 0, 0, -100, 100, -2, 0};
+	short aOut[std::size(aMix)];
+	SoundMixClamp(aOut, aMix, std::size(aMix), 100);
+	for(size_t i = 0; i < std::size(aMix); i++)
+		EXPECT_EQ(aOut[i], aExpected[i]) << "at " << i;
+}
+
+// run with --gtest_also_run_disabled_tests
+TEST(SoundMix, DISABLED_BenchmarkMix256Voices)
+{
+	const unsigned NumVoices = 256;
+	const unsigned Frames = 1024;
+	const std::vector<short> vSamples = RandomSamples(NumVoices * Frames * 2);
+	std::vector<int> vMix(Frames * 2);
+	std::vector<short> vOut(Frames * 2);
+
+	const int NumRuns = 1000;
+	const auto Start = time_get_nanoseconds();
+	for(int Run = 0; Run < NumRuns; Run++)
+	{
+		mem_zero(vMix.data(), vMix.size() * sizeof(int));
+		for(unsigned Voice = 0; Voice < NumVoices; Voice++)
+		{
+			// half mono and half stereo samples
+			const short *pData = &vSamples[Voice * Frames * 2];
+			if(Voice % 2)
+				SoundMixMono(vMix.data(), pData, Frames, Voice % 256, 255 - Voice % 256);
+			else
+				SoundMixStereo(vMix.data(), pData, Frames, Voice % 256, 255 - Voice % 256);
+		}
+		SoundMixClamp(vOut.data(), vMix.data(), Frames * 2, 100);
+	}
+	const auto Time = time_get_nanoseconds() - Start;
+	dbg_msg("sound_mix", "%u voices, %u frames: %.2fus per mix", NumVoices, Frames, std::chrono::duration<double, std::micro>(Time).count() / NumRuns);
+}
@@ -1,14 +1,19 @@
+#include "test.h"
 #include <gtest/gtest.h>
 
 #include <base/detect.h>
 #include <engine/external/json-parser/json.h>
 #include <engine/server.h>
 #include <engine/shared/config.h>
+#include <engine/shared/gzip_writer.h>
+#include <engine/shared/teehistorian_reader.h>
 #include <game/gamecore.h>
 #include <game/server/teehistorian.h>
 
 #include <vector>
 
+#include <zlib.h>
+
 void RegisterGameUuids(CUuidManager *pManager);
 
 class TeeHistorian : public ::testing::Test
@@ -21,6 +26,8 @@ protected:
 	CTeeHistorian::CGameInfo m_GameInfo;
 
 	std::vector<unsigned char> m_vBuffer;
+	int m_NumWrites = 0;
+	CGzipWriter *m_pGzip = nullptr;
 
 	enum
 	{
@@ -93,6 +100,44 @@ protected:
 	{
 		TeeHistorian *pThis = (TeeHistorian *)pUser;
 		WriteBuffer(pThis->m_vBuffer, pData, DataSize);
+		pThis->m_NumWrites++;
+		if(pThis->m_pGzip)
+			pThis->m_pGzip->Write(pData, DataSize);
+	}
+
+	// reads a gzip compressed teehistorian file
+	static bool ReadGzip(const char *pFilename, std::vector<unsigned char> &vOut)
+	{
+		IOHANDLE File = io_open(pFilename, IOFLAG_READ);
+		if(!File)
+			return false;
+		void *pCompressed;
+		unsigned CompressedSize;
+		const bool ReadSuccess = io_read_all(File, &pCompressed, &CompressedSize);
+		io_close(File);
+		if(!ReadSuccess)
+			return false;
+
+		z_stream Stream = {};
+		if(inflateInit2(&Stream, 15 + 16) != Z_OK)
+		{
+			free(pCompressed);
+			return false;
+		}
+		Stream.next_in = (Bytef *)pCompressed;
+		Stream.avail_in = CompressedSize;
+		unsigned char aOut[4096];
+		int Result;
+		do
+		{
+			Stream.next_out = aOut;
+			Stream.avail_out = sizeof(aOut);
+			Result = inflate(&Stream, Z_NO_FLUSH);
+			WriteBuffer(vOut, aOut, sizeof(aOut) - Stream.avail_out);
+		} while(Result == Z_OK);
+		inflateEnd(&Stream);
+		free(pCompressed);
+		return Result == Z_STREAM_END;
 	}
 
 	void Reset(const CTeeHistorian::CGameInfo *pGameInfo)
@@ -134,6 +179,7 @@ protected:
 
 	void ExpectFull(const unsigned char *pOutput, size_t OutputSize)
 	{
+		m_TH.Flush();
 		const ::testing::TestInfo *pTestInfo =
 			::testing::UnitTest::GetInstance()->current_test_info();
 		const char *pTestName = pTestInfo->name();
@@ -904,3 +950,169 @@ TEST_F(TeeHistorian, PrevGameUuid)
 	EXPECT_STREQ(JsonPrevGameUuid, "fe19c218-f555-4002-a273-126c59ccc17a");
 	json_value_free(pJson);
 }
+
+TEST_F(TeeHistorian, OneWritePerTick)
+{
+	Tick(1);
+	Player(0, 1, 2);
+	Player(1, 3, 4);
+	Inputs();
+	m_TH.RecordPlayerJoin(2, CTeeHistorian::PROTOCOL_6);
+	m_TH.RecordPlayerDrop(2, "too many tees");
+	const int NumWrites = m_NumWrites;
+	Tick(2);
+	EXPECT_EQ(m_NumWrites, NumWrites + 1);
+	Player(0, 2, 3);
+	Finish();
+	// end of tick 2 and the finish marker
+	EXPECT_EQ(m_NumWrites, NumWrites + 3);
+}
+
+TEST_F(TeeHistorian, Gzip)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".teehistorian.gz");
+	IOHANDLE File = io_open(aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	CGzipWriter Gzip(File, 6);
+	m_pGzip = &Gzip;
+
+	Reset(&m_GameInfo);
+	for(int i = 1; i <= 100; i++)
+	{
+		Tick(i);
+		Player(0, i, -i);
+		Player(3, 2 * i, 0);
+		Inputs();
+		m_TH.RecordPlayerMessage(0, "hello", 5);
+	}
+	Finish();
+	m_pGzip = nullptr;
+	Gzip.Close();
+	EXPECT_EQ(Gzip.Error(), 0);
+
+	std::vector<unsigned char> vDecompressed;
+	ASSERT_TRUE(ReadGzip(aFilename, vDecompressed));
+	EXPECT_EQ(vDecompressed, m_vBuffer);
+	fs_remove(aFilename);
+}
+
+TEST_F(TeeHistorian, Reader)
+{
+	CNetObj_PlayerInput Input;
+	mem_zero(&Input, sizeof(Input));
+
+	Tick(1);
+	Inputs();
+	m_TH.RecordPlayerJoin(0, CTeeHistorian::PROTOCOL_6);
+	Input.m_Direction = -1;
+	m_TH.RecordPlayerInput(0, 1, &Input);
+	Tick(2);
+	Player(0, 10, 20);
+	Inputs();
+	Input.m_Jump = 1;
+	m_TH.RecordPlayerInput(0, 1, &Input);
+	m_TH.RecordPlayerMessage(0, "hello", 5);
+	Tick(3);
+	Player(0, 12, 20); // implicit tick after the inputs
+	Tick(4);
+	Player(0, 15, 19); // implicit tick by the client id
+	Tick(50);
+	DeadPlayer(0);
+	Inputs();
+	m_TH.RecordPlayerDrop(0, "too many tees");
+	Finish();
+
+	CTeeHistorianReader Reader;
+	char aError[128];
+	ASSERT_TRUE(Reader.Load(std::vector<unsigned char>(m_vBuffer), aError, sizeof(aError))) << aError;
+	EXPECT_STREQ(Reader.HeaderString("map_name"), "Kobra 3 Solo");
+
+	std::vector<CTeeHistorianReader::CRecord> vRecords;
+	CTeeHistorianReader::CRecord Record;
+	while(Reader.Next(&Record))
+		vRecords.push_back(Record);
+	EXPECT_FALSE(Reader.Error());
+
+	const struct
+	{
+		int m_Type;
+		int m_Tick;
+	} aExpected[] = {
+		{CTeeHistorianReader::RECORD_EX, 1},
+		{CTeeHistorianReader::RECORD_JOIN, 1},
+		{CTeeHistorianReader::RECORD_INPUT, 1},
+		{CTeeHistorianReader::RECORD_PLAYER, 2},
+		{CTeeHistorianReader::RECORD_INPUT, 2},
+		{CTeeHistorianReader::RECORD_MESSAGE, 2},
+		{CTeeHistorianReader::RECORD_PLAYER, 3},
+		{CTeeHistorianReader::RECORD_PLAYER, 4},
+		{CTeeHistorianReader::RECORD_PLAYER_OLD, 50},
+		{CTeeHistorianReader::RECORD_DROP, 50},
+		{CTeeHistorianReader::RECORD_FINISH, 50},
+	};
+	ASSERT_EQ(vRecords.size(), std::size(aExpected));
+	for(size_t i = 0; i < vRecords.size(); i++)
+	{
+		EXPECT_EQ(vRecords[i].m_Type, aExpected[i].m_Type) << "record " << i;
+		EXPECT_EQ(vRecords[i].m_Tick, aExpected[i].m_Tick) << "record " << i;
+	}
+
+	EXPECT_EQ(vRecords[2].m_aInput[0], -1);
+	EXPECT_EQ(vRecords[2].m_aInput[3], 0);
+	EXPECT_EQ(mem_comp(vRecords[4].m_aInput, &Input, sizeof(Input)), 0);
+	ASSERT_EQ(vRecords[5].m_DataSize, 5);
+	EXPECT_EQ(mem_comp(vRecords[5].m_pData, "hello", 5), 0);
+	EXPECT_EQ(vRecords[7].m_X, 15);
+	EXPECT_EQ(vRecords[7].m_Y, 19);
+	EXPECT_STREQ(vRecords[9].m_pString, "too many tees");
+}
+
+TEST_F(TeeHistorian, ReaderGzip)
+{
+	CTestInfo Info;
+	char aFilename[IO_MAX_PATH_LENGTH];
+	Info.Filename(aFilename, sizeof(aFilename), ".teehistorian.gz");
+	IOHANDLE File = io_open(aFilename, IOFLAG_WRITE);
+	ASSERT_TRUE(File);
+	CGzipWriter Gzip(File, 6);
+	m_pGzip = &Gzip;
+
+	Reset(&m_GameInfo);
+	for(int i = 1; i <= 100; i++)
+	{
+		Tick(i);
+		Player(0, i, -i);
+	}
+	Finish();
+	m_pGzip = nullptr;
+	Gzip.Close();
+	ASSERT_EQ(Gzip.Error(), 0);
+
+	File = io_open(aFilename, IOFLAG_READ);
+	ASSERT_TRUE(File);
+	void *pData;
+	unsigned DataSize;
+	ASSERT_TRUE(io_read_all(File, &pData, &DataSize));
+	io_close(File);
+	std::vector<unsigned char> vData((unsigned char *)pData, (unsigned char *)pData + DataSize);
+	free(pData);
+	fs_remove(aFilename);
+
+	CTeeHistorianReader Reader;
+	char aError[128];
+	ASSERT_TRUE(Reader.Load(std::move(vData), aError, sizeof(aError))) << aError;
+	CTeeHistorianReader::CRecord Record;
+	int NumPlayers = 0;
+	while(Reader.Next(&Record) && Record.m_Type == CTeeHistorianReader::RECORD_PLAYER)
+	{
+		NumPlayers++;
+		EXPECT_EQ(Record.m_Tick, NumPlayers);
+		EXPECT_EQ(Record.m_X, NumPlayers);
+		EXPECT_EQ(Record.m_Y, -NumPlayers);
+	}
+	EXPECT_EQ(NumPlayers, 100);
+	EXPECT_EQ(Record.m_Type, CTeeHistorianReader::RECORD_FINISH);
+	EXPECT_FALSE(Reader.Error());
+}
@@ -0,0 +1,437 @@
+#include <base/logger.h>
+#include <base/system.h>
+#include <engine/console.h>
+#include <engine/engine.h>
+#include <engine/map.h>
+#include <engine/server.h>
+#include <engine/server/antibot.h>
+#include <engine/server/databases/connection.h>
+#include <engine/server/register.h>
+#include <engine/server/server.h>
+#include <engine/shared/config.h>
+#include <engine/shared/json.h>
+#include <engine/shared/protocol_ex.h>
+#include <engine/shared/teehistorian_ex.h>
+#include <engine/shared/teehistorian_reader.h>
+#include <engine/storage.h>
+#include <game/server/gamecontext.h>
+#include <game/version.h>
+
+#include <algorithm>
+#include <csignal>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const char *TOOL_NAME = "teehistorian_bench";
+
+volatile sig_atomic_t InterruptSignaled = 0;
+
+bool IsInterrupted()
+{
+	return InterruptSignaled;
+}
+
+static void HandleSigIntTerm(int Param)
+{
+	InterruptSignaled = 1;
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+}
+
+// the null register used while replaying
+class CReplayRegister : public IRegister
+{
+public:
+	void Update() override {}
+	void OnConfigChange() override {}
+	bool OnPacket(const CNetChunk *pPacket) override { return false; }
+	void OnNewInfo(const char *pInfo) override {}
+	void OnShutdown() override {}
+};
+
+// the game server, timing the game's part of the snapshots
+class CReplayGameContext : public CGameContext
+{
+public:
+	// time spent in OnSnap since the last reset
+	int64_t m_SnapTime = 0;
+
+	void OnSnap(int ClientId) override
+	{
+		const int64_t Start = ddnet_time_get();
+		CGameContext::OnSnap(ClientId);
+		m_SnapTime += ddnet_time_get() - Start;
+	}
+};
+
+static void LogReplayTimes(const char *pName, std::vector<int64_t> &vTimes)
+{
+	if(vTimes.empty())
+		return;
+	std::sort(vTimes.begin(), vTimes.end());
+	int64_t Total = 0;
+	for(int64_t Time : vTimes)
+		Total += Time;
+	const auto Micros = [](int64_t Time) { return Time * 1000000.0 / time_freq(); };
+	const auto Percentile = [&](int Percent) { return Micros(vTimes[(vTimes.size() - 1) * Percent / 100]); };
+	log_info("replay", "%-10s n=%d mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus max=%.1fus",
+		pName, (int)vTimes.size(), Micros(Total) / vTimes.size(), Percentile(50), Percentile(90), Percentile(99), Micros(vTimes.back()));
+}
+
+// runs the recorded game of a teehistorian file as fast as possible and
+// prints how long the ticks and snapshots took
+static int RunReplay(CServer *pServer, CReplayGameContext *pGameServer, const char *pFilename)
+{
+	CTeeHistorianReader Reader;
+	{
+		void *pData;
+		unsigned DataSize;
+		if(!pServer->Storage()->ReadFile(pFilename, IStorage::TYPE_ALL_OR_ABSOLUTE, &pData, &DataSize))
+		{
+			log_error("replay", "failed to open teehistorian. filename='%s'", pFilename);
+			return -1;
+		}
+		std::vector<unsigned char> vData((unsigned char *)pData, (unsigned char *)pData + DataSize);
+		free(pData);
+		char aError[128];
+		if(!Reader.Load(std::move(vData), aError, sizeof(aError)))
+		{
+			log_error("replay", "failed to load teehistorian: %s. filename='%s'", aError, pFilename);
+			return -1;
+		}
+	}
+
+	// play with the config the game was recorded with
+	const json_value *pConfig = json_object_get(Reader.Header(), "config");
+	if(pConfig->type == json_object)
+	{
+		for(unsigned i = 0; i < pConfig->u.object.length; i++)
+		{
+			const json_value *pValue = pConfig->u.object.values[i].value;
+			if(pValue->type != json_string)
+				continue;
+			char aLine[1024];
+			str_format(aLine, sizeof(aLine), "%s \"", pConfig->u.object.values[i].name);
+			char *pDst = aLine + str_length(aLine);
+			str_escape(&pDst, json_string_get(pValue), aLine + sizeof(aLine) - 1);
+			str_append(aLine, "\"");
+			pServer->Console()->ExecuteLine(aLine);
+		}
+	}
+	// the replay must not write any files or scores
+	pServer->Config()->m_SvTeeHistorian = 0;
+	pServer->Config()->m_SvAutoDemoRecord = 0;
+	pServer->Config()->m_SvUseSql = 0;
+
+	pServer->InitOffline(new CReplayRegister());
+
+	const char *pMapName = Reader.HeaderString("map_name");
+	if(!pMapName || !pServer->LoadMap(pMapName))
+	{
+		log_error("replay", "failed to load map. mapname='%s'", pMapName ? pMapName : "");
+		return -1;
+	}
+	const char *pMapSha256 = Reader.HeaderString("map_sha256");
+	char aSha256[SHA256_MAXSTRSIZE];
+	sha256_str(pServer->m_aCurrentMapSha256[CServer::MAP_TYPE_SIX], aSha256, sizeof(aSha256));
+	if(pMapSha256 && str_comp(pMapSha256, aSha256) != 0)
+	{
+		log_warn("replay", "map differs from the recorded one, expect desyncs. sha256=%s recorded=%s", aSha256, pMapSha256);
+	}
+
+	// the clients only exist in the replay, but their network slots must be
+	// valid so that everything sent to them is dropped
+	NETADDR BindAddr;
+	net_addr_from_str(&BindAddr, "127.0.0.1:0");
+	if(!pServer->m_NetServer.Open(BindAddr, &pServer->m_ServerBan, MAX_CLIENTS, MAX_CLIENTS))
+	{
+		log_error("replay", "couldn't open socket");
+		return -1;
+	}
+
+	pServer->Antibot()->Init();
+	pServer->GameServer()->OnInit(nullptr);
+	if(pServer->ErrorShutdown())
+	{
+		log_error("replay", "shutdown from game server (%s)", pServer->m_aErrorShutdownReason);
+		pServer->m_NetServer.Close();
+		return -1;
+	}
+
+	struct CRecordedPlayer
+	{
+		bool m_Alive;
+		int m_X;
+		int m_Y;
+	};
+	CRecordedPlayer aRecordedPlayers[MAX_CLIENTS] = {};
+	int aaInputs[MAX_CLIENTS][CTeeHistorianReader::NUM_INPUT_INTS];
+	bool aHasInput[MAX_CLIENTS] = {};
+	bool aJoinSixup[MAX_CLIENTS] = {};
+	auto pAntibotData = std::make_unique<CAntibotRoundData>();
+	int NumDesyncs = 0;
+
+	std::vector<int64_t> vTickTimes;
+	std::vector<int64_t> vSnapTimes;
+	std::vector<int64_t> vDoSnapshotTimes;
+
+	const int StartTick = pServer->Tick();
+	const int64_t StartTime = ddnet_time_get();
+	CTeeHistorianReader::CRecord Record;
+	bool HasRecord = Reader.Next(&Record);
+	while(HasRecord && Record.m_Type != CTeeHistorianReader::RECORD_FINISH && !pServer->ErrorShutdown() && !IsInterrupted())
+	{
+		if(Record.m_Tick > pServer->Tick())
+		{
+			for(int c = 0; c < MAX_CLIENTS; c++)
+			{
+				if(pServer->m_aClients[c].m_State == CServer::CClient::STATE_INGAME)
+					pServer->GameServer()->OnClientPredictedEarlyInput(c, aHasInput[c] ? aaInputs[c] : nullptr);
+			}
+
+			pServer->AdvanceTick();
+
+			for(int c = 0; c < MAX_CLIENTS; c++)
+			{
+				if(pServer->m_aClients[c].m_State == CServer::CClient::STATE_INGAME)
+					pServer->GameServer()->OnClientPredictedInput(c, aHasInput[c] ? aaInputs[c] : nullptr);
+			}
+
+			const int64_t TickStart = ddnet_time_get();
+			pServer->GameServer()->OnTick();
+			vTickTimes.push_back(ddnet_time_get() - TickStart);
+
+			if(pServer->Config()->m_SvHighBandwidth || (pServer->Tick() % 2) == 0)
+			{
+				pGameServer->m_SnapTime = 0;
+				const int64_t SnapshotStart = ddnet_time_get();
+				pServer->DoSnapshot();
+				vDoSnapshotTimes.push_back(ddnet_time_get() - SnapshotStart);
+				vSnapTimes.push_back(pGameServer->m_SnapTime);
+
+				// nobody acknowledges the snapshots, pretend that everyone
+				// did to keep sending deltas like to a real client
+				for(auto &Client : pServer->m_aClients)
+				{
+					if(Client.m_State != CServer::CClient::STATE_INGAME)
+						continue;
+					Client.m_LastAckedSnapshot = pServer->Tick();
+					Client.m_SnapRate = CServer::CClient::SNAPRATE_FULL;
+				}
+			}
+			continue;
+		}
+
+		// the positions at the end of the tick come first
+		while(HasRecord && Record.m_Tick == pServer->Tick() && (Record.m_Type == CTeeHistorianReader::RECORD_PLAYER || Record.m_Type == CTeeHistorianReader::RECORD_PLAYER_OLD))
+		{
+			CRecordedPlayer *pPlayer = &aRecordedPlayers[Record.m_ClientId];
+			pPlayer->m_Alive = Record.m_Type == CTeeHistorianReader::RECORD_PLAYER;
+			pPlayer->m_X = Record.m_X;
+			pPlayer->m_Y = Record.m_Y;
+			HasRecord = Reader.Next(&Record);
+		}
+		if(pServer->Tick() > StartTick)
+		{
+			pServer->GameServer()->FillAntibot(pAntibotData.get());
+			bool Desync = false;
+			for(int i = 0; i < MAX_CLIENTS; i++)
+			{
+				const CAntibotCharacterData *pChar = &pAntibotData->m_aCharacters[i];
+				const CRecordedPlayer *pPlayer = &aRecordedPlayers[i];
+				if(pChar->m_Alive != pPlayer->m_Alive || (pChar->m_Alive && (round_to_int(pChar->m_Pos.x) != pPlayer->m_X || round_to_int(pChar->m_Pos.y) != pPlayer->m_Y)))
+					Desync = true;
+			}
+			if(Desync && NumDesyncs++ == 0)
+			{
+				log_warn("replay", "player positions differ from the recorded ones. tick=%d", pServer->Tick());
+			}
+		}
+
+		// followed by everything that happened until the next tick
+		while(HasRecord && Record.m_Tick == pServer->Tick() && Record.m_Type != CTeeHistorianReader::RECORD_FINISH)
+		{
+			const int ClientId = Record.m_ClientId;
+			CServer::CClient *pClient = &pServer->m_aClients[ClientId];
+			switch(Record.m_Type)
+			{
+			case CTeeHistorianReader::RECORD_JOIN:
+				CServer::NewClientCallback(ClientId, pServer, aJoinSixup[ClientId]);
+				// the connection handshake isn't recorded
+				pClient->m_State = CServer::CClient::STATE_READY;
+				pServer->GameServer()->OnClientConnected(ClientId, nullptr);
+				aHasInput[ClientId] = false;
+				break;
+			case CTeeHistorianReader::RECORD_DROP:
+				if(pClient->m_State != CServer::CClient::STATE_EMPTY)
+					CServer::DelClientCallback(ClientId, Record.m_pString, pServer);
+				break;
+			case CTeeHistorianReader::RECORD_INPUT:
+				mem_copy(aaInputs[ClientId], Record.m_aInput, sizeof(aaInputs[ClientId]));
+				aHasInput[ClientId] = true;
+				break;
+			case CTeeHistorianReader::RECORD_MESSAGE:
+			{
+				if(pClient->m_State < CServer::CClient::STATE_READY)
+					break;
+				CUnpacker Unpacker;
+				Unpacker.Reset(Record.m_pData, Record.m_DataSize);
+				CMsgPacker Packer(NETMSG_EX, true);
+				int Msg;
+				bool Sys;
+				CUuid Uuid;
+				// game messages have the same ids for 0.6 and 0.7 clients
+				if(UnpackMessageId(&Msg, &Sys, &Uuid, &Unpacker, &Packer) == UNPACKMESSAGE_ERROR || Sys)
+					break;
+				pServer->GameServer()->OnMessage(Msg, &Unpacker, ClientId);
+				break;
+			}
+			case CTeeHistorianReader::RECORD_EX:
+			{
+				CUnpacker Unpacker;
+				Unpacker.Reset(Record.m_pData, Record.m_DataSize);
+				const int ExClientId = Unpacker.GetInt();
+				if(Unpacker.Error() || ExClientId < 0 || ExClientId >= MAX_CLIENTS)
+					break;
+				CServer::CClient *pExClient = &pServer->m_aClients[ExClientId];
+				switch(g_UuidManager.LookupUuid(Record.m_Uuid))
+				{
+				case TEEHISTORIAN_JOINVER6:
+				case TEEHISTORIAN_JOINVER7:
+					aJoinSixup[ExClientId] = g_UuidManager.LookupUuid(Record.m_Uuid) == TEEHISTORIAN_JOINVER7;
+					break;
+				case TEEHISTORIAN_PLAYER_READY:
+					if(pExClient->m_State != CServer::CClient::STATE_READY)
+						break;
+					pExClient->m_State = CServer::CClient::STATE_INGAME;
+					pServer->GameServer()->OnClientEnter(ExClientId);
+					break;
+				case TEEHISTORIAN_DDNETVER:
+				{
+					const CUuid *pConnectionId = (const CUuid *)Unpacker.GetRaw(sizeof(CUuid));
+					const int DDNetVersion = Unpacker.GetInt();
+					const char *pDDNetVersionStr = Unpacker.GetString(CUnpacker::SANITIZE_CC);
+					if(Unpacker.Error())
+						break;
+					pExClient->m_ConnectionId = *pConnectionId;
+					pExClient->m_DDNetVersion = DDNetVersion;
+					str_copy(pExClient->m_aDDNetVersionStr, pDDNetVersionStr);
+					pExClient->m_DDNetVersionSettled = true;
+					pExClient->m_GotDDNetVersionPacket = true;
+					break;
+				}
+				}
+				break;
+			}
+			}
+			HasRecord = Reader.Next(&Record);
+		}
+	}
+
+	if(Reader.Error())
+	{
+		log_error("replay", "teehistorian is corrupted after tick %d", pServer->Tick());
+	}
+	const int NumTicks = pServer->Tick() - StartTick;
+	const float Duration = (ddnet_time_get() - StartTime) / (float)time_freq();
+	log_info("replay", "replayed %d ticks in %.2fs, %.1fx faster than real time", NumTicks, Duration, NumTicks / (float)pServer->TickSpeed() / maximum(Duration, 0.001f));
+	log_info("replay", "ticks with desynced player positions: %d", NumDesyncs);
+	LogReplayTimes("Tick", vTickTimes);
+	LogReplayTimes("Snap", vSnapTimes);
+	LogReplayTimes("DoSnapshot", vDoSnapshotTimes);
+	if(pServer->Config()->m_SvSnapshotCache)
+	{
+		const uint64_t Sent = pServer->m_NumSnapshotsSent;
+		log_info("replay", "snapshot cache: %d of %d snapshots shared (%.1f%%)", (int)pServer->m_NumSnapshotsShared, (int)Sent, Sent ? pServer->m_NumSnapshotsShared * 100.0 / Sent : 0.0);
+	}
+
+	for(int i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(pServer->m_aClients[i].m_State != CServer::CClient::STATE_EMPTY)
+			CServer::DelClientCallback(i, "Replay finished", pServer);
+	}
+	pServer->Engine()->ShutdownJobs();
+	pServer->GameServer()->OnShutdown(nullptr);
+	pServer->m_pMap->Unload();
+	pServer->m_NetServer.Close();
+	free(pAntibotData->m_Map.m_pTiles);
+
+	return pServer->ErrorShutdown() || Reader.Error() ? -1 : 0;
+}
+
+int main(int argc, const char **argv)
+{
+	CCmdlineFix CmdlineFix(&argc, &argv);
+	log_set_global_logger_default();
+
+	if(argc < 2)
+	{
+		log_error(TOOL_NAME, "Usage: %s <teehistorian file> [console commands]", TOOL_NAME);
+		log_error(TOOL_NAME, "Replays the recorded game as fast as possible and prints the time spent per tick. The map must be in the maps folder.");
+		return -1;
+	}
+
+	if(secure_random_init() != 0)
+	{
+		log_error("secure", "could not initialize secure RNG");
+		return -1;
+	}
+	if(MysqlInit() != 0)
+	{
+		log_error("mysql", "failed to initialize MySQL library");
+		return -1;
+	}
+
+	signal(SIGINT, HandleSigIntTerm);
+	signal(SIGTERM, HandleSigIntTerm);
+
+	CServer *pServer = CreateServer();
+	IKernel *pKernel = IKernel::Create();
+	pKernel->RegisterInterface(pServer);
+
+	IEngine *pEngine = CreateEngine(GAME_NAME, nullptr, std::thread::hardware_concurrency() + 1);
+	pKernel->RegisterInterface(pEngine);
+
+	IStorage *pStorage = CreateStorage(IStorage::EInitializationType::SERVER, argc, argv);
+	if(!pStorage)
+	{
+		log_error(TOOL_NAME, "failed to initialize storage");
+		return -1;
+	}
+	pKernel->RegisterInterface(pStorage);
+
+	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER | CFGFLAG_ECON).release();
+	pKernel->RegisterInterface(pConsole);
+
+	IConfigManager *pConfigManager = CreateConfigManager();
+	pKernel->RegisterInterface(pConfigManager);
+
+	IEngineMap *pEngineMap = CreateEngineMap();
+	pKernel->RegisterInterface(pEngineMap); // IEngineMap
+	pKernel->RegisterInterface(static_cast<IMap *>(pEngineMap), false);
+
+	IEngineAntibot *pEngineAntibot = CreateEngineAntibot();
+	pKernel->RegisterInterface(pEngineAntibot); // IEngineAntibot
+	pKernel->RegisterInterface(static_cast<IAntibot *>(pEngineAntibot), false);
+
+	CReplayGameContext *pGameServer = new CReplayGameContext;
+	pKernel->RegisterInterface(static_cast<IGameServer *>(pGameServer));
+
+	pEngine->Init();
+	pConsole->Init();
+	pConfigManager->Init();
+	pServer->RegisterCommands();
+
+	// settings that differed from their defaults while recording are
+	// restored from the teehistorian, the others can be set here
+	if(argc > 2)
+		pConsole->ParseArguments(argc - 2, &argv[2]);
+
+	int Ret = RunReplay(pServer, pGameServer, argv[1]);
+
+	delete pKernel;
+	MysqlUninit();
+	secure_random_uninit();
+	return Ret;
+}